@@ -3,13 +3,13 @@
 #include "Microfacet.h"
 
 
-__device__ __inline__ float3 ridge_plane_projection(const float3& w, const float3& u)
+__host__ __device__ __inline__ float3 ridge_plane_projection(const float3& w, const float3& u)
 {
 	float3 w_p = normalize(w - dot(w, u) * u);
 	return w_p;
 }
 
-__device__ __inline__ void ridge_create_onb(const float3& n, float3& u, float3& v, const float& t_x, const float& t_y)
+__host__ __device__ __inline__ void ridge_create_onb(const float3& n, float3& u, float3& v, const float& t_x, const float& t_y)
 {
 	//create_onb(n, u, v);
 	//return;
@@ -25,7 +25,7 @@ __device__ __inline__ void ridge_create_onb(const float3& n, float3& u, float3&
 }
 
 
-__device__ __inline__ void ridge_create_rotate_onb(const float3& n, float3& u, float3& v, const float& rad_angle)
+__host__ __device__ __inline__ void ridge_create_rotate_onb(const float3& n, float3& u, float3& v, const float& rad_angle)
 {
 	float3 u_loc = make_float3(cosf(rad_angle), sinf(rad_angle), 0.0f);
 	float3 v_loc = make_float3(-sinf(rad_angle), cosf(rad_angle), 0.0f);
@@ -34,7 +34,7 @@ __device__ __inline__ void ridge_create_rotate_onb(const float3& n, float3& u, f
 	v = transformToWorld(v_loc, n);
 	
 }
-__device__ __inline__ uint ridge_ridge_side(const float3& w_p, const float3& v, const float& theta_p, const float& slope, float& weight, const float& z)
+__host__ __device__ __inline__ uint ridge_ridge_side(const float3& w_p, const float3& v, const float& theta_p, const float& slope, float& weight, const float& z)
 {
 	//ridge_side=1 if w_p hit the slope, ridge_side = 0 if w_p hit the edge
 	uint ridge_side = dot(w_p, v) > 0;
@@ -52,7 +52,7 @@ __device__ __inline__ uint ridge_ridge_side(const float3& w_p, const float3& v,
 	return ridge_side;
 }
 
-__device__ __inline__ void ridge_get_weight_factors(const float3& w_i, const float3& n, const float3& m, const float3& w_p, const float& ior1_over_ior2, const uint& ridge_side, float& F_r, float& den)
+__host__ __device__ __inline__ void ridge_get_weight_factors(const float3& w_i, const float3& n, const float3& m, const float3& w_p, const float& ior1_over_ior2, const uint& ridge_side, float& F_r, float& den)
 {
 	F_r = fmaxf(0.0f, fresnel_R(fmaxf(0.0f, (dot(w_i, m))), ior1_over_ior2));
 	if (ridge_side){
@@ -64,7 +64,7 @@ __device__ __inline__ void ridge_get_weight_factors(const float3& w_i, const flo
 	}
 }
 
-__device__ __inline__ float ridged_G(const float3& w_p, const float3& n, const float3& m, const float& slope, const uint& ridge_side){
+__host__ __device__ __inline__ float ridged_G(const float3& w_p, const float3& n, const float3& m, const float& slope, const uint& ridge_side){
 
 	float G;
 	uint chi;
@@ -87,7 +87,7 @@ __device__ __inline__ float ridged_G(const float3& w_p, const float3& n, const f
 }
 
 //Beckmann distribution normal sampling in object coordinates
-__device__ __inline__ void ridge_sample_normal(const float3& n, const float3& u, const float3& v,
+__host__ __device__ __inline__ void ridge_sample_normal(const float3& n, const float3& u, const float3& v,
 	float3 &sampled_n, const float slope, const uint& ridge_side, const float roughness, const float z)
 {
 	if (ridge_side == 0){
@@ -112,7 +112,7 @@ __device__ __inline__ void ridge_sample_normal(const float3& n, const float3& u,
 }
 
 //Beckmann anisotropic distribution normal sampling in object coordinates
-__device__ __inline__ void ridge_sample_anisotropic_beckmann_normal(const float3& ideal_m, const float3& u, 
+__host__ __device__ __inline__ void ridge_sample_anisotropic_beckmann_normal(const float3& ideal_m, const float3& u, 
 	const float3& v, float3& m, const float a_u, const float a_v,
 	const float z1, const float z2, const uint ridge_side)
 {
@@ -132,7 +132,7 @@ __device__ __inline__ void ridge_sample_anisotropic_beckmann_normal(const float3
 }
 
 //Beckmann anisotropic distribution normal evaluation in object coordinates
-__device__ __inline__ float ridge_eval_anisotropic_beckmann_D( const float3& ideal_m, const float3& u,
+__host__ __device__ __inline__ float ridge_eval_anisotropic_beckmann_D( const float3& ideal_m, const float3& u,
 	const float3& v, float3& m, const float a_u, const float a_v, const uint ridge_side)
 {
 	float D = 1.0f;
@@ -152,19 +152,19 @@ __device__ __inline__ float ridge_eval_anisotropic_beckmann_D( const float3& ide
 
 
 //Gaussian random number
-__device__ __inline__ float ridge_sample_gaussian(const float& std_dev, const float& mean, const float& z1, const float& z2)
+__host__ __device__ __inline__ float ridge_sample_gaussian(const float& std_dev, const float& mean, const float& z1, const float& z2)
 {
 	return  sqrtf(-2.0f * log(z1)) * cosf(2.0f * M_PIf *z2)*std_dev + mean;
 }
 //Gaussian  distribution evaluation
-__device__ __inline__ float ridge_evaluate_gaussian(const float x, const float& std_dev, const float& mean)
+__host__ __device__ __inline__ float ridge_evaluate_gaussian(const float x, const float& std_dev, const float& mean)
 {
 	float std_dev_sqr = std_dev*std_dev;
 	float x_mean_sqr = (x - mean)*(x - mean);
 	return 1.0f / sqrtf(2.0f * M_PIf * std_dev_sqr) * exp(-x_mean_sqr / (2.0f * std_dev_sqr));
 }
 //Gaussian sample normal
-__device__ __inline__ void ridge_sample_gaussian_normal(const float3& n, const float3& u, const float3& v,
+__host__ __device__ __inline__ void ridge_sample_gaussian_normal(const float3& n, const float3& u, const float3& v,
 	float3 &sampled_n, const float slope, const uint& ridge_side,const float roughness, uint& seed)
 {
 	if (ridge_side == 0){
@@ -192,7 +192,7 @@ __device__ __inline__ void ridge_sample_gaussian_normal(const float3& n, const f
 	sampled_n = normalize(u * sampled_n.x + v * sampled_n.y + n * sampled_n.z);
 }
 //evaluate gaussian distribution
-__device__ __inline__ float ridge_evaluate_gaussian_D(const float3& n, const float3& u, const float3& v,
+__host__ __device__ __inline__ float ridge_evaluate_gaussian_D(const float3& n, const float3& u, const float3& v,
 	float3 &sampled_n, const float slope, const float roughness,  const uint ridge_side )
 {
 	if (ridge_side == 0){
@@ -206,8 +206,8 @@ __device__ __inline__ float ridge_evaluate_gaussian_D(const float3& n, const flo
 	float3 un_proj = ridge_plane_projection(sampled_n, v);
 	float cos_theta = fminf(1.0f, dot(n, vn_proj));
 	float cos_phi = fminf(1.0f, dot(un_proj, n));
-	float theta = acos(abs(cos_theta));
-	float phi = acos(abs(cos_phi));
+	float theta = acos(fabsf(cos_theta));
+	float phi = acos(fabsf(cos_phi));
 	if (dot(v, vn_proj) < 0.0f){
 		theta = -theta;
 	}
@@ -221,7 +221,7 @@ __device__ __inline__ float ridge_evaluate_gaussian_D(const float3& n, const flo
 }
 
 //evaluate beckmann distribution
-__device__ __inline__ float ridge_evaluate_beckmann_D(const float3& n, const float3& u,
+__host__ __device__ __inline__ float ridge_evaluate_beckmann_D(const float3& n, const float3& u,
 	const float3& v, const float3& m,const float slope, const float new_slope, 
 	const float roughness, const uint ridge_side)
 {
@@ -233,7 +233,7 @@ __device__ __inline__ float ridge_evaluate_beckmann_D(const float3& n, const flo
 	//if hit the slope
 	float D = 0.0f;
 	float threshold = 1e-6f;
-	if (dot(n, m) < 0.0f || abs(dot(m,u)) > threshold)
+	if (dot(n, m) < 0.0f || fabsf(dot(m,u)) > threshold)
 	{
 		return D;
 	}
@@ -248,7 +248,7 @@ __device__ __inline__ float ridge_evaluate_beckmann_D(const float3& n, const flo
 }
 
 
-__device__ __inline__ void ridge_sample_BRDF(const float ridge_angle,const float3& u, const float3& v, 
+__host__ __device__ __inline__ void ridge_sample_BRDF(const float ridge_angle,const float3& u, const float3& v, 
 	const float3& n, const float3& w_i, const float3& diffuse_color, const float eta, const float a_u, 
 	const float a_v, uint& seed, float3& m, float3& w_o, float3& brdf)
 {
@@ -298,7 +298,7 @@ __device__ __inline__ void ridge_sample_BRDF(const float ridge_angle,const float
 	//rtPrintf("new %f %f %f %f %f\n", spec_weight, diff_weight, diffuse_color.x, diffuse_color.y, diffuse_color.z);
 }
 
-__device__ __inline__ void ridge_eval_BRDF(const float ridge_angle, const float3& u, const float3& v,
+__host__ __device__ __inline__ void ridge_eval_BRDF(const float ridge_angle, const float3& u, const float3& v,
 	const float3& n, const float3& w_i, const float3& w_l, const float3& diffuse_color, const float eta, const float a_u,
 	const float a_v, uint& seed,  float3& brdf)
 {
@@ -319,14 +319,14 @@ __device__ __inline__ void ridge_eval_BRDF(const float ridge_angle, const float3
 	float G_i_h = ridged_G(w_p_i, n, h, h_slope, ridge_side);
 	float G_l_h = ridged_G(w_p_l, n, h, h_slope, ridge_side);
 	float D = ridge_eval_anisotropic_beckmann_D(ideal_m, u, v, h, a_u, a_v, ridge_side);
-	float h_den = 4 * abs(dot(w_i, n)*dot(w_l, n));
+	float h_den = 4 * fabsf(dot(w_i, n)*dot(w_l, n));
 	float correction_factor = h_den;
 	brdf = (diffuse_color * F_t_i_h * F_t_l_h / M_PIf + F_r_i_h)*  D *  G_i_h*G_l_h / h_den  ;
 
 }
 
 
-__device__ __inline__ float3 sample_sinusoid_normal(const float& a, const float& b, const float& c, const float3& u, const float3& v, const float3& n, uint& seed)
+__host__ __device__ __inline__ float3 sample_sinusoid_normal(const float& a, const float& b, const float& c, const float3& u, const float3& v, const float3& n, uint& seed)
 {
 	float r = rnd_tea(seed);
 	float theta = 2 * M_PIf * rnd(seed);
@@ -342,7 +342,7 @@ __device__ __inline__ float3 sample_sinusoid_normal(const float& a, const float&
 	return normal_vector;
 }
 
-__device__ __inline__ float sinusoid_G(const float3& w_i, const float3& n, const float3& m, const float& wavelength, const float& amplitude, const uint& iterations)
+__host__ __device__ __inline__ float sinusoid_G(const float3& w_i, const float3& n, const float3& m, const float& wavelength, const float& amplitude, const uint& iterations)
 {
 	float G;
 	uint chi;
@@ -374,7 +374,7 @@ __device__ __inline__ float sinusoid_G(const float3& w_i, const float3& n, const
 	return G;
 }
 
-__device__ __inline__ void sinusoid_sample_BRDF(const float2& wavelengths, const float& amplitude, const float3& u, const float3& v,
+__host__ __device__ __inline__ void sinusoid_sample_BRDF(const float2& wavelengths, const float& amplitude, const float3& u, const float3& v,
 	const float3& n, const float3& w_i, const float3& diffuse_color, const float eta, const float a_u,
 	const float a_v, uint& seed, float3& m, float3& w_o, float3& brdf)
 {
@@ -415,7 +415,7 @@ __device__ __inline__ void sinusoid_sample_BRDF(const float2& wavelengths, const
 	
 }
 
-__device__ __inline__ void sinusoid_eval_BRDF(const float2& wavelengths, const float& amplitude, const float3& u, const float3& v,
+__host__ __device__ __inline__ void sinusoid_eval_BRDF(const float2& wavelengths, const float& amplitude, const float3& u, const float3& v,
 	const float3& n, const float3& w_i, const float3& w_l, const float3& diffuse_color, const float eta, const float a_u,
 	const float a_v, uint& seed, float3& brdf)
 {
@@ -456,7 +456,7 @@ __device__ __inline__ void sinusoid_eval_BRDF(const float2& wavelengths, const f
 	float F_t_i_m = 1.0f - fresnel_R(fabsf(cos_i_m), eta);
 	float F_t_o_m = F_t_i_m;
 	diff_weight *= F_t_i_m * F_t_o_m * G_i * G_l * correction_factor;
-	float h_den = 4 * abs(dot(w_i, n)*dot(w_l, n));
+	float h_den = 4 * fabsf(dot(w_i, n)*dot(w_l, n));
 	brdf = (diffuse_color * F_t_i_h * F_t_l_h / M_PIf + F_r_i_h) *  dot(n, h) / M_PIf *  G_i*G_l / h_den;
 	//rtPrintf("brdf %f %f %f \n", brdf.x, brdf.y, brdf.z);
 }
\ No newline at end of file
@@ -0,0 +1,443 @@
+#include "BSSRDFBatch.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "Fresnel.h"
+#include "dipoles/directional_dipole.h"
+#include "dipoles/rough_directional_dipole.h"
+#include "dipoles/standard_dipole.h"
+
+using namespace optix;
+
+namespace
+{
+	// Single lane, the fallback and the tail of the batches
+	struct ScalarFloat
+	{
+		typedef bool Mask;
+		float v;
+		ScalarFloat() {}
+		ScalarFloat(float f) : v(f) {}
+		static ScalarFloat load(const float* p) { return ScalarFloat(*p); }
+		void store(float* p) const { *p = v; }
+	};
+	inline ScalarFloat operator+(ScalarFloat a, ScalarFloat b) { return a.v + b.v; }
+	inline ScalarFloat operator-(ScalarFloat a, ScalarFloat b) { return a.v - b.v; }
+	inline ScalarFloat operator*(ScalarFloat a, ScalarFloat b) { return a.v * b.v; }
+	inline ScalarFloat operator/(ScalarFloat a, ScalarFloat b) { return a.v / b.v; }
+	inline ScalarFloat operator-(ScalarFloat a) { return -a.v; }
+	inline bool operator<(ScalarFloat a, ScalarFloat b) { return a.v < b.v; }
+	inline ScalarFloat select(bool m, ScalarFloat a, ScalarFloat b) { return m ? a : b; }
+	inline ScalarFloat vsqrt(ScalarFloat a) { return sqrtf(a.v); }
+	inline ScalarFloat vmax(ScalarFloat a, ScalarFloat b) { return fmaxf(a.v, b.v); }
+	inline ScalarFloat vexp(ScalarFloat a) { return expf(a.v); }
+
+#if defined(__AVX512F__)
+	struct VectorFloat
+	{
+		typedef __mmask16 Mask;
+		__m512 v;
+		VectorFloat() {}
+		VectorFloat(__m512 f) : v(f) {}
+		VectorFloat(float f) : v(_mm512_set1_ps(f)) {}
+		static VectorFloat load(const float* p) { return _mm512_loadu_ps(p); }
+		void store(float* p) const { _mm512_storeu_ps(p, v); }
+	};
+	inline VectorFloat operator+(VectorFloat a, VectorFloat b) { return _mm512_add_ps(a.v, b.v); }
+	inline VectorFloat operator-(VectorFloat a, VectorFloat b) { return _mm512_sub_ps(a.v, b.v); }
+	inline VectorFloat operator*(VectorFloat a, VectorFloat b) { return _mm512_mul_ps(a.v, b.v); }
+	inline VectorFloat operator/(VectorFloat a, VectorFloat b) { return _mm512_div_ps(a.v, b.v); }
+	inline VectorFloat operator-(VectorFloat a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+	inline __mmask16 operator<(VectorFloat a, VectorFloat b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+	inline VectorFloat select(__mmask16 m, VectorFloat a, VectorFloat b) { return _mm512_mask_blend_ps(m, b.v, a.v); }
+	inline VectorFloat vsqrt(VectorFloat a) { return _mm512_sqrt_ps(a.v); }
+	inline VectorFloat vmax(VectorFloat a, VectorFloat b) { return _mm512_max_ps(a.v, b.v); }
+	inline VectorFloat vfloor(VectorFloat a) { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+	// 2^n for integral n in the normal range
+	inline VectorFloat vexp2i(VectorFloat n) { return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127)), 23)); }
+	const char* VECTOR_ISA = "AVX-512";
+#define BSSRDF_BATCH_VECTOR 16
+#elif defined(__AVX2__)
+	struct VectorFloat
+	{
+		typedef __m256 Mask;
+		__m256 v;
+		VectorFloat() {}
+		VectorFloat(__m256 f) : v(f) {}
+		VectorFloat(float f) : v(_mm256_set1_ps(f)) {}
+		static VectorFloat load(const float* p) { return _mm256_loadu_ps(p); }
+		void store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+	inline VectorFloat operator+(VectorFloat a, VectorFloat b) { return _mm256_add_ps(a.v, b.v); }
+	inline VectorFloat operator-(VectorFloat a, VectorFloat b) { return _mm256_sub_ps(a.v, b.v); }
+	inline VectorFloat operator*(VectorFloat a, VectorFloat b) { return _mm256_mul_ps(a.v, b.v); }
+	inline VectorFloat operator/(VectorFloat a, VectorFloat b) { return _mm256_div_ps(a.v, b.v); }
+	inline VectorFloat operator-(VectorFloat a) { return _mm256_sub_ps(_mm256_setzero_ps(), a.v); }
+	inline __m256 operator<(VectorFloat a, VectorFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	inline VectorFloat select(__m256 m, VectorFloat a, VectorFloat b) { return _mm256_blendv_ps(b.v, a.v, m); }
+	inline VectorFloat vsqrt(VectorFloat a) { return _mm256_sqrt_ps(a.v); }
+	inline VectorFloat vmax(VectorFloat a, VectorFloat b) { return _mm256_max_ps(a.v, b.v); }
+	inline VectorFloat vfloor(VectorFloat a) { return _mm256_floor_ps(a.v); }
+	inline VectorFloat vexp2i(VectorFloat n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127)), 23)); }
+	const char* VECTOR_ISA = "AVX2";
+#define BSSRDF_BATCH_VECTOR 8
+#endif
+
+#ifdef BSSRDF_BATCH_VECTOR
+	// expf of the Cephes library: 2^n times a polynomial on [-ln2/2, ln2/2]
+	inline VectorFloat vexp(VectorFloat x)
+	{
+		x = vmax(x, -87.0f);
+		x = select(x < 88.0f, x, 88.0f);
+		VectorFloat n = vfloor(x*1.44269504088896341f + 0.5f);
+		VectorFloat r = x - n*0.693359375f + n*2.12194440e-4f;
+		VectorFloat p = 1.9875691500e-4f;
+		p = p*r + 1.3981999507e-3f;
+		p = p*r + 8.3334519073e-3f;
+		p = p*r + 4.1665795894e-2f;
+		p = p*r + 1.6666665459e-1f;
+		p = p*r + 5.0000001201e-1f;
+		p = p*r*r + r + 1.0f;
+		return p*vexp2i(n);
+	}
+#endif
+
+	template<typename F>
+	struct Vec3
+	{
+		F x, y, z;
+	};
+
+	template<typename F>
+	inline Vec3<F> make_vec3(F x, F y, F z)
+	{
+		Vec3<F> v = { x, y, z };
+		return v;
+	}
+
+	template<typename F>
+	inline Vec3<F> load_vec3(const float* const p[3], unsigned int i)
+	{
+		return make_vec3(F::load(p[0] + i), F::load(p[1] + i), F::load(p[2] + i));
+	}
+
+	template<typename F>
+	inline Vec3<F> broadcast(const float3& v)
+	{
+		return make_vec3(F(v.x), F(v.y), F(v.z));
+	}
+
+	template<typename F> inline Vec3<F> operator-(const Vec3<F>& a, const Vec3<F>& b) { return make_vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	template<typename F> inline Vec3<F> operator*(F s, const Vec3<F>& a) { return make_vec3(s*a.x, s*a.y, s*a.z); }
+	template<typename F> inline F dot(const Vec3<F>& a, const Vec3<F>& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+	template<typename F> inline Vec3<F> cross(const Vec3<F>& a, const Vec3<F>& b) { return make_vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x); }
+	template<typename F, typename M> inline Vec3<F> select(M m, const Vec3<F>& a, const Vec3<F>& b) { return make_vec3(select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z)); }
+
+	inline float channel(const float3& v, int c)
+	{
+		return (&v.x)[c];
+	}
+
+	// S_infinite of one channel
+	template<typename F>
+	inline F s_infinite(F r_sqr, F x_dot_w12, F no_dot_w12, F x_dot_no, const ScatteringMaterialProperties& properties, int c)
+	{
+		F three_D = channel(properties.three_D, c);
+		F r = vsqrt(r_sqr);
+		F r_tr = channel(properties.transport, c)*r;
+		F r_tr_p1 = r_tr + 1.0f;
+		F T = vexp(-r_tr);
+		F coeff = T/(r*r_sqr);
+		F first = channel(properties.C_phi, c)*(r_sqr*channel(properties.reducedExtinction, c) + r_tr_p1*x_dot_w12)*3.0f;
+		F second = channel(properties.C_E, c)*(three_D*r_tr_p1*no_dot_w12 - (r_tr_p1 + three_D*(3.0f*r_tr_p1 + r_tr*r_tr)/r_sqr*x_dot_w12)*x_dot_no);
+		return coeff*(first - second);
+	}
+
+	// dirpole_bssrdf for the lanes of F starting at sample i
+	template<typename F>
+	inline void dirpole_lanes(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int i,
+		const float3& xo, const float3& no, float* result[3])
+	{
+		Vec3<F> xi = load_vec3<F>(samples.pos, i);
+		Vec3<F> ni = load_vec3<F>(samples.normal, i);
+		Vec3<F> w12 = load_vec3<F>(samples.transmitted, i);
+		Vec3<F> n_o = broadcast<F>(no);
+		Vec3<F> x = broadcast<F>(xo) - xi;
+		F r_sqr = dot(x, x);
+		F dot_x_w12 = dot(x, w12);
+		F mu0 = -dot(n_o, w12);
+		typename F::Mask edge = F(0.0f) < mu0;
+
+		// direction of the virtual source
+		Vec3<F> t = cross(ni, x);
+		t = (1.0f/vsqrt(dot(t, t)))*t;
+		Vec3<F> nistar = select(r_sqr < 1.0e-12f, ni, cross((1.0f/vsqrt(r_sqr))*x, t));
+		Vec3<F> wv = w12 - (2.0f*dot(w12, nistar))*nistar;
+		F x_dot_no = dot(x, n_o);
+		F no_dot_wv = dot(n_o, wv);
+
+		for (int c = 0; c < 3; ++c)
+		{
+			// distance to the real source
+			F de = channel(properties.de, c);
+			F cos_beta = -vsqrt((r_sqr - dot_x_w12*dot_x_w12)/(r_sqr + de*de));
+			F D_prime = select(edge, channel(properties.D, c)*mu0, F(channel(properties.one_over_three_ext, c)));
+			F dr_sqr = r_sqr + D_prime*(D_prime - select(edge, 2.0f*de*cos_beta, F(0.0f)));
+
+			// distance and cosines of the virtual source
+			Vec3<F> xoxv = x - F(channel(properties.two_A_de, c))*nistar;
+			F dv_sqr = dot(xoxv, xoxv);
+
+			F Sr = s_infinite(dr_sqr, dot_x_w12, -mu0, x_dot_no, properties, c);
+			F Sv = s_infinite(dv_sqr, dot(xoxv, wv), no_dot_wv, dot(xoxv, n_o), properties, c);
+			vmax(Sr - Sv, F(0.0f)).store(result[c] + i);
+		}
+	}
+
+	// dipole_bssrdf for the lanes of F starting at sample i
+	template<typename F>
+	inline void dipole_lanes(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int i,
+		const float3& xo, float* result[3])
+	{
+		Vec3<F> x = broadcast<F>(xo) - load_vec3<F>(samples.pos, i);
+		F r_sqr = dot(x, x);
+		for (int c = 0; c < 3; ++c)
+		{
+			F three_D = channel(properties.three_D, c);
+			F extrapolation = 4.0f*channel(properties.A, c)*channel(properties.D, c);
+			F corrected_mean_free = three_D + extrapolation;
+			F transport = channel(properties.transport, c);
+
+			F d_r_sqr = r_sqr + three_D*three_D;
+			F d_r = vsqrt(d_r_sqr);
+			F d_v_sqr = r_sqr + extrapolation*extrapolation;
+			F d_v = vsqrt(d_v_sqr);
+
+			F tr_r = transport*d_r;
+			F S_r = three_D*(1.0f + tr_r)/(d_r_sqr*d_r)*vexp(-tr_r);
+			F tr_v = transport*d_v;
+			F S_v = corrected_mean_free*(1.0f + tr_v)/(d_v_sqr*d_v)*vexp(-tr_v);
+			(S_r + S_v).store(result[c] + i);
+		}
+	}
+
+	// Random points on a plane around the exit point, within a few mean free
+	// paths, with refracted directions into the plane
+	void random_samples(unsigned int count, float radius, unsigned int seed, std::vector<float> components[9], BSSRDFBatchSamples& samples)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		for (int k = 0; k < 9; ++k)
+			components[k].resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			float r = radius*sqrtf(uniform(rng));
+			float phi = 2.0f*M_PIf*uniform(rng);
+			float cos_theta = sqrtf(uniform(rng));
+			float sin_theta = sqrtf(1.0f - cos_theta*cos_theta);
+			float psi = 2.0f*M_PIf*uniform(rng);
+			components[0][i] = r*cosf(phi);
+			components[1][i] = r*sinf(phi);
+			components[2][i] = 0.0f;
+			components[3][i] = 0.0f;
+			components[4][i] = 0.0f;
+			components[5][i] = 1.0f;
+			components[6][i] = sin_theta*cosf(psi);
+			components[7][i] = sin_theta*sinf(psi);
+			components[8][i] = -cos_theta;
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			samples.pos[k] = components[k].data();
+			samples.normal[k] = components[3 + k].data();
+			samples.transmitted[k] = components[6 + k].data();
+		}
+	}
+
+	// Largest error relative to the peak of the reference in each channel
+	float max_error(float* result[3], const std::vector<float3>& reference)
+	{
+		float error = 0.0f;
+		for (int c = 0; c < 3; ++c)
+		{
+			float peak = 0.0f;
+			for (unsigned int i = 0; i < reference.size(); ++i)
+				peak = std::max(peak, channel(reference[i], c));
+			for (unsigned int i = 0; i < reference.size(); ++i)
+				error = std::max(error, fabsf(result[c][i] - channel(reference[i], c)) / peak);
+		}
+		return error;
+	}
+
+	template<typename Evaluate>
+	double evaluations_per_second(unsigned int count, const Evaluate& evaluate)
+	{
+		const int repetitions = 20;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repetitions; ++r)
+			evaluate();
+		std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+		return repetitions*(double)count / seconds.count();
+	}
+}
+
+#ifdef BSSRDF_BATCH_VECTOR
+const unsigned int BSSRDFBatch::WIDTH = BSSRDF_BATCH_VECTOR;
+#else
+const unsigned int BSSRDFBatch::WIDTH = 1;
+#endif
+
+const char* BSSRDFBatch::instructionSet()
+{
+#ifdef BSSRDF_BATCH_VECTOR
+	return VECTOR_ISA;
+#else
+	return "scalar";
+#endif
+}
+
+void BSSRDFBatch::dirpole(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+	const float3& xo, const float3& no, float* result[3])
+{
+	unsigned int i = 0;
+#ifdef BSSRDF_BATCH_VECTOR
+	for (; i + BSSRDF_BATCH_VECTOR <= count; i += BSSRDF_BATCH_VECTOR)
+		dirpole_lanes<VectorFloat>(properties, samples, i, xo, no, result);
+#endif
+	for (; i < count; ++i)
+		dirpole_lanes<ScalarFloat>(properties, samples, i, xo, no, result);
+}
+
+void BSSRDFBatch::dipole(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+	const float3& xo, float* result[3])
+{
+	unsigned int i = 0;
+#ifdef BSSRDF_BATCH_VECTOR
+	for (; i + BSSRDF_BATCH_VECTOR <= count; i += BSSRDF_BATCH_VECTOR)
+		dipole_lanes<VectorFloat>(properties, samples, i, xo, result);
+#endif
+	for (; i < count; ++i)
+		dipole_lanes<ScalarFloat>(properties, samples, i, xo, result);
+}
+
+void BSSRDFBatch::dirpoleScalar(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+	const float3& xo, const float3& no, float* result[3])
+{
+	for (unsigned int i = 0; i < count; ++i)
+		dirpole_lanes<ScalarFloat>(properties, samples, i, xo, no, result);
+}
+
+void BSSRDFBatch::dipoleScalar(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+	const float3& xo, float* result[3])
+{
+	for (unsigned int i = 0; i < count; ++i)
+		dipole_lanes<ScalarFloat>(properties, samples, i, xo, result);
+}
+
+ScatteringMaterialProperties BSSRDFBatch::materialProperties(const float3& absorption, const float3& scattering, const float3& meancosine, float ior)
+{
+	ScatteringMaterialProperties properties;
+	properties.absorption = absorption;
+	properties.scattering = scattering;
+	properties.meancosine = meancosine;
+	properties.relative_ior = ior;
+	properties.ior_real = make_float3(ior);
+	float3 reducedScattering = properties.scattering*(1.0f - properties.meancosine);
+	properties.extinction = properties.scattering + properties.absorption;
+	properties.reducedExtinction = reducedScattering + properties.absorption;
+	properties.deltaEddExtinction = properties.scattering*(1.0f - properties.meancosine*properties.meancosine) + properties.absorption;
+	properties.D = make_float3(1.0f) / (3.0f*properties.reducedExtinction);
+	properties.transport = sqrtf(properties.absorption / properties.D);
+	properties.C_phi = make_float3(C_phi(ior));
+	properties.C_phi_inv = make_float3(C_phi(1.0f / ior));
+	properties.C_E = make_float3(C_E(ior));
+	properties.albedo = properties.scattering / properties.extinction;
+	properties.reducedAlbedo = reducedScattering / properties.reducedExtinction;
+	properties.de = 2.131f*properties.D / sqrtf(properties.reducedAlbedo);
+	properties.A = (1.0f - properties.C_E) / (2.0f*properties.C_phi);
+	properties.three_D = 3.0f*properties.D;
+	properties.two_A_de = 2.0f*properties.A*properties.de;
+	properties.global_coeff = make_float3(1.0f) / (4.0f*properties.C_phi_inv) * 1.0f / (4.0f*M_PIf*M_PIf);
+	properties.one_over_three_ext = make_float3(1.0f) / (3.0f*properties.extinction);
+	properties.mean_transport = (properties.transport.x + properties.transport.y + properties.transport.z) / 3.0f;
+	return properties;
+}
+
+bool BSSRDFBatch::report(std::ostream& out)
+{
+	// single precision with a different order of the operations
+	const float tolerance = 1.0e-4f;
+	const unsigned int count = 1 << 16;
+	const float scale = 100.0f;
+	struct { const char* name; float3 absorption, scattering, meancosine; } materials[] = {
+		{ "apple", make_float3(0.0030f, 0.0034f, 0.0046f), make_float3(2.29f, 2.39f, 1.97f), make_float3(0.0f) },
+		{ "skin", make_float3(0.032f, 0.17f, 0.48f), make_float3(0.74f, 0.88f, 1.01f), make_float3(0.0f) },
+		{ "ketchup", make_float3(0.061f, 0.97f, 1.45f), make_float3(0.18f, 0.07f, 0.03f), make_float3(0.0f) },
+		{ "soymilk", make_float3(0.0001f, 0.0005f, 0.0034f), make_float3(2.433f, 2.714f, 4.563f), make_float3(0.873f, 0.858f, 0.832f) },
+	};
+	const float3 xo = make_float3(0.0f);
+	const float3 no = make_float3(0.0f, 0.0f, 1.0f);
+
+	bool valid = true;
+	out << "BSSRDF batches (" << instructionSet() << ", " << WIDTH << " lanes), " << count << " points per material" << std::endl;
+	out << "  material: max error (dirpole and rough dirpole, dipole), evaluations per second (dirpole device function, batch; dipole device function, batch)" << std::endl;
+	for (const auto& material : materials)
+	{
+		ScatteringMaterialProperties properties = materialProperties(scale*material.absorption, scale*material.scattering, material.meancosine, 1.3f);
+		std::vector<float> components[9];
+		BSSRDFBatchSamples samples;
+		random_samples(count, 10.0f*properties.three_D.x, 7, components, samples);
+		std::vector<float> channels[3];
+		float* result[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			channels[c].resize(count);
+			result[c] = channels[c].data();
+		}
+
+		std::vector<float3> dirpole_reference(count), rough_dirpole_reference(count), dipole_reference(count);
+		auto dirpole_device = [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				float3 xi = make_float3(samples.pos[0][i], samples.pos[1][i], samples.pos[2][i]);
+				float3 ni = make_float3(samples.normal[0][i], samples.normal[1][i], samples.normal[2][i]);
+				float3 w12 = make_float3(samples.transmitted[0][i], samples.transmitted[1][i], samples.transmitted[2][i]);
+				dirpole_reference[i] = dirpole_bssrdf(xi, ni, w12, xo, no, properties);
+			}
+		};
+		auto rough_dirpole_device = [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				float3 xi = make_float3(samples.pos[0][i], samples.pos[1][i], samples.pos[2][i]);
+				float3 ni = make_float3(samples.normal[0][i], samples.normal[1][i], samples.normal[2][i]);
+				float3 w12 = make_float3(samples.transmitted[0][i], samples.transmitted[1][i], samples.transmitted[2][i]);
+				rough_dirpole_reference[i] = rough_dirpole_bssrdf(xi, ni, w12, xo, no, properties);
+			}
+		};
+		auto dipole_device = [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				float3 xi = make_float3(samples.pos[0][i], samples.pos[1][i], samples.pos[2][i]);
+				dipole_reference[i] = dipole_bssrdf(length(xo - xi), properties);
+			}
+		};
+		double dirpole_device_rate = evaluations_per_second(count, dirpole_device);
+		double dirpole_rate = evaluations_per_second(count, [&]() { dirpole(properties, samples, count, xo, no, result); });
+		float dirpole_error = max_error(result, dirpole_reference);
+		rough_dirpole_device();
+		dirpole_error = std::max(dirpole_error, max_error(result, rough_dirpole_reference));
+		double dipole_device_rate = evaluations_per_second(count, dipole_device);
+		double dipole_rate = evaluations_per_second(count, [&]() { dipole(properties, samples, count, xo, result); });
+		float dipole_error = max_error(result, dipole_reference);
+
+		bool material_valid = dirpole_error < tolerance && dipole_error < tolerance;
+		valid = valid && material_valid;
+		out << "  " << material.name << ": " << dirpole_error << " " << dipole_error << (material_valid ? "" : " FAILED") << ", "
+			<< dirpole_device_rate << " " << dirpole_rate << "; " << dipole_device_rate << " " << dipole_rate << std::endl;
+	}
+	return valid;
+}
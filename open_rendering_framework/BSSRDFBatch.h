@@ -0,0 +1,49 @@
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include <ostream>
+#include "structs.h"
+
+// Sample points of a batch in SoA layout, one array of count floats for
+// every component
+struct BSSRDFBatchSamples
+{
+	const float* pos[3];
+	const float* normal[3];
+	// refracted direction of the incident light (PositionSample::transmitted)
+	const float* transmitted[3];
+};
+
+// Host side evaluation of the dipoles for a batch of sample points and a
+// single exit point, for the CPU reference renders and for building the
+// SSS caches. The points are processed WIDTH at a time: 16 when compiled
+// with AVX-512, 8 with AVX2 and 1 otherwise, with the same expressions as
+// the device functions of the dipoles folder. result holds count floats
+// per channel.
+class BSSRDFBatch
+{
+public:
+	static const unsigned int WIDTH;
+	static const char* instructionSet();
+
+	// dirpole_bssrdf, also rough_dirpole_bssrdf which is the same function
+	static void dirpole(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+		const optix::float3& xo, const optix::float3& no, float* result[3]);
+	// dipole_bssrdf of the distance between the samples and xo
+	static void dipole(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+		const optix::float3& xo, float* result[3]);
+	// The same, one point at a time
+	static void dirpoleScalar(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+		const optix::float3& xo, const optix::float3& no, float* result[3]);
+	static void dipoleScalar(const ScatteringMaterialProperties& properties, const BSSRDFBatchSamples& samples, unsigned int count,
+		const optix::float3& xo, float* result[3]);
+
+	// Properties as computed by TranslucentMaterial::computeCoefficients,
+	// without the tabulated profile
+	static ScatteringMaterialProperties materialProperties(const optix::float3& absorption, const optix::float3& scattering,
+		const optix::float3& meancosine, float ior);
+
+	// Compares the batches with the device functions compiled for the host
+	// on the default materials and measures the evaluations per second of
+	// both. Returns false if the relative error exceeds the tolerance.
+	static bool report(std::ostream& out);
+};
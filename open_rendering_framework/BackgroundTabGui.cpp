@@ -103,6 +103,7 @@ void BackgroundTab::updateBackgroundColor()
 	float color_y = this->findChild<QLineEdit*>("bg_color_y")->text().toFloat();
 	float color_z = this->findChild<QLineEdit*>("bg_color_z")->text().toFloat();
 	reinterpret_cast<ConstantBackground*> (optixWindow->getScene()->getBackground())->setBackgroundColor(QVector3D(color_x, color_y, color_z));
+	optixWindow->getScene()->invalidateTranslucentSamples();
 	optixWindow->restartFrame();
 }
 
@@ -118,6 +119,7 @@ void BackgroundTab::updatePath()
 	
 	QLineEdit *pathEdit = this->findChild<QLineEdit*>("envmap_path");
 	pathEdit->setText(path);
+	optixWindow->getScene()->invalidateTranslucentSamples();
 	optixWindow->restartFrame();
 }
 
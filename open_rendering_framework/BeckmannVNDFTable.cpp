@@ -0,0 +1,233 @@
+#include "BeckmannVNDFTable.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <QVector>
+#include <QtConcurrent/QtConcurrent>
+#include "MicrofacetBeckmann.h"
+#include "beckmann_vndf_table.h"
+
+using namespace optix;
+
+namespace
+{
+	// slopes per chi-square test, and bins of erf(slope) per dimension
+	const unsigned int TEST_SAMPLES = 1 << 20;
+	const unsigned int TEST_BINS = 32;
+	// bins with fewer samples are pooled, as the chi-square statistic
+	// needs about five expected samples per bin
+	const unsigned int POOLED_SAMPLES = 10;
+	// probability of rejecting a correct table over all the tests
+	const double SIGNIFICANCE = 0.01;
+	// smallest projected area of the exact sampler, whose slopes are zero
+	// below it
+	const double PROJECTED_AREA_MIN = 1.0e-4;
+	// bounds of the bisection, erf(-SLOPE_MAX) is -1 in double precision
+	const double SLOPE_MAX = 6.0;
+
+	// CDF of slope.x of the visible slopes with unit roughness, as in
+	// beckmann_sample_P22_11
+	struct SlopeCDF
+	{
+		explicit SlopeCDF(double theta_i)
+		{
+			cos_theta = cos(theta_i);
+			sin_theta = sin(theta_i);
+			slope_i = cos_theta / sin_theta;
+			projected_area = 0.5*(erf(slope_i) + 1.0)*cos_theta + 0.5 / sqrt(M_PI)*sin_theta*exp(-slope_i*slope_i);
+		}
+
+		double operator()(double s) const
+		{
+			if (s >= slope_i)
+				return 1.0;
+			return (0.5 / sqrt(M_PI)*sin_theta*exp(-s*s) + cos_theta*(0.5 + 0.5*erf(s))) / projected_area;
+		}
+
+		double cos_theta;
+		double sin_theta;
+		double slope_i;
+		double projected_area;
+	};
+
+	// upper bin of erf(slope) in [lower, upper]
+	unsigned int bin(float slope, float lower, float upper)
+	{
+		float x = (float)((erf(slope) - lower) / (upper - lower));
+		return std::min((unsigned int)(clamp(x, 0.0f, 1.0f)*TEST_BINS), TEST_BINS - 1);
+	}
+
+	// upper tail probability of the chi-square distribution with dof degrees
+	// of freedom, with the approximation of Wilson and Hilferty
+	double chi_square_p_value(double statistic, unsigned int dof)
+	{
+		double k = dof;
+		double z = (pow(statistic / k, 1.0 / 3.0) - (1.0 - 2.0 / (9.0*k))) / sqrt(2.0 / (9.0*k));
+		return 0.5*erfc(z / sqrt(2.0));
+	}
+
+	// Two-sample chi-square test of histograms with the same number of
+	// samples, returns the statistic and its degrees of freedom
+	double chi_square(const std::vector<unsigned int>& a, const std::vector<unsigned int>& b, unsigned int& dof)
+	{
+		double statistic = 0.0;
+		unsigned int pooled_a = 0, pooled_b = 0;
+		unsigned int bins = 0;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			if (a[i] + b[i] < POOLED_SAMPLES)
+			{
+				pooled_a += a[i];
+				pooled_b += b[i];
+				continue;
+			}
+			double d = (double)a[i] - (double)b[i];
+			statistic += d*d / (a[i] + b[i]);
+			++bins;
+		}
+		if (pooled_a + pooled_b > 0)
+		{
+			double d = (double)pooled_a - (double)pooled_b;
+			statistic += d*d / (pooled_a + pooled_b);
+			++bins;
+		}
+		dof = std::max(bins, 2u) - 1;
+		return statistic;
+	}
+}
+
+BeckmannVNDFTable::BeckmannVNDFTable(optix::Context c)
+{
+	context = c;
+	table_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, BECKMANN_VNDF_TABLE_SAMPLES, BECKMANN_VNDF_TABLE_ANGLES);
+	build(static_cast<float*>(table_buffer->map()));
+	table_buffer->unmap();
+
+	table_sampler = context->createTextureSampler();
+	table_sampler->setWrapMode(0, RT_WRAP_CLAMP_TO_EDGE);
+	table_sampler->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE);
+	table_sampler->setWrapMode(2, RT_WRAP_CLAMP_TO_EDGE);
+	table_sampler->setIndexingMode(RT_TEXTURE_INDEX_NORMALIZED_COORDINATES);
+	table_sampler->setReadMode(RT_TEXTURE_READ_ELEMENT_TYPE);
+	table_sampler->setMaxAnisotropy(1.0f);
+	table_sampler->setMipLevelCount(1u);
+	table_sampler->setArraySize(1u);
+	table_sampler->setBuffer(0u, 0u, table_buffer);
+	table_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+	context["beckmann_vndf_texture"]->setTextureSampler(table_sampler);
+}
+
+BeckmannVNDFTable::~BeckmannVNDFTable()
+{
+	table_sampler->destroy();
+	table_buffer->destroy();
+}
+
+void BeckmannVNDFTable::build(float* table)
+{
+	QVector<unsigned int> rows;
+	for (unsigned int j = 0; j < BECKMANN_VNDF_TABLE_ANGLES; ++j)
+		rows.push_back(j);
+	QtConcurrent::blockingMap(rows, [table](unsigned int j) {
+		SlopeCDF cdf(beckmann_vndf_table_angle(j));
+		float* row = table + j*BECKMANN_VNDF_TABLE_SAMPLES;
+		for (unsigned int i = 0; i < BECKMANN_VNDF_TABLE_SAMPLES; ++i)
+		{
+			// the exact sampler returns a zero slope for directions that see
+			// almost none of the surface
+			if (!(cdf.projected_area >= PROJECTED_AREA_MIN))
+			{
+				row[i] = 0.0f;
+				continue;
+			}
+			double z = beckmann_vndf_table_sample(i);
+			double lower = -SLOPE_MAX;
+			double upper = std::min(cdf.slope_i, SLOPE_MAX);
+			for (int k = 0; k < 64; ++k)
+			{
+				double s = 0.5*(lower + upper);
+				if (cdf(s) < z)
+					lower = s;
+				else
+					upper = s;
+			}
+			row[i] = clamp((float)erf(0.5*(lower + upper)), -BECKMANN_VNDF_TABLE_ERF_MAX, BECKMANN_VNDF_TABLE_ERF_MAX);
+		}
+	});
+}
+
+optix::float2 BeckmannVNDFTable::sampleSlope(const float* table, float theta_i, float z1, float z2)
+{
+	float x = clamp(1.0f - sqrtf(std::max(0.0f, 1.0f - z1)), 0.0f, 1.0f)*(BECKMANN_VNDF_TABLE_SAMPLES - 1);
+	float y = clamp(theta_i*M_1_PIf, 0.0f, 1.0f)*(BECKMANN_VNDF_TABLE_ANGLES - 1);
+	unsigned int i = std::min((unsigned int)x, (unsigned int)BECKMANN_VNDF_TABLE_SAMPLES - 2);
+	unsigned int j = std::min((unsigned int)y, (unsigned int)BECKMANN_VNDF_TABLE_ANGLES - 2);
+	float s = x - i;
+	float t = y - j;
+	const float* lower = table + j*BECKMANN_VNDF_TABLE_SAMPLES + i;
+	const float* upper = lower + BECKMANN_VNDF_TABLE_SAMPLES;
+	float erf_x = (1.0f - t)*((1.0f - s)*lower[0] + s*lower[1]) + t*((1.0f - s)*upper[0] + s*upper[1]);
+	float erf_y = clamp(2.0f*z2 - 1.0f, -BECKMANN_VNDF_TABLE_ERF_MAX, BECKMANN_VNDF_TABLE_ERF_MAX);
+	return make_float2((float)erfinv(erf_x), (float)erfinv(erf_y));
+}
+
+bool BeckmannVNDFTable::report(std::ostream& out)
+{
+	// between the rows of the table, from below the surface to normal
+	// incidence
+	const float cosines[] = { -0.7f, -0.3f, 0.05f, 0.33f, 0.6f, 0.85f, 0.97f, 0.999f };
+	const unsigned int count = sizeof(cosines) / sizeof(cosines[0]);
+
+	std::vector<float> table(BECKMANN_VNDF_TABLE_SAMPLES*BECKMANN_VNDF_TABLE_ANGLES);
+	auto start = std::chrono::high_resolution_clock::now();
+	build(table.data());
+	std::chrono::duration<double, std::milli> build_time = std::chrono::high_resolution_clock::now() - start;
+
+	out << "Beckmann visible normals table (" << BECKMANN_VNDF_TABLE_SAMPLES << " samples, " << BECKMANN_VNDF_TABLE_ANGLES << " angles), build time "
+		<< build_time.count() << " ms" << std::endl;
+	out << "  chi-square against beckmann_sample_P22_11, " << TEST_SAMPLES << " slopes each, " << TEST_BINS << "x" << TEST_BINS << " bins of erf(slope): cosine, statistic, degrees of freedom, p-value" << std::endl;
+
+	bool valid = true;
+	std::mt19937 generator(2013);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::vector<float2> exact_z(TEST_SAMPLES), table_z(TEST_SAMPLES);
+	std::vector<float2> exact_slopes(TEST_SAMPLES), table_slopes(TEST_SAMPLES);
+	std::chrono::duration<double, std::milli> exact_time(0.0), table_time(0.0);
+	for (unsigned int c = 0; c < count; ++c)
+	{
+		for (unsigned int s = 0; s < TEST_SAMPLES; ++s)
+		{
+			exact_z[s] = make_float2(uniform(generator), uniform(generator));
+			table_z[s] = make_float2(uniform(generator), uniform(generator));
+		}
+		float theta_i = acosf(cosines[c]);
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int s = 0; s < TEST_SAMPLES; ++s)
+			exact_slopes[s] = beckmann_sample_P22_11(theta_i, exact_z[s].x, exact_z[s].y);
+		exact_time += std::chrono::high_resolution_clock::now() - start;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int s = 0; s < TEST_SAMPLES; ++s)
+			table_slopes[s] = sampleSlope(table.data(), theta_i, table_z[s].x, table_z[s].y);
+		table_time += std::chrono::high_resolution_clock::now() - start;
+
+		float upper = (float)erf(std::min(SlopeCDF(theta_i).slope_i, SLOPE_MAX));
+		std::vector<unsigned int> exact_bins(TEST_BINS*TEST_BINS, 0), table_bins(TEST_BINS*TEST_BINS, 0);
+		for (unsigned int s = 0; s < TEST_SAMPLES; ++s)
+		{
+			++exact_bins[bin(exact_slopes[s].y, -1.0f, 1.0f)*TEST_BINS + bin(exact_slopes[s].x, -1.0f, upper)];
+			++table_bins[bin(table_slopes[s].y, -1.0f, 1.0f)*TEST_BINS + bin(table_slopes[s].x, -1.0f, upper)];
+		}
+		unsigned int dof;
+		double statistic = chi_square(exact_bins, table_bins, dof);
+		double p_value = chi_square_p_value(statistic, dof);
+		bool passed = p_value > SIGNIFICANCE / count;
+		valid = valid && passed;
+		out << "  " << cosines[c] << ": " << statistic << " " << dof << " " << p_value << (passed ? "" : " FAILED") << std::endl;
+	}
+	double samples = (double)count*TEST_SAMPLES;
+	out << "  host throughput: " << samples / exact_time.count() * 1.0e-3 << " Msamples/s (beckmann_sample_P22_11), "
+		<< samples / table_time.count() * 1.0e-3 << " Msamples/s (table), speedup " << exact_time.count() / table_time.count() << std::endl;
+	return valid;
+}
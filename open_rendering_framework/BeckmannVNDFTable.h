@@ -0,0 +1,33 @@
+#pragma once
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+#include <ostream>
+
+// Builds the table of beckmann_vndf_table.h by bisection of the CDF of the
+// visible slopes, and uploads it as a texture
+class BeckmannVNDFTable
+{
+public:
+	// Builds the table and sets the texture in the context
+	explicit BeckmannVNDFTable(optix::Context c);
+	~BeckmannVNDFTable();
+
+	// BECKMANN_VNDF_TABLE_SAMPLES*BECKMANN_VNDF_TABLE_ANGLES entries,
+	// samples first
+	static void build(float* table);
+
+	// Visible slope for the incident angle theta_i, read from the table as
+	// beckmann_sample_P22_11_table
+	static optix::float2 sampleSlope(const float* table, float theta_i, float z1, float z2);
+
+	// Two-sample chi-square tests of the slopes of the table against
+	// beckmann_sample_P22_11 for incident directions between the rows, and
+	// the throughput of both on the host. Returns false if any test rejects
+	// the table.
+	static bool report(std::ostream& out);
+
+protected:
+	optix::Context context;
+	optix::Buffer table_buffer;
+	optix::TextureSampler table_sampler;
+};
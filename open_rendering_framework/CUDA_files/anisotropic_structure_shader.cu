@@ -7,6 +7,7 @@
 #include "../Fresnel.h"
 #include "../AnisotropicStructures.h"
 #include "../MyComplex.h"
+#include "../russian_roulette.h"
 using namespace optix;
 
 
@@ -132,9 +133,12 @@ RT_PROGRAM void closest_hit()
 			prd_new_ray.depth = prd_radiance.depth + 1;
 			prd_new_ray.result = make_float3(0.0f);
 			prd_new_ray.seed = seed;
+			prd_new_ray.sobol = prd_radiance.sobol;
+			prd_new_ray.bsdf_pdf = 0.0f;
 			prd_new_ray.emit_light = 1;
+			prd_new_ray.throughput = prd_radiance.throughput * brdf;
 			optix::Ray new_ray = optix::make_Ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, new_ray, prd_new_ray);
+			trace_radiance(top_object, new_ray, prd_new_ray);
 			prd_radiance.seed = prd_new_ray.seed;
 			//rtPrintf("brdf %f %f %f\n", brdf.x, brdf.y, brdf.z);
 			result += prd_new_ray.result * brdf;
@@ -142,8 +146,9 @@ RT_PROGRAM void closest_hit()
 
 		
 		//direct light
-		uint light_idx = light_buffer.size()*rnd_tea(seed);
-		float light_pdf = 1.0f / light_buffer.size();
+		float u_light = rnd_tea(seed);
+		float light_pdf;
+		uint light_idx = sample_light_index(u_light, light_pdf);
 		LightStruct direct_light = light_buffer[light_idx];
 		float dist;
 		float3 radiance;
@@ -190,9 +195,12 @@ RT_PROGRAM void closest_hit()
 			prd_new_ray.depth = prd_radiance.depth + 1;
 			prd_new_ray.result = make_float3(0.0f);
 			prd_new_ray.seed = seed;
+			prd_new_ray.sobol = prd_radiance.sobol;
+			prd_new_ray.bsdf_pdf = 0.0f;
 			prd_new_ray.emit_light = 1;
+			prd_new_ray.throughput = prd_radiance.throughput * brdf;
 			optix::Ray new_ray = optix::make_Ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, new_ray, prd_new_ray);
+			trace_radiance(top_object, new_ray, prd_new_ray);
 			prd_radiance.seed = prd_new_ray.seed;
 			//rtPrintf("brdf %f %f %f\n", brdf.x, brdf.y, brdf.z);
 			result += prd_new_ray.result * brdf;
@@ -200,8 +208,9 @@ RT_PROGRAM void closest_hit()
 
 
 		//direct light
-		uint light_idx = light_buffer.size()*rnd_tea(seed);
-		float light_pdf = 1.0f / light_buffer.size();
+		float u_light = rnd_tea(seed);
+		float light_pdf;
+		uint light_idx = sample_light_index(u_light, light_pdf);
 		LightStruct direct_light = light_buffer[light_idx];
 		float dist;
 		float3 radiance;
@@ -248,10 +257,13 @@ RT_PROGRAM void closest_hit()
 		PerRayData_radiance prd_diffuse;
 		prd_diffuse.depth = prd_radiance.depth + 1;
 		prd_diffuse.seed = seed;
+		prd_diffuse.sobol = prd_radiance.sobol;
+		prd_diffuse.bsdf_pdf = 0.0f;
 		prd_diffuse.emit_light = prd_radiance.emit_light;
 		prd_diffuse.result = make_float3(0.0f);
+		prd_diffuse.throughput = prd_radiance.throughput * brdf;
 		Ray diffuse_ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-		rtTrace(top_object, diffuse_ray, prd_diffuse);
+		trace_radiance(top_object, diffuse_ray, prd_diffuse);
 		result += prd_diffuse.result * brdf;
 		prd_radiance.seed = prd_diffuse.seed;
 		//float r_10 = two_C1(ior);
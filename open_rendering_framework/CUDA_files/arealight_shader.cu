@@ -1,6 +1,7 @@
 #include <optix_world.h>
-//#include "LightSampler.h"
 #include "../structs.h"
+#include "../LightSampler.h"
+#include "../mis.h"
 
 
 using namespace optix;
@@ -16,6 +17,12 @@ rtDeclareVariable(PerRayData_shadow,   prd_shadow,   rtPayload, );
 // Variables for shading
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, );
 rtDeclareVariable(float3, radiance, , );
+rtDeclareVariable(int, primitive_index, attribute primitive_index, );
+
+// Index of this emitter in light_buffer and of its first triangle in
+// triangle_light_buffer (-1 for disk and spherical lights)
+rtDeclareVariable(uint, light_index, , );
+rtDeclareVariable(int, light_triangle_offset, , );
 
 // Shadow variables
 rtDeclareVariable(float, scene_epsilon, , );
@@ -42,8 +49,17 @@ RT_PROGRAM void closest_hit()
 
   
   float3 result = make_float3(0.0f);
-  if (dot(normal, -ray.direction) > 0.0f && prd_radiance.emit_light) {
-	  result = radiance;
+  if (dot(normal, -ray.direction) > 0.0f) {
+	  if (prd_radiance.emit_light) {
+		  result = radiance;
+	  }
+	  else if (prd_radiance.bsdf_pdf > 0.0f) {
+		  // the shader that spawned the ray also sampled the lights, so weight
+		  // the emission against the pdf of having picked this point that way
+		  int triangle_idx = light_triangle_offset >= 0 ? light_triangle_offset + primitive_index : -1;
+		  float light_pdf = light_sample_pdf(ray.origin, prd_radiance.mis_normal, light_index, triangle_idx, ray.direction, t_hit);
+		  result = radiance * mis_power_heuristic(prd_radiance.bsdf_pdf, light_pdf);
+	  }
   }
   
   prd_radiance.result = result; 
@@ -1,9 +1,12 @@
 #include <optix.h>
 #include <optix_math.h>
 #include "../random.h"
+#include "../sobol.h"
 #include "../structs.h"
 #include "../sampler.h"
 #include "../LightSampler.h"
+#include "../mis.h"
+#include "../russian_roulette.h"
 
 using namespace optix;
 
@@ -52,19 +55,52 @@ RT_PROGRAM void closest_hit()
 	// Emission
 	float3 result = /*prd_radiance.emit_light ? emissive :*/ make_float3(0.0f);
 
-	uint light_idx = light_buffer.size()*rnd_tea(t);
-	float light_pdf = 1.0f / light_buffer.size();
-	LightStruct direct_light = light_buffer[light_idx];
-	
-
 	float dist;
 	float3 radiance;
 	float3 w_l = make_float3(0.0f);
 	float cos_theta = 0.0f;
-
-	evaluate_direct_illumination(hit_pos, &direct_light, w_l, radiance, dist, prd_radiance.seed);
-	radiance /= light_pdf;
+	float sample_pdf;
+	if (ris_candidates > 1)
+	{
+		// resampled direct lighting: radiance is already divided by the pdf
+		LightReservoir reservoir;
+		sample_light_ris(hit_pos, ffnormal, ris_candidates, prd_radiance.depth, prd_radiance.sobol, t, reservoir);
+		evaluate_light_reservoir(hit_pos, ffnormal, reservoir, w_l, radiance, dist, sample_pdf);
+	}
+	else
+	{
+		float u_light;
+		float2 xi_light;
+		if (sobol_sampler)
+		{
+			u_light = sobol_1d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_LIGHT_SELECTION));
+			xi_light = sobol_2d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_LIGHT_POSITION));
+		}
+		else
+		{
+			u_light = rnd_tea(t);
+			xi_light.x = rnd_tea(t);
+			xi_light.y = rnd_tea(t);
+		}
+		float light_pdf;
+		int triangle_idx;
+		uint light_idx = sample_light(hit_pos, ffnormal, u_light, triangle_idx, light_pdf);
+		// the remainder of the light selection sample picks the primitive within the light
+		float3 xi_direct = make_float3(u_light, xi_light.x, xi_light.y);
+		LightStruct direct_light = light_buffer[light_idx];
+
+		float emitter_pdf;
+		evaluate_light_emitter(hit_pos, &direct_light, triangle_idx, w_l, radiance, dist, xi_direct, emitter_pdf);
+		radiance = light_pdf > 0.0f ? radiance / light_pdf : make_float3(0.0f);
+		sample_pdf = light_pdf*emitter_pdf;
+	}
 	cos_theta = dot(ffnormal, w_l);
+	// the indirect ray below is traced with probability prob, which is part
+	// of the pdf of BSDF sampling
+	float prob = (diffuse_color.x + diffuse_color.y + diffuse_color.z) / 3.0f;
+	// emitters that BSDF sampling can also hit are weighted with MIS
+	if (sample_pdf > 0.0f)
+		radiance *= mis_power_heuristic(sample_pdf, prob*fmaxf(cos_theta, 0.0f)*M_1_PIf);
 
 	if (cos_theta > 0.0)
 	{
@@ -82,20 +118,24 @@ RT_PROGRAM void closest_hit()
 
 	// Indirect illumination 
 
-	float prob = 1.0f;
-	prob = (diffuse_color.x + diffuse_color.y + diffuse_color.z) / 3.0f;
-	float xi = rnd_tea(t);
+	float xi = sobol_sampler ? sobol_1d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_BSDF_LOBE)) : rnd_tea(t);
 	if (xi < prob)
 	{
-		float3 new_dir = sample_cosine_weighted(ffnormal, t);
+		float3 new_dir = sobol_sampler ?
+			sample_cosine_weighted(ffnormal, sobol_2d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_BSDF_DIRECTION))) :
+			sample_cosine_weighted(ffnormal, t);
 
 		PerRayData_radiance prd_new;
 		prd_new.depth = prd_radiance.depth + 1;
 		prd_new.seed = t;
+		prd_new.sobol = prd_radiance.sobol;
+		prd_new.bsdf_pdf = prob*dot(ffnormal, new_dir)*M_1_PIf;
+		prd_new.mis_normal = ffnormal;
 		prd_new.result = make_float3(0.0f);
-		prd_new.emit_light = prd_radiance.emit_light;
+		prd_new.emit_light = 0;
+		prd_new.throughput = prd_radiance.throughput*diffuse_color / prob;
 		Ray new_ray(hit_pos, new_dir, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-		rtTrace(top_object, new_ray, prd_new);
+		trace_radiance(top_object, new_ray, prd_new);
 		result += prd_new.result*diffuse_color / prob;
 
 		prd_radiance.seed = prd_new.seed;
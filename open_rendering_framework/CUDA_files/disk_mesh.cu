@@ -37,6 +37,7 @@ rtDeclareVariable(float, radius, , );
 
 rtDeclareVariable(float3, geometric_normal, attribute geometric_normal, );
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, );
+rtDeclareVariable(int, primitive_index, attribute primitive_index, );
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 rtDeclareVariable(float, scene_epsilon, , );
 RT_PROGRAM void disk_intersect(int primIdx)
@@ -55,6 +56,7 @@ RT_PROGRAM void disk_intersect(int primIdx)
 		if (square_dist <= radius*radius) {
 			if (rtPotentialIntersection(t)) {
 				shading_normal = geometric_normal = normal;
+				primitive_index = 0;
 				
 				rtReportIntersection(0);
 			}
@@ -58,8 +58,9 @@ RT_PROGRAM void closest_hit()
 
 
 	//sample light
-	uint light_idx = light_buffer.size()*rnd_tea(t);
-	float light_pdf = 1.0f / light_buffer.size();
+	float u_light = rnd_tea(t);
+	float light_pdf;
+	uint light_idx = sample_light_index(u_light, light_pdf);
 	LightStruct direct_light = light_buffer[light_idx];
 	float dist;
 	float3 radiance;
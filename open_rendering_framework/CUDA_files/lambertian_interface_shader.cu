@@ -5,6 +5,7 @@
 #include "../sampler.h"
 #include "../LightSampler.h"
 #include "../Fresnel.h"
+#include "../russian_roulette.h"
 
 using namespace optix;
 
@@ -79,8 +80,9 @@ RT_PROGRAM void closest_hit()
 	// Direct illumination
 	//for (int i = 0; i < light_buffer.size(); ++i)
 	//{
-	uint light_idx = light_buffer.size()*rnd_tea(t);
-	float light_pdf = 1.0f / light_buffer.size();
+	float u_light = rnd_tea(t);
+	float light_pdf;
+	uint light_idx = sample_light_index(u_light, light_pdf);
 	LightStruct direct_light = light_buffer[light_idx];
 		//LightStruct direct_light = light_buffer[i];
 	float dist;
@@ -143,10 +145,13 @@ RT_PROGRAM void closest_hit()
 		PerRayData_radiance prd_diffuse;
 		prd_diffuse.depth = prd_radiance.depth + 1;
 		prd_diffuse.seed = t;
+		prd_diffuse.sobol = prd_radiance.sobol;
+		prd_diffuse.bsdf_pdf = 0.0f;
 		prd_diffuse.emit_light = prd_radiance.emit_light;
 		prd_diffuse.result = make_float3(0.0f);
+		prd_diffuse.throughput = prd_radiance.throughput * diffuse_color * n1_over_n2 * n1_over_n2 *T_01_r  / (1.0f - diffuse_color * r_10);
 		Ray diffuse_ray(hit_pos, diffuse_dir, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-		rtTrace(top_object, diffuse_ray, prd_diffuse);
+		trace_radiance(top_object, diffuse_ray, prd_diffuse);
 
 		result += prd_diffuse.result * diffuse_color * n1_over_n2 * n1_over_n2 *T_01_r  / (1.0f - diffuse_color * r_10);
 		prd_radiance.seed = prd_diffuse.seed;
@@ -159,10 +164,13 @@ RT_PROGRAM void closest_hit()
 		PerRayData_radiance prd_refl;
 		prd_refl.depth = prd_radiance.depth + 1;
 		prd_refl.seed = prd_radiance.seed;
+		prd_refl.sobol = prd_radiance.sobol;
+		prd_refl.bsdf_pdf = 0.0f;
 		prd_refl.emit_light = 1;
 		prd_refl.result = make_float3(0.0f);
+		prd_refl.throughput = prd_radiance.throughput;
 		Ray refl_ray(hit_pos, refl_dir, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-		rtTrace(top_object, refl_ray, prd_refl);
+		trace_radiance(top_object, refl_ray, prd_refl);
 		result += prd_refl.result ;
 		prd_radiance.seed = prd_refl.seed;
 
@@ -8,6 +8,11 @@
 #include "../Microfacet.h"
 #include "../MyComplex.h"
 #include "../random.h"
+#include "../LightSampler.h"
+#include "../mis.h"
+#include "../russian_roulette.h"
+#include "../sampler.h"
+#include "../energy_compensation.h"
 
 
 using namespace optix;
@@ -33,6 +38,10 @@ rtDeclareVariable(MyComplex3, ior, , );
 rtDeclareVariable(float2, roughness, , );
 rtDeclareVariable(uint, microfacet_model, , );
 rtDeclareVariable(uint, normal_distribution, , );
+// Fresnel reflectance of ior (ConductorFresnel) and its average over the
+// cosine weighted hemisphere
+rtBuffer<float3> fresnel_table_buffer;
+rtDeclareVariable(float3, fresnel_average, , );
 
 // Any hit program for shadows
 RT_PROGRAM void any_hit()
@@ -74,15 +83,106 @@ RT_PROGRAM void closest_hit()
 		prd_new_ray.depth = prd_radiance.depth + 1;
 		prd_new_ray.result = make_float3(0.0f);
 		prd_new_ray.seed = seed;
+		prd_new_ray.sobol = prd_radiance.sobol;
+		prd_new_ray.bsdf_pdf = 0.0f;
 		prd_new_ray.emit_light = 1;
+		prd_new_ray.throughput = prd_radiance.throughput * weight;
 		optix::Ray new_ray = optix::make_Ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-		rtTrace(top_object, new_ray, prd_new_ray);
+		trace_radiance(top_object, new_ray, prd_new_ray);
 
 		result += prd_new_ray.result * weight;
 
 	}
 	else
 	{
+		// ENERGY_COMPENSATION_MODEL adds the multiple scattering lobe of Kulla
+		// and Conty to the visible normals model and samples it, cosine
+		// weighted, with the probability 1 - E_i of the energy it restores
+		float E_i = 1.0f;
+		float E_avg = 1.0f;
+		float3 F_avg = make_float3(0.0f);
+		float alpha = energy_table_alpha(a_x, a_y);
+		if (microfacet_model == ENERGY_COMPENSATION_MODEL)
+		{
+			E_i = conductor_albedo(dot(w_i, ffnormal), alpha, normal_distribution);
+			E_avg = conductor_average_albedo(alpha, normal_distribution);
+			F_avg = fresnel_average;
+		}
+
+		// Direct illumination from area lights, weighted with MIS against the
+		// reflected ray below, which used to be the only way to find them
+		float u_light = rnd_tea(seed);
+		float2 xi_light = make_float2(rnd_tea(seed), rnd_tea(seed));
+		float light_pdf;
+		int triangle_idx;
+		uint light_idx = sample_light(hit_point, ffnormal, u_light, triangle_idx, light_pdf);
+		float3 xi_direct = make_float3(u_light, xi_light.x, xi_light.y);
+		LightStruct direct_light = light_buffer[light_idx];
+		float dist;
+		float3 radiance;
+		float3 w_l = make_float3(0.0f);
+		float emitter_pdf;
+		evaluate_light_emitter(hit_point, &direct_light, triangle_idx, w_l, radiance, dist, xi_direct, emitter_pdf);
+		float cos_theta_l = dot(ffnormal, w_l);
+		float cos_theta_i = dot(w_i, ffnormal);
+		if (light_pdf > 0.0f && emitter_pdf > 0.0f && cos_theta_l > 0.0f && cos_theta_i > 0.0f)
+		{
+			float3 h = normalize(w_i + w_l);
+			float D, G_i_h, G_l_h;
+			if (microfacet_model == WALTER_MODEL)
+			{
+				D = microfacet_distribution_eval(h, ffnormal, a_x, normal_distribution);
+				G_i_h = masking_G1(w_i, h, ffnormal, a_x, normal_distribution);
+				G_l_h = masking_G1(w_l, h, ffnormal, a_x, normal_distribution);
+			}
+			else
+			{
+				D = microfacet_eval_NDF(h, ffnormal, a_x, a_y, normal_distribution);
+				G_i_h = masking_G1(w_i, h, ffnormal, a_x, a_y, normal_distribution);
+				G_l_h = masking_G1(w_l, h, ffnormal, a_x, a_y, normal_distribution);
+			}
+			float3 brdf_cos = fresnel_tabulated_R(dot(w_i, h), fresnel_table_buffer) * D * G_i_h * G_l_h / (4.0f * cos_theta_i);
+			float bsdf_pdf = microfacet_reflection_pdf(w_i, w_l, ffnormal, a_x, a_y, microfacet_model, normal_distribution);
+			if (microfacet_model == ENERGY_COMPENSATION_MODEL)
+			{
+				float E_l = conductor_albedo(cos_theta_l, alpha, normal_distribution);
+				brdf_cos += conductor_multiple_scattering(E_i, E_l, E_avg, F_avg) * cos_theta_l;
+				bsdf_pdf = E_i * bsdf_pdf + (1.0f - E_i) * cos_theta_l * M_1_PIf;
+			}
+			if (fmaxf(brdf_cos) > 0.0f)
+			{
+				PerRayData_shadow shadow_prd;
+				shadow_prd.attenuation = 1.0f;
+				Ray shadow_ray(hit_point, w_l, shadow_ray_type, scene_epsilon, dist - scene_epsilon);
+				rtTrace(top_shadower, shadow_ray, shadow_prd);
+				float w = mis_power_heuristic(light_pdf*emitter_pdf, bsdf_pdf);
+				result += shadow_prd.attenuation * radiance / light_pdf * brdf_cos * w;
+			}
+		}
+
+		if (microfacet_model == ENERGY_COMPENSATION_MODEL && rnd_tea(seed) >= E_i)
+		{
+			// multiple scattering lobe, its weight is F_ms (1 - E_o)/(1 - E_avg)
+			float3 w_o = sample_cosine_weighted(ffnormal, seed);
+			float cos_theta_o = dot(w_o, ffnormal);
+			float E_o = conductor_albedo(cos_theta_o, alpha, normal_distribution);
+			float3 weight = conductor_multiple_scattering(E_i, E_o, E_avg, F_avg) * M_PIf / (1.0f - E_i);
+			PerRayData_radiance prd_new_ray;
+			prd_new_ray.depth = prd_radiance.depth + 1;
+			prd_new_ray.result = make_float3(0.0f);
+			prd_new_ray.seed = seed;
+			prd_new_ray.sobol = prd_radiance.sobol;
+			prd_new_ray.bsdf_pdf = E_i * microfacet_reflection_pdf(w_i, w_o, ffnormal, a_x, a_y, microfacet_model, normal_distribution) + (1.0f - E_i) * cos_theta_o * M_1_PIf;
+			prd_new_ray.mis_normal = ffnormal;
+			prd_new_ray.emit_light = 0;
+			prd_new_ray.throughput = prd_radiance.throughput * weight;
+			optix::Ray scattered_ray = optix::make_Ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
+			trace_radiance(top_object, scattered_ray, prd_new_ray);
+			prd_radiance.seed = prd_new_ray.seed;
+			prd_radiance.result = result + prd_new_ray.result * weight;
+			return;
+		}
+
 		float z1 = rnd_tea(seed);
 		float z2 = rnd_tea(seed);
 		float3 microfacet_normal;
@@ -93,7 +193,7 @@ RT_PROGRAM void closest_hit()
 		{
 			microfacet_sample_normal(ffnormal, microfacet_normal, z1, z2, a_x, normal_distribution);
 		}
-		else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+		else
 		{
 			microfacet_sample_visible_normal(w_i, ffnormal, microfacet_normal, a_x, a_y, z1, z2, normal_distribution);
 		}
@@ -103,7 +203,7 @@ RT_PROGRAM void closest_hit()
 		{
 			G_i_m = masking_G1(w_i, microfacet_normal, ffnormal, a_x, normal_distribution);
 		}
-		else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+		else
 		{
 			G_i_m = masking_G1(w_i, microfacet_normal, ffnormal, a_x, a_y, normal_distribution);
 		}
@@ -114,7 +214,7 @@ RT_PROGRAM void closest_hit()
 			return;
 		}
 		// Compute Fresnel reflectance (R) and reflected and refracted rays
-		float3 F = fresnel_MyComplex_R(w_i, microfacet_normal, eta);
+		float3 F = fresnel_tabulated_R(dot(w_i, microfacet_normal), fresnel_table_buffer);
 		float3 w_o =  -w_i + 2.0f*microfacet_normal*dot(w_i, microfacet_normal);
 
 		float abs_i_m = fabsf(dot(w_i, microfacet_normal));
@@ -124,7 +224,12 @@ RT_PROGRAM void closest_hit()
 		prd_new_ray.depth = prd_radiance.depth + 1;
 		prd_new_ray.result = make_float3(0.0f);
 		prd_new_ray.seed = seed;
-		prd_new_ray.emit_light = 1;
+		prd_new_ray.sobol = prd_radiance.sobol;
+		prd_new_ray.bsdf_pdf = dot(w_o, ffnormal) > 0.0f ? microfacet_reflection_pdf(w_i, w_o, ffnormal, a_x, a_y, microfacet_model, normal_distribution) : 0.0f;
+		if (microfacet_model == ENERGY_COMPENSATION_MODEL && prd_new_ray.bsdf_pdf > 0.0f)
+			prd_new_ray.bsdf_pdf = E_i * prd_new_ray.bsdf_pdf + (1.0f - E_i) * dot(w_o, ffnormal) * M_1_PIf;
+		prd_new_ray.mis_normal = ffnormal;
+		prd_new_ray.emit_light = prd_new_ray.bsdf_pdf > 0.0f ? 0 : 1;
 		optix::Ray reflected_ray = optix::make_Ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
 		float3 weight = F;
 		{
@@ -133,7 +238,7 @@ RT_PROGRAM void closest_hit()
 			{
 				G_o_m_refl = masking_G1(w_o, microfacet_normal, ffnormal, a_x, normal_distribution);
 			}
-			else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+			else
 			{
 				G_o_m_refl = masking_G1(w_o, microfacet_normal, ffnormal, a_x, a_y, normal_distribution);
 			}
@@ -142,15 +247,18 @@ RT_PROGRAM void closest_hit()
 				prd_radiance.result = result;
 				return;
 			}
-			rtTrace(top_object, reflected_ray, prd_new_ray);
 			if (microfacet_model == WALTER_MODEL)
 			{
 				weight *= abs_i_m * G_i_m * G_o_m_refl / (abs_i_n * abs_n_m);
 			}
-			else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+			else
 			{
-				weight *= G_o_m_refl;
+				// visible normals are sampled with the probability E_i, one
+				// without energy compensation
+				weight *= G_o_m_refl / E_i;
 			}
+			prd_new_ray.throughput = prd_radiance.throughput * weight;
+			trace_radiance(top_object, reflected_ray, prd_new_ray);
 
 		}
 		prd_radiance.seed = prd_new_ray.seed;
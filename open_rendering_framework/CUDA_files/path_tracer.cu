@@ -5,6 +5,7 @@
 #include <optix_world.h>
 #include "../structs.h"
 #include "../random.h"
+#include "../sobol.h"
 
 using namespace optix;
 
@@ -48,7 +49,11 @@ RT_PROGRAM void path_tracer()
 	prd.seed = tea<16>(launch_dim.x*launch_index.y + launch_index.x, frame);
 	prd.seed64.seed = make_uint2(tea<16>(launch_dim.x*launch_index.y + launch_index.x, frame), tea<16>(launch_dim.x*launch_index.y + launch_index.x, frame));
 	/*prd.seed64.l = tea<16>(launch_dim.x*launch_index.y + launch_index.x, frame);*/
-	float2 jitter = make_float2(rnd_tea(prd.seed), rnd_tea(prd.seed));
+	if (sobol_sampler)
+		prd.sobol = sobol_init(launch_dim.x*launch_index.y + launch_index.x, frame);
+	prd.bsdf_pdf = 0.0f;
+	prd.throughput = make_float3(1.0f);
+	float2 jitter = sobol_sampler ? sobol_2d(prd.sobol, sobol_camera_slot()) : make_float2(rnd_tea(prd.seed), rnd_tea(prd.seed));
 	float2 ip_coords = (make_float2(launch_index) + jitter) / make_float2(launch_dim) * 2.0f - 1.0f;
 	float3 origin = eye;
 	float3 direction = normalize(ip_coords.x*U + ip_coords.y*V + W);
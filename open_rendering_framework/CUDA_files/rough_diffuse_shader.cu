@@ -1,12 +1,15 @@
 #include <optix.h>
 #include <optix_math.h>
 #include "../random.h"
+#include "../sobol.h"
 #include "../structs.h"
 #include "../sampler.h"
 #include "../LightSampler.h"
 #include "../Fresnel.h"
 #include "../Microfacet.h"
 #include "../MyComplex.h"
+#include "../mis.h"
+#include "../russian_roulette.h"
 using namespace optix;
 
 
@@ -50,6 +53,19 @@ RT_PROGRAM void any_hit()
 	rtTerminateRay();
 }
 
+// Solid angle pdf of the directions sampled by the single scattering model,
+// used for MIS weights only. The lobe is picked with the Fresnel reflectance
+// at the sampled microfacet and the diffuse lobe is centered on it; both are
+// approximated with the macro normal, which keeps the weights consistent
+// between light and BSDF sampling.
+__device__ __inline__ float rough_diffuse_pdf(const float3& w_i, const float3& w_o, const float3& normal, const float a_x, const float a_y, const float R)
+{
+	float cos_theta_o = dot(w_o, normal);
+	if (cos_theta_o <= 0.0f)
+		return 0.0f;
+	return R * microfacet_reflection_pdf(w_i, w_o, normal, a_x, a_y, VISIBLE_NORMALS_MODEL, normal_distribution) + (1.0f - R) * cos_theta_o * M_1_PIf;
+}
+
 // Closest hit program for Lambertian shading using the basic light as a directional source.
 // This one includes shadows.
 RT_PROGRAM void closest_hit()
@@ -81,8 +97,18 @@ RT_PROGRAM void closest_hit()
 	//rtPrintf("scale %f \n", roughness_scale_factor);
 	//sampling microfacet normal
 	float3 microfacet_normal;
-	float z1 = rnd_tea(t);
-	float z2 = rnd_tea(t);
+	float z1, z2;
+	if (sobol_sampler)
+	{
+		float2 xi_normal = sobol_2d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_MICROFACET_NORMAL));
+		z1 = xi_normal.x;
+		z2 = xi_normal.y;
+	}
+	else
+	{
+		z1 = rnd_tea(t);
+		z2 = rnd_tea(t);
+	}
 	microfacet_sample_visible_normal(w_i, ffnormal, microfacet_normal, a_x, a_y, z1, z2, normal_distribution);
 
 	float cos_theta_i = dot(w_i, microfacet_normal);
@@ -97,19 +123,58 @@ RT_PROGRAM void closest_hit()
 	}
 
 	float T_01_i = 1.0f - R_i;
-	// Direct illumination
 
-	uint light_idx = light_buffer.size()*rnd_tea(t);
-	float light_pdf = 1.0f / light_buffer.size();
-	LightStruct direct_light = light_buffer[light_idx];
+	// Fresnel reflectance at the macro normal for the MIS weights
+	float cos_theta_i_n = dot(w_i, ffnormal);
+	float R_n = 1.0f;
+	float sin_theta_n_t_sqr = n1_over_n2*n1_over_n2*(1.0f - cos_theta_i_n*cos_theta_i_n);
+	if (sin_theta_n_t_sqr < 1.0f)
+		R_n = fresnel_R(cos_theta_i_n, sqrtf(1.0f - sin_theta_n_t_sqr), n1_over_n2);
+	// Direct illumination
 
 	float dist;
 	float3 radiance;
 	float3 w_l = make_float3(0.0f);
 	float cos_theta_l = 0.0f;
-	evaluate_direct_illumination(hit_pos, &direct_light, w_l, radiance, dist, prd_radiance.seed);
-	radiance /= light_pdf;
+	float sample_pdf;
+	if (ris_candidates > 1)
+	{
+		// resampled direct lighting: radiance is already divided by the pdf
+		LightReservoir reservoir;
+		sample_light_ris(hit_pos, ffnormal, ris_candidates, prd_radiance.depth, prd_radiance.sobol, t, reservoir);
+		evaluate_light_reservoir(hit_pos, ffnormal, reservoir, w_l, radiance, dist, sample_pdf);
+	}
+	else
+	{
+		float u_light;
+		float2 xi_light;
+		if (sobol_sampler)
+		{
+			u_light = sobol_1d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_LIGHT_SELECTION));
+			xi_light = sobol_2d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_LIGHT_POSITION));
+		}
+		else
+		{
+			u_light = rnd_tea(t);
+			xi_light.x = rnd_tea(t);
+			xi_light.y = rnd_tea(t);
+		}
+		float light_pdf;
+		int triangle_idx;
+		uint light_idx = sample_light(hit_pos, ffnormal, u_light, triangle_idx, light_pdf);
+		// the remainder of the light selection sample picks the primitive within the light
+		float3 xi_direct = make_float3(u_light, xi_light.x, xi_light.y);
+		LightStruct direct_light = light_buffer[light_idx];
+
+		float emitter_pdf;
+		evaluate_light_emitter(hit_pos, &direct_light, triangle_idx, w_l, radiance, dist, xi_direct, emitter_pdf);
+		radiance = light_pdf > 0.0f ? radiance / light_pdf : make_float3(0.0f);
+		sample_pdf = light_pdf*emitter_pdf;
+	}
 	cos_theta_l = dot(ffnormal, w_l);
+	// emitters that BSDF sampling can also hit are weighted with MIS (single scattering only)
+	if (sample_pdf > 0.0f && microfacet_model != MULTISCATTERING_MODEL)
+		radiance *= mis_power_heuristic(sample_pdf, rough_diffuse_pdf(w_i, w_l, ffnormal, a_x, a_y, R_n));
 	if (cos_theta_l > 0.0)
 	{
 		float V = 1.0f;
@@ -181,7 +246,7 @@ RT_PROGRAM void closest_hit()
 	// Indirect illumination 
 
 	float prob = R_i;
-	float xi = rnd_tea(t);
+	float xi = sobol_sampler ? sobol_1d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_BSDF_LOBE)) : rnd_tea(t);
 	if (xi > prob)
 	{
 		if (microfacet_model == MULTISCATTERING_MODEL)
@@ -207,17 +272,22 @@ RT_PROGRAM void closest_hit()
 			PerRayData_radiance prd_diffuse;
 			prd_diffuse.depth = prd_radiance.depth + 1;
 			prd_diffuse.seed = t;
+			prd_diffuse.sobol = prd_radiance.sobol;
+			prd_diffuse.bsdf_pdf = 0.0f;
 			prd_diffuse.emit_light = prd_radiance.emit_light;
 			prd_diffuse.result = make_float3(0.0f);
+			prd_diffuse.throughput = prd_radiance.throughput * n1_over_n2 * n1_over_n2  * T_01_r / (1.0f - diffuse_color * r_10)  * weight;
 			Ray diffuse_ray(hit_pos, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, diffuse_ray, prd_diffuse);
+			trace_radiance(top_object, diffuse_ray, prd_diffuse);
 
 			result += prd_diffuse.result * n1_over_n2 * n1_over_n2  * T_01_r / (1.0f - diffuse_color * r_10)  * weight;
 			prd_radiance.seed = prd_diffuse.seed;
 
 		}
 		else {
-			float3 diffuse_dir = sample_cosine_weighted(microfacet_normal, t);
+			float3 diffuse_dir = sobol_sampler ?
+				sample_cosine_weighted(microfacet_normal, sobol_2d(prd_radiance.sobol, sobol_slot(prd_radiance.depth, SOBOL_BSDF_DIRECTION))) :
+				sample_cosine_weighted(microfacet_normal, t);
 			float cos_theta_r = dot(diffuse_dir, microfacet_normal);
 			float G_o_m = masking_G1(diffuse_dir, microfacet_normal, ffnormal, a_x, a_y, normal_distribution);
 			if (G_o_m < 0.0f) {
@@ -238,10 +308,15 @@ RT_PROGRAM void closest_hit()
 			PerRayData_radiance prd_diffuse;
 			prd_diffuse.depth = prd_radiance.depth + 1;
 			prd_diffuse.seed = t;
-			prd_diffuse.emit_light = prd_radiance.emit_light;
+			prd_diffuse.sobol = prd_radiance.sobol;
+			prd_diffuse.bsdf_pdf = rough_diffuse_pdf(w_i, diffuse_dir, ffnormal, a_x, a_y, R_n);
+			prd_diffuse.mis_normal = ffnormal;
+			// light sampling never reaches directions below the macro surface
+			prd_diffuse.emit_light = prd_diffuse.bsdf_pdf > 0.0f ? 0 : 1;
 			prd_diffuse.result = make_float3(0.0f);
+			prd_diffuse.throughput = prd_radiance.throughput * diffuse_color * n1_over_n2 * n1_over_n2 *T_01_r / (1.0f - diffuse_color * r_10)  * G_o_m;
 			Ray diffuse_ray(hit_pos, diffuse_dir, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, diffuse_ray, prd_diffuse);
+			trace_radiance(top_object, diffuse_ray, prd_diffuse);
 
 			result += prd_diffuse.result * diffuse_color * n1_over_n2 * n1_over_n2 *T_01_r / (1.0f - diffuse_color * r_10)  * G_o_m;
 			prd_radiance.seed = prd_diffuse.seed;
@@ -262,9 +337,12 @@ RT_PROGRAM void closest_hit()
 			prd_new_ray.depth = prd_radiance.depth + 1;
 			prd_new_ray.result = make_float3(0.0f);
 			prd_new_ray.seed = t;
+			prd_new_ray.sobol = prd_radiance.sobol;
+			prd_new_ray.bsdf_pdf = 0.0f;
 			prd_new_ray.emit_light = prd_radiance.emit_light;
+			prd_new_ray.throughput = prd_radiance.throughput;
 			optix::Ray new_ray = optix::make_Ray(hit_pos, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, new_ray, prd_new_ray);
+			trace_radiance(top_object, new_ray, prd_new_ray);
 			result += prd_new_ray.result ;
 		}
 		else {
@@ -278,10 +356,14 @@ RT_PROGRAM void closest_hit()
 			PerRayData_radiance prd_refl;
 			prd_refl.depth = prd_radiance.depth + 1;
 			prd_refl.seed = prd_radiance.seed;
-			prd_refl.emit_light = prd_radiance.emit_light;
+			prd_refl.sobol = prd_radiance.sobol;
+			prd_refl.bsdf_pdf = rough_diffuse_pdf(w_i, refl_dir, ffnormal, a_x, a_y, R_n);
+			prd_refl.mis_normal = ffnormal;
+			prd_refl.emit_light = prd_refl.bsdf_pdf > 0.0f ? 0 : 1;
 			prd_refl.result = make_float3(0.0f);
+			prd_refl.throughput = prd_radiance.throughput * G_o_m;
 			Ray refl_ray(hit_pos, refl_dir, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, refl_ray, prd_refl);
+			trace_radiance(top_object, refl_ray, prd_refl);
 			result += prd_refl.result * G_o_m;
 			prd_radiance.seed = prd_refl.seed;
 		}
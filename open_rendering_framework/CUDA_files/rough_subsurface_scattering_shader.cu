@@ -12,10 +12,13 @@
 #include "../random.h"
 #include "../dipoles/directional_dipole.h"
 #include "../dipoles/standard_dipole.h"
+#include "../dipoles/dipole_profile.h"
 #include "../Fresnel.h"
 #include "../structs.h"
+#include "../compact_sample.h"
 #include "../Microfacet.h"
 #include "../LightSampler.h"
+#include "../russian_roulette.h"
 using namespace optix;
 
 // Standard ray variables
@@ -29,12 +32,15 @@ rtDeclareVariable(int, max_depth, , );
 rtDeclareVariable(ScatteringMaterialProperties, scattering_properties, , );
 
 // Variables for shading
-rtBuffer<PositionSample> samples_output_buffer;
+rtBuffer<CompactPositionSample> compact_samples_buffer;
+rtBuffer<float3> translucent_bbox_buffer;
 rtDeclareVariable(uint, translucent_index, , );
-rtDeclareVariable(uint, samples, , );
+// first sample and number of samples of every translucent object
+rtBuffer<uint2> translucent_sample_buffer;
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, );
 rtDeclareVariable(float3, texcoord, attribute texcoord, );
 rtDeclareVariable(uint, dipole_model, , );
+rtBuffer<float3> dipole_profile_buffer;
 rtDeclareVariable(uint, normal_distribution, , );
 rtDeclareVariable(uint, microfacet_model, , );
 rtDeclareVariable(float2, roughness, , );
@@ -106,12 +112,12 @@ RT_PROGRAM void closest_hit()
 #ifdef DIRECTLIGHT
 
 #ifdef RND_64
-	uint light_idx = light_buffer.size()*rnd_accurate(t64);
+	float u_light = rnd_accurate(t64);
 #else
-	uint light_idx = light_buffer.size()*rnd_tea(t);
+	float u_light = rnd_tea(t);
 #endif
-
-	float light_pdf = 1.0f / light_buffer.size();
+	float light_pdf;
+	uint light_idx = sample_light_index(u_light, light_pdf);
 	LightStruct direct_light = light_buffer[light_idx];
 
 	float dist;
@@ -168,7 +174,7 @@ RT_PROGRAM void closest_hit()
 	}
 #endif
 	//
-	if (microfacet_model == WALTER_MODEL || microfacet_model == VISIBLE_NORMALS_MODEL)
+	if (microfacet_model != MULTISCATTERING_MODEL)
 	{
 #ifdef TRANSMIT
 
@@ -209,11 +215,14 @@ RT_PROGRAM void closest_hit()
 			PerRayData_radiance prd_refracted;
 			prd_refracted.depth = prd_radiance.depth + 1;
 			prd_refracted.seed = t;
+			prd_refracted.sobol = prd_radiance.sobol;
+			prd_refracted.bsdf_pdf = 0.0f;
 			prd_refracted.seed64 = t64;
 			prd_refracted.result = make_float3(0.0f);
 			prd_refracted.emit_light = 1;
+			prd_refracted.throughput = prd_radiance.throughput * beam_T;
 			Ray refracted(hit_pos, w_t, radiance_ray_type, scene_epsilon);
-			rtTrace(top_object, refracted, prd_refracted);
+			trace_radiance(top_object, refracted, prd_refracted);
 			float3 weight = make_float3(1.0f);
 			if (microfacet_model == WALTER_MODEL) {
 				float G_i_m = masking_G1(w_i, microfacet_normal, ffnormal, a_x, normal_distribution);
@@ -240,11 +249,13 @@ RT_PROGRAM void closest_hit()
 		//float chosen_transport_rr = props.mean_transport;
 		float chosen_transport_rr = fminf(props.transport.x, fminf(props.transport.y, props.transport.z));
 		float3 accumulate = make_float3(0.0f);
-		uint N = samples_output_buffer.size();
-		N = samples;
+		uint2 sample_range = translucent_sample_buffer[translucent_index];
+		uint N = sample_range.y;
+		float3 bbox_min = translucent_bbox_buffer[2 * translucent_index];
+		float3 bbox_max = translucent_bbox_buffer[2 * translucent_index + 1];
 		for (uint i = 0; i < N; ++i)
 		{
-			PositionSample& sample = samples_output_buffer[i + translucent_index*N];
+			PositionSample sample = decode_position_sample(compact_samples_buffer[sample_range.x + i], bbox_min, bbox_max);
 			float3 T12 = sample.weight;
 			float3 w12 = sample.transmitted;
 			// compute contribution if sample is non-zero
@@ -252,6 +263,9 @@ RT_PROGRAM void closest_hit()
 			{
 				// Russian roulette
 				float dist = length(hit_pos - sample.pos);
+				// the standard dipole is negligible beyond the effective radius
+				if (dipole_model == STANDARD_DIPOLE && dist >= props.dipole_effective_radius)
+					continue;
 				float exp_term = exp(-dist * chosen_transport_rr);
 				//exp_term = fmaxf(exp_term, 0.000001f);
 #ifdef RND_64
@@ -265,7 +279,7 @@ RT_PROGRAM void closest_hit()
 						accumulate += T12*sample.L*dirpole_bssrdf(sample.pos, sample.normal, w12, hit_pos, normal, props) / exp_term * weight;
 					}
 					else if (dipole_model == STANDARD_DIPOLE) {
-						accumulate += T12*sample.L*dipole_bssrdf(dist, props) / exp_term * weight;
+						accumulate += T12*sample.L*dipole_bssrdf_tabulated(dist, props, dipole_profile_buffer) / exp_term * weight;
 					}
 				}
 				else {
@@ -290,11 +304,14 @@ RT_PROGRAM void closest_hit()
 			PerRayData_radiance prd_reflected;
 			prd_reflected.depth = prd_radiance.depth + 1;
 			prd_reflected.seed = t;
+			prd_reflected.sobol = prd_radiance.sobol;
+			prd_reflected.bsdf_pdf = 0.0f;
 			prd_reflected.seed64 = t64;
 			prd_reflected.result = make_float3(0.0f);
 			prd_reflected.emit_light = prd_radiance.emit_light;
+			prd_reflected.throughput = prd_radiance.throughput * beam_T;
 			Ray reflected(hit_pos, w_r, radiance_ray_type, scene_epsilon);
-			rtTrace(top_object, reflected, prd_reflected);
+			trace_radiance(top_object, reflected, prd_reflected);
 
 
 
@@ -365,10 +382,13 @@ RT_PROGRAM void closest_hit()
 			prd_new_ray.depth = prd_radiance.depth + 1;
 			prd_new_ray.result = make_float3(0.0f);
 			prd_new_ray.seed = t;
+			prd_new_ray.sobol = prd_radiance.sobol;
+			prd_new_ray.bsdf_pdf = 0.0f;
 			prd_new_ray.emit_light = 1;
 			prd_new_ray.seed64 = t64;
+			prd_new_ray.throughput = prd_radiance.throughput * weight * beam_T;
 			optix::Ray new_ray = optix::make_Ray(hit_pos, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, new_ray, prd_new_ray);
+			trace_radiance(top_object, new_ray, prd_new_ray);
 			prd_radiance.seed = prd_new_ray.seed;
 			result += prd_new_ray.result * weight;
 			t = prd_new_ray.seed;
@@ -384,11 +404,13 @@ RT_PROGRAM void closest_hit()
 		//float chosen_transport_rr = props.mean_transport;
 		float chosen_transport_rr = fminf(props.transport.x, fminf(props.transport.y, props.transport.z));
 		float3 accumulate = make_float3(0.0f);
-		uint N = samples_output_buffer.size();
-		N = samples;
+		uint2 sample_range = translucent_sample_buffer[translucent_index];
+		uint N = sample_range.y;
+		float3 bbox_min = translucent_bbox_buffer[2 * translucent_index];
+		float3 bbox_max = translucent_bbox_buffer[2 * translucent_index + 1];
 		for (uint i = 0; i < N; ++i)
 		{
-			PositionSample& sample = samples_output_buffer[i + translucent_index*N];
+			PositionSample sample = decode_position_sample(compact_samples_buffer[sample_range.x + i], bbox_min, bbox_max);
 			float3 T12 = sample.weight;
 			float3 w12 = sample.transmitted;
 			// compute contribution if sample is non-zero
@@ -396,6 +418,9 @@ RT_PROGRAM void closest_hit()
 			{
 				// Russian roulette
 				float dist = length(hit_pos - sample.pos);
+				// the standard dipole is negligible beyond the effective radius
+				if (dipole_model == STANDARD_DIPOLE && dist >= props.dipole_effective_radius)
+					continue;
 				float exp_term = exp(-dist * chosen_transport_rr);
 				//exp_term = fmaxf(exp_term, 0.000001f);
 #ifdef RND_64
@@ -409,7 +434,7 @@ RT_PROGRAM void closest_hit()
 						accumulate += T12*sample.L*dirpole_bssrdf(sample.pos, sample.normal, w12, hit_pos, normal, props) / exp_term * weight;
 					}
 					else if (dipole_model == STANDARD_DIPOLE) {
-						accumulate += T12*sample.L*dipole_bssrdf(dist, props) / exp_term * weight;
+						accumulate += T12*sample.L*dipole_bssrdf_tabulated(dist, props, dipole_profile_buffer) / exp_term * weight;
 					}
 				}
 				else {
@@ -436,10 +461,13 @@ RT_PROGRAM void closest_hit()
 			prd_new_ray.depth = prd_radiance.depth + 1;
 			prd_new_ray.result = make_float3(0.0f);
 			prd_new_ray.seed = t;
+			prd_new_ray.sobol = prd_radiance.sobol;
+			prd_new_ray.bsdf_pdf = 0.0f;
 			prd_new_ray.seed64 = t64;
 			prd_new_ray.emit_light = 1;
+			prd_new_ray.throughput = prd_radiance.throughput * weight * beam_T;
 			optix::Ray new_ray = optix::make_Ray(hit_pos, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-			rtTrace(top_object, new_ray, prd_new_ray);
+			trace_radiance(top_object, new_ray, prd_new_ray);
 			prd_radiance.seed = prd_new_ray.seed;
 			result += prd_new_ray.result * weight;
 			t = prd_new_ray.seed;
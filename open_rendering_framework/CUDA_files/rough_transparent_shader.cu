@@ -9,6 +9,8 @@
 #include "../Microfacet.h"
 #include "../fresnel.h"
 #include "../LightSampler.h"
+#include "../russian_roulette.h"
+#include "../energy_compensation.h"
 
 
 using namespace optix;
@@ -112,9 +114,12 @@ RT_PROGRAM void closest_hit()
 		prd_new_ray.depth = prd_radiance.depth + 1;
 		prd_new_ray.result = make_float3(0.0f);
 		prd_new_ray.seed = t;
+		prd_new_ray.sobol = prd_radiance.sobol;
+		prd_new_ray.bsdf_pdf = 0.0f;
 		prd_new_ray.emit_light = 1;
+		prd_new_ray.throughput = prd_radiance.throughput * weight * beam_T;
 		optix::Ray new_ray = optix::make_Ray(hit_point, w_o, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-		rtTrace(top_object, new_ray, prd_new_ray);
+		trace_radiance(top_object, new_ray, prd_new_ray);
 		prd_radiance.seed = prd_new_ray.seed;
 		result += prd_new_ray.result * weight;
 	}
@@ -124,7 +129,7 @@ RT_PROGRAM void closest_hit()
 		{
 			microfacet_sample_normal(ffnormal, microfacet_normal, z1, z2, roughness, normal_distribution);
 		}
-		else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+		else
 		{
 			microfacet_sample_visible_normal(w_i, ffnormal, microfacet_normal, roughness, roughness, z1, z2, normal_distribution);
 		}
@@ -142,7 +147,7 @@ RT_PROGRAM void closest_hit()
 		{
 			G_i_m = masking_G1(w_i, microfacet_normal, ffnormal, roughness, normal_distribution);
 		}
-		else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+		else
 		{
 			G_i_m = masking_G1(w_i, microfacet_normal, ffnormal, roughness, roughness, normal_distribution);
 		}
@@ -163,6 +168,8 @@ RT_PROGRAM void closest_hit()
 		prd_new_ray.depth = prd_radiance.depth + 1;
 		prd_new_ray.result = make_float3(0.0f);
 		prd_new_ray.seed = t;
+		prd_new_ray.sobol = prd_radiance.sobol;
+		prd_new_ray.bsdf_pdf = 0.0f;
 		prd_new_ray.emit_light = 1;
 		float weight = 1.0f;
 		//Russian Roulette to choose between reflection and refraction
@@ -171,7 +178,7 @@ RT_PROGRAM void closest_hit()
 			{
 				G_o_m_refr = masking_G1(refracted_ray.direction, microfacet_normal, ffnormal, roughness, normal_distribution);
 			}
-			else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+			else
 			{
 				G_o_m_refr = masking_G1(refracted_ray.direction, microfacet_normal, ffnormal, roughness, roughness, normal_distribution);
 			}
@@ -180,15 +187,20 @@ RT_PROGRAM void closest_hit()
 				prd_radiance.result = result;
 				return;
 			}
-			rtTrace(top_object, refracted_ray, prd_new_ray);
 			if (microfacet_model == WALTER_MODEL)
 			{
 				weight = abs_i_m * G_i_m * G_o_m_refr / (abs_i_n * abs_n_m);
 			}
-			else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+			else
 			{
 				weight = G_o_m_refr;
 			}
+			if (microfacet_model == ENERGY_COMPENSATION_MODEL)
+			{
+				weight /= dielectric_albedo(abs_i_n, roughness, 1.0f / ior1_over_ior2, normal_distribution);
+			}
+			prd_new_ray.throughput = prd_radiance.throughput * weight * beam_T;
+			trace_radiance(top_object, refracted_ray, prd_new_ray);
 
 		}
 		else {
@@ -197,7 +209,7 @@ RT_PROGRAM void closest_hit()
 			{
 				G_o_m_refl = masking_G1(reflected_ray.direction, microfacet_normal, ffnormal, roughness, normal_distribution);
 			}
-			else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+			else
 			{
 				G_o_m_refl = masking_G1(reflected_ray.direction, microfacet_normal, ffnormal, roughness, roughness, normal_distribution);
 			}
@@ -206,15 +218,20 @@ RT_PROGRAM void closest_hit()
 				prd_radiance.result = result;
 				return;
 			}
-			rtTrace(top_object, reflected_ray, prd_new_ray);
 			if (microfacet_model == WALTER_MODEL)
 			{
 				weight = abs_i_m * G_i_m * G_o_m_refl / (abs_i_n * abs_n_m);
 			}
-			else if (microfacet_model == VISIBLE_NORMALS_MODEL)
+			else
 			{
 				weight = G_o_m_refl;
 			}
+			if (microfacet_model == ENERGY_COMPENSATION_MODEL)
+			{
+				weight /= dielectric_albedo(abs_i_n, roughness, 1.0f / ior1_over_ior2, normal_distribution);
+			}
+			prd_new_ray.throughput = prd_radiance.throughput * weight * beam_T;
+			trace_radiance(top_object, reflected_ray, prd_new_ray);
 
 		}
 		prd_radiance.seed = prd_new_ray.seed;
@@ -7,21 +7,18 @@
 #include <optix_math.h>
 #include "../helpers.h"
 #include "../random.h"
+#include "../sobol.h"
 #include "../structs.h"
 #include "../sampler.h"
 #include "../Fresnel.h"
 #include "../LightSampler.h"
 #include "../Microfacet.h"
+#include "../compact_sample.h"
+#include "../area_cdf.h"
 using namespace optix;
 #define GLOBAL
 #define RND_64
 
-// Triangle mesh data
-rtBuffer<float3> vertex_buffer;
-rtBuffer<float3> normal_buffer;
-rtBuffer<int3>   vindex_buffer;
-rtBuffer<int3>   nindex_buffer;
-
 // Ray generation variables
 rtDeclareVariable(float, scene_epsilon, , );
 rtDeclareVariable(rtObject, top_shadower, , );
@@ -29,82 +26,126 @@ rtDeclareVariable(rtObject, top_shadower, , );
 #ifdef GLOBAL
 rtDeclareVariable(rtObject, top_object, , );
 #endif
-// SS properties
-rtDeclareVariable(ScatteringMaterialProperties, current_scattering_properties, , );
-rtDeclareVariable(float2, current_roughness, , );
-rtDeclareVariable(uint, current_microfacet_model, , );
-rtDeclareVariable(uint, current_normal_distribution, , );
-rtDeclareVariable(uint, current_material_type, , );
+// Translucent objects, whose samples are stored one after the other
+rtBuffer<TranslucentObjectRecord> translucent_object_buffer;
 
 // Window variables
-rtBuffer<PositionSample> samples_output_buffer;
+rtBuffer<CompactPositionSample> compact_samples_buffer;
+// min and max of the world space bounding box of every translucent object
+rtBuffer<float3> translucent_bbox_buffer;
 rtDeclareVariable(uint, launch_index, rtLaunchIndex, );
-rtDeclareVariable(uint, current_translucent_obj, , );
-rtDeclareVariable(uint, samples, , );
 rtDeclareVariable(uint, frame, , );
-rtDeclareVariable(Matrix4x4, transform_matrix, , );
-rtDeclareVariable(Matrix4x4, normal_matrix, , );
+
+// Triangle area CDFs of the translucent objects (area_cdf.h)
+rtBuffer<float> translucent_area_cdf;
+// Poisson-disk sets of the translucent objects, in world space (SSSPoissonSets)
+rtBuffer<float3> sss_poisson_positions;
+rtBuffer<float3> sss_poisson_normals;
+
+// Index of the object whose samples are relit by launch index idx
+__forceinline__ __device__ uint find_translucent_object(uint idx)
+{
+	uint low = 0;
+	uint high = translucent_object_buffer.size() - 1;
+	while (low < high)
+	{
+		uint middle = (low + high + 1) >> 1;
+		if (translucent_object_buffer[middle].launch_offset <= idx)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	return low;
+}
 
 RT_PROGRAM void sample_camera()
 {
-	uint idx = launch_index + current_translucent_obj*samples;
-	PositionSample& sample = samples_output_buffer[idx];
+	uint object_idx = find_translucent_object(launch_index);
+	const TranslucentObjectRecord& object = translucent_object_buffer[object_idx];
+	uint idx = object.sample_offset + object.refresh_offset + launch_index - object.launch_offset;
+	// only the compact copy is written
+	PositionSample sample;
+	sample.transmitted = sample.weight = sample.L = make_float3(0.0f);
 
-	uint triangles = vindex_buffer.size();
 	uint t = tea<16>(idx, frame);
 #ifdef RND_64
 	Seed64 t64;
 	t64.seed = make_uint2(tea<16>(idx, frame), tea<16>(idx, frame));
-	uint triangle_id = (int)(rnd_accurate(t64) * triangles);
+#endif
+	// every point stands for area/N of the surface: the points are uniform
+	// with pdf 1/area or spread evenly by the Poisson-disk sets
+	float area = object.area;
+	float3 n;
+	if (object.poisson_capacity > 0)
+	{
+		// the point of the Poisson-disk set of the block of the sample
+		uint i = idx - object.sample_offset;
+		uint set = (object.poisson_set + i / object.frame_samples) % SSS_POISSON_SETS;
+		uint point = object.poisson_offset + set*object.poisson_capacity + i % object.frame_samples;
+		sample.pos = sss_poisson_positions[point];
+		n = sss_poisson_normals[point];
+	}
+	else
+	{
+		rtBufferId<float3, 1> vertex_buffer(object.vertex_buffer_id);
+		rtBufferId<float3, 1> normal_buffer(object.normal_buffer_id);
+		rtBufferId<int3, 1> vindex_buffer(object.vindex_buffer_id);
+		rtBufferId<int3, 1> nindex_buffer(object.nindex_buffer_id);
+		const Matrix4x4& transform_matrix = object.transform_matrix;
+		const Matrix4x4& normal_matrix = object.normal_matrix;
+
+		uint triangles = vindex_buffer.size();
+#ifdef RND_64
+		uint triangle_id = sample_area_cdf(translucent_area_cdf, object.area_cdf_offset, triangles, rnd_accurate(t64));
 #else
-	uint triangle_id = (int)(rnd_tea(t) * triangles);
+		uint triangle_id = sample_area_cdf(translucent_area_cdf, object.area_cdf_offset, triangles, rnd_tea(t));
 #endif
 
-	int3 idx_vxt = vindex_buffer[triangle_id];
-	float3 v0 = vertex_buffer[idx_vxt.x];
-	float3 v1 = vertex_buffer[idx_vxt.y];
-	float3 v2 = vertex_buffer[idx_vxt.z];
+		int3 idx_vxt = vindex_buffer[triangle_id];
+		float3 v0 = vertex_buffer[idx_vxt.x];
+		float3 v1 = vertex_buffer[idx_vxt.y];
+		float3 v2 = vertex_buffer[idx_vxt.z];
 
-	v0 = make_float3(transform_matrix * optix::make_float4(v0, 1.0f));
-	v1 = make_float3(transform_matrix * optix::make_float4(v1, 1.0f));
-	v2 = make_float3(transform_matrix * optix::make_float4(v2, 1.0f));
+		v0 = make_float3(transform_matrix * optix::make_float4(v0, 1.0f));
+		v1 = make_float3(transform_matrix * optix::make_float4(v1, 1.0f));
+		v2 = make_float3(transform_matrix * optix::make_float4(v2, 1.0f));
 
-	float3 perp_triangle = cross(v1 - v0, v2 - v0);
-	float area = 0.5f*length(perp_triangle);
-	// sample a point in the triangle
+		float3 perp_triangle = cross(v1 - v0, v2 - v0);
+		// triangles are picked proportionally to their area; sample a point
+		// in the triangle
 
 #ifdef RND_64
-	float xi1 = sqrt(rnd_accurate(t64));
-	float xi2 = rnd_accurate(t64);
+		float xi1 = sqrt(rnd_accurate(t64));
+		float xi2 = rnd_accurate(t64);
 #else
-	float xi1 = sqrt(rnd_tea(t));
-	float xi2 = rnd_tea(t);
+		float xi1 = sqrt(rnd_tea(t));
+		float xi2 = rnd_tea(t);
 #endif
-	float u = 1.0f - xi1;
-	float v = (1.0f - xi2)*xi1;
-	float w = xi1*xi2;
-	float3 pos = u*v0 + v*v1 + w*v2;
-	sample.pos = u*v0 + v*v1 + w*v2;
-	//sample.pos = make_float3(transform_matrix * optix::make_float4(pos, 1.0f));
-	float3 n;
-	// compute the sample normal
-	if (normal_buffer.size() > 0)
-	{
-		int3 nidx_vxt = nindex_buffer[triangle_id];
-		float3 n0 = normal_buffer[nidx_vxt.x];
-		float3 n1 = normal_buffer[nidx_vxt.y];
-		float3 n2 = normal_buffer[nidx_vxt.z];
-		n = normalize(u*n0 + v*n1 + w*n2);
-		n = make_float3(normal_matrix * optix::make_float4(n, 0.0f));
-		n = normalize(n);
-	}
-	else {
-		n = normalize(perp_triangle);
+		float u = 1.0f - xi1;
+		float v = (1.0f - xi2)*xi1;
+		float w = xi1*xi2;
+		float3 pos = u*v0 + v*v1 + w*v2;
+		sample.pos = u*v0 + v*v1 + w*v2;
+		//sample.pos = make_float3(transform_matrix * optix::make_float4(pos, 1.0f));
+		// compute the sample normal
+		if (normal_buffer.size() > 0)
+		{
+			int3 nidx_vxt = nindex_buffer[triangle_id];
+			float3 n0 = normal_buffer[nidx_vxt.x];
+			float3 n1 = normal_buffer[nidx_vxt.y];
+			float3 n2 = normal_buffer[nidx_vxt.z];
+			n = normalize(u*n0 + v*n1 + w*n2);
+			n = make_float3(normal_matrix * optix::make_float4(n, 0.0f));
+			n = normalize(n);
+		}
+		else {
+			n = normalize(perp_triangle);
+		}
 	}
 
 	sample.normal = n;
 
-	float ior = current_scattering_properties.relative_ior;
+	float ior = object.properties.relative_ior;
 	float recip_ior = 1.0f / ior;
 	// evaluate incoming light
 
@@ -118,17 +159,18 @@ RT_PROGRAM void sample_camera()
 	{
 #endif
 
-#ifdef RND_64 
-	uint light_idx = light_buffer.size()*rnd_accurate(t64);
+#ifdef RND_64
+	float u_light = rnd_accurate(t64);
 #else
-	uint light_idx = light_buffer.size()*rnd_tea(t);
+	float u_light = rnd_tea(t);
 #endif
-	float light_pdf = 1.0f / light_buffer.size();
+	float light_pdf;
+	uint light_idx = sample_light_index(u_light, light_pdf);
 	LightStruct direct_light = light_buffer[light_idx];
 	evaluate_direct_illumination(sample.pos, &direct_light, w_i, Le, r, t);
 	sample.dir = w_i;
 
-	if (current_material_type != TRANSLUCENT_SHADER)
+	if (object.material_type != TRANSLUCENT_SHADER)
 	{
 		float3 microfacet_normal;
 #ifdef RND_64
@@ -138,15 +180,15 @@ RT_PROGRAM void sample_camera()
 		float z1 = rnd_tea(t);
 		float z2 = rnd_tea(t);
 #endif
-		float a_x = current_roughness.x;
-		float a_y = current_roughness.y;
-		if (current_microfacet_model == WALTER_MODEL)
+		float a_x = object.roughness.x;
+		float a_y = object.roughness.y;
+		if (object.microfacet_model == WALTER_MODEL)
 		{
-			microfacet_sample_normal(n, microfacet_normal, a_x, z1, z2, current_normal_distribution);
+			microfacet_sample_normal(n, microfacet_normal, a_x, z1, z2, object.normal_distribution);
 		}
 		else
 		{
-			microfacet_sample_visible_normal(w_i, n, microfacet_normal, a_x, a_y, z1, z2, current_normal_distribution);
+			microfacet_sample_visible_normal(w_i, n, microfacet_normal, a_x, a_y, z1, z2, object.normal_distribution);
 
 		}
 		sample.normal = microfacet_normal;
@@ -171,7 +213,7 @@ RT_PROGRAM void sample_camera()
 	{
 		w_i = sample_cosine_weighted(n, t);
 
-		if (current_material_type != TRANSLUCENT_SHADER)
+		if (object.material_type != TRANSLUCENT_SHADER)
 		{
 			float3 microfacet_normal;
 #ifdef RND_64
@@ -181,15 +223,15 @@ RT_PROGRAM void sample_camera()
 			float z1 = rnd_tea(t);
 			float z2 = rnd_tea(t);
 #endif
-			float a_x = current_roughness.x;
-			float a_y = current_roughness.y;
-			if (current_microfacet_model == WALTER_MODEL)
+			float a_x = object.roughness.x;
+			float a_y = object.roughness.y;
+			if (object.microfacet_model == WALTER_MODEL)
 			{
-				microfacet_sample_normal(n, microfacet_normal, a_x, z1, z2, current_normal_distribution);
+				microfacet_sample_normal(n, microfacet_normal, a_x, z1, z2, object.normal_distribution);
 			}
 			else
 			{
-				microfacet_sample_visible_normal(w_i, n, microfacet_normal, a_x, a_y, z1, z2, current_normal_distribution);
+				microfacet_sample_visible_normal(w_i, n, microfacet_normal, a_x, a_y, z1, z2, object.normal_distribution);
 			}
 			sample.normal = microfacet_normal;
 		}
@@ -198,6 +240,10 @@ RT_PROGRAM void sample_camera()
 		prd_new.depth = 0;
 		prd_new.seed = t;
 		prd_new.seed64 = t64;
+		if (sobol_sampler)
+			prd_new.sobol = sobol_init(idx, frame);
+		prd_new.bsdf_pdf = 0.0f;
+		prd_new.throughput = make_float3(1.0f);
 		Ray new_ray(sample.pos, w_i, radiance_ray_type, scene_epsilon);
 		rtTrace(top_object, new_ray, prd_new);
 		t = prd_new.seed;
@@ -211,7 +257,7 @@ RT_PROGRAM void sample_camera()
 	float3 weight = make_float3(1.0f);
 
 //---------------SMOOTH TRANSLUCENT MATERIAL----------------
-	if (current_material_type == TRANSLUCENT_SHADER) {
+	if (object.material_type == TRANSLUCENT_SHADER) {
 		
 		// compute direction of the transmitted lights
 		float cos_theta_i_sqr = cos_theta_i*cos_theta_i;
@@ -219,17 +265,17 @@ RT_PROGRAM void sample_camera()
 		float cos_theta_t = sqrt(1.0f - sin_theta_t_sqr);
 		sample.transmitted = recip_ior*(cos_theta_i*sample.normal - w_i) - sample.normal*cos_theta_t;
 		float3 T12 = make_float3(1.0f - fresnel_R(cos_theta_i, cos_theta_t, recip_ior));
-		//T12 *= current_scattering_properties.C_phi * 4.0f;
+		//T12 *= object.properties.C_phi * 4.0f;
 		weight *= T12;
 		sample.weight = weight;
-		sample.L = Le*(triangles*area);
+		sample.L = Le*area;
 
 	} 
 //---------------ROUGH TRANSLUCENT MATERIAL----------------
-	else if (current_material_type == ROUGH_TRANSLUCENT_SHADER) {
+	else if (object.material_type == ROUGH_TRANSLUCENT_SHADER) {
 
-		float a_x = current_roughness.x;
-		float a_y = current_roughness.y;
+		float a_x = object.roughness.x;
+		float a_y = object.roughness.y;
 		// compute direction of the transmitted lights
 		float cos_theta_i_sqr = cos_theta_i*cos_theta_i;
 		float sin_theta_t_sqr = recip_ior*recip_ior*(1.0f - cos_theta_i_sqr);
@@ -237,33 +283,34 @@ RT_PROGRAM void sample_camera()
 		sample.transmitted = recip_ior*(cos_theta_i*sample.normal - w_i) - sample.normal*cos_theta_t;
 		float3 T12 = make_float3(1.0f - fresnel_R(cos_theta_i, cos_theta_t, recip_ior));
 		
-		if (current_microfacet_model == WALTER_MODEL) {
-			float G_i_m = masking_G1(w_i, sample.normal, n, a_x, a_y, current_normal_distribution);
+		if (object.microfacet_model == WALTER_MODEL) {
+			float G_i_m = masking_G1(w_i, sample.normal, n, a_x, a_y, object.normal_distribution);
 			float abs_i_m = fabsf(dot(w_i, sample.normal));
 			float abs_i_n = fabsf(dot(w_i, n));
 			float abs_n_m = fabsf(dot(n, sample.normal));
-			float G_o_m = masking_G1(sample.transmitted, sample.normal, n, a_x, a_y, current_normal_distribution);
+			float G_o_m = masking_G1(sample.transmitted, sample.normal, n, a_x, a_y, object.normal_distribution);
 			weight *= abs_i_m * G_i_m / (abs_i_n * abs_n_m) * G_o_m;
 			weight *= T12;
 		}
-		else if (current_microfacet_model == VISIBLE_NORMALS_MODEL)
+		else if (object.microfacet_model == VISIBLE_NORMALS_MODEL || object.microfacet_model == ENERGY_COMPENSATION_MODEL)
 		{
-			float G_o_m = masking_G1(sample.transmitted, sample.normal, n, a_x, a_y, current_normal_distribution);
+			float G_o_m = masking_G1(sample.transmitted, sample.normal, n, a_x, a_y, object.normal_distribution);
 			weight *= G_o_m;
 			weight *= T12;
 		}
-		else if (current_microfacet_model == MULTISCATTERING_MODEL) {
-			//weight *= microfacet_multiscattering_dielectric_BSDF_eval(w_i, sample.transmitted, n, recip_ior, a_x, a_y, t, 0, current_normal_distribution);
-			float G_i_m = masking_G1(w_i, sample.normal, n, a_x, a_y, current_normal_distribution);
-			float D = microfacet_eval_visible_normal(w_i, sample.normal, n, a_x, a_y, current_normal_distribution);
+		else if (object.microfacet_model == MULTISCATTERING_MODEL) {
+			//weight *= microfacet_multiscattering_dielectric_BSDF_eval(w_i, sample.transmitted, n, recip_ior, a_x, a_y, t, 0, object.normal_distribution);
+			float G_i_m = masking_G1(w_i, sample.normal, n, a_x, a_y, object.normal_distribution);
+			float D = microfacet_eval_visible_normal(w_i, sample.normal, n, a_x, a_y, object.normal_distribution);
 			float microfacet_pdf = G_i_m  * D  *fabsf(dot(w_i, sample.normal)) / fabsf(dot(w_i, n));
 			weight *=  (T12);
 
 		}
 		//rtPrintf("weight %f %f %f \n", weight.x, weight.y, weight.z);
-		//weight *= current_scattering_properties.C_phi * 4.0f;	
+		//weight *= object.properties.C_phi * 4.0f;	
 		sample.weight = weight;
-		sample.L = Le*(triangles*area);
+		sample.L = Le*area;
 	}
+	compact_samples_buffer[idx] = encode_position_sample(sample, translucent_bbox_buffer[2 * object_idx], translucent_bbox_buffer[2 * object_idx + 1]);
 }
 
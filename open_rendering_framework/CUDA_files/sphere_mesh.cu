@@ -36,6 +36,7 @@ rtDeclareVariable(float, radius, , );
 
 rtDeclareVariable(float3, geometric_normal, attribute geometric_normal, );
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, );
+rtDeclareVariable(int, primitive_index, attribute primitive_index, );
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 rtDeclareVariable(float, scene_epsilon, , );
 
@@ -76,6 +77,7 @@ RT_PROGRAM void sphere_intersect(int primIdx)
 		bool check_second = true;
 		if (rtPotentialIntersection(root1 + root11)) {
 			shading_normal = geometric_normal = (O + (root1 + root11)*D) / radius;
+			primitive_index = 0;
 
 			if (rtReportIntersection(0))
 				check_second = false;
@@ -84,6 +86,7 @@ RT_PROGRAM void sphere_intersect(int primIdx)
 			float root2 = (-b + sdisc) + (do_refine ? root1 : 0);
 			if (rtPotentialIntersection(root2)) {
 				shading_normal = geometric_normal = (O + root2*D) / radius;
+				primitive_index = 0;
 
 				rtReportIntersection(0);
 			}
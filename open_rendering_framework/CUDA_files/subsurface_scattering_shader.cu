@@ -13,8 +13,15 @@
 #include "../random.h"
 #include "../dipoles/directional_dipole.h"
 #include "../dipoles/standard_dipole.h"
+#include "../dipoles/dipole_profile.h"
+#include "../dipoles/bssrdf_sampling.h"
+#include "../dipoles/photon_beam_diffusion.h"
 #include "../Fresnel.h"
 #include "../structs.h"
+#include "../compact_sample.h"
+#include "../russian_roulette.h"
+#include "../sss_octree.h"
+#include "../LightSampler.h"
 
 using namespace optix;
 
@@ -23,26 +30,180 @@ rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 rtDeclareVariable(float, t_hit, rtIntersectionDistance, );
 rtDeclareVariable(PerRayData_radiance, prd_radiance, rtPayload, );
 rtDeclareVariable(PerRayData_shadow, prd_shadow, rtPayload, );
+rtDeclareVariable(PerRayData_probe, prd_probe, rtPayload, );
 rtDeclareVariable(int, max_depth, , );
 
 // SS properties
 rtDeclareVariable(ScatteringMaterialProperties, scattering_properties, , );
 
 // Variables for shading
-rtBuffer<PositionSample> samples_output_buffer;
+rtBuffer<CompactPositionSample> compact_samples_buffer;
+rtBuffer<float3> translucent_bbox_buffer;
 rtDeclareVariable(uint, translucent_index, , );
-rtDeclareVariable(uint, samples, , );
+// first sample and number of samples of every translucent object
+rtBuffer<uint2> translucent_sample_buffer;
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, );
 rtDeclareVariable(float3, texcoord, attribute texcoord, );
 rtDeclareVariable(uint, dipole_model, , );
+rtBuffer<float3> dipole_profile_buffer;
+rtBuffer<float3> pbd_table_buffer;
+rtBuffer<SSSOctreeNode> sss_octree_buffer;
+rtBuffer<uint> sss_octree_sample_buffer;
+rtBuffer<uint2> sss_octree_object_buffer;
+rtDeclareVariable(float, sss_octree_max_solid_angle, , );
+rtDeclareVariable(uint, sss_estimator, , );
+rtBuffer<float3> dipole_cdf_buffer;
+// the object, which is the only one crossed by the probe rays
+rtDeclareVariable(rtObject, sss_probe_object, , );
 
 #if defined REFLECT || defined TRANSMIT
 // Recursive ray tracing variables
 rtDeclareVariable(float, scene_epsilon, , );
 rtDeclareVariable(rtObject, top_object, , );
+rtDeclareVariable(rtObject, top_shadower, , );
 //rtDeclareVariable(unsigned int, radiance_ray_type, , );
 #endif
 
+// BSSRDF times the transmitted power of a sample or of an octree node
+struct SSSOctreeEval
+{
+	float3 xo;
+	float3 no;
+	ScatteringMaterialProperties props;
+
+	__device__ __inline__ float3 operator()(const float3& pos, const float3& normal, const float3& transmitted, const float3& power) const
+	{
+		if (dipole_model == DIRECTIONAL_DIPOLE)
+			return power*dirpole_bssrdf(pos, normal, transmitted, xo, no, props);
+		else if (dipole_model == STANDARD_DIPOLE)
+			return power*dipole_bssrdf_tabulated(length(xo - pos), props, dipole_profile_buffer);
+		else if (dipole_model == PHOTON_BEAM_DIFFUSION)
+			return power*pbd_bssrdf_tabulated(length(xo - pos), transmitted, normal, props, pbd_table_buffer);
+		return make_float3(0.0f);
+	}
+};
+
+// Samples of an object decoded from compact_samples_buffer, for sss_octree_gather
+struct SSSOctreeSamples
+{
+	float3 bbox_min;
+	float3 bbox_max;
+
+	__device__ __inline__ PositionSample operator[](uint i) const
+	{
+		return decode_position_sample(compact_samples_buffer[i], bbox_min, bbox_max);
+	}
+};
+
+__device__ __inline__ float sss_rnd(uint& t, Seed64& t64)
+{
+#ifdef RND_64
+	return rnd_accurate(t64);
+#else
+	return rnd_tea(t);
+#endif
+}
+
+// Light transported to xo from one entry point found by a probe ray
+// (dipoles/bssrdf_sampling.h). The entry point is lit as a sample of the
+// sample pass, by a light sample or by an indirect ray with probability one
+// half each, and weighted by the inverse of its pdf instead of the area of
+// the object over the number of samples.
+__device__ __inline__ float3 sss_probe(const float3& xo, const float3& no, const ScatteringMaterialProperties& props, uint& t, Seed64& t64)
+{
+	BSSRDFProbe probe;
+	float xi_axis = sss_rnd(t, t64);
+	float xi_channel = sss_rnd(t, t64);
+	float xi_radius = sss_rnd(t, t64);
+	float xi_phi = sss_rnd(t, t64);
+	if (!bssrdf_sample_probe(xo, no, xi_axis, xi_channel, xi_radius, xi_phi, props, dipole_cdf_buffer, probe))
+		return make_float3(0.0f);
+
+	// walk along the probe through the surface of the object, keeping one of
+	// the crossings uniformly at random
+	float3 origin = probe.origin;
+	float remaining = probe.length;
+	uint hits = 0;
+	float3 xi, ni;
+	for (uint k = 0; k < BSSRDF_PROBE_MAX_HITS && remaining > scene_epsilon; ++k)
+	{
+		PerRayData_probe prd_probe_ray;
+		prd_probe_ray.dist = -1.0f;
+		Ray probe_ray(origin, probe.direction, probe_ray_type, scene_epsilon, remaining);
+		rtTrace(sss_probe_object, probe_ray, prd_probe_ray);
+		if (prd_probe_ray.dist < 0.0f)
+			break;
+		origin += prd_probe_ray.dist*probe.direction;
+		remaining -= prd_probe_ray.dist;
+		++hits;
+		if (sss_rnd(t, t64)*hits < 1.0f)
+		{
+			xi = origin;
+			ni = prd_probe_ray.normal;
+		}
+	}
+	if (hits == 0)
+		return make_float3(0.0f);
+	float pdf = bssrdf_probe_pdf(xo, no, xi, ni, props, dipole_cdf_buffer) / hits;
+	if (pdf <= 0.0f)
+		return make_float3(0.0f);
+
+	// incident light at the entry point
+	float3 w_i, Le;
+	const float indirect_prob = 0.5f;
+	if (sss_rnd(t, t64) >= indirect_prob)
+	{
+		float u_light = sss_rnd(t, t64);
+		float light_pdf;
+		uint light_idx = sample_light_index(u_light, light_pdf);
+		LightStruct direct_light = light_buffer[light_idx];
+		float dist;
+		evaluate_direct_illumination(xi, &direct_light, w_i, Le, dist, t);
+		float cos_theta_i = dot(w_i, ni);
+		if (cos_theta_i <= 0.0f)
+			return make_float3(0.0f);
+		PerRayData_shadow shadow_prd;
+		shadow_prd.attenuation = 1.0f;
+		Ray shadow_ray(xi, w_i, shadow_ray_type, scene_epsilon, dist);
+		rtTrace(top_shadower, shadow_ray, shadow_prd);
+		Le *= shadow_prd.attenuation*cos_theta_i / (light_pdf*(1.0f - indirect_prob));
+	}
+	else
+	{
+		// emitters are left to the light samples
+		w_i = sample_cosine_weighted(ni, t);
+		PerRayData_radiance prd_indirect;
+		prd_indirect.depth = prd_radiance.depth + 1;
+		prd_indirect.seed = t;
+		prd_indirect.seed64 = t64;
+		prd_indirect.sobol = prd_radiance.sobol;
+		prd_indirect.bsdf_pdf = 0.0f;
+		prd_indirect.result = make_float3(0.0f);
+		prd_indirect.emit_light = 0;
+		prd_indirect.throughput = prd_radiance.throughput;
+		Ray indirect_ray(xi, w_i, radiance_ray_type, scene_epsilon);
+		trace_radiance(top_object, indirect_ray, prd_indirect);
+		t = prd_indirect.seed;
+		t64 = prd_indirect.seed64;
+		Le = prd_indirect.result*M_PIf / indirect_prob;
+	}
+
+	float recip_ior = 1.0f / props.relative_ior;
+	float cos_theta_i = fmaxf(dot(w_i, ni), 0.0f);
+	float sin_theta_t_sqr = recip_ior*recip_ior*(1.0f - cos_theta_i*cos_theta_i);
+	float cos_theta_t = sqrtf(1.0f - sin_theta_t_sqr);
+	float3 w12 = recip_ior*(cos_theta_i*ni - w_i) - ni*cos_theta_t;
+	float T12 = 1.0f - fresnel_R(cos_theta_i, cos_theta_t, recip_ior);
+	float3 S = make_float3(0.0f);
+	if (dipole_model == DIRECTIONAL_DIPOLE)
+		S = dirpole_bssrdf(xi, ni, w12, xo, no, props);
+	else if (dipole_model == STANDARD_DIPOLE)
+		S = dipole_bssrdf_tabulated(length(xo - xi), props, dipole_profile_buffer);
+	else if (dipole_model == PHOTON_BEAM_DIFFUSION)
+		S = pbd_bssrdf_tabulated(length(xo - xi), w12, ni, props, pbd_table_buffer);
+	return T12*Le*S / pdf;
+}
+
 // Any hit program for shadows
 RT_PROGRAM void any_hit()
 {
@@ -51,6 +212,13 @@ RT_PROGRAM void any_hit()
 	rtTerminateRay();
 }
 
+// Closest hit program for the probe rays of the BSSRDF sampling
+RT_PROGRAM void probe_closest_hit()
+{
+	prd_probe.dist = t_hit;
+	prd_probe.normal = normalize(rtTransformNormal(RT_OBJECT_TO_WORLD, shading_normal));
+}
+
 // Closest hit program for Lambertian shading using the basic light as a directional source
 RT_PROGRAM void closest_hit()
 {
@@ -80,7 +248,7 @@ RT_PROGRAM void closest_hit()
 		if (dipole_model == DIRECTIONAL_DIPOLE) {
 			beam_T = expf(-t_hit*props.deltaEddExtinction);
 		}
-		else if (dipole_model == STANDARD_DIPOLE) {
+		else if (dipole_model == STANDARD_DIPOLE || dipole_model == PHOTON_BEAM_DIFFUSION) {
 			beam_T = expf(-t_hit*props.extinction);
 		}
 		float prob = (beam_T.x + beam_T.y + beam_T.z) / 3.0f;
@@ -109,10 +277,13 @@ RT_PROGRAM void closest_hit()
 		prd_refracted.depth = prd_radiance.depth + 1;
 		prd_refracted.seed64 = t64;
 		prd_refracted.seed = t;
+		prd_refracted.sobol = prd_radiance.sobol;
+		prd_refracted.bsdf_pdf = 0.0f;
 		prd_refracted.result = make_float3(0.0f);
 		prd_refracted.emit_light = 1;
+		prd_refracted.throughput = prd_radiance.throughput * beam_T;
 		Ray refracted(xo, wt, radiance_ray_type, scene_epsilon);
-		rtTrace(top_object, refracted, prd_refracted);
+		trace_radiance(top_object, refracted, prd_refracted);
 		prd_radiance.result += prd_refracted.result;
 		t = prd_refracted.seed;
 		t64 = prd_refracted.seed64;
@@ -126,47 +297,70 @@ RT_PROGRAM void closest_hit()
 	//float chosen_transport_rr = props.mean_transport;
 	float chosen_transport_rr = fminf(props.transport.x, fminf(props.transport.y, props.transport.z));
 	float3 accumulate = make_float3(0.0f);
-	uint N = samples_output_buffer.size();
-	N = samples;
-	for (uint i = 0; i < N; ++i)
+	uint2 sample_range = translucent_sample_buffer[translucent_index];
+	uint N = sample_range.y;
+	if (sss_estimator == SSS_PROBE_RAYS)
+	{
+		accumulate = sss_probe(xo, no, props, t, t64);
+		N = 1;
+	}
+	else if (sss_octree_max_solid_angle > 0.0f && translucent_index < sss_octree_object_buffer.size())
+	{
+		SSSOctreeEval eval = { xo, no, props };
+		SSSOctreeSamples samples = { translucent_bbox_buffer[2 * translucent_index], translucent_bbox_buffer[2 * translucent_index + 1] };
+		uint2 octree = sss_octree_object_buffer[translucent_index];
+		accumulate = sss_octree_gather(sss_octree_buffer, octree.x, octree.y, sss_octree_sample_buffer, samples, xo, sss_octree_max_solid_angle, eval);
+	}
+	else
 	{
-		PositionSample& sample = samples_output_buffer[i + translucent_index*N];
-
-		// compute direction of the transmitted light
-		const float3& wi = sample.dir;
-		float cos_theta_i = max(dot(wi, sample.normal), 0.0f);
-		float cos_theta_i_sqr = cos_theta_i*cos_theta_i;
-		float sin_theta_t_sqr = recip_ior*recip_ior*(1.0f - cos_theta_i_sqr);
-		float cos_theta_t = sqrt(1.0f - sin_theta_t_sqr);
-	    //float3 w12 = recip_ior*(cos_theta_i*sample.normal - wi) - sample.normal*cos_theta_t;
-		//float T12 = 1.0f - fresnel_R(cos_theta_i, cos_theta_t, recip_ior);
-		float3 T12 = sample.weight;
-		float3 w12 = sample.transmitted;
-		// compute contribution if sample is non-zero
-		if (dot(sample.L, sample.L) > 0.0f)
+		float3 bbox_min = translucent_bbox_buffer[2 * translucent_index];
+		float3 bbox_max = translucent_bbox_buffer[2 * translucent_index + 1];
+		for (uint i = 0; i < N; ++i)
 		{
-			// Russian roulette
-			float dist = length(xo - sample.pos);
-			float exp_term = exp(-dist * chosen_transport_rr);
-			//exp_term = fmaxf(exp_term, 0.000001f);
+			PositionSample sample = decode_position_sample(compact_samples_buffer[sample_range.x + i], bbox_min, bbox_max);
+
+			// compute direction of the transmitted light
+			const float3& wi = sample.dir;
+			float cos_theta_i = max(dot(wi, sample.normal), 0.0f);
+			float cos_theta_i_sqr = cos_theta_i*cos_theta_i;
+			float sin_theta_t_sqr = recip_ior*recip_ior*(1.0f - cos_theta_i_sqr);
+			float cos_theta_t = sqrt(1.0f - sin_theta_t_sqr);
+		    //float3 w12 = recip_ior*(cos_theta_i*sample.normal - wi) - sample.normal*cos_theta_t;
+			//float T12 = 1.0f - fresnel_R(cos_theta_i, cos_theta_t, recip_ior);
+			float3 T12 = sample.weight;
+			float3 w12 = sample.transmitted;
+			// compute contribution if sample is non-zero
+			if (dot(sample.L, sample.L) > 0.0f)
+			{
+				// Russian roulette
+				float dist = length(xo - sample.pos);
+				// the tabulated models are negligible beyond the effective radius
+				if (dipole_model != DIRECTIONAL_DIPOLE && dist >= props.dipole_effective_radius)
+					continue;
+				float exp_term = exp(-dist * chosen_transport_rr);
+				//exp_term = fmaxf(exp_term, 0.000001f);
 #ifdef RND_64
-			float rnd_number = rnd_accurate(t64);
+				float rnd_number = rnd_accurate(t64);
 #else
-			float rnd_number = rnd_tea(t);
+				float rnd_number = rnd_tea(t);
 #endif
-			if (rnd_number < exp_term )
-			{
-				
-				if (dipole_model == DIRECTIONAL_DIPOLE) {
-					accumulate += T12*sample.L*dirpole_bssrdf(sample.pos, sample.normal, w12, xo, no, props) / exp_term;
+				if (rnd_number < exp_term )
+				{
+					
+					if (dipole_model == DIRECTIONAL_DIPOLE) {
+						accumulate += T12*sample.L*dirpole_bssrdf(sample.pos, sample.normal, w12, xo, no, props) / exp_term;
+					}
+					else if (dipole_model == STANDARD_DIPOLE) {
+						accumulate += T12*sample.L*dipole_bssrdf_tabulated(dist, props, dipole_profile_buffer) / exp_term;
+					}
+					else if (dipole_model == PHOTON_BEAM_DIFFUSION) {
+						accumulate += T12*sample.L*pbd_bssrdf_tabulated(dist, w12, sample.normal, props, pbd_table_buffer) / exp_term;
+					}
 				}
-				else if (dipole_model == STANDARD_DIPOLE) {
-					accumulate += T12*sample.L*dipole_bssrdf(dist, props) / exp_term;
+				else {
+					//rtPrintf("no dipole \n");
 				}
 			}
-			else {
-				//rtPrintf("no dipole \n");
-			}
 		}
 	}
 #ifdef TRANSMIT
@@ -185,11 +379,14 @@ RT_PROGRAM void closest_hit()
 		PerRayData_radiance prd_reflected;
 		prd_reflected.depth = prd_radiance.depth + 1;
 		prd_reflected.seed = t;
+		prd_reflected.sobol = prd_radiance.sobol;
+		prd_reflected.bsdf_pdf = 0.0f;
 		prd_reflected.seed64 = t64;
 		prd_reflected.result = make_float3(0.0f);
 		prd_reflected.emit_light = 1;
+		prd_reflected.throughput = prd_radiance.throughput * beam_T;
 		Ray reflected(xo, wr, radiance_ray_type, scene_epsilon);
-		rtTrace(top_object, reflected, prd_reflected);
+		trace_radiance(top_object, reflected, prd_reflected);
 		prd_radiance.result += prd_reflected.result;
 		t = prd_reflected.seed;
 		t64 = prd_reflected.seed64;
@@ -9,6 +9,7 @@
 #include "../sampler.h"
 #include "../LightSampler.h"
 #include "../Fresnel.h"
+#include "../russian_roulette.h"
 //#define DIFFUSE_PART
 
 using namespace optix;
@@ -108,8 +109,9 @@ RT_PROGRAM void closest_hit()
     dir = n1_over_n2*ray.direction + normal*(n1_over_n2*cos_theta - cos_theta_t);
 
   prd_radiance.emit_light = 1;
+  prd_radiance.throughput *= beam_T;
   Ray to_trace = make_Ray(hit_pos, dir, radiance_ray_type, scene_epsilon, RT_DEFAULT_MAX);
-  rtTrace(top_object, to_trace, prd_radiance);
+  trace_radiance(top_object, to_trace, prd_radiance);
   prd_radiance.result *= beam_T;
  
 }
@@ -41,6 +41,7 @@ rtBuffer<uint>   material_buffer; // per-face material index
 rtDeclareVariable(float3, texcoord, attribute texcoord, ); 
 rtDeclareVariable(float3, geometric_normal, attribute geometric_normal, ); 
 rtDeclareVariable(float3, shading_normal, attribute shading_normal, ); 
+rtDeclareVariable(int, primitive_index, attribute primitive_index, ); 
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
 
 RT_PROGRAM void mesh_intersect( int primIdx )
@@ -80,6 +81,7 @@ RT_PROGRAM void mesh_intersect( int primIdx )
         texcoord = make_float3( t1*beta + t2*gamma + t0*(1.0f-beta-gamma) );
       }
 
+      primitive_index = primIdx;
       rtReportIntersection(material_buffer[primIdx]);
     }
   }
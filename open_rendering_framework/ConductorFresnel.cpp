@@ -0,0 +1,116 @@
+#include "ConductorFresnel.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "Fresnel.h"
+
+using namespace optix;
+
+namespace
+{
+	// cosines between the entries per test, and hits of the benchmark
+	const unsigned int TEST_COSINES = 1 << 12;
+	const unsigned int BENCHMARK_HITS = 1 << 20;
+
+	MyComplex3 complex3(float n_x, float k_x, float n_y, float k_y, float n_z, float k_z)
+	{
+		MyComplex3 c = { MyComplex{ n_x, k_x }, MyComplex{ n_y, k_y }, MyComplex{ n_z, k_z } };
+		return c;
+	}
+
+	float largest_difference(const float3& a, const float3& b)
+	{
+		return fmaxf(fabsf(a.x - b.x), fmaxf(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+	}
+}
+
+void ConductorFresnel::build(const MyComplex3& ior1_over_ior2, optix::float3* table)
+{
+	for (unsigned int i = 0; i < FRESNEL_TABLE_COSINES; ++i)
+		table[i] = fresnel_MyComplex_R(i / (float)(FRESNEL_TABLE_COSINES - 1), ior1_over_ior2);
+}
+
+optix::float3 ConductorFresnel::average(const optix::float3* table)
+{
+	float3 F_avg = make_float3(0.0f);
+	for (unsigned int i = 0; i + 1 < FRESNEL_TABLE_COSINES; ++i)
+	{
+		float a = i / (float)(FRESNEL_TABLE_COSINES - 1);
+		float b = (i + 1) / (float)(FRESNEL_TABLE_COSINES - 1);
+		F_avg += (b - a)*(table[i] * (2.0f*a + b) + table[i + 1] * (a + 2.0f*b)) / 6.0f;
+	}
+	return 2.0f*F_avg;
+}
+
+bool ConductorFresnel::report(std::ostream& out)
+{
+	// absolute error of the reflectance, the largest is close to grazing
+	// incidence, where the reflectance of the conductors dips before it
+	// rises to one
+	const float tolerance = 2.0e-3f;
+	const unsigned int count = 64;
+
+	// the defaults of MetallicMaterial, then random conductors
+	std::vector<MyComplex3> iors = {
+		complex3(0.170265f, 3.01893f, 0.511516f, 2.44734f, 1.47544f, 1.87263f),
+		complex3(0.12614f, 3.80301f, 0.126421f, 3.24418f, 0.150691f, 2.45234f),
+		complex3(0.407567f, 3.03073f, 0.944315f, 2.62346f, 1.16966f, 2.38102f),
+		complex3(1.24134f, 7.35646f, 0.918662f, 6.54687f, 0.614598f, 5.45122f) };
+	const char* names[] = { "gold", "silver", "copper", "aluminium" };
+	std::mt19937 generator(1982);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	while (iors.size() < count)
+	{
+		float n[3], k[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			n[c] = 0.05f + 2.95f*uniform(generator);
+			k[c] = 8.0f*uniform(generator);
+		}
+		iors.push_back(complex3(n[0], k[0], n[1], k[1], n[2], k[2]));
+	}
+
+	bool valid = true;
+	float largest_error = 0.0f;
+	std::vector<float3> table(FRESNEL_TABLE_COSINES);
+	out << "Conductor Fresnel tables (" << FRESNEL_TABLE_COSINES << " cosines), largest error between the entries" << std::endl;
+	for (unsigned int m = 0; m < count; ++m)
+	{
+		// as the metallic shader, the relative index of the air over the metal
+		MyComplex3 eta = 1.0f / iors[m];
+		build(eta, table.data());
+		float error = 0.0f;
+		for (unsigned int s = 0; s < TEST_COSINES; ++s)
+		{
+			float cos_theta = (s + 0.5f) / TEST_COSINES;
+			error = std::max(error, largest_difference(fresnel_tabulated_R(cos_theta, table), fresnel_MyComplex_R(cos_theta, eta)));
+		}
+		largest_error = std::max(largest_error, error);
+		if (m < 4)
+			out << "  " << names[m] << ": " << error << std::endl;
+	}
+	valid = largest_error < tolerance;
+	out << "  " << count - 4 << " random conductors: " << largest_error << (valid ? "" : " FAILED") << std::endl;
+
+	// a metallic hit evaluates the reflectance for the light sample and for
+	// the reflected ray
+	MyComplex3 eta = 1.0f / iors[0];
+	build(eta, table.data());
+	std::vector<float2> cosines(BENCHMARK_HITS);
+	for (unsigned int h = 0; h < BENCHMARK_HITS; ++h)
+		cosines[h] = make_float2(uniform(generator), uniform(generator));
+	float3 sum = make_float3(0.0f);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int h = 0; h < BENCHMARK_HITS; ++h)
+		sum += fresnel_MyComplex_R(cosines[h].x, eta) + fresnel_MyComplex_R(cosines[h].y, eta);
+	std::chrono::duration<double, std::nano> exact_time = std::chrono::high_resolution_clock::now() - start;
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int h = 0; h < BENCHMARK_HITS; ++h)
+		sum += fresnel_tabulated_R(cosines[h].x, table) + fresnel_tabulated_R(cosines[h].y, table);
+	std::chrono::duration<double, std::nano> table_time = std::chrono::high_resolution_clock::now() - start;
+	out << "  host Fresnel cost per metallic hit: " << exact_time.count() / BENCHMARK_HITS << " ns (fresnel_MyComplex_R), "
+		<< table_time.count() / BENCHMARK_HITS << " ns (table), speedup " << exact_time.count() / table_time.count()
+		<< " (checksum " << sum.x + sum.y + sum.z << ")" << std::endl;
+	return valid;
+}
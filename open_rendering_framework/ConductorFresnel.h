@@ -0,0 +1,25 @@
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include <ostream>
+#include "MyComplex.h"
+
+// Host side builder of the Fresnel reflectance tables of the conductors
+// (fresnel_tabulated_R in Fresnel.h), one per metallic material, with
+// FRESNEL_TABLE_COSINES entries per channel of fresnel_MyComplex_R for the
+// relative index of refraction of the material.
+class ConductorFresnel
+{
+public:
+	// Fills the FRESNEL_TABLE_COSINES entries of the table, ior1_over_ior2
+	// as in fresnel_MyComplex_R
+	static void build(const MyComplex3& ior1_over_ior2, optix::float3* table);
+	// Average of the table over the cosine weighted hemisphere,
+	// 2 int_0^1 F(mu) mu dmu of its linear interpolation
+	static optix::float3 average(const optix::float3* table);
+
+	// Compares the tables of the default conductors and of random ones with
+	// fresnel_MyComplex_R between the entries, and measures the cost of the
+	// Fresnel reflectance of a metallic hit with both. Returns false if the
+	// error exceeds the tolerance.
+	static bool report(std::ostream& out);
+};
@@ -0,0 +1,325 @@
+#include "EnergyCompensation.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <QVector>
+#include <QtConcurrent/QtConcurrent>
+#include "Fresnel.h"
+#include "MicrofacetBeckmann.h"
+#include "MicrofacetGGX.h"
+#include "energy_compensation.h"
+
+using namespace optix;
+
+namespace
+{
+	// microfacet normals of the reference albedos of the report
+	const unsigned int REFERENCE_SAMPLES = 1 << 14;
+	// smallest cosine and roughness of the entries, visible normal sampling
+	// is singular at zero
+	const float COSINE_MIN = 1.0e-3f;
+	const float ROUGHNESS_MIN = 1.0e-3f;
+
+	// Hammersley point s of n
+	float2 hammersley(unsigned int s, unsigned int n)
+	{
+		unsigned int x = s;
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return make_float2((s + 0.5f) / n, x*2.3283064365386963e-10f);
+	}
+
+	float3 sample_visible_normal(const float3& wi, float alpha, NormalsDistribution distribution, const float2& z)
+	{
+		if (distribution == GGX_DISTRIBUTION)
+			return ggx_sample_VNDF(wi, alpha, alpha, z.x, z.y);
+		return beckmann_sample_VNDF(wi, alpha, alpha, z.x, z.y);
+	}
+
+	// masking of wo by the microfacet wm, as masking_G1 in the shaders
+	float masking(const float3& wo, const float3& wm, float alpha, NormalsDistribution distribution)
+	{
+		if (wo.z*dot(wo, wm) <= 0.0f)
+			return 0.0f;
+		if (distribution == GGX_DISTRIBUTION)
+			return ggx_G1(wo.z, alpha*alpha);
+		return beckmann_G1(wo.z, alpha*alpha);
+	}
+
+	float3 incident_direction(float mu)
+	{
+		mu = std::max(mu, COSINE_MIN);
+		return make_float3(sqrtf(1.0f - mu*mu), 0.0f, mu);
+	}
+
+	float2 entry(float beckmann, float ggx)
+	{
+		return make_float2(beckmann, ggx);
+	}
+
+	float entry_value(const float2& entry, NormalsDistribution distribution)
+	{
+		return distribution == GGX_DISTRIBUTION ? entry.y : entry.x;
+	}
+
+	// Linear interpolation of the tables at the coordinates of the textures
+	float interpolate(const std::vector<float2>& table, unsigned int offset, unsigned int stride, unsigned int n, float x, NormalsDistribution distribution)
+	{
+		x = clamp(x, 0.0f, 1.0f)*(n - 1);
+		unsigned int i = std::min((unsigned int)x, n - 2);
+		float t = x - i;
+		return (1.0f - t)*entry_value(table[offset + i*stride], distribution) + t*entry_value(table[offset + (i + 1)*stride], distribution);
+	}
+
+	// offset is the first entry of a slice of the dielectric table
+	float conductor_lookup(const std::vector<float2>& table, float mu, float alpha, NormalsDistribution distribution, unsigned int offset = 0)
+	{
+		float y = clamp(alpha, 0.0f, 1.0f)*(ENERGY_TABLE_ROUGHNESSES - 1);
+		unsigned int j = std::min((unsigned int)y, (unsigned int)ENERGY_TABLE_ROUGHNESSES - 2);
+		float t = y - j;
+		float lower = interpolate(table, offset + j*ENERGY_TABLE_COSINES, 1, ENERGY_TABLE_COSINES, mu, distribution);
+		float upper = interpolate(table, offset + (j + 1)*ENERGY_TABLE_COSINES, 1, ENERGY_TABLE_COSINES, mu, distribution);
+		return (1.0f - t)*lower + t*upper;
+	}
+
+	float dielectric_lookup(const std::vector<float2>& table, float mu, float alpha, float eta, NormalsDistribution distribution)
+	{
+		const unsigned int slice = ENERGY_TABLE_COSINES*ENERGY_TABLE_ROUGHNESSES;
+		float z = energy_table_eta_texel(eta)*2*ENERGY_TABLE_ETAS - 0.5f;
+		unsigned int k = (unsigned int)z;
+		if (k % ENERGY_TABLE_ETAS == ENERGY_TABLE_ETAS - 1)
+			--k;
+		float t = z - k;
+		return (1.0f - t)*conductor_lookup(table, mu, alpha, distribution, k*slice) + t*conductor_lookup(table, mu, alpha, distribution, (k + 1)*slice);
+	}
+
+	// 2 int_0^1 E(mu) mu dmu of the linear interpolation of E in mu
+	float cosine_weighted_average(const float2* albedo, NormalsDistribution distribution)
+	{
+		float E_avg = 0.0f;
+		for (unsigned int i = 0; i + 1 < ENERGY_TABLE_COSINES; ++i)
+		{
+			float a = energy_table_cosine(i);
+			float b = energy_table_cosine(i + 1);
+			E_avg += (b - a)*(entry_value(albedo[i], distribution)*(2.0f*a + b) + entry_value(albedo[i + 1], distribution)*(a + 2.0f*b)) / 6.0f;
+		}
+		return 2.0f*E_avg;
+	}
+
+	TextureSampler table_sampler(Context context, Buffer buffer)
+	{
+		TextureSampler sampler = context->createTextureSampler();
+		sampler->setWrapMode(0, RT_WRAP_CLAMP_TO_EDGE);
+		sampler->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE);
+		sampler->setWrapMode(2, RT_WRAP_CLAMP_TO_EDGE);
+		sampler->setIndexingMode(RT_TEXTURE_INDEX_NORMALIZED_COORDINATES);
+		sampler->setReadMode(RT_TEXTURE_READ_ELEMENT_TYPE);
+		sampler->setMaxAnisotropy(1.0f);
+		sampler->setMipLevelCount(1u);
+		sampler->setArraySize(1u);
+		sampler->setBuffer(0u, 0u, buffer);
+		sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+		return sampler;
+	}
+}
+
+const unsigned int EnergyCompensation::CONDUCTOR_SAMPLES = 1 << 10;
+const unsigned int EnergyCompensation::DIELECTRIC_SAMPLES = 1 << 10;
+
+EnergyCompensation::EnergyCompensation(optix::Context c)
+{
+	context = c;
+	conductor_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, ENERGY_TABLE_COSINES, ENERGY_TABLE_ROUGHNESSES);
+	conductor_average_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, ENERGY_TABLE_ROUGHNESSES);
+	dielectric_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, ENERGY_TABLE_COSINES, ENERGY_TABLE_ROUGHNESSES, 2 * ENERGY_TABLE_ETAS);
+	buildConductor(static_cast<float2*>(conductor_buffer->map()), static_cast<float2*>(conductor_average_buffer->map()));
+	conductor_buffer->unmap();
+	conductor_average_buffer->unmap();
+	buildDielectric(static_cast<float2*>(dielectric_buffer->map()));
+	dielectric_buffer->unmap();
+
+	conductor_sampler = table_sampler(context, conductor_buffer);
+	conductor_average_sampler = table_sampler(context, conductor_average_buffer);
+	dielectric_sampler = table_sampler(context, dielectric_buffer);
+	context["conductor_albedo_texture"]->setTextureSampler(conductor_sampler);
+	context["conductor_average_albedo_texture"]->setTextureSampler(conductor_average_sampler);
+	context["dielectric_albedo_texture"]->setTextureSampler(dielectric_sampler);
+}
+
+EnergyCompensation::~EnergyCompensation()
+{
+	conductor_sampler->destroy();
+	conductor_average_sampler->destroy();
+	dielectric_sampler->destroy();
+	conductor_buffer->destroy();
+	conductor_average_buffer->destroy();
+	dielectric_buffer->destroy();
+}
+
+float EnergyCompensation::conductorAlbedo(float mu, float alpha, NormalsDistribution distribution, unsigned int samples)
+{
+	float3 wi = incident_direction(mu);
+	alpha = std::max(alpha, ROUGHNESS_MIN);
+	double E = 0.0;
+	for (unsigned int s = 0; s < samples; ++s)
+	{
+		float3 wm = sample_visible_normal(wi, alpha, distribution, hammersley(s, samples));
+		float3 wo = 2.0f*dot(wi, wm)*wm - wi;
+		E += masking(wo, wm, alpha, distribution);
+	}
+	return (float)(E / samples);
+}
+
+float EnergyCompensation::dielectricAlbedo(float mu, float alpha, float eta, NormalsDistribution distribution, unsigned int samples)
+{
+	float E;
+	dielectricAlbedos(mu, alpha, &eta, 1, distribution, samples, &E);
+	return E;
+}
+
+void EnergyCompensation::dielectricAlbedos(float mu, float alpha, const float* etas, unsigned int count, NormalsDistribution distribution, unsigned int samples, float* albedos)
+{
+	float3 wi = incident_direction(mu);
+	alpha = std::max(alpha, ROUGHNESS_MIN);
+	std::vector<double> E(count, 0.0);
+	for (unsigned int s = 0; s < samples; ++s)
+	{
+		float3 wm = sample_visible_normal(wi, alpha, distribution, hammersley(s, samples));
+		float cos_theta = dot(wi, wm);
+		if (cos_theta <= 0.0f)
+			continue;
+		float3 wr = 2.0f*cos_theta*wm - wi;
+		float G_r = masking(wr, wm, alpha, distribution);
+		for (unsigned int k = 0; k < count; ++k)
+		{
+			float recip_eta = 1.0f / etas[k];
+			float R = fresnel_R(cos_theta, recip_eta);
+			E[k] += R*G_r;
+			if (R < 1.0f)
+			{
+				float cos_theta_t = sqrtf(1.0f - recip_eta*recip_eta*(1.0f - cos_theta*cos_theta));
+				float3 wt = -recip_eta*wi + wm*(recip_eta*cos_theta - cos_theta_t);
+				E[k] += (1.0f - R)*masking(wt, wm, alpha, distribution);
+			}
+		}
+	}
+	for (unsigned int k = 0; k < count; ++k)
+		albedos[k] = (float)(E[k] / samples);
+}
+
+void EnergyCompensation::buildConductor(optix::float2* albedo, optix::float2* average_albedo)
+{
+	QVector<unsigned int> rows;
+	for (unsigned int j = 0; j < ENERGY_TABLE_ROUGHNESSES; ++j)
+		rows.push_back(j);
+	QtConcurrent::blockingMap(rows, [albedo, average_albedo](unsigned int j) {
+		float alpha = energy_table_roughness(j);
+		float2* row = albedo + j*ENERGY_TABLE_COSINES;
+		for (unsigned int i = 0; i < ENERGY_TABLE_COSINES; ++i)
+		{
+			float mu = energy_table_cosine(i);
+			row[i] = entry(conductorAlbedo(mu, alpha, BECKMANN_DISTRIBUTION, CONDUCTOR_SAMPLES), conductorAlbedo(mu, alpha, GGX_DISTRIBUTION, CONDUCTOR_SAMPLES));
+		}
+		// the average of the table as the shaders interpolate it, so that the
+		// multiple scattering lobe restores the energy of the table exactly
+		average_albedo[j] = entry(cosine_weighted_average(row, BECKMANN_DISTRIBUTION), cosine_weighted_average(row, GGX_DISTRIBUTION));
+	});
+}
+
+void EnergyCompensation::buildDielectric(optix::float2* albedo)
+{
+	const unsigned int slice = ENERGY_TABLE_COSINES*ENERGY_TABLE_ROUGHNESSES;
+	float etas[2 * ENERGY_TABLE_ETAS];
+	for (unsigned int k = 0; k < ENERGY_TABLE_ETAS; ++k)
+	{
+		etas[k] = energy_table_eta(k);
+		etas[k + ENERGY_TABLE_ETAS] = 1.0f / etas[k];
+	}
+	// the microfacet normals of an entry are the same for every eta
+	QVector<unsigned int> rows;
+	for (unsigned int j = 0; j < ENERGY_TABLE_ROUGHNESSES; ++j)
+		rows.push_back(j);
+	QtConcurrent::blockingMap(rows, [albedo, &etas](unsigned int j) {
+		float alpha = energy_table_roughness(j);
+		float beckmann[2 * ENERGY_TABLE_ETAS], ggx[2 * ENERGY_TABLE_ETAS];
+		for (unsigned int i = 0; i < ENERGY_TABLE_COSINES; ++i)
+		{
+			float mu = energy_table_cosine(i);
+			dielectricAlbedos(mu, alpha, etas, 2 * ENERGY_TABLE_ETAS, BECKMANN_DISTRIBUTION, DIELECTRIC_SAMPLES, beckmann);
+			dielectricAlbedos(mu, alpha, etas, 2 * ENERGY_TABLE_ETAS, GGX_DISTRIBUTION, DIELECTRIC_SAMPLES, ggx);
+			for (unsigned int k = 0; k < 2 * ENERGY_TABLE_ETAS; ++k)
+				albedo[k*slice + j*ENERGY_TABLE_COSINES + i] = entry(beckmann[k], ggx[k]);
+		}
+	});
+}
+
+bool EnergyCompensation::report(std::ostream& out)
+{
+	// relative to the albedo of one, the reference albedos are about as
+	// accurate as the tables, and the linear interpolation of E near grazing
+	// angles is the largest error
+	const float tolerance = 2.0e-2f;
+	const unsigned int count = 256;
+
+	std::vector<float2> conductor(ENERGY_TABLE_COSINES*ENERGY_TABLE_ROUGHNESSES), conductor_average(ENERGY_TABLE_ROUGHNESSES);
+	std::vector<float2> dielectric(ENERGY_TABLE_COSINES*ENERGY_TABLE_ROUGHNESSES * 2 * ENERGY_TABLE_ETAS);
+	auto start = std::chrono::high_resolution_clock::now();
+	buildConductor(conductor.data(), conductor_average.data());
+	std::chrono::duration<double, std::milli> conductor_time = std::chrono::high_resolution_clock::now() - start;
+	start = std::chrono::high_resolution_clock::now();
+	buildDielectric(dielectric.data());
+	std::chrono::duration<double, std::milli> dielectric_time = std::chrono::high_resolution_clock::now() - start;
+
+	bool valid = true;
+	out << "Energy compensation tables (" << ENERGY_TABLE_COSINES << " cosines, " << ENERGY_TABLE_ROUGHNESSES << " roughnesses, "
+		<< 2 * ENERGY_TABLE_ETAS << " etas), build time " << conductor_time.count() << " ms (conductors, " << CONDUCTOR_SAMPLES << " samples), "
+		<< dielectric_time.count() << " ms (dielectrics, " << DIELECTRIC_SAMPLES << " samples)" << std::endl;
+	out << "  white furnace, " << count << " points between the entries: lowest single scattering albedo, largest error of the compensated albedo" << std::endl;
+	const char* names[] = { "beckmann", "ggx" };
+	for (int d = 0; d < NUMBER_OF_NORMALS_DISTRIBUTION; ++d)
+	{
+		NormalsDistribution distribution = static_cast<NormalsDistribution>(d);
+		std::mt19937 generator(2017);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		float conductor_lowest = 1.0f, conductor_error = 0.0f;
+		float dielectric_lowest = 1.0f, dielectric_error = 0.0f;
+		for (unsigned int p = 0; p < count; ++p)
+		{
+			float mu = 0.02f + 0.98f*uniform(generator);
+			float alpha = 0.05f + 0.95f*uniform(generator);
+			float eta = energy_table_eta(0) + (ENERGY_TABLE_ETA_MAX - 1.0f)*uniform(generator);
+			if (uniform(generator) < 0.5f)
+				eta = 1.0f / eta;
+
+			// white conductor: the single scattering albedo plus the albedo of the
+			// multiple scattering lobe, integrated over the outgoing cosine
+			float E = conductorAlbedo(mu, alpha, distribution, REFERENCE_SAMPLES);
+			float E_i = conductor_lookup(conductor, mu, alpha, distribution);
+			float E_avg = interpolate(conductor_average, 0, 1, ENERGY_TABLE_ROUGHNESSES, alpha, distribution);
+			const unsigned int steps = 1024;
+			float multiple = 0.0f;
+			for (unsigned int s = 0; s < steps; ++s)
+			{
+				float mu_o = (s + 0.5f) / steps;
+				multiple += conductor_multiple_scattering(E_i, conductor_lookup(conductor, mu_o, alpha, distribution), E_avg, make_float3(1.0f)).x*mu_o;
+			}
+			multiple *= 2.0f*M_PIf / steps;
+			conductor_lowest = std::min(conductor_lowest, E);
+			conductor_error = std::max(conductor_error, fabsf(E + multiple - 1.0f));
+
+			// dielectric: the single scattering albedo scaled by the table
+			E = dielectricAlbedo(mu, alpha, eta, distribution, REFERENCE_SAMPLES);
+			dielectric_lowest = std::min(dielectric_lowest, E);
+			dielectric_error = std::max(dielectric_error, fabsf(E / dielectric_lookup(dielectric, mu, alpha, eta, distribution) - 1.0f));
+		}
+		bool distribution_valid = conductor_error < tolerance && dielectric_error < tolerance;
+		valid = valid && distribution_valid;
+		out << "  " << names[d] << ": conductor " << conductor_lowest << " " << conductor_error << ", dielectric " << dielectric_lowest << " " << dielectric_error
+			<< (distribution_valid ? "" : " FAILED") << std::endl;
+	}
+	return valid;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+#include <ostream>
+#include "structs.h"
+
+// Builds the albedo tables of energy_compensation.h over Hammersley sets of
+// visible normals, and uploads them as textures
+class EnergyCompensation
+{
+public:
+	// microfacet normals per entry
+	static const unsigned int CONDUCTOR_SAMPLES;
+	static const unsigned int DIELECTRIC_SAMPLES;
+
+	// Builds the tables and sets the textures in the context
+	explicit EnergyCompensation(optix::Context c);
+	~EnergyCompensation();
+
+	// ENERGY_TABLE_COSINES*ENERGY_TABLE_ROUGHNESSES entries of E(mu, alpha),
+	// cosines first, and ENERGY_TABLE_ROUGHNESSES entries of Eavg(alpha)
+	static void buildConductor(optix::float2* albedo, optix::float2* average_albedo);
+	// ENERGY_TABLE_COSINES*ENERGY_TABLE_ROUGHNESSES*2*ENERGY_TABLE_ETAS
+	// entries of E(mu, alpha, eta), cosines first
+	static void buildDielectric(optix::float2* albedo);
+
+	// Albedo of a white conductor and of a dielectric (eta = n_t/n_i) with
+	// isotropic roughness alpha, for the cosine mu of the incident direction
+	static float conductorAlbedo(float mu, float alpha, NormalsDistribution distribution, unsigned int samples);
+	static float dielectricAlbedo(float mu, float alpha, float eta, NormalsDistribution distribution, unsigned int samples);
+	// albedos of count dielectrics, with the same microfacet normals
+	static void dielectricAlbedos(float mu, float alpha, const float* etas, unsigned int count, NormalsDistribution distribution, unsigned int samples, float* albedos);
+
+	// White furnace test of the compensated BSDFs between the entries of
+	// the tables, against albedos computed with many more samples. Returns
+	// false if the albedo of any differs from one beyond the tolerance.
+	static bool report(std::ostream& out);
+
+protected:
+	optix::Context context;
+	optix::Buffer conductor_buffer;
+	optix::Buffer conductor_average_buffer;
+	optix::Buffer dielectric_buffer;
+	optix::TextureSampler conductor_sampler;
+	optix::TextureSampler conductor_average_sampler;
+	optix::TextureSampler dielectric_sampler;
+};
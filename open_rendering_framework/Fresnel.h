@@ -11,19 +11,19 @@ __host__ __device__ __inline__ optix::float3 sqrtf(const optix::float3& v)
 }
 
 // Helper functions for computing Fresnel reflectance
-__device__ __inline__ float fresnel_r_s(float cos_theta1, float cos_theta2, float ior1_over_ior2)
+__host__ __device__ __inline__ float fresnel_r_s(float cos_theta1, float cos_theta2, float ior1_over_ior2)
 {
 	// Compute the perpendicularly polarized component of the Fresnel reflectance
 	return (ior1_over_ior2*cos_theta1 - cos_theta2) / (ior1_over_ior2*cos_theta1 + cos_theta2);
 }
 
-__device__ __inline__ float fresnel_r_p(float cos_theta1, float cos_theta2, float ior1_over_ior2)
+__host__ __device__ __inline__ float fresnel_r_p(float cos_theta1, float cos_theta2, float ior1_over_ior2)
 {
 	// Compute the parallelly polarized component of the Fresnel reflectance
 	return (cos_theta1 - ior1_over_ior2*cos_theta2) / (cos_theta1 + ior1_over_ior2*cos_theta2);
 }
 
-__device__ __inline__ float fresnel_R(float cos_theta1, float cos_theta2, float ior1_over_ior2)
+__host__ __device__ __inline__ float fresnel_R(float cos_theta1, float cos_theta2, float ior1_over_ior2)
 {
 	// Compute the Fresnel reflectance using fresnel_r_s(...) and fresnel_r_p(...)
 	float r_s = fresnel_r_s(cos_theta1, cos_theta2, ior1_over_ior2);
@@ -75,10 +75,8 @@ __host__ __device__ __inline__ optix::float3 fresnel_MyComplex_R(float cos_theta
   return (R_s + R_p)*0.5f;
 }
 
-__device__ __inline__ optix::float3 fresnel_MyComplex_R(const optix::float3 w_i, const optix::float3 w_m, const MyComplex3 ior1_over_ior2)
+__host__ __device__ __inline__ optix::float3 fresnel_MyComplex_R(float cos_theta_i, const MyComplex3& ior1_over_ior2)
 {
-
-  float cos_theta_i = dot(w_i, w_m);
   float sin_theta_i = sqrtf(1 - cos_theta_i * cos_theta_i);
 
   MyComplex3 sin_theta_t = ior1_over_ior2 * sin_theta_i;
@@ -90,6 +88,25 @@ __device__ __inline__ optix::float3 fresnel_MyComplex_R(const optix::float3 w_i,
   return R;
 }
 
+__host__ __device__ __inline__ optix::float3 fresnel_MyComplex_R(const optix::float3 w_i, const optix::float3 w_m, const MyComplex3 ior1_over_ior2)
+{
+  return fresnel_MyComplex_R(dot(w_i, w_m), ior1_over_ior2);
+}
+
+// Fresnel reflectance of a conductor tabulated per material
+// (ConductorFresnel) uniformly in the cosine of the angle of incidence, in
+// place of the complex arithmetic of fresnel_MyComplex_R. Linear
+// interpolation of the table, the cosine is clamped to [0, 1].
+#define FRESNEL_TABLE_COSINES 128
+
+template<typename Table>
+__host__ __device__ __inline__ optix::float3 fresnel_tabulated_R(float cos_theta_i, Table& table)
+{
+  float x = optix::clamp(cos_theta_i, 0.0f, 1.0f)*(FRESNEL_TABLE_COSINES - 1);
+  unsigned int i = (unsigned int)fminf(x, FRESNEL_TABLE_COSINES - 2.0f);
+  return optix::lerp(table[i], table[i + 1], x - i);
+}
+
 __host__ __device__ __inline__ float two_C1(float n)
 {
   float r;
@@ -396,5 +396,6 @@ void GeometryTab::updateMaterial(int mtl_type)
 	geometryWidgetVector[currentGeometry]->layout()->replaceWidget(oldTableWidget, newTableWidget);
 	oldTableWidget->deleteLater();	
 	optixWindow->getScene()->computeTranslucentGeometries();
+	optixWindow->getScene()->invalidateTranslucentSamples();
 	optixWindow->restartFrame();
 }
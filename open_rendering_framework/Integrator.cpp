@@ -10,8 +10,28 @@ PathTracer::PathTracer(optix::Context c)
 	max_depth = 50;
 	scene_epsilon = 1e-4;
 	exception_color = QVector3D(1, 0, 0);
+	rr_start_depth = 3;
+	rr_min_prob = 0.05f;
+	light_bvh = false;
+	ris_candidates = 1;
+	ris_temporal_reuse = false;
+	sobol_sampler = false;
+	sss_octree_max_solid_angle = 0.0f;
+	sss_sample_budget = 0;
+	sss_sample_lifetime = 1;
+	sss_poisson_samples = false;
 	context["max_depth"]->setInt(max_depth);
 	context["scene_epsilon"]->setFloat(scene_epsilon);
+	context["rr_start_depth"]->setInt(rr_start_depth);
+	context["rr_min_prob"]->setFloat(rr_min_prob);
+	context["light_bvh_selection"]->setInt(light_bvh);
+	context["ris_candidates"]->setUint(ris_candidates);
+	context["ris_temporal_reuse"]->setInt(ris_temporal_reuse);
+	context["sobol_sampler"]->setInt(sobol_sampler);
+	context["sss_octree_max_solid_angle"]->setFloat(sss_octree_max_solid_angle);
+	context["sss_sample_budget"]->setUint(sss_sample_budget);
+	context["sss_sample_lifetime"]->setUint(sss_sample_lifetime);
+	context["sss_poisson_samples"]->setUint(sss_poisson_samples);
 	// Ray generation program
 	const std::string ptx_camera_path = OptixScene::ptxPath(SAMPLE_NAME, "path_tracer.cu");
 	optix::Program ray_gen_program = context->createProgramFromPTXFile(ptx_camera_path, "path_tracer");
@@ -49,8 +69,48 @@ void PathTracer::readJSON(const QJsonObject &json )
 		exception_color = QVector3D(tmp[0].toDouble(), tmp[1].toDouble(), tmp[2].toDouble());
 	}
 
+	if (parameters.contains("rr_start_depth") && parameters["rr_start_depth"].isDouble())
+		rr_start_depth = parameters["rr_start_depth"].toInt();
+
+	if (parameters.contains("rr_min_prob") && parameters["rr_min_prob"].isDouble())
+		rr_min_prob = (float)parameters["rr_min_prob"].toDouble();
+
+	if (parameters.contains("light_bvh") && parameters["light_bvh"].isBool())
+		light_bvh = parameters["light_bvh"].toBool();
+
+	if (parameters.contains("ris_candidates") && parameters["ris_candidates"].isDouble())
+		ris_candidates = std::max(parameters["ris_candidates"].toInt(), 1);
+
+	if (parameters.contains("ris_temporal_reuse") && parameters["ris_temporal_reuse"].isBool())
+		ris_temporal_reuse = parameters["ris_temporal_reuse"].toBool();
+
+	if (parameters.contains("sobol_sampler") && parameters["sobol_sampler"].isBool())
+		sobol_sampler = parameters["sobol_sampler"].toBool();
+
+	if (parameters.contains("sss_octree_max_solid_angle") && parameters["sss_octree_max_solid_angle"].isDouble())
+		sss_octree_max_solid_angle = std::max((float)parameters["sss_octree_max_solid_angle"].toDouble(), 0.0f);
+
+	if (parameters.contains("sss_sample_budget") && parameters["sss_sample_budget"].isDouble())
+		sss_sample_budget = std::max(parameters["sss_sample_budget"].toInt(), 0);
+
+	if (parameters.contains("sss_sample_lifetime") && parameters["sss_sample_lifetime"].isDouble())
+		sss_sample_lifetime = std::max(parameters["sss_sample_lifetime"].toInt(), 1);
+
+	if (parameters.contains("sss_poisson_samples") && parameters["sss_poisson_samples"].isBool())
+		sss_poisson_samples = parameters["sss_poisson_samples"].toBool();
+
 	context["max_depth"]->setInt(max_depth);
 	context["scene_epsilon"]->setFloat(scene_epsilon);
+	context["rr_start_depth"]->setInt(rr_start_depth);
+	context["rr_min_prob"]->setFloat(rr_min_prob);
+	context["light_bvh_selection"]->setInt(light_bvh);
+	context["ris_candidates"]->setUint(ris_candidates);
+	context["ris_temporal_reuse"]->setInt(ris_temporal_reuse);
+	context["sobol_sampler"]->setInt(sobol_sampler);
+	context["sss_octree_max_solid_angle"]->setFloat(sss_octree_max_solid_angle);
+	context["sss_sample_budget"]->setUint(sss_sample_budget);
+	context["sss_sample_lifetime"]->setUint(sss_sample_lifetime);
+	context["sss_poisson_samples"]->setUint(sss_poisson_samples);
 	// Ray generation program
 	const std::string ptx_camera_path = OptixScene::ptxPath(SAMPLE_NAME, "path_tracer.cu");
 	optix::Program ray_gen_program = context->createProgramFromPTXFile(ptx_camera_path, "path_tracer");
@@ -70,6 +130,16 @@ void PathTracer::writeJSON(QJsonObject &json) const
 	parameters["max_depth"] = (int)max_depth;
 	parameters["scene_epsilon"] = scene_epsilon;
 	parameters["exception_color"] = QJsonArray{ exception_color.x(), exception_color.y(), exception_color.z() };
+	parameters["rr_start_depth"] = (int)rr_start_depth;
+	parameters["rr_min_prob"] = rr_min_prob;
+	parameters["light_bvh"] = light_bvh;
+	parameters["ris_candidates"] = (int)ris_candidates;
+	parameters["ris_temporal_reuse"] = ris_temporal_reuse;
+	parameters["sobol_sampler"] = sobol_sampler;
+	parameters["sss_octree_max_solid_angle"] = sss_octree_max_solid_angle;
+	parameters["sss_sample_budget"] = (int)sss_sample_budget;
+	parameters["sss_sample_lifetime"] = (int)sss_sample_lifetime;
+	parameters["sss_poisson_samples"] = sss_poisson_samples;
 	json["parameters"] = parameters;
 }
 
@@ -92,6 +162,66 @@ void PathTracer::setExceptionColor(QVector3D exc_color)
 	context["exception_color"]->setFloat(exception_color.x(), exception_color.y(), exception_color.z());
 }
 
+void PathTracer::setRRStartDepth(uint start_depth)
+{
+	rr_start_depth = start_depth;
+	context["rr_start_depth"]->setInt(rr_start_depth);
+}
+
+void PathTracer::setRRMinProb(float min_prob)
+{
+	rr_min_prob = min_prob;
+	context["rr_min_prob"]->setFloat(rr_min_prob);
+}
+
+void PathTracer::setLightBVH(bool bvh)
+{
+	light_bvh = bvh;
+	context["light_bvh_selection"]->setInt(light_bvh);
+}
+
+void PathTracer::setRISCandidates(uint candidates)
+{
+	ris_candidates = std::max(candidates, 1u);
+	context["ris_candidates"]->setUint(ris_candidates);
+}
+
+void PathTracer::setRISTemporalReuse(bool temporal_reuse)
+{
+	ris_temporal_reuse = temporal_reuse;
+	context["ris_temporal_reuse"]->setInt(ris_temporal_reuse);
+}
+
+void PathTracer::setSobolSampler(bool sobol)
+{
+	sobol_sampler = sobol;
+	context["sobol_sampler"]->setInt(sobol_sampler);
+}
+
+void PathTracer::setSSSOctreeMaxSolidAngle(float max_solid_angle)
+{
+	sss_octree_max_solid_angle = std::max(max_solid_angle, 0.0f);
+	context["sss_octree_max_solid_angle"]->setFloat(sss_octree_max_solid_angle);
+}
+
+void PathTracer::setSSSSampleBudget(uint budget)
+{
+	sss_sample_budget = budget;
+	context["sss_sample_budget"]->setUint(sss_sample_budget);
+}
+
+void PathTracer::setSSSSampleLifetime(uint lifetime)
+{
+	sss_sample_lifetime = std::max(lifetime, 1u);
+	context["sss_sample_lifetime"]->setUint(sss_sample_lifetime);
+}
+
+void PathTracer::setSSSPoissonSamples(bool poisson)
+{
+	sss_poisson_samples = poisson;
+	context["sss_poisson_samples"]->setUint(sss_poisson_samples);
+}
+
 
 
 //--------------------------------------------------------------------------------------------
@@ -106,6 +236,17 @@ DepthTracer::DepthTracer(optix::Context c)
 	exception_color = QVector3D(1, 0, 0);
 	context["max_depth"]->setInt(max_depth);
 	context["scene_epsilon"]->setFloat(scene_epsilon);
+	// the radiance shaders still reference the Russian roulette settings
+	context["rr_start_depth"]->setInt(max_depth);
+	context["rr_min_prob"]->setFloat(1.0f);
+	context["light_bvh_selection"]->setInt(0);
+	context["ris_candidates"]->setUint(1u);
+	context["ris_temporal_reuse"]->setInt(0);
+	context["sobol_sampler"]->setInt(0);
+	context["sss_octree_max_solid_angle"]->setFloat(0.0f);
+	context["sss_sample_budget"]->setUint(0u);
+	context["sss_sample_lifetime"]->setUint(1u);
+	context["sss_poisson_samples"]->setUint(0u);
 	// Ray generation program
 	const std::string ptx_camera_path = OptixScene::ptxPath(SAMPLE_NAME, "depth_tracer.cu");
 	optix::Program ray_gen_program = context->createProgramFromPTXFile(ptx_camera_path, "depth_tracer");
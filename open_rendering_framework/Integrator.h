@@ -37,11 +37,56 @@ public:
 	void setSceneEpsilon(float scene_eps);
 	QVector3D getExceptionColor() { return exception_color; };
 	void setExceptionColor(QVector3D exc_color);
+	uint getRRStartDepth() { return rr_start_depth; };
+	void setRRStartDepth(uint start_depth);
+	float getRRMinProb() { return rr_min_prob; };
+	void setRRMinProb(float min_prob);
+	bool getLightBVH() { return light_bvh; };
+	void setLightBVH(bool bvh);
+	uint getRISCandidates() { return ris_candidates; };
+	void setRISCandidates(uint candidates);
+	bool getRISTemporalReuse() { return ris_temporal_reuse; };
+	void setRISTemporalReuse(bool temporal_reuse);
+	bool getSobolSampler() { return sobol_sampler; };
+	void setSobolSampler(bool sobol);
+	float getSSSOctreeMaxSolidAngle() { return sss_octree_max_solid_angle; };
+	void setSSSOctreeMaxSolidAngle(float max_solid_angle);
+	uint getSSSSampleBudget() { return sss_sample_budget; };
+	void setSSSSampleBudget(uint budget);
+	uint getSSSSampleLifetime() { return sss_sample_lifetime; };
+	void setSSSSampleLifetime(uint lifetime);
+	bool getSSSPoissonSamples() { return sss_poisson_samples; };
+	void setSSSPoissonSamples(bool poisson);
 
 protected:
 	uint max_depth;
 	float scene_epsilon;
 	QVector3D exception_color;
+	// Russian roulette starts at this depth and never kills a path with a higher probability than 1 - rr_min_prob
+	uint rr_start_depth;
+	float rr_min_prob;
+	// Direct lighting picks lights with the light hierarchy (LightBVH) instead of by power
+	bool light_bvh;
+	// Direct lighting resamples this many light samples per shading point (1 disables it),
+	// optionally reusing the reservoir of the camera hit of each pixel across frames
+	uint ris_candidates;
+	bool ris_temporal_reuse;
+	// Samples the camera, lights and BSDFs with the Owen-scrambled Sobol sampler (sobol.h)
+	// instead of rnd_tea
+	bool sobol_sampler;
+	// Subsurface samples are integrated with an octree (sss_octree_gather), whose nodes are
+	// used in place of their samples below this solid angle (0 sums all the samples)
+	float sss_octree_max_solid_angle;
+	// Subsurface samples per frame shared by all the translucent objects, in proportion to
+	// their area, scattering and screen coverage (0 gives every object the same number).
+	// With a sample lifetime the split only follows the camera when the samples are invalidated
+	uint sss_sample_budget;
+	// Subsurface samples are kept for this many frames, and a frame relights one in
+	// sss_sample_lifetime of them, so that more samples are gathered for the same cost
+	uint sss_sample_lifetime;
+	// Subsurface samples are lit at the points of precomputed Poisson-disk sets (SSSPoissonSets)
+	// instead of independent uniform points
+	bool sss_poisson_samples;
 };
 
 class DepthTracer : public Integrator
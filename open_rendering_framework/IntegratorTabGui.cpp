@@ -66,6 +66,78 @@ void IntegratorTab::initPathTracerParameters(PathTracer* integrator) {
 	QObject::connect(yColorEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateExceptionColor);
 	QObject::connect(zColorEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateExceptionColor);
 
+	QLabel *rrStartDepthLabel = new QLabel(tr("RR Start Depth"), integratorGroupBox);
+	rrStartDepthLabel->setObjectName("rr_start_depth_label");
+	QLineEdit *rrStartDepthEdit = new QLineEdit(QString::number(integrator->getRRStartDepth()), integratorGroupBox);
+	rrStartDepthEdit->setObjectName("rr_start_depth_edit");
+	QObject::connect(rrStartDepthEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateRRStartDepth);
+
+	QLabel *rrMinProbLabel = new QLabel(tr("RR Min Probability"), integratorGroupBox);
+	rrMinProbLabel->setObjectName("rr_min_prob_label");
+	QLineEdit *rrMinProbEdit = new QLineEdit(QString::number(integrator->getRRMinProb()), integratorGroupBox);
+	rrMinProbEdit->setObjectName("rr_min_prob_edit");
+	QObject::connect(rrMinProbEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateRRMinProb);
+
+	QLabel *lightBVHLabel = new QLabel(tr("Light Selection"), integratorGroupBox);
+	lightBVHLabel->setObjectName("light_bvh_label");
+	QComboBox *lightBVHComboBox = new QComboBox(integratorGroupBox);
+	lightBVHComboBox->setObjectName("light_bvh_combobox");
+	lightBVHComboBox->addItem(tr("Power"));
+	lightBVHComboBox->addItem(tr("Light BVH"));
+	lightBVHComboBox->setCurrentIndex(integrator->getLightBVH() ? 1 : 0);
+	QObject::connect(lightBVHComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateLightBVH(int)));
+
+	QLabel *risCandidatesLabel = new QLabel(tr("RIS Candidates"), integratorGroupBox);
+	risCandidatesLabel->setObjectName("ris_candidates_label");
+	QLineEdit *risCandidatesEdit = new QLineEdit(QString::number(integrator->getRISCandidates()), integratorGroupBox);
+	risCandidatesEdit->setObjectName("ris_candidates_edit");
+	QObject::connect(risCandidatesEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateRISCandidates);
+
+	QLabel *risTemporalReuseLabel = new QLabel(tr("RIS Temporal Reuse"), integratorGroupBox);
+	risTemporalReuseLabel->setObjectName("ris_temporal_reuse_label");
+	QComboBox *risTemporalReuseComboBox = new QComboBox(integratorGroupBox);
+	risTemporalReuseComboBox->setObjectName("ris_temporal_reuse_combobox");
+	risTemporalReuseComboBox->addItem(tr("Off"));
+	risTemporalReuseComboBox->addItem(tr("On"));
+	risTemporalReuseComboBox->setCurrentIndex(integrator->getRISTemporalReuse() ? 1 : 0);
+	QObject::connect(risTemporalReuseComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateRISTemporalReuse(int)));
+
+	QLabel *samplerLabel = new QLabel(tr("Sampler"), integratorGroupBox);
+	samplerLabel->setObjectName("sampler_label");
+	QComboBox *samplerComboBox = new QComboBox(integratorGroupBox);
+	samplerComboBox->setObjectName("sampler_combobox");
+	samplerComboBox->addItem(tr("Random"));
+	samplerComboBox->addItem(tr("Sobol"));
+	samplerComboBox->setCurrentIndex(integrator->getSobolSampler() ? 1 : 0);
+	QObject::connect(samplerComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateSobolSampler(int)));
+
+	QLabel *sssOctreeLabel = new QLabel(tr("SSS Octree Max Solid Angle"), integratorGroupBox);
+	sssOctreeLabel->setObjectName("sss_octree_label");
+	QLineEdit *sssOctreeEdit = new QLineEdit(QString::number(integrator->getSSSOctreeMaxSolidAngle()), integratorGroupBox);
+	sssOctreeEdit->setObjectName("sss_octree_edit");
+	QObject::connect(sssOctreeEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateSSSOctreeMaxSolidAngle);
+
+	QLabel *sssBudgetLabel = new QLabel(tr("SSS Sample Budget"), integratorGroupBox);
+	sssBudgetLabel->setObjectName("sss_budget_label");
+	QLineEdit *sssBudgetEdit = new QLineEdit(QString::number(integrator->getSSSSampleBudget()), integratorGroupBox);
+	sssBudgetEdit->setObjectName("sss_budget_edit");
+	QObject::connect(sssBudgetEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateSSSSampleBudget);
+
+	QLabel *sssLifetimeLabel = new QLabel(tr("SSS Sample Lifetime"), integratorGroupBox);
+	sssLifetimeLabel->setObjectName("sss_lifetime_label");
+	QLineEdit *sssLifetimeEdit = new QLineEdit(QString::number(integrator->getSSSSampleLifetime()), integratorGroupBox);
+	sssLifetimeEdit->setObjectName("sss_lifetime_edit");
+	QObject::connect(sssLifetimeEdit, &QLineEdit::returnPressed, this, &IntegratorTab::updateSSSSampleLifetime);
+
+	QLabel *sssPoissonLabel = new QLabel(tr("SSS Poisson-Disk Samples"), integratorGroupBox);
+	sssPoissonLabel->setObjectName("sss_poisson_label");
+	QComboBox *sssPoissonComboBox = new QComboBox(integratorGroupBox);
+	sssPoissonComboBox->setObjectName("sss_poisson_combobox");
+	sssPoissonComboBox->addItem(tr("Off"));
+	sssPoissonComboBox->addItem(tr("On"));
+	sssPoissonComboBox->setCurrentIndex(integrator->getSSSPoissonSamples() ? 1 : 0);
+	QObject::connect(sssPoissonComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateSSSPoissonSamples(int)));
+
 	integratorLayout->addWidget(integratorNameLabel, 0, 0);
 	integratorLayout->addWidget(integratorComboBox, 0, 1);
 	integratorLayout->addWidget(maxDepthLabel, 1, 0);
@@ -76,6 +148,26 @@ void IntegratorTab::initPathTracerParameters(PathTracer* integrator) {
 	integratorLayout->addWidget(xColorEdit, 3, 1);
 	integratorLayout->addWidget(yColorEdit, 3, 2);
 	integratorLayout->addWidget(zColorEdit, 3, 3);
+	integratorLayout->addWidget(rrStartDepthLabel, 4, 0);
+	integratorLayout->addWidget(rrStartDepthEdit, 4, 1);
+	integratorLayout->addWidget(rrMinProbLabel, 5, 0);
+	integratorLayout->addWidget(rrMinProbEdit, 5, 1);
+	integratorLayout->addWidget(lightBVHLabel, 6, 0);
+	integratorLayout->addWidget(lightBVHComboBox, 6, 1);
+	integratorLayout->addWidget(risCandidatesLabel, 7, 0);
+	integratorLayout->addWidget(risCandidatesEdit, 7, 1);
+	integratorLayout->addWidget(risTemporalReuseLabel, 8, 0);
+	integratorLayout->addWidget(risTemporalReuseComboBox, 8, 1);
+	integratorLayout->addWidget(samplerLabel, 9, 0);
+	integratorLayout->addWidget(samplerComboBox, 9, 1);
+	integratorLayout->addWidget(sssOctreeLabel, 10, 0);
+	integratorLayout->addWidget(sssOctreeEdit, 10, 1);
+	integratorLayout->addWidget(sssBudgetLabel, 11, 0);
+	integratorLayout->addWidget(sssBudgetEdit, 11, 1);
+	integratorLayout->addWidget(sssLifetimeLabel, 12, 0);
+	integratorLayout->addWidget(sssLifetimeEdit, 12, 1);
+	integratorLayout->addWidget(sssPoissonLabel, 13, 0);
+	integratorLayout->addWidget(sssPoissonComboBox, 13, 1);
 	integratorGroupBox->setLayout(integratorLayout);
 	integratorTabLayout->addWidget(integratorGroupBox);
 }
@@ -142,6 +234,7 @@ void IntegratorTab::updateMaxDepth()
 {
 	int max_depth = this->findChild<QLineEdit*>("max_depth_edit")->text().toInt();
 	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setMaxDepth(max_depth);
+	optixWindow->getScene()->invalidateTranslucentSamples();
 	optixWindow->restartFrame();
 }
 
@@ -151,6 +244,7 @@ void IntegratorTab::updateExceptionColor()
 	float color_y = this->findChild<QLineEdit*>("exc_color_y")->text().toFloat();
 	float color_z = this->findChild<QLineEdit*>("exc_color_z")->text().toFloat();
 	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setExceptionColor(QVector3D(color_x, color_y, color_z));
+	optixWindow->getScene()->invalidateTranslucentSamples();
 	optixWindow->restartFrame();
 }
 
@@ -158,6 +252,73 @@ void IntegratorTab::updateSceneEpsilon()
 {
 	float scene_epsilon = this->findChild<QLineEdit*>("scene_epsilon_edit")->text().toFloat();
 	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setSceneEpsilon(scene_epsilon);
+	optixWindow->getScene()->invalidateTranslucentSamples();
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateRRStartDepth()
+{
+	int rr_start_depth = this->findChild<QLineEdit*>("rr_start_depth_edit")->text().toInt();
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setRRStartDepth(rr_start_depth);
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateRRMinProb()
+{
+	float rr_min_prob = this->findChild<QLineEdit*>("rr_min_prob_edit")->text().toFloat();
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setRRMinProb(rr_min_prob);
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateLightBVH(int bvh)
+{
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setLightBVH(bvh == 1);
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateRISCandidates()
+{
+	int ris_candidates = this->findChild<QLineEdit*>("ris_candidates_edit")->text().toInt();
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setRISCandidates(std::max(ris_candidates, 1));
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateRISTemporalReuse(int temporalReuse)
+{
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setRISTemporalReuse(temporalReuse == 1);
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateSobolSampler(int sampler)
+{
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setSobolSampler(sampler == 1);
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateSSSOctreeMaxSolidAngle()
+{
+	float max_solid_angle = this->findChild<QLineEdit*>("sss_octree_edit")->text().toFloat();
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setSSSOctreeMaxSolidAngle(max_solid_angle);
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateSSSSampleBudget()
+{
+	int budget = this->findChild<QLineEdit*>("sss_budget_edit")->text().toInt();
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setSSSSampleBudget(std::max(budget, 0));
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateSSSSampleLifetime()
+{
+	int lifetime = this->findChild<QLineEdit*>("sss_lifetime_edit")->text().toInt();
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setSSSSampleLifetime(std::max(lifetime, 1));
+	optixWindow->restartFrame();
+}
+
+void IntegratorTab::updateSSSPoissonSamples(int poisson)
+{
+	reinterpret_cast<PathTracer*> (optixWindow->getScene()->getIntegrator())->setSSSPoissonSamples(poisson == 1);
 	optixWindow->restartFrame();
 }
 
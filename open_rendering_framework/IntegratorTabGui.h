@@ -25,6 +25,16 @@ public slots:
 	void updateMaxDepth();
 	void updateExceptionColor();
 	void updateSceneEpsilon();
+	void updateRRStartDepth();
+	void updateRRMinProb();
+	void updateLightBVH(int bvh);
+	void updateRISCandidates();
+	void updateRISTemporalReuse(int temporalReuse);
+	void updateSobolSampler(int sampler);
+	void updateSSSOctreeMaxSolidAngle();
+	void updateSSSSampleBudget();
+	void updateSSSSampleLifetime();
+	void updateSSSPoissonSamples(int poisson);
 	void changeIntegratorType(int integratorType);
 signals:
 
@@ -124,6 +124,8 @@ TriangleAreaLight::TriangleAreaLight(optix::Context c)
 	translation = optix::make_float3(0.0f,0.0f, 0.0f);
 	scale = optix::make_float3(1.0f, 1.0f, 1.0f);
 	angle_deg = 0.0f;
+	area = 0.0f;
+	sampling_mode = AREA_SAMPLING;
 	rotation_axis = optix::make_float3(0.0f, 1.0f, 0.0f);
 	x_rotation = optix::Matrix4x4::identity();
 	y_rotation = optix::Matrix4x4::identity();
@@ -206,6 +208,11 @@ void TriangleAreaLight::readJSON(const QJsonObject &json)
 		z_rotation = optix::Matrix4x4::rotate(z_rot * M_PIf / 180.0f, z_axis);
 	}
 
+	if (parameters.contains("sampling_mode") && parameters["sampling_mode"].isDouble()) {
+		int mode = parameters["sampling_mode"].toInt();
+		sampling_mode = mode >= 0 && mode < NUMBER_OF_TRIANGLE_LIGHT_SAMPLINGS ? static_cast<TriangleLightSampling>(mode) : AREA_SAMPLING;
+	}
+
 	computeTransformationMatrix();
 }
 
@@ -223,6 +230,7 @@ void TriangleAreaLight::writeJSON(QJsonObject &json) const
 	parameters["y_rotation"] = y_rot;
 	parameters["z_rotation"] = z_rot;
 	parameters["rotation"] = QJsonArray{ angle_deg, rotation_axis.x, rotation_axis.y, rotation_axis.z };
+	parameters["sampling_mode"] = sampling_mode;
 	json["parameters"] = parameters;
 }
 
@@ -276,6 +284,7 @@ void TriangleAreaLight::applyTransformationMatrix()
 	TriangleLight* transformed_data = static_cast<TriangleLight*>(transformed_light_buffer->map());
 	TriangleLight* original_data = static_cast<TriangleLight*>(triangle_light_buffer->map());
 	optix::Matrix4x4 normalMatrix = transformationMatrix.inverse().transpose();
+	area = 0.0f;
 	for (int idx = 0; idx < size; idx++)
 	{
 		TriangleLight* transformed_light = &transformed_data[idx];
@@ -294,6 +303,7 @@ void TriangleAreaLight::applyTransformationMatrix()
 		// normal vector
 		optix::float3 perp_triangle = cross(transformed_light->v1 - transformed_light->v2, transformed_light->v0 - transformed_light->v2);
 		transformed_light->area = 0.5*length(perp_triangle);
+		area += transformed_light->area;
 		transformed_light->emission = light->emission;
 	}
 	transformed_light_buffer->unmap();
@@ -365,6 +375,11 @@ void TriangleAreaLight::setRotationZ(float a_d)
 	applyTransformationMatrix();
 }
 
+void TriangleAreaLight::setSamplingMode(TriangleLightSampling s)
+{
+	sampling_mode = s;
+}
+
 
 //DiskLight
 DiskAreaLight::DiskAreaLight(optix::Context c)
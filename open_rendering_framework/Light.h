@@ -89,6 +89,8 @@ public:
 	float getYRotation() { return y_rot; };
 	float getZRotation() { return z_rot; };
 	RTsize getSize() { return size; };
+	float getArea() { return area; };
+	TriangleLightSampling getSamplingMode() { return sampling_mode; };
 
 	void loadLightGeometry();
 	
@@ -117,6 +119,8 @@ protected:
 	float y_rot;
 	float z_rot;
 	RTsize size;
+	float area;
+	TriangleLightSampling sampling_mode;
 
 public slots:
 	void setRadiance(QVector3D r);
@@ -127,6 +131,7 @@ public slots:
 	void setRotationX(float angle_degree);
 	void setRotationY(float angle_degree);
 	void setRotationZ(float angle_degree);
+	void setSamplingMode(TriangleLightSampling s);
 };
 
 
@@ -0,0 +1,695 @@
+#include "LightBVH.h"
+#include "alias_table.h"
+#include "chi_square.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <QtConcurrent/QtConcurrent>
+
+using namespace optix;
+
+namespace
+{
+	const int BUCKETS = 12;
+	// subtrees with more emitters than this are built on the thread pool
+	const int PARALLEL_THRESHOLD = 1024;
+
+	float3 rotate(const float3& v, const float3& axis, float angle)
+	{
+		// Rodrigues' rotation formula
+		float s = sinf(angle);
+		float c = cosf(angle);
+		return v * c + cross(axis, v) * s + axis * dot(axis, v) * (1.0f - c);
+	}
+
+	float angle_between(const float3& a, const float3& b)
+	{
+		float d = dot(a, b);
+		if (d < 0.0f)
+			return M_PIf - 2.0f * asinf(fminf(length(a + b) * 0.5f, 1.0f));
+		return 2.0f * asinf(fminf(length(b - a) * 0.5f, 1.0f));
+	}
+
+	float mean(const float3& v)
+	{
+		return (v.x + v.y + v.z) / 3.0f;
+	}
+}
+
+LightBVH::LightBVH(optix::Context c)
+{
+	context = c;
+	node_buffer = context->createBuffer(RT_BUFFER_INPUT);
+	node_buffer->setFormat(RT_FORMAT_USER);
+	node_buffer->setElementSize(sizeof(LightBVHNode));
+	node_buffer->setSize(0);
+	infinite_light_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, 0);
+	parent_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, 0);
+	leaf_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, 0);
+	light_count = 0;
+	triangle_count = 0;
+	context["light_bvh_buffer"]->set(node_buffer);
+	context["infinite_light_buffer"]->set(infinite_light_buffer);
+	context["light_bvh_parent_buffer"]->set(parent_buffer);
+	context["light_bvh_leaf_buffer"]->set(leaf_buffer);
+}
+
+LightBVH::LightBVH()
+{
+	light_count = 0;
+	triangle_count = 0;
+}
+
+LightBVH::~LightBVH()
+{
+	if (!context.get())
+		return;
+	node_buffer->destroy();
+	infinite_light_buffer->destroy();
+	parent_buffer->destroy();
+	leaf_buffer->destroy();
+}
+
+void LightBVH::update(const QVector<LightStruct>& light_structs, const TriangleLight* triangle_lights)
+{
+	rebuild(light_structs, triangle_lights);
+	upload();
+}
+
+void LightBVH::rebuild(const QVector<LightStruct>& light_structs, const TriangleLight* triangle_lights)
+{
+	QVector<Emitter> emitters;
+	QVector<QPair<unsigned int, int> > keys;
+	infinite_lights.clear();
+	light_count = light_structs.size();
+	triangle_count = 0;
+	for (int idx = 0; idx < light_structs.size(); idx++)
+	{
+		const LightStruct& light_struct = light_structs[idx];
+		if (light_struct.light_type == DIRECTIONAL_LIGHT)
+		{
+			infinite_lights.append(idx);
+			continue;
+		}
+		int first = -1;
+		int last = -1;
+		if (light_struct.light_type == TRIANGLES_AREA_LIGHT)
+		{
+			const TrianglesAreaLightStruct* triangle_light = reinterpret_cast<const TrianglesAreaLightStruct*>(&light_struct);
+			first = triangle_light->buffer_start_idx;
+			last = triangle_light->buffer_end_idx;
+			triangle_count = std::max(triangle_count, static_cast<unsigned int>(last + 1));
+		}
+		for (int t = first; t <= last; t++)
+		{
+			Emitter emitter;
+			emitter.light_idx = idx;
+			emitter.triangle_idx = t;
+			emitter.bounds = emitterBounds(light_struct, t >= 0 ? &triangle_lights[t] : 0);
+			emitter.centroid = 0.5f * (emitter.bounds.bbox_min + emitter.bounds.bbox_max);
+			emitters.append(emitter);
+			keys.append(qMakePair(emitter.light_idx, emitter.triangle_idx));
+		}
+	}
+
+	if (keys == emitter_keys && !nodes.isEmpty())
+	{
+		refit(light_structs, triangle_lights);
+	}
+	else
+	{
+		emitter_keys = keys;
+		nodes.clear();
+		parents.clear();
+		if (!emitters.isEmpty())
+		{
+			nodes.reserve(2 * emitters.size() - 1);
+			parents.reserve(2 * emitters.size() - 1);
+			BuildNode* root = build(emitters.data(), 0, emitters.size());
+			flatten(root, emitters.data(), 0);
+			deleteBuildNode(root);
+		}
+	}
+
+	// emitters outside the hierarchy (directional lights) keep an invalid leaf
+	leaves.fill(0xffffffffu, light_count + triangle_count);
+	for (int idx = 0; idx < nodes.size(); idx++)
+	{
+		const LightBVHNode& node = nodes[idx];
+		if (node.leaf)
+			leaves[node.triangle_idx >= 0 ? light_count + node.triangle_idx : node.child_or_light] = idx;
+	}
+}
+
+LightBVHNode LightBVH::emitterBounds(const LightStruct& light_struct, const TriangleLight* triangle)
+{
+	LightBVHNode bounds;
+	bounds.axis = make_float3(0.0f, 0.0f, 1.0f);
+	bounds.cos_theta_o = -1.0f;
+	bounds.cos_theta_e = 0.0f;
+	bounds.two_sided = 0;
+	bounds.leaf = 1;
+	bounds.child_or_light = 0;
+	bounds.triangle_idx = -1;
+	if (light_struct.light_type == POINT_LIGHT)
+	{
+		const PointLightStruct* point_light = reinterpret_cast<const PointLightStruct*>(&light_struct);
+		bounds.bbox_min = bounds.bbox_max = point_light->position;
+		bounds.phi = mean(point_light->emitted_radiance);
+	}
+	else if (light_struct.light_type == SPHERICAL_LIGHT)
+	{
+		const SphericalLightStruct* sphere_light = reinterpret_cast<const SphericalLightStruct*>(&light_struct);
+		bounds.bbox_min = sphere_light->position - make_float3(sphere_light->radius);
+		bounds.bbox_max = sphere_light->position + make_float3(sphere_light->radius);
+		bounds.phi = mean(sphere_light->emitted_radiance) * M_PIf * sphere_light->radius * sphere_light->radius;
+	}
+	else if (light_struct.light_type == DISK_LIGHT)
+	{
+		const DiskLightStruct* disk_light = reinterpret_cast<const DiskLightStruct*>(&light_struct);
+		float theta = disk_light->theta * M_PIf / 180.0f;
+		float phi = disk_light->phi * M_PIf / 180.0f;
+		bounds.bbox_min = disk_light->position - make_float3(disk_light->radius);
+		bounds.bbox_max = disk_light->position + make_float3(disk_light->radius);
+		bounds.phi = mean(disk_light->emitted_radiance) * M_PIf * disk_light->radius * disk_light->radius;
+		bounds.axis = make_float3(sinf(theta) * sinf(phi), cosf(theta), sinf(theta) * cosf(phi));
+		bounds.cos_theta_o = 1.0f;
+	}
+	else if (light_struct.light_type == TRIANGLES_AREA_LIGHT)
+	{
+		const TrianglesAreaLightStruct* triangle_light = reinterpret_cast<const TrianglesAreaLightStruct*>(&light_struct);
+		bounds.bbox_min = fminf(fminf(triangle->v0, triangle->v1), triangle->v2);
+		bounds.bbox_max = fmaxf(fmaxf(triangle->v0, triangle->v1), triangle->v2);
+		bounds.phi = mean(triangle_light->emitted_radiance) * triangle->area;
+		float3 n = cross(triangle->v1 - triangle->v0, triangle->v2 - triangle->v0);
+		if (triangle->has_normals)
+		{
+			// the shading normals decide the emitting side in the light sampler
+			float3 n0 = normalize(triangle->n0);
+			float3 n1 = normalize(triangle->n1);
+			float3 n2 = normalize(triangle->n2);
+			n = n0 + n1 + n2;
+			if (dot(n, n) > 0.0f)
+			{
+				n = normalize(n);
+				bounds.cos_theta_o = fminf(fminf(dot(n, n0), dot(n, n1)), dot(n, n2));
+			}
+		}
+		else if (dot(n, n) > 0.0f)
+		{
+			n = normalize(n);
+			bounds.cos_theta_o = 1.0f;
+		}
+		if (dot(n, n) > 0.0f)
+			bounds.axis = n;
+	}
+	return bounds;
+}
+
+LightBVHNode LightBVH::unionBounds(const LightBVHNode& a, const LightBVHNode& b)
+{
+	if (a.phi <= 0.0f)
+		return b;
+	if (b.phi <= 0.0f)
+		return a;
+
+	LightBVHNode u;
+	u.bbox_min = fminf(a.bbox_min, b.bbox_min);
+	u.bbox_max = fmaxf(a.bbox_max, b.bbox_max);
+	u.phi = a.phi + b.phi;
+	u.cos_theta_e = fminf(a.cos_theta_e, b.cos_theta_e);
+	u.two_sided = a.two_sided | b.two_sided;
+	u.leaf = 0;
+	u.child_or_light = 0;
+	u.triangle_idx = -1;
+
+	// union of the normal cones [pbrt-v4 DirectionCone::Union]
+	float theta_a = acosf(fmaxf(fminf(a.cos_theta_o, 1.0f), -1.0f));
+	float theta_b = acosf(fmaxf(fminf(b.cos_theta_o, 1.0f), -1.0f));
+	float theta_d = angle_between(a.axis, b.axis);
+	if (fminf(theta_d + theta_b, M_PIf) <= theta_a)
+	{
+		u.axis = a.axis;
+		u.cos_theta_o = a.cos_theta_o;
+		return u;
+	}
+	if (fminf(theta_d + theta_a, M_PIf) <= theta_b)
+	{
+		u.axis = b.axis;
+		u.cos_theta_o = b.cos_theta_o;
+		return u;
+	}
+	float theta_o = 0.5f * (theta_a + theta_d + theta_b);
+	float3 w_r = cross(a.axis, b.axis);
+	if (theta_o >= M_PIf || dot(w_r, w_r) == 0.0f)
+	{
+		u.axis = a.axis;
+		u.cos_theta_o = -1.0f;
+		return u;
+	}
+	u.axis = normalize(rotate(a.axis, normalize(w_r), theta_o - theta_a));
+	u.cos_theta_o = cosf(theta_o);
+	return u;
+}
+
+float LightBVH::cost(const LightBVHNode& bounds, const float3& parent_extent, int axis)
+{
+	// surface area orientation heuristic [Conty Estevez and Kulla 2018]
+	float theta_o = acosf(fmaxf(fminf(bounds.cos_theta_o, 1.0f), -1.0f));
+	float theta_e = acosf(fmaxf(fminf(bounds.cos_theta_e, 1.0f), -1.0f));
+	float theta_w = fminf(theta_o + theta_e, M_PIf);
+	float sin_theta_o = sqrtf(fmaxf(1.0f - bounds.cos_theta_o * bounds.cos_theta_o, 0.0f));
+	float M_omega = 2.0f * M_PIf * (1.0f - bounds.cos_theta_o) +
+		0.5f * M_PIf * (2.0f * theta_w * sin_theta_o - cosf(theta_o - 2.0f * theta_w) - 2.0f * theta_o * sin_theta_o + bounds.cos_theta_o);
+	float extent_axis = axis == 0 ? parent_extent.x : (axis == 1 ? parent_extent.y : parent_extent.z);
+	float K_r = fmaxf(fmaxf(parent_extent.x, parent_extent.y), parent_extent.z) / fmaxf(extent_axis, 1.0e-12f);
+	float3 d = bounds.bbox_max - bounds.bbox_min;
+	float area = 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	return bounds.phi * M_omega * K_r * area;
+}
+
+LightBVH::BuildNode* LightBVH::build(Emitter* emitters, int begin, int end)
+{
+	BuildNode* node = new BuildNode();
+	node->children[0] = node->children[1] = 0;
+	node->emitter = -1;
+	if (end - begin == 1)
+	{
+		node->bounds = emitters[begin].bounds;
+		node->emitter = begin;
+		return node;
+	}
+
+	LightBVHNode bounds = emitters[begin].bounds;
+	float3 centroid_min = emitters[begin].centroid;
+	float3 centroid_max = emitters[begin].centroid;
+	for (int i = begin + 1; i < end; i++)
+	{
+		bounds = unionBounds(bounds, emitters[i].bounds);
+		centroid_min = fminf(centroid_min, emitters[i].centroid);
+		centroid_max = fmaxf(centroid_max, emitters[i].centroid);
+	}
+	float3 extent = bounds.bbox_max - bounds.bbox_min;
+	float3 centroid_extent = centroid_max - centroid_min;
+
+	// evaluate bucketed splits along all axes
+	float best_cost = 1.0e38f;
+	int best_axis = -1;
+	int best_bucket = -1;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float c_min = axis == 0 ? centroid_min.x : (axis == 1 ? centroid_min.y : centroid_min.z);
+		float c_ext = axis == 0 ? centroid_extent.x : (axis == 1 ? centroid_extent.y : centroid_extent.z);
+		if (c_ext <= 0.0f)
+			continue;
+		LightBVHNode buckets[BUCKETS];
+		bool filled[BUCKETS] = { false };
+		for (int i = begin; i < end; i++)
+		{
+			float c = axis == 0 ? emitters[i].centroid.x : (axis == 1 ? emitters[i].centroid.y : emitters[i].centroid.z);
+			int b = std::min(static_cast<int>(BUCKETS * (c - c_min) / c_ext), BUCKETS - 1);
+			buckets[b] = filled[b] ? unionBounds(buckets[b], emitters[i].bounds) : emitters[i].bounds;
+			filled[b] = true;
+		}
+		for (int split = 0; split < BUCKETS - 1; split++)
+		{
+			LightBVHNode below, above;
+			bool has_below = false, has_above = false;
+			for (int b = 0; b <= split; b++)
+				if (filled[b])
+				{
+					below = has_below ? unionBounds(below, buckets[b]) : buckets[b];
+					has_below = true;
+				}
+			for (int b = split + 1; b < BUCKETS; b++)
+				if (filled[b])
+				{
+					above = has_above ? unionBounds(above, buckets[b]) : buckets[b];
+					has_above = true;
+				}
+			if (!has_below || !has_above)
+				continue;
+			float c = cost(below, extent, axis) + cost(above, extent, axis);
+			if (c < best_cost)
+			{
+				best_cost = c;
+				best_axis = axis;
+				best_bucket = split;
+			}
+		}
+	}
+
+	int mid = (begin + end) / 2;
+	if (best_axis >= 0)
+	{
+		float c_min = best_axis == 0 ? centroid_min.x : (best_axis == 1 ? centroid_min.y : centroid_min.z);
+		float c_ext = best_axis == 0 ? centroid_extent.x : (best_axis == 1 ? centroid_extent.y : centroid_extent.z);
+		Emitter* split = std::partition(emitters + begin, emitters + end, [=](const Emitter& e) {
+			float c = best_axis == 0 ? e.centroid.x : (best_axis == 1 ? e.centroid.y : e.centroid.z);
+			return std::min(static_cast<int>(BUCKETS * (c - c_min) / c_ext), BUCKETS - 1) <= best_bucket;
+		});
+		mid = static_cast<int>(split - emitters);
+		if (mid == begin || mid == end)
+			mid = (begin + end) / 2;
+	}
+
+	if (end - begin > PARALLEL_THRESHOLD)
+	{
+		QFuture<BuildNode*> first = QtConcurrent::run([=]() { return build(emitters, begin, mid); });
+		node->children[1] = build(emitters, mid, end);
+		node->children[0] = first.result();
+	}
+	else
+	{
+		node->children[0] = build(emitters, begin, mid);
+		node->children[1] = build(emitters, mid, end);
+	}
+	node->bounds = unionBounds(node->children[0]->bounds, node->children[1]->bounds);
+	return node;
+}
+
+void LightBVH::flatten(const BuildNode* node, Emitter* emitters, unsigned int parent)
+{
+	int idx = nodes.size();
+	nodes.append(node->bounds);
+	parents.append(parent);
+	LightBVHNode& flat = nodes[idx];
+	if (node->emitter >= 0)
+	{
+		flat.leaf = 1;
+		flat.child_or_light = emitters[node->emitter].light_idx;
+		flat.triangle_idx = emitters[node->emitter].triangle_idx;
+		return;
+	}
+	flat.leaf = 0;
+	flat.triangle_idx = -1;
+	flatten(node->children[0], emitters, idx);
+	nodes[idx].child_or_light = nodes.size();
+	flatten(node->children[1], emitters, idx);
+}
+
+void LightBVH::deleteBuildNode(BuildNode* node)
+{
+	if (node->children[0])
+		deleteBuildNode(node->children[0]);
+	if (node->children[1])
+		deleteBuildNode(node->children[1]);
+	delete node;
+}
+
+void LightBVH::refit(const QVector<LightStruct>& light_structs, const TriangleLight* triangle_lights)
+{
+	// children are always stored after their parent, so a reverse sweep updates bottom up
+	for (int idx = nodes.size() - 1; idx >= 0; idx--)
+	{
+		LightBVHNode& node = nodes[idx];
+		LightBVHNode bounds;
+		if (node.leaf)
+		{
+			bounds = emitterBounds(light_structs[node.child_or_light], node.triangle_idx >= 0 ? &triangle_lights[node.triangle_idx] : 0);
+		}
+		else
+		{
+			bounds = unionBounds(nodes[idx + 1], nodes[node.child_or_light]);
+		}
+		bounds.leaf = node.leaf;
+		bounds.child_or_light = node.child_or_light;
+		bounds.triangle_idx = node.triangle_idx;
+		node = bounds;
+	}
+}
+
+void LightBVH::upload()
+{
+	node_buffer->setSize(nodes.size());
+	if (!nodes.isEmpty())
+	{
+		memcpy(node_buffer->map(), nodes.data(), nodes.size() * sizeof(LightBVHNode));
+		node_buffer->unmap();
+	}
+	parent_buffer->setSize(parents.size());
+	if (!parents.isEmpty())
+	{
+		memcpy(parent_buffer->map(), parents.data(), parents.size() * sizeof(unsigned int));
+		parent_buffer->unmap();
+	}
+
+	leaf_buffer->setSize(leaves.size());
+	if (!leaves.isEmpty())
+	{
+		memcpy(leaf_buffer->map(), leaves.data(), leaves.size() * sizeof(unsigned int));
+		leaf_buffer->unmap();
+	}
+
+	infinite_light_buffer->setSize(infinite_lights.size());
+	if (!infinite_lights.isEmpty())
+	{
+		memcpy(infinite_light_buffer->map(), infinite_lights.data(), infinite_lights.size() * sizeof(unsigned int));
+		infinite_light_buffer->unmap();
+	}
+}
+
+namespace
+{
+	// emitters of the report scenes, all triangles of a mesh share its light
+	struct ReportScene
+	{
+		QVector<LightStruct> lights;
+		std::vector<TriangleLight> triangles;
+	};
+
+	LightStruct make_light(unsigned int type, const float3& radiance)
+	{
+		LightStruct light;
+		memset(&light, 0, sizeof(LightStruct));
+		light.light_type = type;
+		light.emitted_radiance = radiance;
+		return light;
+	}
+
+	// adds a TrianglesAreaLight of count small triangles around center
+	void add_triangle_light(ReportScene& scene, const float3& center, float extent, float size, unsigned int count, const float3& radiance, bool smooth_normals, std::mt19937& generator)
+	{
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		auto random_direction = [&]() {
+			float z = 2.0f * uniform(generator) - 1.0f;
+			float phi = 2.0f * M_PIf * uniform(generator);
+			float r = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+			return make_float3(r * cosf(phi), r * sinf(phi), z);
+		};
+		LightStruct light = make_light(TRIANGLES_AREA_LIGHT, radiance);
+		TrianglesAreaLightStruct* triangle_light = reinterpret_cast<TrianglesAreaLightStruct*>(&light);
+		triangle_light->triangle_count = static_cast<float>(count);
+		triangle_light->buffer_start_idx = static_cast<float>(scene.triangles.size());
+		triangle_light->buffer_end_idx = static_cast<float>(scene.triangles.size() + count - 1);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			TriangleLight triangle;
+			float3 p = center + extent * make_float3(uniform(generator) - 0.5f, uniform(generator) - 0.5f, uniform(generator) - 0.5f);
+			triangle.v0 = p;
+			triangle.v1 = p + size * random_direction();
+			triangle.v2 = p + size * random_direction();
+			float3 n = cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+			triangle.area = 0.5f * length(n);
+			n = normalize(n);
+			triangle.has_normals = smooth_normals ? 1 : 0;
+			triangle.n0 = normalize(n + 0.3f * random_direction());
+			triangle.n1 = normalize(n + 0.3f * random_direction());
+			triangle.n2 = normalize(n + 0.3f * random_direction());
+			triangle.emission = radiance;
+			scene.triangles.push_back(triangle);
+		}
+		scene.lights.append(light);
+	}
+
+	// one sample estimate of the unshadowed irradiance at pos with normal n
+	// from the emitter, sampled uniformly by area with xi
+	double emitter_irradiance(const ReportScene& scene, unsigned int light_idx, int triangle_idx, const float3& pos, const float3& n, float xi1, float xi2)
+	{
+		const TriangleLight& triangle = scene.triangles[triangle_idx];
+		float sqrt_xi1 = sqrtf(xi1);
+		float3 p = triangle.v0 * (1.0f - sqrt_xi1) + triangle.v1 * ((1.0f - xi2) * sqrt_xi1) + triangle.v2 * (xi2 * sqrt_xi1);
+		float3 normal = normalize(cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0));
+		float3 d = p - pos;
+		float r_sqr = dot(d, d);
+		d /= sqrtf(r_sqr);
+		float cos_theta = dot(n, d);
+		float cos_theta_prime = -dot(normal, d);
+		if (cos_theta <= 0.0f || cos_theta_prime <= 0.0f)
+			return 0.0;
+		return mean(scene.lights[light_idx].emitted_radiance) * triangle.area * cos_theta * cos_theta_prime / r_sqr;
+	}
+}
+
+bool LightBVH::report(std::ostream& out)
+{
+	const unsigned int samples = 1u << 18;
+	const double significance = 0.01;
+	std::mt19937 generator(29);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	// every kind of light, with a black mesh whose emitters can never be picked
+	ReportScene scene;
+	add_triangle_light(scene, make_float3(0.0f, 4.0f, 0.0f), 6.0f, 0.5f, 200, make_float3(1.0f, 2.0f, 3.0f), false, generator);
+	add_triangle_light(scene, make_float3(-3.0f, 2.0f, 5.0f), 3.0f, 0.3f, 100, make_float3(10.0f), true, generator);
+	add_triangle_light(scene, make_float3(3.0f, 2.0f, -5.0f), 3.0f, 0.3f, 20, make_float3(0.0f), false, generator);
+	for (int i = 0; i < 4; i++)
+	{
+		LightStruct light = make_light(POINT_LIGHT, make_float3(powf(10.0f, 2.0f * uniform(generator))));
+		PointLightStruct* point_light = reinterpret_cast<PointLightStruct*>(&light);
+		point_light->position = make_float3(8.0f * uniform(generator) - 4.0f, 3.0f, 8.0f * uniform(generator) - 4.0f);
+		scene.lights.append(light);
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		LightStruct light = make_light(DISK_LIGHT, make_float3(5.0f));
+		DiskLightStruct* disk_light = reinterpret_cast<DiskLightStruct*>(&light);
+		disk_light->position = make_float3(6.0f * i - 3.0f, 5.0f, 0.0f);
+		disk_light->radius = 0.5f;
+		disk_light->theta = 150.0f + 30.0f * i;
+		disk_light->phi = 90.0f * i;
+		scene.lights.append(light);
+		light = make_light(SPHERICAL_LIGHT, make_float3(2.0f));
+		SphericalLightStruct* sphere_light = reinterpret_cast<SphericalLightStruct*>(&light);
+		sphere_light->position = make_float3(0.0f, 1.0f + i, 6.0f * i - 3.0f);
+		sphere_light->radius = 0.25f;
+		scene.lights.append(light);
+	}
+	scene.lights.append(make_light(DIRECTIONAL_LIGHT, make_float3(1.0f)));
+
+	LightBVH bvh;
+	bvh.rebuild(scene.lights, scene.triangles.data());
+	unsigned int node_count = bvh.nodes.size();
+	out << "Light BVH: " << scene.lights.size() << " lights, " << scene.triangles.size() << " emissive triangles, "
+		<< node_count << " nodes, " << bvh.infinite_lights.size() << " infinite light" << std::endl;
+
+	// shading points with and without a normal, one of them below all the lights
+	const int points = 9;
+	unsigned int tests = 0;
+	std::vector<float3> positions, normals;
+	for (int p = 0; p < points; p++)
+	{
+		positions.push_back(make_float3(12.0f * uniform(generator) - 6.0f, 6.0f * uniform(generator) - 1.0f, 12.0f * uniform(generator) - 6.0f));
+		float z = 2.0f * uniform(generator) - 1.0f;
+		float phi = 2.0f * M_PIf * uniform(generator);
+		float r = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+		normals.push_back(p == 0 ? make_float3(0.0f) : make_float3(r * cosf(phi), r * sinf(phi), z));
+	}
+	positions[1] = make_float3(0.0f, -20.0f, 0.0f);
+	normals[1] = make_float3(0.0f, -1.0f, 0.0f);
+	for (int p = 0; p < points; p++)
+	{
+		// the last bin counts the samples for which the traversal fails, when
+		// both children of a node that may contribute cannot
+		std::vector<unsigned int> observed(node_count + 1, 0u);
+		std::vector<double> expected(node_count + 1, 0.0);
+		double pmf_sum = 0.0;
+		for (unsigned int idx = 0; idx < node_count; idx++)
+			if (bvh.nodes[idx].leaf)
+			{
+				float pmf = light_bvh_pmf(bvh.nodes, bvh.parents, node_count, idx, positions[p], normals[p]);
+				expected[idx] = pmf * (double)samples;
+				pmf_sum += pmf;
+			}
+		unsigned int failed = 0, wrong_pmf = 0, zero_pmf = 0;
+		for (unsigned int s = 0; s < samples; s++)
+		{
+			float u = uniform(generator);
+			LightBVHNode leaf;
+			float pmf;
+			if (!light_bvh_sample(bvh.nodes, node_count, positions[p], normals[p], u, leaf, pmf))
+			{
+				failed++;
+				observed[node_count]++;
+				continue;
+			}
+			unsigned int idx = bvh.leaves[leaf.triangle_idx >= 0 ? bvh.light_count + leaf.triangle_idx : leaf.child_or_light];
+			observed[idx]++;
+			float expected_pmf = (float)(expected[idx] / samples);
+			if (fabsf(pmf - expected_pmf) > 1.0e-4f * expected_pmf)
+				wrong_pmf++;
+			if (expected_pmf <= 0.0f)
+				zero_pmf++;
+		}
+		expected[node_count] = fmax(1.0 - pmf_sum, 0.0) * samples;
+		double p_value = chi_square_test(observed, expected);
+		bool valid = wrong_pmf == 0 && zero_pmf == 0 && pmf_sum < 1.0 + 1.0e-4 && p_value > significance / points;
+		passed = passed && valid;
+		out << "  point " << p << ": pmf sum " << pmf_sum << ", " << failed << " failed samples, p-value " << p_value << ", "
+			<< wrong_pmf << " wrong pmfs" << (valid ? "" : " FAILED") << std::endl;
+	}
+
+	// direct lighting on a floor below strips of 16 emissive triangles facing
+	// every direction, at an equal number of samples with the light hierarchy
+	// and with the alias tables of the lights and of their triangles
+	const unsigned int floor_points = 64, light_samples = 16, strip = 16;
+	out << "  relative RMSE at " << light_samples << " samples per point, light BVH and power:" << std::endl;
+	float bvh_rmse = 0.0f, power_rmse = 0.0f;
+	for (unsigned int triangle_count : { 256u, 4096u, 65536u })
+	{
+		ReportScene strips;
+		for (unsigned int i = 0; i < triangle_count / strip; i++)
+		{
+			float3 center = make_float3(100.0f * uniform(generator) - 50.0f, 1.0f + 4.0f * uniform(generator), 100.0f * uniform(generator) - 50.0f);
+			add_triangle_light(strips, center, 0.5f, 0.2f, strip, make_float3(powf(10.0f, 2.0f * uniform(generator))), false, generator);
+		}
+		LightBVH strip_bvh;
+		auto start = std::chrono::high_resolution_clock::now();
+		strip_bvh.rebuild(strips.lights, strips.triangles.data());
+		double build_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		unsigned int strip_nodes = strip_bvh.nodes.size();
+
+		std::vector<AliasEntry> light_table(strips.lights.size()), triangle_table(strips.triangles.size());
+		std::vector<float> power(strips.lights.size()), area(strips.triangles.size());
+		for (int i = 0; i < strips.lights.size(); i++)
+			power[i] = 0.0f;
+		for (unsigned int t = 0; t < strips.triangles.size(); t++)
+		{
+			area[t] = strips.triangles[t].area;
+			power[t / strip] += area[t] * mean(strips.lights[t / strip].emitted_radiance);
+		}
+		build_alias_table(power.data(), power.size(), light_table.data());
+		for (unsigned int i = 0; i < power.size(); i++)
+			build_alias_table(area.data() + i * strip, strip, triangle_table.data() + i * strip);
+
+		double squared_error[2] = { 0.0, 0.0 };
+		const float3 up = make_float3(0.0f, 1.0f, 0.0f);
+		for (unsigned int p = 0; p < floor_points; p++)
+		{
+			float3 pos = make_float3(100.0f * uniform(generator) - 50.0f, 0.0f, 100.0f * uniform(generator) - 50.0f);
+			// 4x4 stratified samples of every triangle
+			double reference = 0.0;
+			for (unsigned int t = 0; t < strips.triangles.size(); t++)
+				for (int s = 0; s < 16; s++)
+					reference += emitter_irradiance(strips, t / strip, t, pos, up, ((s & 3) + 0.5f) / 4.0f, ((s >> 2) + 0.5f) / 4.0f) / 16.0;
+			double estimate[2] = { 0.0, 0.0 };
+			for (unsigned int s = 0; s < light_samples; s++)
+			{
+				float u = uniform(generator);
+				LightBVHNode leaf;
+				float pmf;
+				if (light_bvh_sample(strip_bvh.nodes, strip_nodes, pos, up, u, leaf, pmf))
+					estimate[0] += emitter_irradiance(strips, leaf.child_or_light, leaf.triangle_idx, pos, up, uniform(generator), uniform(generator)) / pmf;
+				u = uniform(generator);
+				float light_pmf, triangle_pmf;
+				unsigned int light_idx = sample_alias(light_table, 0u, light_table.size(), u, light_pmf);
+				unsigned int triangle_idx = sample_alias(triangle_table, light_idx * strip, strip, u, triangle_pmf) + light_idx * strip;
+				estimate[1] += emitter_irradiance(strips, light_idx, triangle_idx, pos, up, uniform(generator), uniform(generator)) / (light_pmf * triangle_pmf);
+			}
+			for (int e = 0; e < 2; e++)
+			{
+				double relative_error = reference > 0.0 ? (estimate[e] / light_samples - reference) / reference : 0.0;
+				squared_error[e] += relative_error * relative_error;
+			}
+		}
+		bvh_rmse = (float)sqrt(squared_error[0] / floor_points);
+		power_rmse = (float)sqrt(squared_error[1] / floor_points);
+		out << "    " << triangle_count << " triangles: " << bvh_rmse << " and " << power_rmse << ", built in " << build_ms << " ms" << std::endl;
+	}
+	passed = passed && bvh_rmse < power_rmse;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+#include <QVector>
+#include <ostream>
+#include "structs.h"
+#include "light_bvh.h"
+
+// Host side builder of the light hierarchy traversed by light_bvh_sample.
+// Every bounded emitter (a triangle of a TrianglesAreaLight, a point, disk or
+// spherical light) becomes a leaf, while directional lights are kept apart in
+// a list of infinite lights. The build splits the emitters with the surface
+// area orientation heuristic and builds large subtrees in parallel. When only
+// the emitters change (e.g. a light is moved) and not the set of emitters,
+// the existing topology is refitted instead of rebuilt. The parent of every
+// node and the leaf of every emitter are uploaded as well, so that the
+// probability of picking a given emitter can be found when it is hit.
+class LightBVH
+{
+public:
+	explicit LightBVH(optix::Context c);
+	~LightBVH();
+
+	void update(const QVector<LightStruct>& light_structs, const TriangleLight* triangle_lights);
+	optix::Buffer& getNodeBuffer() { return node_buffer; };
+	optix::Buffer& getInfiniteLightBuffer() { return infinite_light_buffer; };
+	optix::Buffer& getParentBuffer() { return parent_buffer; };
+	optix::Buffer& getLeafBuffer() { return leaf_buffer; };
+	int getNodeCount() { return nodes.size(); };
+	// Checks the pmf of light_bvh_sample against light_bvh_pmf, with chi-square
+	// tests of the sampled leaves, on a scene of every kind of light, and
+	// compares the noise of direct lighting with the selection by power as
+	// the number of emissive triangles grows. Returns false if a test fails.
+	static bool report(std::ostream& out);
+
+protected:
+	// builds without uploading, for report
+	LightBVH();
+	struct Emitter
+	{
+		unsigned int light_idx;
+		int triangle_idx;
+		LightBVHNode bounds;
+		optix::float3 centroid;
+	};
+	struct BuildNode
+	{
+		LightBVHNode bounds;
+		BuildNode* children[2];
+		int emitter;
+	};
+
+	static LightBVHNode emitterBounds(const LightStruct& light_struct, const TriangleLight* triangle);
+	static LightBVHNode unionBounds(const LightBVHNode& a, const LightBVHNode& b);
+	static float cost(const LightBVHNode& bounds, const optix::float3& parent_extent, int axis);
+	BuildNode* build(Emitter* emitters, int begin, int end);
+	void flatten(const BuildNode* node, Emitter* emitters, unsigned int parent);
+	void deleteBuildNode(BuildNode* node);
+	void refit(const QVector<LightStruct>& light_structs, const TriangleLight* triangle_lights);
+	void rebuild(const QVector<LightStruct>& light_structs, const TriangleLight* triangle_lights);
+	void upload();
+
+	optix::Context context;
+	optix::Buffer node_buffer;
+	optix::Buffer infinite_light_buffer;
+	optix::Buffer parent_buffer;
+	optix::Buffer leaf_buffer;
+	QVector<LightBVHNode> nodes;
+	QVector<unsigned int> infinite_lights;
+	// parent of every node, used to find the pmf of a given leaf (light_bvh_pmf)
+	QVector<unsigned int> parents;
+	// leaf of every emitter: lights first, then the triangles of triangle_light_buffer
+	QVector<unsigned int> leaves;
+	unsigned int light_count;
+	unsigned int triangle_count;
+	// (light, triangle) pairs of the current leaves, used to detect when a refit suffices
+	QVector<QPair<unsigned int, int> > emitter_keys;
+};
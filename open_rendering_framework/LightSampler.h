@@ -11,12 +11,39 @@
 #include "sampler.h"
 #include "structs.h"
 #include "helpers.h"
+#include "alias_table.h"
+#include "light_bvh.h"
+#include "solid_angle_sampling.h"
+#include "reservoir.h"
+#include "sobol.h"
 //
 // Area light variables
 rtBuffer<LightStruct> light_buffer;
 rtBuffer<TriangleLight> triangle_light_buffer;
+rtBuffer<AliasEntry> light_alias_buffer;
+rtBuffer<AliasEntry> triangle_light_alias_buffer;
+rtBuffer<LightBVHNode> light_bvh_buffer;
+rtBuffer<uint> infinite_light_buffer;
+rtBuffer<uint> light_bvh_parent_buffer;
+rtBuffer<uint> light_bvh_leaf_buffer;
+// lights are picked with the light hierarchy instead of by power when set
+rtDeclareVariable(int, light_bvh_selection, , );
+//
+// Resampled direct lighting variables
+rtBuffer<PixelReservoir, 2> light_reservoir_buffer;
+rtDeclareVariable(uint, ris_candidates, , );
+rtDeclareVariable(int, ris_temporal_reuse, , );
+rtDeclareVariable(uint2, ris_launch_index, rtLaunchIndex, );
+rtDeclareVariable(uint2, ris_launch_dim, rtLaunchDim, );
 //
 
+// Picks a light with probability proportional to its estimated power.
+// On return u is a fresh uniform number that can be reused within the light.
+__device__ __inline__ uint sample_light_index(float& u, float& pmf)
+{
+	return sample_alias(light_alias_buffer, 0, light_buffer.size(), u, pmf);
+}
+
 __device__ __inline__ void evaluate_point_light(const float3& pos, const PointLightStruct* point_light, float3& dir, float3& L, float& dist)
 {
 	float3 light_pos = point_light->position;
@@ -37,28 +64,85 @@ __device__ __inline__ void evaluate_directional_light(const float3& pos, const D
 }
 
 
-__device__ __inline__ void evaluate_triangle_area_light(const float3& pos, const TrianglesAreaLightStruct* light_struct, float3& dir, float3& L, float& dist, uint& seed)
+// Samples a point on a given triangle of a TrianglesAreaLight. The
+// returned radiance is not divided by the probability of the triangle.
+// Below this solid angle the spherical triangle sampling loses precision, above
+// it the triangle almost covers the hemisphere and the cosine at the light
+// dominates the variance: in both cases fall back to area sampling [pbrt-v4].
+#define MIN_SPHERICAL_TRIANGLE_SOLID_ANGLE 3.0e-4f
+#define MAX_SPHERICAL_TRIANGLE_SOLID_ANGLE 6.22f
+
+__device__ __inline__ float3 triangle_light_normal(const TriangleLight& triangle_light, const float3& uvw)
+{
+	if (triangle_light.has_normals)
+	{
+		return normalize(triangle_light.n0*uvw.x + triangle_light.n1*uvw.y + triangle_light.n2*uvw.z);
+	}
+	return normalize(cross(triangle_light.v1 - triangle_light.v0, triangle_light.v2 - triangle_light.v0));
+}
+
+// As above, at the point light_pos of the triangle
+__device__ __inline__ float3 triangle_light_normal_at(const TriangleLight& triangle_light, const float3& light_pos)
+{
+	float3 e1 = triangle_light.v1 - triangle_light.v0;
+	float3 e2 = triangle_light.v2 - triangle_light.v0;
+	float3 c = cross(e1, e2);
+	float c_sqr = dot(c, c);
+	float3 d = light_pos - triangle_light.v0;
+	float v = dot(cross(d, e2), c) / c_sqr;
+	float w = dot(cross(e1, d), c) / c_sqr;
+	return triangle_light_normal(triangle_light, make_float3(1.0f - v - w, v, w));
+}
+
+// Samples the direction uniformly in the solid angle subtended by the triangle.
+// Returns false if the triangle is too small or too large for it to pay off.
+__device__ __inline__ bool evaluate_spherical_triangle_light(const float3& pos, const TrianglesAreaLightStruct* light_struct, const TriangleLight& triangle_light, float3& dir, float3& L, float& dist, const float2& xi)
+{
+	float solid_angle = spherical_triangle_solid_angle(pos, triangle_light.v0, triangle_light.v1, triangle_light.v2);
+	if (!(solid_angle > MIN_SPHERICAL_TRIANGLE_SOLID_ANGLE && solid_angle < MAX_SPHERICAL_TRIANGLE_SOLID_ANGLE))
+		return false;
+	float pdf;
+	if (!sample_spherical_triangle(pos, triangle_light.v0, triangle_light.v1, triangle_light.v2, xi, dir, pdf))
+		return false;
+
+	// barycentric coordinates of the point seen along dir [Moller and Trumbore 1997]
+	float3 e1 = triangle_light.v1 - triangle_light.v0;
+	float3 e2 = triangle_light.v2 - triangle_light.v0;
+	float3 p = cross(dir, e2);
+	float det = dot(e1, p);
+	L = make_float3(0.0f);
+	dist = 0.0f;
+	if (det == 0.0f)
+		return true;
+	float inv_det = 1.0f / det;
+	float3 s = pos - triangle_light.v0;
+	float3 q = cross(s, e1);
+	float v = clamp(dot(s, p)*inv_det, 0.0f, 1.0f);
+	float w = clamp(dot(dir, q)*inv_det, 0.0f, 1.0f - v);
+	dist = dot(e2, q)*inv_det;
+	if (dist <= 0.0f)
+		return true;
+
+	float3 n = triangle_light_normal(triangle_light, make_float3(1.0f - v - w, v, w));
+	if (dot(n, -dir) > 0.0f)
+		L = light_struct->emitted_radiance / pdf;
+	return true;
+}
+
+__device__ __inline__ void evaluate_triangle_light(const float3& pos, const TrianglesAreaLightStruct* light_struct, uint triangle_id, float3& dir, float3& L, float& dist, const float2& xi)
 {
-	  // sample a triangle
-	  uint triangles = light_struct->triangle_count;
-	  uint triangle_id = (uint)(rnd_tea(seed)*triangles) + light_struct->buffer_start_idx;
-	  
 	  TriangleLight triangle_light = triangle_light_buffer[triangle_id];
-	  float3 uvw = sample_barycentric(seed);
+	  if (light_struct->sampling_mode == SPHERICAL_TRIANGLE_SAMPLING && evaluate_spherical_triangle_light(pos, light_struct, triangle_light, dir, L, dist, xi))
+		  return;
+
+	  float3 uvw = sample_barycentric(xi);
 	  float3 light_pos = triangle_light.v0*uvw.x + triangle_light.v1*uvw.y + triangle_light.v2*uvw.z;
 	 
 	  //float4 light_pos4 = light_struct->transformation_matrix * make_float4(light_pos, 1.0f);
 	  //light_pos = make_float3(light_pos4);
 	
 	  // Compute normal
-	  float3 n;
-	  if (triangle_light.has_normals)
-	  {
-		  n = normalize(triangle_light.n0*uvw.x + triangle_light.n1*uvw.y + triangle_light.n2*uvw.z);
-	  }
-	  else {
-		  n = normalize(cross(triangle_light.v1 - triangle_light.v0, triangle_light.v2 - triangle_light.v0));
-	  }
+	  float3 n = triangle_light_normal(triangle_light, uvw);
 	  //n = make_float3(light_struct->transformation_matrix.inverse().transpose() * make_float4(n, 0.0f));
 	  // Find distance and direction
 	  dir = light_pos - pos;
@@ -67,25 +151,83 @@ __device__ __inline__ void evaluate_triangle_area_light(const float3& pos, const
 	  dir = normalize(dir);
 	  float cos_theta_prime = fmaxf(dot(n, -dir), 0.0f);
 
-	  L = light_struct->emitted_radiance*(triangle_light.area*cos_theta_prime/sqr_dist*triangles);
+	  L = light_struct->emitted_radiance*(triangle_light.area*cos_theta_prime/sqr_dist);
 }
 
-__device__ __inline__ void evaluate_disk_area_light(const float3& pos, const DiskLightStruct* disk_light, float3& dir, float3& L, float& dist, uint& seed)
+// Solid angle pdf with which evaluate_triangle_light samples the direction
+// dir, hitting the triangle at distance dist.
+__device__ __inline__ float triangle_light_pdf(const float3& pos, const TrianglesAreaLightStruct* light_struct, uint triangle_id, const float3& dir, float dist)
+{
+	TriangleLight triangle_light = triangle_light_buffer[triangle_id];
+	if (light_struct->sampling_mode == SPHERICAL_TRIANGLE_SAMPLING)
+	{
+		float solid_angle = spherical_triangle_solid_angle(pos, triangle_light.v0, triangle_light.v1, triangle_light.v2);
+		if (solid_angle > MIN_SPHERICAL_TRIANGLE_SOLID_ANGLE && solid_angle < MAX_SPHERICAL_TRIANGLE_SOLID_ANGLE)
+			return 1.0f / solid_angle;
+	}
+
+	if (triangle_light.area <= 0.0f)
+		return 0.0f;
+	float3 n = triangle_light_normal_at(triangle_light, pos + dist*dir);
+	float cos_theta_prime = dot(n, -dir);
+	return cos_theta_prime > 0.0f ? dist*dist / (triangle_light.area*cos_theta_prime) : 0.0f;
+}
+
+// The xi variants take the sample explicitly: xi.x selects the primitive
+// (when there is one to select) and xi.y, xi.z the position on it.
+__device__ __inline__ void evaluate_triangle_area_light(const float3& pos, const TrianglesAreaLightStruct* light_struct, float3& dir, float3& L, float& dist, const float3& xi)
+{
+	  // sample a triangle from its table (build_triangle_light_alias_table)
+	  uint triangles = light_struct->triangle_count;
+	  float u = xi.x;
+	  float triangle_pmf;
+	  uint triangle_id = sample_alias(triangle_light_alias_buffer, light_struct->buffer_start_idx, triangles, u, triangle_pmf) + light_struct->buffer_start_idx;
+	  evaluate_triangle_light(pos, light_struct, triangle_id, dir, L, dist, make_float2(xi.y, xi.z));
+	  L /= triangle_pmf;
+}
+
+// As above, pdf is the solid angle pdf of the sampled direction
+__device__ __inline__ void evaluate_triangle_area_light(const float3& pos, const TrianglesAreaLightStruct* light_struct, float3& dir, float3& L, float& dist, const float3& xi, float& pdf)
+{
+	  uint triangles = light_struct->triangle_count;
+	  float u = xi.x;
+	  float triangle_pmf;
+	  uint triangle_id = sample_alias(triangle_light_alias_buffer, light_struct->buffer_start_idx, triangles, u, triangle_pmf) + light_struct->buffer_start_idx;
+	  evaluate_triangle_light(pos, light_struct, triangle_id, dir, L, dist, make_float2(xi.y, xi.z));
+	  L /= triangle_pmf;
+	  pdf = triangle_pmf*triangle_light_pdf(pos, light_struct, triangle_id, dir, dist);
+}
+
+__device__ __inline__ void evaluate_triangle_area_light(const float3& pos, const TrianglesAreaLightStruct* light_struct, float3& dir, float3& L, float& dist, uint& seed)
+{
+	float3 xi;
+	xi.x = rnd_tea(seed);
+	xi.y = rnd_tea(seed);
+	xi.z = rnd_tea(seed);
+	evaluate_triangle_area_light(pos, light_struct, dir, L, dist, xi);
+}
+
+__device__ __inline__ float3 disk_light_normal(const DiskLightStruct* disk_light)
 {
-	float3 light_pos = disk_light->position;
-	float light_radius = disk_light->radius;
 	float theta = disk_light->theta * M_PIf / 180.0f;
 	float phi = disk_light->phi * M_PIf / 180.0f;
+	return make_float3(sinf(theta) * sinf(phi), cosf(theta), sinf(theta) * cosf(phi));
+}
+
+__device__ __inline__ void evaluate_disk_area_light(const float3& pos, const DiskLightStruct* disk_light, float3& dir, float3& L, float& dist, const float3& xi)
+{
+	float3 light_pos = disk_light->position;
+	float light_radius = disk_light->radius;
 
 	float area = M_PIf * light_radius * light_radius;
 	float pdf = 1.0f / area;
 
-	float3 normal = make_float3(sinf(theta) * sinf(phi), cosf(theta), sinf(theta) * cosf(phi));
+	float3 normal = disk_light_normal(disk_light);
 	float3 U, V;
 	create_onb(normal, U, V);
 
-	float u1 = rnd_tea(seed);
-	float u2 = rnd_tea(seed);
+	float u1 = xi.y;
+	float u2 = xi.z;
 	float r = sqrtf(u1) * light_radius;
 	float t = 2.0f * M_PIf * u2;
 	float3 disk_point = make_float3(r * cosf(t), r * sinf(t), 0.0f);
@@ -100,44 +242,106 @@ __device__ __inline__ void evaluate_disk_area_light(const float3& pos, const Dis
 	L = disk_light->emitted_radiance*(cos_theta_prime / sqr_dist) / pdf;
 }
 
-__device__ __inline__ void evaluate_spherical_area_light(const float3& pos, const SphericalLightStruct* spherical_light, float3& dir, float3& L, float& dist, uint& seed)
+__device__ __inline__ void evaluate_disk_area_light(const float3& pos, const DiskLightStruct* disk_light, float3& dir, float3& L, float& dist, uint& seed)
+{
+	float3 xi;
+	xi.x = 0.0f;
+	xi.y = rnd_tea(seed);
+	xi.z = rnd_tea(seed);
+	evaluate_disk_area_light(pos, disk_light, dir, L, dist, xi);
+}
+
+__device__ __inline__ float disk_area_light_pdf(const float3& pos, const DiskLightStruct* disk_light, const float3& dir, float dist)
+{
+	float3 normal = disk_light_normal(disk_light);
+	float area = M_PIf * disk_light->radius * disk_light->radius;
+	float cos_theta_prime = dot(normal, -dir);
+	return cos_theta_prime > 0.0f && area > 0.0f ? dist*dist / (area*cos_theta_prime) : 0.0f;
+}
+
+// Samples the cone of directions subtended by the sphere, see solid_angle_sampling.h
+__device__ __inline__ void evaluate_spherical_area_light(const float3& pos, const SphericalLightStruct* spherical_light, float3& dir, float3& L, float& dist, const float3& xi)
 {
 	float3 light_pos = spherical_light->position;
 	float light_radius = spherical_light->radius;
 	float3 radiance = spherical_light->emitted_radiance;
 
-	float3 visible_normal = normalize(pos - light_pos);
-	float3 U, V;
-	create_onb(visible_normal, U, V);
-
-	float area = 4 * M_PIf * light_radius * light_radius;
-	float pdf = 1.0f / area;
-	float u1 = rnd_tea(seed);
-	float u2 = rnd_tea(seed);
-	float z_coord =  u1;
-	float3 sphere_point = light_radius * make_float3(cosf(2 * M_PIf*u2) * sqrtf(1 - z_coord * z_coord), sinf(2 * M_PIf*u2) * sqrtf(1 - z_coord * z_coord), z_coord);
-	sphere_point = sphere_point.x * U + sphere_point.y * V + sphere_point.z * visible_normal + light_pos;
-	float3 normal = normalize(sphere_point - light_pos);
+	float3 sphere_point, normal;
+	float pdf;
+	sample_sphere_solid_angle(pos, light_pos, light_radius, make_float2(xi.y, xi.z), sphere_point, normal, pdf);
 	dir = sphere_point - pos;
 	float sqr_dist = dot(dir, dir);
 	dist = sqrt(sqr_dist);
 	dir = normalize(dir);
-	float cos_theta_prime = fmaxf(dot(normal, -dir), 0.0f);
-	L = radiance*(cos_theta_prime / sqr_dist) / pdf;
-
-	//float area = 4 * M_PIf * light_radius * light_radius;
-	//float pdf = 1.0f / area;
-	//float u1 = rnd_tea(seed);
-	//float u2 = rnd_tea(seed);
-	//float z_coord = 1 - 2 * u1;
-	//float3 sphere_point = light_pos + light_radius * make_float3(cosf(2*M_PIf*u2) * sqrtf(1 - z_coord * z_coord), sinf(2 * M_PIf*u2) * sqrtf(1 - z_coord * z_coord), z_coord);
-	//float3 normal = normalize(sphere_point - light_pos);
-	//dir = sphere_point - pos;
-	//float sqr_dist = dot(dir, dir);
-	//dist = sqrt(sqr_dist);
-	//dir = normalize(dir);
-	//float cos_theta_prime = fmaxf(dot(normal, -dir), 0.0f);
-	//L = radiance*(cos_theta_prime / sqr_dist) / pdf;
+	float cos_theta_prime = dot(normal, -dir);
+	L = (pdf > 0.0f && cos_theta_prime > 0.0f) ? radiance / pdf : make_float3(0.0f);
+}
+
+__device__ __inline__ void evaluate_spherical_area_light(const float3& pos, const SphericalLightStruct* spherical_light, float3& dir, float3& L, float& dist, uint& seed)
+{
+	float3 xi;
+	xi.x = 0.0f;
+	xi.y = rnd_tea(seed);
+	xi.z = rnd_tea(seed);
+	evaluate_spherical_area_light(pos, spherical_light, dir, L, dist, xi);
+}
+
+__device__ __inline__ float spherical_area_light_pdf(const float3& pos, const SphericalLightStruct* spherical_light, const float3& dir, float dist)
+{
+	float3 center = spherical_light->position;
+	float radius = spherical_light->radius;
+	float3 d = center - pos;
+	if (dot(d, d) > radius*radius)
+		return sphere_solid_angle_pdf(pos, center, radius);
+	// inside the sphere the whole surface is sampled by area
+	float3 normal = normalize(pos + dist*dir - center);
+	float cos_theta_prime = fabsf(dot(normal, dir));
+	return cos_theta_prime > 0.0f ? dist*dist / (cos_theta_prime*4.0f*M_PIf*radius*radius) : 0.0f;
+}
+
+__device__ __inline__ void evaluate_direct_illumination(const float3& pos, LightStruct* light_struct, float3& dir, float3& L, float& dist, const float3& xi)
+{
+	if (light_struct->light_type == POINT_LIGHT) {
+		PointLightStruct* point_light = reinterpret_cast<PointLightStruct*>(light_struct);
+		evaluate_point_light(pos, point_light, dir, L, dist);
+	}
+	if (light_struct->light_type == DIRECTIONAL_LIGHT) {
+		DirectionalLightStruct* directional_light = reinterpret_cast<DirectionalLightStruct*>(light_struct);
+		evaluate_directional_light(pos, directional_light, dir, L, dist);
+	}
+	if (light_struct->light_type == TRIANGLES_AREA_LIGHT) {
+		TrianglesAreaLightStruct* triangle_light = reinterpret_cast<TrianglesAreaLightStruct*>(light_struct);
+		evaluate_triangle_area_light(pos, triangle_light, dir, L, dist, xi);
+	}
+	if (light_struct->light_type == DISK_LIGHT) {
+		DiskLightStruct* disk_light = reinterpret_cast<DiskLightStruct*>(light_struct);
+		evaluate_disk_area_light(pos, disk_light, dir, L, dist, xi);
+	}
+	if (light_struct->light_type == SPHERICAL_LIGHT) {
+		SphericalLightStruct* spherical_light = reinterpret_cast<SphericalLightStruct*>(light_struct);
+		evaluate_spherical_area_light(pos, spherical_light, dir, L, dist, xi);
+	}
+
+}
+
+
+// As above, pdf is the solid angle pdf of the sampled direction within the
+// light, or zero for point and directional lights, which cannot be hit.
+__device__ __inline__ void evaluate_direct_illumination(const float3& pos, LightStruct* light_struct, float3& dir, float3& L, float& dist, const float3& xi, float& pdf)
+{
+	pdf = 0.0f;
+	if (light_struct->light_type == TRIANGLES_AREA_LIGHT) {
+		TrianglesAreaLightStruct* triangle_light = reinterpret_cast<TrianglesAreaLightStruct*>(light_struct);
+		evaluate_triangle_area_light(pos, triangle_light, dir, L, dist, xi, pdf);
+		return;
+	}
+	evaluate_direct_illumination(pos, light_struct, dir, L, dist, xi);
+	if (light_struct->light_type == DISK_LIGHT) {
+		pdf = disk_area_light_pdf(pos, reinterpret_cast<DiskLightStruct*>(light_struct), dir, dist);
+	}
+	if (light_struct->light_type == SPHERICAL_LIGHT) {
+		pdf = spherical_area_light_pdf(pos, reinterpret_cast<SphericalLightStruct*>(light_struct), dir, dist);
+	}
 }
 
 __device__ __inline__ void evaluate_direct_illumination(const float3& pos, LightStruct* light_struct, float3& dir, float3& L, float& dist, uint& seed)
@@ -165,4 +369,253 @@ __device__ __inline__ void evaluate_direct_illumination(const float3& pos, Light
 
 }
 
+// Picks a light with the light hierarchy, or a directional light as in pbrt-v4; pmf is zero
+// if no bounded light reaches pos, triangle_idx is the triangle of a TrianglesAreaLight or -1
+__device__ __inline__ uint sample_light_bvh(const float3& pos, const float3& normal, float& u, int& triangle_idx, float& pmf)
+{
+	uint infinite_lights = infinite_light_buffer.size();
+	uint bvh_nodes = light_bvh_buffer.size();
+	float p_infinite = infinite_lights > 0 ? (float)infinite_lights / (infinite_lights + (bvh_nodes > 0 ? 1 : 0)) : 0.0f;
+	triangle_idx = -1;
+	if (u < p_infinite)
+	{
+		float scaled = u / p_infinite * infinite_lights;
+		uint idx = min((uint)scaled, infinite_lights - 1);
+		u = fminf(scaled - idx, 0.99999994f);
+		pmf = p_infinite / infinite_lights;
+		return infinite_light_buffer[idx];
+	}
+	u = fminf((u - p_infinite) / (1.0f - p_infinite), 0.99999994f);
+	LightBVHNode leaf;
+	float leaf_pmf;
+	if (light_bvh_sample(light_bvh_buffer, bvh_nodes, pos, normal, u, leaf, leaf_pmf))
+	{
+		triangle_idx = leaf.triangle_idx;
+		pmf = leaf_pmf * (1.0f - p_infinite);
+		return leaf.child_or_light;
+	}
+	pmf = 0.0f;
+	return 0;
+}
+
+// Picks a light with the light hierarchy if light_bvh_selection is set,
+// otherwise by power with the alias table of the lights.
+__device__ __inline__ uint sample_light(const float3& pos, const float3& normal, float& u, int& triangle_idx, float& pmf)
+{
+	if (light_bvh_selection)
+		return sample_light_bvh(pos, normal, u, triangle_idx, pmf);
+	triangle_idx = -1;
+	return sample_light_index(u, pmf);
+}
+
+// Evaluates a light picked by sample_light
+__device__ __inline__ void evaluate_light_emitter(const float3& pos, LightStruct* light_struct, int triangle_idx, float3& dir, float3& L, float& dist, const float3& xi)
+{
+	if (triangle_idx >= 0)
+	{
+		TrianglesAreaLightStruct* triangle_light = reinterpret_cast<TrianglesAreaLightStruct*>(light_struct);
+		evaluate_triangle_light(pos, triangle_light, triangle_idx, dir, L, dist, make_float2(xi.y, xi.z));
+	}
+	else
+	{
+		evaluate_direct_illumination(pos, light_struct, dir, L, dist, xi);
+	}
+}
+
+
+// As above, pdf is the solid angle pdf of the sampled direction given the
+// picked light (or triangle), zero for point and directional lights.
+__device__ __inline__ void evaluate_light_emitter(const float3& pos, LightStruct* light_struct, int triangle_idx, float3& dir, float3& L, float& dist, const float3& xi, float& pdf)
+{
+	if (triangle_idx >= 0)
+	{
+		TrianglesAreaLightStruct* triangle_light = reinterpret_cast<TrianglesAreaLightStruct*>(light_struct);
+		evaluate_triangle_light(pos, triangle_light, triangle_idx, dir, L, dist, make_float2(xi.y, xi.z));
+		pdf = triangle_light_pdf(pos, triangle_light, triangle_idx, dir, dist);
+	}
+	else
+	{
+		evaluate_direct_illumination(pos, light_struct, dir, L, dist, xi, pdf);
+	}
+}
+
+// Probability that the shader at pos with normal picks the given light and,
+// for triangle lights, the given triangle. It follows sample_light: the
+// light hierarchy if light_bvh_selection is set, otherwise the alias tables
+// of the lights and of their triangles.
+__device__ __inline__ float light_selection_pmf(const float3& pos, const float3& normal, uint light_idx, int triangle_idx)
+{
+	if (light_bvh_selection)
+	{
+		uint infinite_lights = infinite_light_buffer.size();
+		uint bvh_nodes = light_bvh_buffer.size();
+		uint leaf_key = triangle_idx >= 0 ? light_buffer.size() + triangle_idx : light_idx;
+		if (bvh_nodes == 0 || leaf_key >= light_bvh_leaf_buffer.size())
+			return 0.0f;
+		float p_infinite = (float)infinite_lights / (infinite_lights + 1);
+		return (1.0f - p_infinite)*light_bvh_pmf(light_bvh_buffer, light_bvh_parent_buffer, bvh_nodes, light_bvh_leaf_buffer[leaf_key], pos, normal);
+	}
+	float pmf = light_alias_buffer[light_idx].pmf;
+	if (triangle_idx >= 0)
+		pmf *= triangle_light_alias_buffer[triangle_idx].pmf;
+	return pmf;
+}
+
+// Solid angle pdf with which direct lighting at pos samples the direction dir
+// towards the given light, hitting it at distance dist.
+__device__ __inline__ float light_sample_pdf(const float3& pos, const float3& normal, uint light_idx, int triangle_idx, const float3& dir, float dist)
+{
+	LightStruct light_struct = light_buffer[light_idx];
+	float pmf = light_selection_pmf(pos, normal, light_idx, triangle_idx);
+	if (pmf <= 0.0f)
+		return 0.0f;
+	if (light_struct.light_type == TRIANGLES_AREA_LIGHT && triangle_idx >= 0)
+		return pmf*triangle_light_pdf(pos, reinterpret_cast<TrianglesAreaLightStruct*>(&light_struct), triangle_idx, dir, dist);
+	if (light_struct.light_type == DISK_LIGHT)
+		return pmf*disk_area_light_pdf(pos, reinterpret_cast<DiskLightStruct*>(&light_struct), dir, dist);
+	if (light_struct.light_type == SPHERICAL_LIGHT)
+		return pmf*spherical_area_light_pdf(pos, reinterpret_cast<SphericalLightStruct*>(&light_struct), dir, dist);
+	return 0.0f;
+}
+
+// Target function of resampled direct lighting: the unshadowed irradiance from light_pos
+// at pos in area measure, G being the cosine at the light over the squared distance
+__device__ __inline__ float light_ris_target(const float3& pos, const float3& normal, uint light_idx, int triangle_idx, const float3& light_pos, float3& dir, float3& Le, float& dist, float& G)
+{
+	G = 0.0f;
+	Le = make_float3(0.0f);
+	dir = normal;
+	dist = 0.0f;
+	if (light_idx >= light_buffer.size())
+		return 0.0f;
+	LightStruct light_struct = light_buffer[light_idx];
+	if (light_struct.light_type == DIRECTIONAL_LIGHT)
+	{
+		evaluate_directional_light(pos, reinterpret_cast<DirectionalLightStruct*>(&light_struct), dir, Le, dist);
+		G = 1.0f;
+	}
+	else
+	{
+		float3 d = light_pos - pos;
+		float sqr_dist = dot(d, d);
+		if (!(sqr_dist > 0.0f))
+			return 0.0f;
+		dist = sqrtf(sqr_dist);
+		dir = d / dist;
+		if (light_struct.light_type == POINT_LIGHT)
+		{
+			Le = light_struct.emitted_radiance / sqr_dist;
+			G = 1.0f;
+		}
+		else
+		{
+			float3 n = make_float3(0.0f);
+			if (light_struct.light_type == TRIANGLES_AREA_LIGHT && triangle_idx >= 0)
+				n = triangle_light_normal_at(triangle_light_buffer[triangle_idx], light_pos);
+			if (light_struct.light_type == DISK_LIGHT)
+				n = disk_light_normal(reinterpret_cast<DiskLightStruct*>(&light_struct));
+			if (light_struct.light_type == SPHERICAL_LIGHT)
+				n = normalize(light_pos - reinterpret_cast<SphericalLightStruct*>(&light_struct)->position);
+			float cos_theta_prime = dot(n, -dir);
+			if (cos_theta_prime > 0.0f)
+			{
+				Le = light_struct.emitted_radiance;
+				G = cos_theta_prime / sqr_dist;
+			}
+		}
+	}
+	float cos_theta = dot(normal, dir);
+	return cos_theta > 0.0f ? (Le.x + Le.y + Le.z) / 3.0f*cos_theta*G : 0.0f;
+}
+
+// Resampled importance sampling of direct lighting [Talbot et al. 2005] of candidates
+// light samples, reusing the reservoir of the pixel at camera hits if ris_temporal_reuse is set
+__device__ __inline__ void sample_light_ris(const float3& pos, const float3& normal, uint candidates, int depth, const SobolSampler& sobol, uint& seed, LightReservoir& r)
+{
+	reservoir_reset(r);
+	for (uint i = 0; i < candidates; ++i)
+	{
+		float u;
+		float2 xi_light;
+		if (sobol_sampler)
+		{
+			// the candidates of a frame are consecutive points of the sequence
+			SobolSampler candidate = sobol;
+			candidate.index = sobol.index*candidates + i;
+			u = sobol_1d(candidate, sobol_slot(depth, SOBOL_LIGHT_SELECTION));
+			xi_light = sobol_2d(candidate, sobol_slot(depth, SOBOL_LIGHT_POSITION));
+		}
+		else
+		{
+			u = rnd_tea(seed);
+			xi_light.x = rnd_tea(seed);
+			xi_light.y = rnd_tea(seed);
+		}
+		float pmf;
+		int triangle_idx;
+		uint light_idx = sample_light(pos, normal, u, triangle_idx, pmf);
+		float target = 0.0f, w = 0.0f;
+		float3 light_pos = make_float3(0.0f);
+		if (pmf > 0.0f && light_idx < light_buffer.size())
+		{
+			LightStruct light_struct = light_buffer[light_idx];
+			// the reservoir keeps the triangle, so it is picked here rather
+			// than within the light
+			if (triangle_idx < 0 && light_struct.light_type == TRIANGLES_AREA_LIGHT)
+			{
+				TrianglesAreaLightStruct* triangle_light = reinterpret_cast<TrianglesAreaLightStruct*>(&light_struct);
+				uint start = (uint)triangle_light->buffer_start_idx;
+				float triangle_pmf;
+				triangle_idx = sample_alias(triangle_light_alias_buffer, start, (uint)triangle_light->triangle_count, u, triangle_pmf) + start;
+				pmf *= triangle_pmf;
+			}
+			float3 dir, L, Le;
+			float dist, emitter_pdf, G;
+			evaluate_light_emitter(pos, &light_struct, triangle_idx, dir, L, dist, make_float3(u, xi_light.x, xi_light.y), emitter_pdf);
+			light_pos = pos + dist*dir;
+			target = light_ris_target(pos, normal, light_idx, triangle_idx, light_pos, dir, Le, dist, G);
+			// the source pdf in area measure, as the target
+			float source = pmf*(emitter_pdf > 0.0f ? emitter_pdf*G : 1.0f);
+			w = target > 0.0f && source > 0.0f ? target / source : 0.0f;
+		}
+		reservoir_update(r, light_idx, triangle_idx, light_pos, target, w, rnd_tea(seed));
+	}
+	reservoir_finalize(r);
+
+	// Temporal reuse [Bitterli et al. 2020] with a capped history; the previous candidates only
+	// count if the previous shading point could have kept the sample (reservoir_finalize)
+	if (depth == 0 && ris_temporal_reuse && ris_launch_dim.x == light_reservoir_buffer.size().x && ris_launch_dim.y == light_reservoir_buffer.size().y)
+	{
+		PixelReservoir pixel = light_reservoir_buffer[ris_launch_index];
+		LightReservoir& previous = pixel.reservoir;
+		previous.M = fminf(previous.M, 20.0f*candidates);
+		if (previous.M > 0.0f)
+		{
+			float3 dir, Le;
+			float dist, G;
+			float Z = r.M;
+			float target = light_ris_target(pos, normal, previous.light_idx, previous.triangle_idx, previous.light_pos, dir, Le, dist, G);
+			reservoir_merge(r, previous, target, rnd_tea(seed));
+			if (light_ris_target(pixel.pos, pixel.normal, r.light_idx, r.triangle_idx, r.light_pos, dir, Le, dist, G) > 0.0f)
+				Z += previous.M;
+			reservoir_finalize(r, Z);
+		}
+		pixel.reservoir = r;
+		pixel.pos = pos;
+		pixel.normal = normal;
+		light_reservoir_buffer[ris_launch_index] = pixel;
+	}
+}
+
+// Evaluates the sample kept by a reservoir: L is the radiance over the solid angle pdf 1/(G W),
+// pdf the solid angle pdf of plain light sampling, for MIS against BSDF sampling
+__device__ __inline__ void evaluate_light_reservoir(const float3& pos, const float3& normal, const LightReservoir& r, float3& dir, float3& L, float& dist, float& pdf)
+{
+	float3 Le;
+	float G;
+	float target = light_ris_target(pos, normal, r.light_idx, r.triangle_idx, r.light_pos, dir, Le, dist, G);
+	L = target > 0.0f ? Le*(G*r.W) : make_float3(0.0f);
+	pdf = target > 0.0f ? light_sample_pdf(pos, normal, r.light_idx, r.triangle_idx, dir, dist) : 0.0f;
+}
+
 #endif
\ No newline at end of file
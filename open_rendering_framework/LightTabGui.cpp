@@ -463,6 +463,18 @@ void LightTab::addTriangleAreaLightParameters(TriangleAreaLight* light, Triangle
 	QObject::connect(zRotSlider, SIGNAL(valueChanged(int)), zRotSpinBox, SLOT(setValue(int)));
 	QObject::connect(zRotSpinBox, SIGNAL(valueChanged(int)), zRotSlider, SLOT(setValue(int)));
 
+	//LIGHT SAMPLING WIDGETS AND SIGNALS-SLOTS CONNECTIONS
+	QLabel *samplingLabel = new QLabel(tr("Sampling"), triangleLightBox);
+	samplingLabel->setObjectName("sampling_label");
+	QComboBox *samplingComboBox = new QComboBox(triangleLightBox);
+	samplingComboBox->setObjectName("sampling_combobox");
+	for (int idx = 0; idx < TriangleLightSampling::NUMBER_OF_TRIANGLE_LIGHT_SAMPLINGS; idx++)
+	{
+		samplingComboBox->addItem(triangleLightSamplingNames[idx]);
+	}
+	samplingComboBox->setCurrentIndex(light->getSamplingMode());
+	QObject::connect(samplingComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateTriangleLightSampling(int)));
+
 
 	//REMOVE BUTTON
 	QPushButton *removeButton = new QPushButton("Remove", triangleLightBox);
@@ -499,6 +511,8 @@ void LightTab::addTriangleAreaLightParameters(TriangleAreaLight* light, Triangle
 	triangleLightLayout->addWidget(zRotSliderLabel, 8, 0);
 	triangleLightLayout->addWidget(zRotSlider, 8, 1);
 	triangleLightLayout->addWidget(zRotSpinBox, 8, 2);
+	triangleLightLayout->addWidget(samplingLabel, 9, 0);
+	triangleLightLayout->addWidget(samplingComboBox, 9, 1, 1, 2);
 
 	triangleLightBox->setLayout(triangleLightLayout);
 	lightWidgetVector.append(triangleLightBox);
@@ -581,6 +595,14 @@ void LightTab::updateTriangleLightRadiance()
 	optixWindow->restartFrame();
 }
 
+void LightTab::updateTriangleLightSampling(int sampling_mode)
+{
+	reinterpret_cast<TrianglesAreaLightStruct*> (&optixWindow->getScene()->getLightStructs()->data()[currentLight])->sampling_mode = sampling_mode;
+	reinterpret_cast<TriangleAreaLight*> (optixWindow->getScene()->getLights()->data()[currentLight])->setSamplingMode(static_cast<TriangleLightSampling>(sampling_mode));
+	optixWindow->getScene()->updateLights(false);
+	optixWindow->restartFrame();
+}
+
 void LightTab::updateTriangleLightPosition()
 {
 	float pos_x = lightWidgetVector[currentLight]->findChild<QLineEdit*>("pos_x")->text().toFloat();
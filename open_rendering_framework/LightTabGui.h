@@ -41,6 +41,7 @@ protected slots:
 	void updateTriangleLightXRotation();
 	void updateTriangleLightYRotation();
 	void updateTriangleLightZRotation();
+	void updateTriangleLightSampling(int sampling_mode);
 	void updateDiskLightPosition();
 	void updateDiskLightRadiance();
 	void updateDiskLightRadius();
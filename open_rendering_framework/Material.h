@@ -322,6 +322,7 @@ protected:
 
 	void initTable();
 	void initPrograms();
+	void updateFresnelTable();
 
 	//parameters
 	MyComplex3 index_of_refraction;
@@ -333,6 +334,9 @@ protected:
 	optix::float2 roughness;
 	MicrofacetModel m_model;
 	NormalsDistribution n_distribution;
+	// Fresnel reflectance of the index of refraction (ConductorFresnel)
+	QVector<optix::float3> fresnel_table;
+	optix::Buffer fresnel_table_buffer;
 
 private:
 	enum TableRows
@@ -393,6 +397,17 @@ protected:
 	optix::float3 meancosine;
 	DefaultScatteringMaterial current;
 	DipoleModel dipole_model;
+	SSSEstimator sss_estimator;
+	// radial profile of the standard dipole (dipoles/dipole_profile.h)
+	QVector<optix::float3> dipole_profile;
+	optix::Buffer dipole_profile_buffer;
+	// its CDF, to sample the probe rays (dipoles/bssrdf_sampling.h)
+	QVector<optix::float3> dipole_cdf;
+	optix::Buffer dipole_cdf_buffer;
+	// multiple scattering of photon beam diffusion (PBDTable), built only
+	// for that model
+	QVector<optix::float3> pbd_table;
+	optix::Buffer pbd_table_buffer;
 
 private:
 	enum TableRows
@@ -404,6 +419,7 @@ private:
 		scattering_row,
 		meancosine_row,
 		dipole_row,
+		estimator_row,
 		table_rows
 	};
 
@@ -411,6 +427,7 @@ public slots:
 	void tableUpdate(int row, int column);
 	void updateDefaultMaterial(int material);
 	void updateDipoleModel(int model);
+	void updateSSSEstimator(int estimator);
 };
 
 class RoughTranslucentMaterial : public MyMaterial
@@ -456,6 +473,9 @@ protected:
 	optix::float3 meancosine;
 	DefaultScatteringMaterial current;
 	DipoleModel dipole_model;
+	// radial profile of the standard dipole (dipoles/dipole_profile.h)
+	QVector<optix::float3> dipole_profile;
+	optix::Buffer dipole_profile_buffer;
 	optix::float2 roughness;
 	MicrofacetModel m_model;
 	NormalsDistribution n_distribution;
@@ -2,6 +2,8 @@
 #include "Material.h"
 #include "OptixScene.h"
 #include "sampleConfig.h"
+#include "Fresnel.h"
+#include "ConductorFresnel.h"
 
 
 MetallicMaterial::MetallicMaterial(optix::Context c)
@@ -17,6 +19,8 @@ MetallicMaterial::MetallicMaterial(optix::Context c)
 	initPrograms();
 	mtl->declareVariable("ior");
 	mtl["ior"]->setUserData(sizeof(MyComplex3), &index_of_refraction);
+	mtl->declareVariable("fresnel_average");
+	updateFresnelTable();
 	mtl->declareVariable("roughness");
 	mtl["roughness"]->setFloat(roughness);
 	mtl->declareVariable("microfacet_model");
@@ -114,9 +118,20 @@ void MetallicMaterial::initPrograms()
 	mtl->setClosestHitProgram(radiance_ray_type, closest_hit);
 	mtl->setAnyHitProgram(shadow_ray_type, any_hit);
 	mtl->setClosestHitProgram(depth_ray_type, depth_closest_hit);
-
+	fresnel_table_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, FRESNEL_TABLE_COSINES);
+	mtl["fresnel_table_buffer"]->set(fresnel_table_buffer);
 };
 
+void MetallicMaterial::updateFresnelTable()
+{
+	// relative index of the air over the metal, as in the metallic shader
+	fresnel_table.resize(FRESNEL_TABLE_COSINES);
+	ConductorFresnel::build(1.0f / index_of_refraction, fresnel_table.data());
+	memcpy(fresnel_table_buffer->map(), fresnel_table.data(), FRESNEL_TABLE_COSINES * sizeof(optix::float3));
+	fresnel_table_buffer->unmap();
+	mtl["fresnel_average"]->setFloat(ConductorFresnel::average(fresnel_table.data()));
+}
+
 void MetallicMaterial::tableUpdate(int row, int column)
 {
 	if (row == 1 || row == 2 || row== 3)
@@ -222,6 +237,8 @@ void MetallicMaterial::loadFromJSON(const QJsonObject &json)
 
 	mtl->declareVariable("ior");
 	mtl["ior"]->setUserData(sizeof(MyComplex3), &index_of_refraction);
+	mtl->declareVariable("fresnel_average");
+	updateFresnelTable();
 	mtl->declareVariable("roughness");
 	mtl["roughness"]->setFloat(roughness);
 	mtl->declareVariable("microfacet_model");
@@ -236,6 +253,7 @@ void MetallicMaterial::setIor(MyComplex3 ior)
 {
 	index_of_refraction = ior;
 	mtl["ior"]->setUserData(sizeof(MyComplex3), &index_of_refraction);
+	updateFresnelTable();
 
 };
 
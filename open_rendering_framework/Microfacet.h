@@ -5,7 +5,7 @@
 #include "MicrofacetGGX.h"
 
 
-__inline__ __device__ float masking_G1(const float cos_theta, const float alpha_sqr, const uint normal_distribution)
+__host__ __device__ __inline__ float masking_G1(const float cos_theta, const float alpha_sqr, const uint normal_distribution)
 {
 	if (normal_distribution == GGX_DISTRIBUTION)
 		return ggx_G1(cos_theta, alpha_sqr);
@@ -13,7 +13,7 @@ __inline__ __device__ float masking_G1(const float cos_theta, const float alpha_
 		return beckmann_G1(cos_theta, alpha_sqr);
 }
 
-__inline__ __device__ float masking_G1(const optix::float3 v, const optix::float3 m, const optix::float3 n, const float alpha, const uint normal_distribution)
+__host__ __device__ __inline__ float masking_G1(const optix::float3 v, const optix::float3 m, const optix::float3 n, const float alpha, const uint normal_distribution)
 {
 	if (normal_distribution == GGX_DISTRIBUTION)
 		return ggx_G1(v, m, n, alpha);
@@ -21,7 +21,7 @@ __inline__ __device__ float masking_G1(const optix::float3 v, const optix::float
 		return beckmann_G1(v, m, n, alpha);
 }
 
-__inline__ __device__ float masking_G1(const optix::float3 v, const optix::float3 m, const optix::float3 n, const float alpha_x, const float alpha_y, const uint normal_distribution)
+__host__ __device__ __inline__ float masking_G1(const optix::float3 v, const optix::float3 m, const optix::float3 n, const float alpha_x, const float alpha_y, const uint normal_distribution)
 {
 
 	//	float alpha = alpha_i(transformToLocal(v, n), alpha_x, alpha_y);
@@ -31,7 +31,7 @@ __inline__ __device__ float masking_G1(const optix::float3 v, const optix::float
 		return beckmann_G1(v, m, n, alpha_x, alpha_y);
 }
 
-__inline__ __device__ float masking_G(const float cos_theta_i, const float cos_theta_o, const float cosines, const float alpha, const uint normal_distribution)
+__host__ __device__ __inline__ float masking_G(const float cos_theta_i, const float cos_theta_o, const float cosines, const float alpha, const uint normal_distribution)
 {
 	if (normal_distribution == GGX_DISTRIBUTION)
 		return ggx_G(cos_theta_i, cos_theta_o, cosines, alpha);
@@ -39,7 +39,7 @@ __inline__ __device__ float masking_G(const float cos_theta_i, const float cos_t
 		return beckmann_G(cos_theta_i, cos_theta_o, cosines, alpha);
 }
 
-__inline__ __device__ float masking_G(const float3 wi, const float h, const float a_x, const float a_y, const uint normal_distribution)
+__host__ __device__ __inline__ float masking_G(const float3 wi, const float h, const float a_x, const float a_y, const uint normal_distribution)
 {
 	if (normal_distribution == GGX_DISTRIBUTION)
 		return ggx_G(wi, h, a_x, a_y);
@@ -47,7 +47,7 @@ __inline__ __device__ float masking_G(const float3 wi, const float h, const floa
 		return beckmann_G(wi, h, a_x, a_y);
 }
 
-__inline__ __device__ void microfacet_sample_normal(const float3 normal, float3 &sampled_normal, const float z1, const float z2, const float alpha, const uint normal_distribution)
+__host__ __device__ __inline__ void microfacet_sample_normal(const float3 normal, float3 &sampled_normal, const float z1, const float z2, const float alpha, const uint normal_distribution)
 {
 	if (normal_distribution == GGX_DISTRIBUTION) {
 		//rtPrintf("GGX \n");
@@ -59,7 +59,7 @@ __inline__ __device__ void microfacet_sample_normal(const float3 normal, float3
 	}
 }
 
-__inline__ __device__ float microfacet_eval_BSDF(const float3 w_i, const float3 w_o, const float3 n, const float alpha, const float ior1_over_ior2, const uint normal_distribution)
+__host__ __device__ __inline__ float microfacet_eval_BSDF(const float3 w_i, const float3 w_o, const float3 n, const float alpha, const float ior1_over_ior2, const uint normal_distribution)
 {
 	float bsdf = 0.0f;
 	if (normal_distribution == GGX_DISTRIBUTION)
@@ -69,7 +69,7 @@ __inline__ __device__ float microfacet_eval_BSDF(const float3 w_i, const float3
 	return bsdf;
 }
 
-__inline__ __device__ void microfacet_sample_visible_normal(const float3& wi, const float3& normal, float3 &sampled_normal,
+__host__ __device__ __inline__ void microfacet_sample_visible_normal(const float3& wi, const float3& normal, float3 &sampled_normal,
 	const float a_x, const float a_y, const float z1, const float z2, uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(wi, normal);
@@ -82,7 +82,7 @@ __inline__ __device__ void microfacet_sample_visible_normal(const float3& wi, co
 	return;
 }
 
-__inline__ __device__ float microfacet_eval_visible_normal(const float3& wi, const float3& wm, const float3& normal,
+__host__ __device__ __inline__ float microfacet_eval_visible_normal(const float3& wi, const float3& wm, const float3& normal,
 	const float a_x, const float a_y, uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(wi, normal);
@@ -97,8 +97,45 @@ __inline__ __device__ float microfacet_eval_visible_normal(const float3& wi, con
 }
 
 
+__host__ __device__ __inline__ float microfacet_distribution_eval(const float3& m, const float3& n, const float alpha, const uint normal_distribution)
+{
+	if (normal_distribution == GGX_DISTRIBUTION)
+		return ggx_distribution_eval(m, n, alpha);
+	else
+		return beckmann_distribution_eval(m, n, alpha);
+}
+
+__host__ __device__ __inline__ float microfacet_eval_NDF(const float3& wm, const float3& normal, const float a_x, const float a_y, uint normal_distribution)
+{
+	float3 local_wm = transformToLocal(wm, normal);
+	if (normal_distribution == GGX_DISTRIBUTION)
+		return ggx_eval_NDF(local_wm, a_x, a_y);
+	else
+		return beckmann_eval_NDF(local_wm, a_x, a_y);
+}
+
+//Solid angle pdf of reflecting w_i into w_o about a microfacet normal sampled with
+//microfacet_sample_normal (WALTER_MODEL) or microfacet_sample_visible_normal (VISIBLE_NORMALS_MODEL
+//and the single scattering lobe of ENERGY_COMPENSATION_MODEL)
+__host__ __device__ __inline__ float microfacet_reflection_pdf(const float3& w_i, const float3& w_o, const float3& normal,
+	const float a_x, const float a_y, const uint microfacet_model, const uint normal_distribution)
+{
+	float3 h = w_i + w_o;
+	if (dot(h, h) <= 0.0f)
+		return 0.0f;
+	h = normalize(h);
+	float o_h = fabsf(dot(w_o, h));
+	if (o_h <= 0.0f)
+		return 0.0f;
+	if (microfacet_model == WALTER_MODEL)
+		return microfacet_distribution_eval(h, normal, a_x, normal_distribution) * fabsf(dot(h, normal)) / (4.0f * o_h);
+	if (microfacet_model == VISIBLE_NORMALS_MODEL || microfacet_model == ENERGY_COMPENSATION_MODEL)
+		return microfacet_eval_visible_normal(w_i, h, normal, a_x, a_y, normal_distribution) / (4.0f * o_h);
+	return 0.0f;
+}
+
 //Sample the multiscattering BSDF for dielectric
-__inline__ __device__ void microfacet_multiscattering_dielectric_BSDF_sample(const float3& w_i, float3& w_o, const float3& normal,
+__host__ __device__ __inline__ void microfacet_multiscattering_dielectric_BSDF_sample(const float3& w_i, float3& w_o, const float3& normal,
 	float eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight, const uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(w_i, normal);
@@ -113,7 +150,7 @@ __inline__ __device__ void microfacet_multiscattering_dielectric_BSDF_sample(con
 }
 
 //Evaluate dielectric BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float microfacet_multiscattering_dielectric_BSDF_eval(const optix::float3& w_i, const optix::float3 w_o, const float3& normal,
+__host__ __device__ __inline__ float microfacet_multiscattering_dielectric_BSDF_eval(const optix::float3& w_i, const optix::float3 w_o, const float3& normal,
 	float eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder,  const uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(w_i, normal);
@@ -126,7 +163,7 @@ __device__ __inline__ float microfacet_multiscattering_dielectric_BSDF_eval(cons
 }
 
 //Sample the multiscattering BSDF for diffuse
-__inline__ __device__ void microfacet_multiscattering_diffuse_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
+__host__ __device__ __inline__ void microfacet_multiscattering_diffuse_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
 	const float3& normal, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight, const float3& rho_d, const uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(w_i, normal);
@@ -142,7 +179,7 @@ __inline__ __device__ void microfacet_multiscattering_diffuse_BSDF_sample(const
 }
 
 //Evaluate diffuse BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float3 microfacet_multiscattering_diffuse_BSDF_eval(const optix::float3& w_i, const optix::float3 w_o, const float3& normal,
+__host__ __device__ __inline__ float3 microfacet_multiscattering_diffuse_BSDF_eval(const optix::float3& w_i, const optix::float3 w_o, const float3& normal,
 	const float a_x, const float a_y, uint& seed, uint scatteringOrder, const float3& rho_d, const uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(w_i, normal);
@@ -154,7 +191,7 @@ __device__ __inline__ float3 microfacet_multiscattering_diffuse_BSDF_eval(const
 }
 
 //Sample the multiscattering BSDF for conductor
-__inline__ __device__ void microfacet_multiscattering_conductor_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
+__host__ __device__ __inline__ void microfacet_multiscattering_conductor_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
 	const float3& normal, const MyComplex3 eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight, const uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(w_i, normal);
@@ -170,7 +207,7 @@ __inline__ __device__ void microfacet_multiscattering_conductor_BSDF_sample(cons
 }
 
 //Evaluate conductor BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float3 microfacet_multiscattering_conductor_BSDF_eval(const optix::float3& w_i, const optix::float3 w_o, const optix::float3 normal, 
+__host__ __device__ __inline__ float3 microfacet_multiscattering_conductor_BSDF_eval(const optix::float3& w_i, const optix::float3 w_o, const optix::float3 normal, 
 	const MyComplex3 eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder, const uint normal_distribution)
 {
 	float3 local_wi = transformToLocal(w_i, normal);
@@ -4,13 +4,14 @@
 #include "helpers.h"
 #include <optixu/optixu_math_namespace.h>
 #include <optix.h>
-#include "fresnel.h"
+#include "Fresnel.h"
 #include "MyComplex.h"
 #include "random.h"
+#include "beckmann_vndf_table.h"
 using namespace optix;
 
 // projected roughness, wi in local coordinates, the normal is (0,0,1)
-__device__ __inline__ float beckmann_alpha_i(const optix::float3& wi, const float alpha_x, const float alpha_y){
+__host__ __device__ __inline__ float beckmann_alpha_i(const optix::float3& wi, const float alpha_x, const float alpha_y){
 	float invSinTheta2 = 1.0f / (1.0f - wi.z*wi.z);
 	if (wi.z == 1.0f || wi.z == -1.0f)
 		invSinTheta2 = 0.0f;
@@ -21,7 +22,7 @@ __device__ __inline__ float beckmann_alpha_i(const optix::float3& wi, const floa
 }
 
 //Beckmann Smith Lambda function
-__device__ __inline__ float beckmann_smith_lambda(const float3& wi, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_smith_lambda(const float3& wi, const float a_x, const float a_y){
 	if (wi.z > 0.9999f){
 		return 0.0f;
 	}
@@ -42,7 +43,7 @@ __device__ __inline__ float beckmann_smith_lambda(const float3& wi, const float
 }
 
 //Beckmann Projected Area
-__device__ __inline__ float beckmann_projected_area(const float3& wi, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_projected_area(const float3& wi, const float a_x, const float a_y){
 
 	if (wi.z > 0.9999f)
 		return 1.0f;
@@ -58,14 +59,14 @@ __device__ __inline__ float beckmann_projected_area(const float3& wi, const floa
 }
 
 //Beckmann slope distribution
-__device__ __inline__ float beckmann_slope_pdf(const float slope_x, const float alpha_x, const float slope_y, const float alpha_y){
+__host__ __device__ __inline__ float beckmann_slope_pdf(const float slope_x, const float alpha_x, const float slope_y, const float alpha_y){
 
 	float pdf = 1.0f / (M_PIf * alpha_x * alpha_y) *expf(-slope_x * slope_x / (alpha_x * alpha_x) - slope_y * slope_y / (alpha_y * alpha_y));
 	return pdf;
 }
 
 //G1 masking shadowing function, Beckmann distribution
-__inline__ __device__ float beckmann_G1(float cos_theta, float alpha_b_sqr)
+__host__ __device__ __inline__ float beckmann_G1(float cos_theta, float alpha_b_sqr)
 {
 	float cos_theta_sqr = cos_theta*cos_theta;
 	float tan_theta_sqr = (1.0f - cos_theta_sqr) / cos_theta_sqr;
@@ -75,7 +76,7 @@ __inline__ __device__ float beckmann_G1(float cos_theta, float alpha_b_sqr)
 }
 
 //G1 masking shadowing function, Beckmann distribution
-__inline__ __device__ float beckmann_G1(const optix::float3& v,const optix::float3& m,const optix::float3& n, float width)
+__host__ __device__ __inline__ float beckmann_G1(const optix::float3& v,const optix::float3& m,const optix::float3& n, float width)
 {
 	float cos_theta_v = dot(v, n);
 	if (optix::dot(v, m) * cos_theta_v <= 0)
@@ -86,7 +87,7 @@ __inline__ __device__ float beckmann_G1(const optix::float3& v,const optix::floa
 }
 
 //G1 masking shadowing function, Beckmann distribution
-__inline__ __device__ float beckmann_G1(const optix::float3& v, const optix::float3& m, const optix::float3& n, float a_x, float a_y)
+__host__ __device__ __inline__ float beckmann_G1(const optix::float3& v, const optix::float3& m, const optix::float3& n, float a_x, float a_y)
 {
 	float width = beckmann_alpha_i(transformToLocal(v, n), a_x, a_y);
 	float cos_theta_v = dot(v, n);
@@ -98,14 +99,14 @@ __inline__ __device__ float beckmann_G1(const optix::float3& v, const optix::flo
 }
 
 //G masking shadowing function, Beckmann distribution
-__inline__ __device__ float beckmann_G(float cos_theta_i, float cos_theta_o, float cosines, float width)
+__host__ __device__ __inline__ float beckmann_G(float cos_theta_i, float cos_theta_o, float cosines, float width)
 {
   float alpha_b_sqr = width*width;
   return beckmann_G1(cos_theta_i, alpha_b_sqr)*beckmann_G1(cos_theta_o, alpha_b_sqr)*cosines;
 }
 
 //Evaluate the masking function at height h
-__device__ __inline__ float beckmann_G(const optix::float3& wi, const float h, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_G(const optix::float3& wi, const float h, const float a_x, const float a_y){
 
 	if (wi.z > 0.9999f)
 		return 1.0f;
@@ -127,7 +128,7 @@ __device__ __inline__ float beckmann_G(const optix::float3& wi, const float h, c
 }
 
 //Evaluate the masking function averaged over all heights h
-__device__ __inline__ float beckmann_G(const optix::float3& wi, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_G(const optix::float3& wi, const float a_x, const float a_y){
 
 	if (wi.z > 0.9999f)
 		return 1.0f;
@@ -141,7 +142,7 @@ __device__ __inline__ float beckmann_G(const optix::float3& wi, const float a_x,
 }
 
 //Beckmann distribution normal sampling
-__device__ __inline__ void beckmann_sample_hemisphere(const optix::float3& normal,float3& sampled_normal, float z1, float z2, float width){
+__host__ __device__ __inline__ void beckmann_sample_hemisphere(const optix::float3& normal,float3& sampled_normal, float z1, float z2, float width){
 
 	float phi = 2 * M_PIf*z2;
 	float theta;
@@ -158,7 +159,7 @@ __device__ __inline__ void beckmann_sample_hemisphere(const optix::float3& norma
 }
 
 //Importance sampling the beckmann distribution of visible slopes
-__device__ __inline__ float2 beckmann_sample_P22_11(const float theta_i, const float z1, const float z2){
+__host__ __device__ __inline__ float2 beckmann_sample_P22_11(const float theta_i, const float z1, const float z2){
 
 	float2 slope;
 	if (theta_i < 0.0001f){
@@ -178,17 +179,34 @@ __device__ __inline__ float2 beckmann_sample_P22_11(const float theta_i, const f
 		return make_float2(0.0f, 0.0f);
 
 	float c = 1.0f / proj_area;
-	float erf_min = -0.9999f;
-	float erf_max = max(erf_min, (float)erf(slope_i));
+	// below the slope -2 erf has little float resolution left, and Newton
+	// steps run on the log of the CDF, written with erfc, in the slope itself
+	float s_tail = fminf(-2.0f, slope_i);
+	float CDF_tail = c * (0.25f * M_2_SQRTPIf * sin_theta_i * expf(-s_tail*s_tail) + 0.5f * cos_theta_i * erfcf(-s_tail));
+	if (z1 < CDF_tail){
+		float s = -sqrtf(s_tail*s_tail - logf(fmaxf(z1, 1.0e-30f) / CDF_tail));
+		for (int i = 0; i < 4; ++i){
+			float CDF = c * (0.25f * M_2_SQRTPIf * sin_theta_i * expf(-s*s) + 0.5f * cos_theta_i * erfcf(-s));
+			float derivative = 0.5f * M_2_SQRTPIf * c * (cos_theta_i - s * sin_theta_i) * expf(-s*s);
+			s = fminf(s_tail, s - CDF / derivative * logf(CDF / fmaxf(z1, 1.0e-30f)));
+		}
+		slope.x = s;
+		slope.y = erfinv(2.0f * z2 - 1.0f);
+		return slope;
+	}
+	float erf_min = (float)erf(s_tail);
+	float erf_max = fmaxf(erf_min, (float)erf(slope_i));
 	float erf_current = 0.5f * (erf_min + erf_max);
 
 	while (erf_max - erf_min > 0.00001f){
-		if (!(erf_current >= erf_min && erf_current <= erf_max))
+		// Newton steps that leave the bracket, or land on one of its ends,
+		// fall back to bisection
+		if (!(erf_current > erf_min && erf_current < erf_max))
 			erf_current = 0.5f * (erf_min + erf_max);
 		float s = erfinv(erf_current);
 		float CDF = (s >= slope_i) ? 1.0f : c * (0.25* M_2_SQRTPIf * sin_theta_i * expf(-s*s) + cos_theta_i * (0.5f + 0.5f * (float)erf(s)));
 		float diff = CDF - z1;
-		if (abs(diff) < 0.00001f)
+		if (fabsf(diff) < 0.00001f)
 			break;
 		if (diff > 0.0f){
 			if (erf_max == erf_current)
@@ -204,16 +222,21 @@ __device__ __inline__ float2 beckmann_sample_P22_11(const float theta_i, const f
 		erf_current -= diff / derivative;
 	}
 
-	slope.x = erfinv(min(erf_max, max(erf_min, erf_current)));
+	slope.x = erfinv(fminf(erf_max, fmaxf(erf_min, erf_current)));
 	slope.y = erfinv(2.0f * z2 - 1.0f);
 	return slope;
 }
 
 //Beckmann Visible normal importance sampling, wi is in local coordinates and the normal is (0,0,1)
-__device__ __inline__ float3 beckmann_sample_VNDF(const float3& wi, const float a_x, const float a_y, const float z1, const float z2){
+__host__ __device__ __inline__ float3 beckmann_sample_VNDF(const float3& wi, const float a_x, const float a_y, const float z1, const float z2){
 
 	float3 wi_11 = normalize(make_float3(a_x * wi.x, a_y * wi.y, wi.z));
+#ifdef __CUDACC__
+	// the shaders read the inverse CDF of the slopes from a table
+	float2 slope_11 = beckmann_sample_P22_11_table(acosf(wi_11.z), z1, z2);
+#else
 	float2 slope_11 = beckmann_sample_P22_11(acosf(wi_11.z), z1, z2);
+#endif
 	float phi = atan2(wi_11.y, wi_11.x);
 	float2 slope = make_float2(cosf(phi) * slope_11.x - sinf(phi) * slope_11.y, sinf(phi) * slope_11.x + cos(phi) * slope_11.y);
 
@@ -231,7 +254,7 @@ __device__ __inline__ float3 beckmann_sample_VNDF(const float3& wi, const float
 }
 
 //Beckmann normal importance sampling, wi is in local coordinates and the normal is (0,0,1)
-__device__ __inline__ float3 beckmann_sample_NDF(const float a_x, const float a_y, const float z1, const float z2){
+__host__ __device__ __inline__ float3 beckmann_sample_NDF(const float a_x, const float a_y, const float z1, const float z2){
 
 	float2 slope;
 	slope.x = a_x * sqrtf(-logf(z1)) * cos(2*M_PIf *z2);
@@ -246,7 +269,7 @@ __device__ __inline__ float3 beckmann_sample_NDF(const float a_x, const float a_
 }
 
 //Beckmann distribution of normals
-__device__ __inline__ float beckmann_eval_NDF(const float3& wm, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_eval_NDF(const float3& wm, const float a_x, const float a_y){
 
 	if (wm.z <= 0.0f)
 		return 0.0f;
@@ -261,7 +284,7 @@ __device__ __inline__ float beckmann_eval_NDF(const float3& wm, const float a_x,
 }
 
 //Beckmann distribution of visible normals
-__device__ __inline__ float beckmann_eval_VNDF(const float3& wi, const float3& wm, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_eval_VNDF(const float3& wi, const float3& wm, const float a_x, const float a_y){
 
 
 	if (wm.z <= 0.0f)
@@ -276,12 +299,12 @@ __device__ __inline__ float beckmann_eval_VNDF(const float3& wi, const float3& w
 
 	// value
 	float D = beckmann_eval_NDF(wm, a_x, a_y);
-	float result = c * max(0.0f, dot(wi, wm)) * D;
+	float result = c * fmaxf(0.0f, dot(wi, wm)) * D;
 	return result;
 }
 
 //Sample height distribution
-__device__ __inline__ float beckmann_sample_height(const float3& wr, const float hr, const float z, const float a_x, const float a_y){
+__host__ __device__ __inline__ float beckmann_sample_height(const float3& wr, const float hr, const float z, const float a_x, const float a_y){
 
 	if (wr.z > 0.999f){
 		return RT_DEFAULT_MAX;
@@ -294,20 +317,19 @@ __device__ __inline__ float beckmann_sample_height(const float3& wr, const float
 		return hr;
 
 	//probability of intersection
-	float G_1 = beckmann_G(wr,  a_x, a_y) ;
+	float G_1 = beckmann_G(wr, hr, a_x, a_y);
 	//rtPrintf("G=%f, z=%f\n", G_1, z);
 	//Leave the microsurface
 	if (z > 1.0f - G_1)
 		return RT_DEFAULT_MAX;
 	float gaussCDF = GaussianHeightCDF(hr);
-	float lambda = beckmann_smith_lambda(wr, a_x, a_y);
 	float pow = powf((1.0f - z), 1.0f / beckmann_smith_lambda(wr, a_x, a_y));
 	float h = GaussianHeightInvCDF(gaussCDF / pow);
 	return h;
 }
 
 //Sample dielectric phase function p(wi,wo)
-__device__ __inline__ float3 beckmann_sample_dielectric_phase(const optix::float3& w_i, optix::float3& w_m, const float& m_eta, uint& seed,
+__host__ __device__ __inline__ float3 beckmann_sample_dielectric_phase(const optix::float3& w_i, optix::float3& w_m, const float& m_eta, uint& seed,
 	const bool wi_outside, bool& wo_outside, float& F, const float a_x, const float a_y)
 {
 	float z1 = rnd_tea(seed);
@@ -338,7 +360,7 @@ __device__ __inline__ float3 beckmann_sample_dielectric_phase(const optix::float
 }
 
 //Evaluate dielectric phase function p(wi,wo)
-__device__ __inline__ float beckmann_eval_dielectric_phase(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float beckmann_eval_dielectric_phase(const optix::float3& w_i, const optix::float3& w_o,
 	const bool wi_outside, const bool wo_outside, const float& m_eta, const float a_x, const float a_y, float3& w_h)
 {
 	float eta = wi_outside ? m_eta : 1.0f / m_eta;
@@ -372,7 +394,7 @@ __device__ __inline__ float beckmann_eval_dielectric_phase(const optix::float3&
 }
 
 //Sample diffuse phase function p(wi,wo)
-__device__ __inline__ float3 beckmann_sample_diffuse_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
+__host__ __device__ __inline__ float3 beckmann_sample_diffuse_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
 	const float a_x, const float a_y)
 {
 	float z1 = rnd_tea(seed);
@@ -408,7 +430,7 @@ __device__ __inline__ float3 beckmann_sample_diffuse_phase(const optix::float3&
 }
 
 //Evaluate diffuse phase function p(wi,wo)
-__device__ __inline__ float beckmann_eval_diffuse_phase(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float beckmann_eval_diffuse_phase(const optix::float3& w_i, const optix::float3& w_o,
 	float3& w_m, const float a_x, const float a_y, uint& seed)
 {
 	float z1 = rnd_tea(seed);
@@ -420,7 +442,7 @@ __device__ __inline__ float beckmann_eval_diffuse_phase(const optix::float3& w_i
 }
 
 //Sample conductor phase function p(wi,wo)
-__device__ __inline__ float3 beckmann_sample_conductor_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
+__host__ __device__ __inline__ float3 beckmann_sample_conductor_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
 	const float a_x, const float a_y)
 {
 	float z1 = rnd_tea(seed);
@@ -431,18 +453,18 @@ __device__ __inline__ float3 beckmann_sample_conductor_phase(const optix::float3
 }
 
 //Evaluate conductor phase function p(wi,wo)
-__device__ __inline__ float beckmann_eval_conductor_phase(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float beckmann_eval_conductor_phase(const optix::float3& w_i, const optix::float3& w_o,
 	float3& w_m, const float a_x, const float a_y)
 {
 	w_m = normalize(w_i + w_o);
 	if (w_m.z < 0.0f)
 		return 0.0f;
-	float value = 0.25f * beckmann_eval_VNDF(w_i, w_m, a_x, a_y);
+	float value = 0.25f * beckmann_eval_VNDF(w_i, w_m, a_x, a_y) / dot(w_i, w_m);
 	return value;
 }
 
 //Sample the multiscattering BSDF for dielectric
-__inline__ __device__ void beckmann_multiscattering_dielectric_BSDF_sample(const float3& w_i, float3& w_o,
+__host__ __device__ __inline__ void beckmann_multiscattering_dielectric_BSDF_sample(const float3& w_i, float3& w_o,
 	float eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight)
 {
 	float hr = 1.0f + GaussianHeightInvCDF(0.9999f);
@@ -476,7 +498,7 @@ __inline__ __device__ void beckmann_multiscattering_dielectric_BSDF_sample(const
 }
 
 //Evaluate dielectric BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float beckmann_multiscattering_dielectric_BSDF_eval(const optix::float3& w_i, 
+__host__ __device__ __inline__ float beckmann_multiscattering_dielectric_BSDF_eval(const optix::float3& w_i, 
 	const optix::float3& w_o, float eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -527,7 +549,7 @@ __device__ __inline__ float beckmann_multiscattering_dielectric_BSDF_eval(const
 }
 
 //Sample the multiscattering BSDF for dielectric
-__inline__ __device__ void beckmann_multiscattering_dielectric_BSDF_sample_test(const float3& w_i, float3& w_o,
+__host__ __device__ __inline__ void beckmann_multiscattering_dielectric_BSDF_sample_test(const float3& w_i, float3& w_o,
 	float eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight)
 {
 	//float hr = 1.0f + GaussianHeightInvCDF(0.9999f);
@@ -562,7 +584,7 @@ __inline__ __device__ void beckmann_multiscattering_dielectric_BSDF_sample_test(
 }
 
 //Evaluate dielectric BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float beckmann_multiscattering_dielectric_BSDF_eval_test(const optix::float3& w_i,
+__host__ __device__ __inline__ float beckmann_multiscattering_dielectric_BSDF_eval_test(const optix::float3& w_i,
 	const optix::float3& w_o, float eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -610,7 +632,7 @@ __device__ __inline__ float beckmann_multiscattering_dielectric_BSDF_eval_test(c
 	return sum;
 }
 //Sample the diffuse BSDF with a random walk, return the outgoing direction wo
-__device__ __inline__ void beckmann_multiscattering_diffuse_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
+__host__ __device__ __inline__ void beckmann_multiscattering_diffuse_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
 	const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight, const float3& rho_d)
 {
 	weight = make_float3(1.0f);
@@ -640,7 +662,7 @@ __device__ __inline__ void beckmann_multiscattering_diffuse_BSDF_sample(const op
 }
 
 //Evaluate diffuse BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float3 beckmann_multiscattering_diffuse_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float3 beckmann_multiscattering_diffuse_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
 	const float a_x, const float a_y, uint& seed, const float3& rho_d, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -674,7 +696,7 @@ __device__ __inline__ float3 beckmann_multiscattering_diffuse_BSDF_eval(const op
 }
 
 //Evaluate conductor BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float3 beckmann_multiscattering_conductor_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float3 beckmann_multiscattering_conductor_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
 	const MyComplex3 eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -708,7 +730,7 @@ __device__ __inline__ float3 beckmann_multiscattering_conductor_BSDF_eval(const
 }
 
 //Sample the conductor BSDF with a random walk, return the outgoing direction wo
-__device__ __inline__ void beckmann_multiscattering_conductor_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
+__host__ __device__ __inline__ void beckmann_multiscattering_conductor_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
 	const MyComplex3 eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight)
 {
 	float hr = 1.0f + GaussianHeightInvCDF(0.9999f);
@@ -736,7 +758,7 @@ __device__ __inline__ void beckmann_multiscattering_conductor_BSDF_sample(const
 }
 
 //Evaluate Beckmann Distribution
-__device__ __inline__ float beckmann_distribution_eval(const float3& m, const float3& n, const float alpha)
+__host__ __device__ __inline__ float beckmann_distribution_eval(const float3& m, const float3& n, const float alpha)
 {
 	float D = 0.0f;
 	float cos_theta = dot(m, n);
@@ -750,7 +772,7 @@ __device__ __inline__ float beckmann_distribution_eval(const float3& m, const fl
 }
 
 //Evaluate Walter BSDF
-__device__ __inline__ float beckmann_microfacet_BSDF_eval(const float3& w_i, const float3& w_o, const float3& n, const float alpha, const float ior1_over_ior2)
+__host__ __device__ __inline__ float beckmann_microfacet_BSDF_eval(const float3& w_i, const float3& w_o, const float3& n, const float alpha, const float ior1_over_ior2)
 {
 
 	uint isReflection = dot(w_o, n) > 0.0f ? 1 : 0;
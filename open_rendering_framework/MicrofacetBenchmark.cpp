@@ -0,0 +1,329 @@
+#include "MicrofacetBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "structs.h"
+#include "AnisotropicStructures.h"
+#include "chi_square.h"
+
+using namespace optix;
+
+namespace
+{
+	// directions per throughput measurement, fewer for the random walks
+	const unsigned int BENCHMARK_SAMPLES = 1 << 18;
+	const unsigned int BENCHMARK_WALKS = 1 << 15;
+	// normals per chi-square test, bins in theta and phi, and midpoints per
+	// bin and dimension of the expected counts
+	const unsigned int TEST_SAMPLES = 1 << 22;
+	const unsigned int THETA_BINS = 32;
+	const unsigned int PHI_BINS = 32;
+	const unsigned int BIN_MIDPOINTS = 32;
+	// bins with fewer expected normals are pooled, as the chi-square
+	// statistic needs about five expected samples per bin
+	const double POOLED_EXPECTED = 5.0;
+	// probability of rejecting a correct sampler over all the tests
+	const double SIGNIFICANCE = 0.01;
+	// outgoing directions per batch of a white furnace test, until the
+	// standard error of the albedo falls below FURNACE_ERROR or the test
+	// reaches FURNACE_DIRECTIONS. The walks conserve energy, and an albedo
+	// further from one than FURNACE_DEVIATIONS standard errors fails, the
+	// two sided bound of SIGNIFICANCE over the 36 tests.
+	const unsigned int FURNACE_BATCH = 1 << 16;
+	const unsigned int FURNACE_DIRECTIONS = 1 << 20;
+	const double FURNACE_ERROR = 0.002;
+	const double FURNACE_DEVIATIONS = 3.6;
+
+	const char* distribution_name(uint normal_distribution)
+	{
+		return normal_distribution == GGX_DISTRIBUTION ? "GGX" : "Beckmann";
+	}
+
+	float3 spherical_direction(float cos_theta, float phi)
+	{
+		float sin_theta = sqrtf(fmaxf(0.0f, 1.0f - cos_theta*cos_theta));
+		return make_float3(sin_theta*cosf(phi), sin_theta*sinf(phi), cos_theta);
+	}
+
+	// uniform direction on the upper hemisphere, or on the sphere
+	float3 uniform_direction(float z1, float z2, bool sphere)
+	{
+		return spherical_direction(sphere ? 2.0f*z1 - 1.0f : z1, 2.0f*M_PIf*z2);
+	}
+
+	// Bins the normals drawn by sample(z1, z2) in theta and phi, and compares
+	// them with the integral of pdf(m) over the bins
+	template<typename Sample, typename Pdf>
+	bool chi_square_test(std::ostream& out, const char* label, Sample sample, Pdf pdf, std::mt19937& generator, unsigned int tests)
+	{
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		std::vector<unsigned int> observed(THETA_BINS*PHI_BINS, 0);
+		unsigned int invalid = 0;
+		for (unsigned int s = 0; s < TEST_SAMPLES; ++s)
+		{
+			float z1 = uniform(generator);
+			float z2 = uniform(generator);
+			float3 m = sample(z1, z2);
+			if (!isfinite(m.x) || !isfinite(m.y) || !isfinite(m.z))
+			{
+				++invalid;
+				continue;
+			}
+			float theta = acosf(clamp(m.z, -1.0f, 1.0f));
+			float phi = atan2f(m.y, m.x) + M_PIf;
+			unsigned int i = std::min((unsigned int)(theta / M_PI_2f * THETA_BINS), THETA_BINS - 1);
+			unsigned int j = std::min((unsigned int)(phi / (2.0f*M_PIf) * PHI_BINS), PHI_BINS - 1);
+			++observed[i*PHI_BINS + j];
+		}
+
+		std::vector<double> expected(THETA_BINS*PHI_BINS, 0.0);
+		double d_theta = M_PI_2f / (THETA_BINS*BIN_MIDPOINTS);
+		double d_phi = 2.0f*M_PIf / (PHI_BINS*BIN_MIDPOINTS);
+		for (unsigned int i = 0; i < THETA_BINS*BIN_MIDPOINTS; ++i)
+		{
+			float theta = (float)((i + 0.5)*d_theta);
+			for (unsigned int j = 0; j < PHI_BINS*BIN_MIDPOINTS; ++j)
+			{
+				float phi = (float)((j + 0.5)*d_phi);
+				float3 m = spherical_direction(cosf(theta), phi - M_PIf);
+				expected[(i / BIN_MIDPOINTS)*PHI_BINS + j / BIN_MIDPOINTS] += TEST_SAMPLES*pdf(m)*sinf(theta)*d_theta*d_phi;
+			}
+		}
+
+		unsigned int dof;
+		double statistic = chi_square(observed, expected, POOLED_EXPECTED, dof);
+		double p_value = chi_square_p_value(statistic, dof);
+		bool passed = invalid == 0 && p_value > SIGNIFICANCE / tests;
+		out << "  " << label << ": " << statistic << " " << dof << " " << p_value;
+		if (invalid > 0)
+			out << ", " << invalid << " invalid normals";
+		out << (passed ? "" : " FAILED") << std::endl;
+		return passed;
+	}
+
+	// Millions of calls per second of f(w_i, w_o, seed) on the directions
+	template<typename Function>
+	double throughput(Function f, const std::vector<float3>& w_i, const std::vector<float3>& w_o, unsigned int count, float3& checksum)
+	{
+		uint seed = tea<16>(count, 1982u);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int s = 0; s < count; ++s)
+			checksum += f(w_i[s], w_o[s], seed);
+		std::chrono::duration<double, std::micro> time = std::chrono::high_resolution_clock::now() - start;
+		return count / time.count();
+	}
+
+	// Albedo of the random walk eval(w_o, seed) for an incident direction,
+	// integrated over uniform outgoing directions on the upper hemisphere,
+	// or on the sphere. Every direction seeds its own walk, as the pixels of
+	// the shaders do: rnd_tea has short cycles, and one state carried across
+	// the directions correlates their walks. Returns the estimate, its
+	// standard error and the number of directions.
+	template<typename Eval>
+	double furnace(Eval eval, bool sphere, std::mt19937& generator, double& error, unsigned int& directions)
+	{
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		uint base = generator();
+		double inverse_pdf = (sphere ? 4.0 : 2.0)*M_PI;
+		double sum = 0.0, sum_sqr = 0.0, mean = 0.0;
+		directions = 0;
+		do
+		{
+			for (unsigned int s = 0; s < FURNACE_BATCH; ++s, ++directions)
+			{
+				uint seed = tea<16>(directions, base);
+				float3 w_o = uniform_direction(uniform(generator), uniform(generator), sphere);
+				double value = eval(w_o, seed)*inverse_pdf;
+				sum += value;
+				sum_sqr += value*value;
+			}
+			mean = sum / directions;
+			error = sqrt(std::max(0.0, sum_sqr / directions - mean*mean) / directions);
+		} while (error > FURNACE_ERROR && directions < FURNACE_DIRECTIONS);
+		return mean;
+	}
+}
+
+bool MicrofacetBenchmark::report(std::ostream& out)
+{
+	const uint distributions[] = { BECKMANN_DISTRIBUTION, GGX_DISTRIBUTION };
+	const float3 n = make_float3(0.0f, 0.0f, 1.0f);
+	float3 u, v;
+	create_onb(n, u, v);
+	// the defaults of the materials, gold as in MetallicMaterial and the
+	// structures of AnisotropicMaterial
+	const float alpha = 0.5f;
+	const float eta = 1.5f;
+	const MyComplex3 gold = { MyComplex{ 0.170265, 3.01893 }, MyComplex{ 0.511516, 2.44734 }, MyComplex{ 1.47544, 1.87263 } };
+	const MyComplex3 gold_eta = 1.0f / gold;
+	const float3 rho_d = make_float3(0.5f);
+	const float ridge_angle = 5.0f;
+	const float2 sinusoid_wavelengths = make_float2(1.0f);
+	const float sinusoid_amplitude = 1.0f;
+
+	bool valid = true;
+	std::mt19937 generator(2017);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::vector<float3> w_i(BENCHMARK_SAMPLES), w_o(BENCHMARK_SAMPLES);
+	for (unsigned int s = 0; s < BENCHMARK_SAMPLES; ++s)
+	{
+		w_i[s] = uniform_direction(uniform(generator), uniform(generator), false);
+		w_o[s] = uniform_direction(uniform(generator), uniform(generator), false);
+	}
+
+	out << "Microfacet models on the host, one thread, roughness " << alpha << ": Msamples/s, Mevals/s" << std::endl;
+	float3 checksum = make_float3(0.0f);
+	for (uint d : distributions)
+	{
+		double sample_rate = throughput([&](const float3& wi, const float3&, uint& seed) {
+			float3 m;
+			microfacet_sample_visible_normal(wi, n, m, alpha, alpha, rnd(seed), rnd(seed), d);
+			return reflect(-wi, m);
+		}, w_i, w_o, BENCHMARK_SAMPLES, checksum);
+		double eval_rate = throughput([&](const float3& wi, const float3& wo, uint&) {
+			return make_float3(microfacet_eval_BSDF(wi, wo, n, alpha, 1.0f / eta, d));
+		}, w_i, w_o, BENCHMARK_SAMPLES, checksum);
+		out << "  " << distribution_name(d) << " single scattering: " << sample_rate << ", " << eval_rate << std::endl;
+
+		sample_rate = throughput([&](const float3& wi, const float3&, uint& seed) {
+			float3 wo, weight;
+			uint order = 0;
+			microfacet_multiscattering_dielectric_BSDF_sample(wi, wo, n, eta, alpha, alpha, seed, order, weight, d);
+			return wo*weight.x;
+		}, w_i, w_o, BENCHMARK_WALKS, checksum);
+		eval_rate = throughput([&](const float3& wi, const float3& wo, uint& seed) {
+			return make_float3(microfacet_multiscattering_dielectric_BSDF_eval(wi, wo, n, eta, alpha, alpha, seed, 0, d));
+		}, w_i, w_o, BENCHMARK_WALKS, checksum);
+		out << "  " << distribution_name(d) << " multiple scattering dielectric: " << sample_rate << ", " << eval_rate << std::endl;
+
+		sample_rate = throughput([&](const float3& wi, const float3&, uint& seed) {
+			float3 wo, wm, weight;
+			uint order = 0;
+			microfacet_multiscattering_conductor_BSDF_sample(wi, wo, wm, n, gold_eta, alpha, alpha, seed, order, weight, d);
+			return wo*weight;
+		}, w_i, w_o, BENCHMARK_WALKS, checksum);
+		eval_rate = throughput([&](const float3& wi, const float3& wo, uint& seed) {
+			return microfacet_multiscattering_conductor_BSDF_eval(wi, wo, n, gold_eta, alpha, alpha, seed, 0, d);
+		}, w_i, w_o, BENCHMARK_WALKS, checksum);
+		out << "  " << distribution_name(d) << " multiple scattering conductor: " << sample_rate << ", " << eval_rate << std::endl;
+
+		sample_rate = throughput([&](const float3& wi, const float3&, uint& seed) {
+			float3 wo, wm, weight;
+			uint order = 0;
+			microfacet_multiscattering_diffuse_BSDF_sample(wi, wo, wm, n, alpha, alpha, seed, order, weight, rho_d, d);
+			return wo*weight;
+		}, w_i, w_o, BENCHMARK_WALKS, checksum);
+		eval_rate = throughput([&](const float3& wi, const float3& wo, uint& seed) {
+			return microfacet_multiscattering_diffuse_BSDF_eval(wi, wo, n, alpha, alpha, seed, 0, rho_d, d);
+		}, w_i, w_o, BENCHMARK_WALKS, checksum);
+		out << "  " << distribution_name(d) << " multiple scattering diffuse: " << sample_rate << ", " << eval_rate << std::endl;
+	}
+
+	double sample_rate = throughput([&](const float3& wi, const float3&, uint& seed) {
+		float3 m, wo, brdf;
+		ridge_sample_BRDF(ridge_angle, u, v, n, wi, rho_d, 1.0f / eta, alpha, alpha, seed, m, wo, brdf);
+		return wo*brdf;
+	}, w_i, w_o, BENCHMARK_SAMPLES, checksum);
+	double eval_rate = throughput([&](const float3& wi, const float3& wo, uint& seed) {
+		float3 brdf;
+		ridge_eval_BRDF(ridge_angle, u, v, n, wi, wo, rho_d, 1.0f / eta, alpha, alpha, seed, brdf);
+		return brdf;
+	}, w_i, w_o, BENCHMARK_SAMPLES, checksum);
+	out << "  ridge: " << sample_rate << ", " << eval_rate << std::endl;
+
+	sample_rate = throughput([&](const float3& wi, const float3&, uint& seed) {
+		float3 m, wo, brdf;
+		sinusoid_sample_BRDF(sinusoid_wavelengths, sinusoid_amplitude, u, v, n, wi, rho_d, 1.0f / eta, alpha, alpha, seed, m, wo, brdf);
+		return wo*brdf;
+	}, w_i, w_o, BENCHMARK_SAMPLES, checksum);
+	eval_rate = throughput([&](const float3& wi, const float3& wo, uint& seed) {
+		float3 brdf;
+		sinusoid_eval_BRDF(sinusoid_wavelengths, sinusoid_amplitude, u, v, n, wi, wo, rho_d, 1.0f / eta, alpha, alpha, seed, brdf);
+		return brdf;
+	}, w_i, w_o, BENCHMARK_SAMPLES, checksum);
+	out << "  sinusoid: " << sample_rate << ", " << eval_rate << std::endl;
+	out << "  (checksum " << checksum.x + checksum.y + checksum.z << ")" << std::endl;
+
+	// normal sampling for a roughness, and visible normal sampling for the
+	// roughness along x and y and the cosine of the incident direction, which
+	// the random walks also sample from below the surface
+	const float normal_alphas[] = { 0.2f, 0.7f };
+	const float3 visible_tests[] = { make_float3(0.2f, 0.2f, 0.9f), make_float3(0.5f, 0.5f, 0.5f), make_float3(0.8f, 0.8f, 0.1f),
+		make_float3(0.2f, 0.6f, 0.5f), make_float3(0.6f, 0.2f, 0.95f), make_float3(0.5f, 0.5f, -0.3f), make_float3(0.8f, 0.6f, -0.5f) };
+	const unsigned int normal_count = sizeof(normal_alphas) / sizeof(normal_alphas[0]);
+	const unsigned int visible_count = sizeof(visible_tests) / sizeof(visible_tests[0]);
+	const unsigned int tests = 2 * (normal_count + visible_count);
+	out << "  chi-square of the sampled normals, " << TEST_SAMPLES << " normals each, " << THETA_BINS << "x" << PHI_BINS
+		<< " bins of theta and phi: statistic, degrees of freedom, p-value" << std::endl;
+	char label[128];
+	for (uint d : distributions)
+	{
+		for (float a : normal_alphas)
+		{
+			sprintf(label, "%s normals, roughness %g", distribution_name(d), a);
+			valid = chi_square_test(out, label, [&](float z1, float z2) {
+				float3 m;
+				microfacet_sample_normal(n, m, z1, z2, a, d);
+				return m;
+			}, [&](const float3& m) {
+				return microfacet_distribution_eval(m, n, a, d) * fmaxf(0.0f, dot(m, n));
+			}, generator, tests) && valid;
+		}
+		for (const float3& test : visible_tests)
+		{
+			float3 wi = spherical_direction(test.z, 0.7f);
+			sprintf(label, "%s visible normals, roughness %g %g, cosine %g", distribution_name(d), test.x, test.y, test.z);
+			valid = chi_square_test(out, label, [&](float z1, float z2) {
+				float3 m;
+				microfacet_sample_visible_normal(wi, n, m, test.x, test.y, z1, z2, d);
+				return m;
+			}, [&](const float3& m) {
+				return microfacet_eval_visible_normal(wi, m, n, test.x, test.y, d);
+			}, generator, tests) && valid;
+		}
+	}
+
+	// a conductor that reflects all the light, a white diffuse microsurface
+	// and a dielectric, which reflects and transmits all the light
+	const MyComplex3 mirror = { MyComplex{ 1.0, 1.0e4 }, MyComplex{ 1.0, 1.0e4 }, MyComplex{ 1.0, 1.0e4 } };
+	const MyComplex3 mirror_eta = 1.0f / mirror;
+	const float3 white = make_float3(1.0f);
+	const float furnace_alphas[] = { 0.2f, 0.6f, 1.0f };
+	const float furnace_cosines[] = { 0.2f, 0.9f };
+	out << "  white furnace of the random walks, up to " << FURNACE_DIRECTIONS << " uniform outgoing directions each: albedo, standard error, directions" << std::endl;
+	for (uint d : distributions)
+	{
+		for (float a : furnace_alphas)
+		{
+			for (float cos_i : furnace_cosines)
+			{
+				float3 wi = spherical_direction(cos_i, 0.7f);
+				double errors[3];
+				unsigned int directions[3];
+				double albedos[3] = {
+					furnace([&](const float3& wo, uint& seed) {
+						return microfacet_multiscattering_conductor_BSDF_eval(wi, wo, n, mirror_eta, a, a, seed, 0, d).x;
+					}, false, generator, errors[0], directions[0]),
+					furnace([&](const float3& wo, uint& seed) {
+						return microfacet_multiscattering_diffuse_BSDF_eval(wi, wo, n, a, a, seed, 0, white, d).x;
+					}, false, generator, errors[1], directions[1]),
+					furnace([&](const float3& wo, uint& seed) {
+						return microfacet_multiscattering_dielectric_BSDF_eval(wi, wo, n, eta, a, a, seed, 0, d);
+					}, true, generator, errors[2], directions[2]) };
+				const char* names[] = { "conductor", "diffuse", "dielectric" };
+				out << "  " << distribution_name(d) << ", roughness " << a << ", cosine " << cos_i << ":";
+				for (int m = 0; m < 3; ++m)
+				{
+					bool passed = fabs(albedos[m] - 1.0) < FURNACE_DEVIATIONS*errors[m];
+					valid = valid && passed;
+					out << " " << names[m] << " " << albedos[m] << " " << errors[m] << " " << directions[m] << (passed ? "" : " FAILED");
+				}
+				out << std::endl;
+			}
+		}
+	}
+	return valid;
+}
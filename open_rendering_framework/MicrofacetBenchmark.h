@@ -0,0 +1,17 @@
+#pragma once
+#include <ostream>
+
+// Host side benchmark and validation of the microfacet models of
+// Microfacet.h and AnisotropicStructures.h, whose functions compile for the
+// host as for the device. The random walks take their random number state
+// by reference, as in the shaders.
+class MicrofacetBenchmark
+{
+public:
+	// Measures the samples and evaluations per second of every model on one
+	// thread, tests the normal and visible normal sampling of both
+	// distributions against their densities with chi-square tests, and the
+	// energy conservation of the random walks of the multiple scattering
+	// models with white furnace tests. Returns false if any test fails.
+	static bool report(std::ostream& out);
+};
@@ -6,7 +6,7 @@
 using namespace optix;
 
 // projected roughness, wi in local coordinates, the normal is (0,0,1)
-__device__ __inline__ float ggx_alpha_i(const optix::float3& wi, const float alpha_x, const float alpha_y){
+__host__ __device__ __inline__ float ggx_alpha_i(const optix::float3& wi, const float alpha_x, const float alpha_y){
 	float invSinTheta2 = 1.0f / (1.0f - wi.z*wi.z);
 	if (wi.z == 1.0f || wi.z == -1.0f)
 		invSinTheta2 = 0.0f;
@@ -17,7 +17,7 @@ __device__ __inline__ float ggx_alpha_i(const optix::float3& wi, const float alp
 }
 
 // GGX Smith Lambda function
-__device__ __inline__ float ggx_smith_lambda(const float3& wi, const float alpha_x, const float alpha_y){
+__host__ __device__ __inline__ float ggx_smith_lambda(const float3& wi, const float alpha_x, const float alpha_y){
 	if (wi.z > 0.99999f)
 		return 0.0f;
 	if (wi.z < -0.99999f)
@@ -30,7 +30,7 @@ __device__ __inline__ float ggx_smith_lambda(const float3& wi, const float alpha
 }
 
 //GGX Projected Area
-__device__ __inline__ float ggx_projected_area(const float3& wi, const float a_x, const float a_y){
+__host__ __device__ __inline__ float ggx_projected_area(const float3& wi, const float a_x, const float a_y){
 
 	if (wi.z > 0.9999f)
 		return 1.0f;
@@ -45,22 +45,21 @@ __device__ __inline__ float ggx_projected_area(const float3& wi, const float a_x
 }
 
 //GGX slope distribution
-__device__ __inline__ float ggx_slope_pdf(const float slope_x, const float alpha_x, const float slope_y, const float alpha_y){
+__host__ __device__ __inline__ float ggx_slope_pdf(const float slope_x, const float alpha_x, const float slope_y, const float alpha_y){
 
 	float tmp = 1.0f + slope_x * slope_x / (alpha_x * alpha_x) + slope_y * slope_y / (alpha_y * alpha_y);
 	float value = 1.0f / (M_PIf * alpha_x * alpha_y) / (tmp * tmp);
 	return value;
 }
-__inline__ __device__ float ggx_G1(float cos_theta, float alpha_g_sqr)
+__host__ __device__ __inline__ float ggx_G1(float cos_theta, float alpha_g_sqr)
 {
 	float cos_theta_sqr = cos_theta*cos_theta;
 	float tan_theta_sqr = (1.0f - cos_theta_sqr) / cos_theta_sqr;
-	float G = 2.0f / (1.0f + sqrtf(1.0f + alpha_g_sqr*tan_theta_sqr));
 	return 2.0f / (1.0f + sqrtf(1.0f + alpha_g_sqr*tan_theta_sqr));
 }
 
 
-__inline__ __device__ float ggx_G1(const optix::float3& v, const optix::float3& m, const optix::float3& n, float a_x, float a_y)
+__host__ __device__ __inline__ float ggx_G1(const optix::float3& v, const optix::float3& m, const optix::float3& n, float a_x, float a_y)
 {
 	float alpha = ggx_alpha_i(normalize(transformToLocal(v, n)), a_x, a_y);
 	float alpha_g_sqr = alpha * alpha;
@@ -74,7 +73,7 @@ __inline__ __device__ float ggx_G1(const optix::float3& v, const optix::float3&
 }
 
 
-__inline__ __device__ float ggx_G1(const optix::float3& v, const optix::float3& m, const optix::float3& n, float a_g)
+__host__ __device__ __inline__ float ggx_G1(const optix::float3& v, const optix::float3& m, const optix::float3& n, float a_g)
 {
 	float cos_theta_v = dot(v, n);
 	if (cos_theta_v * dot(v, m) <= 0)
@@ -83,14 +82,14 @@ __inline__ __device__ float ggx_G1(const optix::float3& v, const optix::float3&
 }
 
 
-__inline__ __device__ float ggx_G(float cos_theta_i, float cos_theta_o, float cosines, float roughness)
+__host__ __device__ __inline__ float ggx_G(float cos_theta_i, float cos_theta_o, float cosines, float roughness)
 {
 	float alpha_b_sqr = roughness*roughness;
 	return ggx_G1(cos_theta_i, alpha_b_sqr)*ggx_G1(cos_theta_o, alpha_b_sqr)*cosines;
 }
 
 //Evaluate the masking function at height h
-__device__ __inline__ float ggx_G(const float3& wi, const float h, const float a_x, const float a_y){
+__host__ __device__ __inline__ float ggx_G(const float3& wi, const float h, const float a_x, const float a_y){
 
 	if (wi.z > 0.9999f)
 		return 1.0f;
@@ -107,7 +106,7 @@ __device__ __inline__ float ggx_G(const float3& wi, const float h, const float a
 }
 
 //Evaluate the masking function averaged over all heights h
-__device__ __inline__ float ggx_G(const float3& wi, const float a_x, const float a_y){
+__host__ __device__ __inline__ float ggx_G(const float3& wi, const float a_x, const float a_y){
 
 	if (wi.z > 0.9999f)
 		return 1.0f;
@@ -120,7 +119,7 @@ __device__ __inline__ float ggx_G(const float3& wi, const float a_x, const float
 	return G;
 }
 
-__device__ __inline__ void ggx_sample_hemisphere(const optix::float3& normal, float3& sampled_normal, float z1, float z2, float a_g)
+__host__ __device__ __inline__ void ggx_sample_hemisphere(const optix::float3& normal, float3& sampled_normal, float z1, float z2, float a_g)
 {
 	float phi = 2 * M_PIf *z2;
 	float theta;
@@ -139,7 +138,7 @@ __device__ __inline__ void ggx_sample_hemisphere(const optix::float3& normal, fl
 }
 
 //Importance sampling the GXX distribution of visible slopes
-__device__ __inline__ float2 ggx_sample_P22_11(const float theta_i, float z1, float z2){
+__host__ __device__ __inline__ float2 ggx_sample_P22_11(const float theta_i, float z1, float z2){
 
 	float2 slope;
 
@@ -151,11 +150,12 @@ __device__ __inline__ float2 ggx_sample_P22_11(const float theta_i, float z1, fl
 		slope.y = r * sinf(phi);
 		return slope;
 	}
+	// the random walks also sample directions below the surface, the cosine
+	// keeps its sign away from zero
 	float sin_theta_i = sinf(theta_i);
-	float cos_theta_i = fmaxf(cosf(theta_i), 1e-7);
+	float cos_theta_i = copysignf(fmaxf(fabsf(cosf(theta_i)), 1e-7f), cosf(theta_i));
 	float tan_theta_i = sin_theta_i / cos_theta_i;
 
-	float slope_i = cos_theta_i / sin_theta_i;
 	float proj_area = 0.5f * (cos_theta_i + 1.0f);
 
 	if (proj_area < 0.0001f || proj_area != proj_area)
@@ -165,7 +165,7 @@ __device__ __inline__ float2 ggx_sample_P22_11(const float theta_i, float z1, fl
 	float A = 2.0f*z1 / cos_theta_i / c - 1.0f;
 	float B = tan_theta_i;
 	float tmp = 1.0f / (A*A - 1.0f);
-	float D = sqrtf(max(0.0f, B*B*tmp*tmp - (A*A - B*B)*tmp));
+	float D = sqrtf(fmaxf(0.0f, B*B*tmp*tmp - (A*A - B*B)*tmp));
 	float slope_x_1 = B*tmp - D;
 	float slope_x_2 = B*tmp + D;
 	slope.x = (A < 0.0f || slope_x_2 > 1.0f / tan_theta_i) ? slope_x_1 : slope_x_2;
@@ -182,12 +182,20 @@ __device__ __inline__ float2 ggx_sample_P22_11(const float theta_i, float z1, fl
 		zz2 = 2.0f * (0.5f - z2);
 	}
 	float z = (zz2 * (zz2 * (zz2 * 0.27385f - 0.73369f) + 0.46341f)) / (zz2 * (zz2 * (zz2 * 0.093073f + 0.309420f) - 1.0000f) + 0.597999f);
+	// the rational approximation is off by up to 1e-3 in the CDF and saturates
+	// in the tail. One Newton step on the angle beta = atan(z), whose CDF is
+	// (2 beta + sin(2 beta)) / pi, from the approximation or in the tail from
+	// pi/2 - beta = (3 pi (1 - zz2) / 4)^(1/3), brings it below 1e-4
+	float beta = (zz2 < 0.95f) ? atanf(z) : M_PI_2f - cbrtf(0.75f * M_PIf * (1.0f - zz2));
+	float cos_beta = cosf(beta);
+	beta -= (beta + sinf(beta) * cos_beta - M_PI_2f * zz2) / fmaxf(2.0f * cos_beta * cos_beta, 1.0e-6f);
+	z = tanf(clamp(beta, 0.0f, M_PI_2f - 1.0e-4f));
 	slope.y = S * z * sqrtf(1.0f + slope.x*slope.x);
 	return slope;
 }
 
 //GXX Visible normal importance sampling, wi is in local coordinates and the normal is (0,0,1)
-__device__ __inline__ float3 ggx_sample_VNDF(const float3& wi, const float a_x, const float a_y, const float z1, const float z2){
+__host__ __device__ __inline__ float3 ggx_sample_VNDF(const float3& wi, const float a_x, const float a_y, const float z1, const float z2){
 
 	float3 wi_11 = normalize(make_float3(a_x * wi.x, a_y * wi.y, wi.z));
 	float2 slope_11 = ggx_sample_P22_11(acosf(wi_11.z), z1, z2);
@@ -207,7 +215,7 @@ __device__ __inline__ float3 ggx_sample_VNDF(const float3& wi, const float a_x,
 }
 
 //GGX normal importance sampling, wi is in local coordinates and the normal is (0,0,1)
-__device__ __inline__ float3 ggx_sample_NDF(const float a_x, const float a_y, const float z1, const float z2){
+__host__ __device__ __inline__ float3 ggx_sample_NDF(const float a_x, const float a_y, const float z1, const float z2){
 
 	float2 slope;
 	slope.x = a_x * sqrtf(z1) * cos(2 * M_PIf *z2) / sqrtf(1-z1);
@@ -216,7 +224,7 @@ __device__ __inline__ float3 ggx_sample_NDF(const float a_x, const float a_y, co
 	return wm;
 }
 //GGX distribution of normals
-__device__ __inline__ float ggx_eval_NDF(const float3& wm, const float a_x, const float a_y){
+__host__ __device__ __inline__ float ggx_eval_NDF(const float3& wm, const float a_x, const float a_y){
 
 	if (wm.z <= 0.0f)
 		return 0.0f;
@@ -231,7 +239,7 @@ __device__ __inline__ float ggx_eval_NDF(const float3& wm, const float a_x, cons
 }
 
 //Beckmann distribution of visible normals
-__device__ __inline__ float ggx_eval_VNDF(const float3& wi, const float3& wm, const float a_x, const float a_y){
+__host__ __device__ __inline__ float ggx_eval_VNDF(const float3& wi, const float3& wm, const float a_x, const float a_y){
 
 
 	if (wm.z <= 0.0f)
@@ -246,12 +254,12 @@ __device__ __inline__ float ggx_eval_VNDF(const float3& wi, const float3& wm, co
 
 	// value
 	float D = ggx_eval_NDF(wm, a_x, a_y);
-	float result = c * max(0.0f, dot(wi, wm)) * D;
+	float result = c * fmaxf(0.0f, dot(wi, wm)) * D;
 	return result;
 }
 
 //Sample height distribution
-__device__ __inline__ float ggx_sample_height(const float3& wr, const float hr, const float z, const float a_x, const float a_y){
+__host__ __device__ __inline__ float ggx_sample_height(const float3& wr, const float hr, const float z, const float a_x, const float a_y){
 
 	if (wr.z > 0.9999f){
 		return RT_DEFAULT_MAX;
@@ -276,7 +284,7 @@ __device__ __inline__ float ggx_sample_height(const float3& wr, const float hr,
 }
 
 //Sample dielectric phase function p(wi,wo)
-__device__ __inline__ float3 ggx_sample_dielectric_phase(const optix::float3& w_i, optix::float3& w_m, const float& m_eta, uint& seed,
+__host__ __device__ __inline__ float3 ggx_sample_dielectric_phase(const optix::float3& w_i, optix::float3& w_m, const float& m_eta, uint& seed,
 	const bool wi_outside, bool& wo_outside, float& F, const float a_x, const float a_y)
 {
 
@@ -304,7 +312,7 @@ __device__ __inline__ float3 ggx_sample_dielectric_phase(const optix::float3& w_
 }
 
 //Evaluate dielectric phase function p(wi,wo)
-__device__ __inline__ float ggx_eval_dielectric_phase(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float ggx_eval_dielectric_phase(const optix::float3& w_i, const optix::float3& w_o,
 	const bool wi_outside, const bool wo_outside, float& m_eta, const float a_x, const float a_y)
 {
 	float eta = wi_outside ? m_eta : 1.0f / m_eta;
@@ -339,7 +347,7 @@ __device__ __inline__ float ggx_eval_dielectric_phase(const optix::float3& w_i,
 }
 
 //Sample diffuse phase function p(wi,wo)
-__device__ __inline__ float3 ggx_sample_diffuse_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
+__host__ __device__ __inline__ float3 ggx_sample_diffuse_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
 	const float a_x, const float a_y)
 {
 	float z1 = rnd_tea(seed);
@@ -375,7 +383,7 @@ __device__ __inline__ float3 ggx_sample_diffuse_phase(const optix::float3& w_i,
 }
 
 //Evaluate diffuse phase function p(wi,wo)
-__device__ __inline__ float ggx_eval_diffuse_phase(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float ggx_eval_diffuse_phase(const optix::float3& w_i, const optix::float3& w_o,
 	float3& w_m, const float a_x, const float a_y, uint& seed)
 {
 	float z1 = rnd_tea(seed);
@@ -387,7 +395,7 @@ __device__ __inline__ float ggx_eval_diffuse_phase(const optix::float3& w_i, con
 }
 
 //Sample conductor phase function p(wi,wo)
-__device__ __inline__ float3 ggx_sample_conductor_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
+__host__ __device__ __inline__ float3 ggx_sample_conductor_phase(const optix::float3& w_i, optix::float3& w_m, uint& seed,
 	const float a_x, const float a_y)
 {
 	float z1 = rnd_tea(seed);
@@ -398,18 +406,18 @@ __device__ __inline__ float3 ggx_sample_conductor_phase(const optix::float3& w_i
 }
 
 //Evaluate conductor phase function p(wi,wo)
-__device__ __inline__ float ggx_eval_conductor_phase(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float ggx_eval_conductor_phase(const optix::float3& w_i, const optix::float3& w_o,
 	float3& w_m, const float a_x, const float a_y)
 {
 	w_m = normalize(w_i + w_o);
 	if (w_m.z < 0.0f)
 		return 0.0f;
-	float value = 0.25f * ggx_eval_VNDF(w_i, w_m, a_x, a_y);
+	float value = 0.25f * ggx_eval_VNDF(w_i, w_m, a_x, a_y) / dot(w_i, w_m);
 	return value;
 }
 
 //Sample the multiscattering BSDF for dielectric
-__inline__ __device__ void ggx_multiscattering_dielectric_BSDF_sample(const float3& local_wi, float3& w_o,
+__host__ __device__ __inline__ void ggx_multiscattering_dielectric_BSDF_sample(const float3& local_wi, float3& w_o,
 	float eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight)
 {
 	float hr = 1.0f + GaussianHeightInvCDF(0.9999f);
@@ -442,7 +450,7 @@ __inline__ __device__ void ggx_multiscattering_dielectric_BSDF_sample(const floa
 }
 
 //Evaluate dielectric BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float ggx_multiscattering_dielectric_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float ggx_multiscattering_dielectric_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
 	float eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -481,7 +489,7 @@ __device__ __inline__ float ggx_multiscattering_dielectric_BSDF_eval(const optix
 }
 
 //Sample the multiscattering BSDF for dielectric
-__inline__ __device__ void ggx_multiscattering_dielectric_BSDF_sample_test(const float3& w_i, float3& w_o,
+__host__ __device__ __inline__ void ggx_multiscattering_dielectric_BSDF_sample_test(const float3& w_i, float3& w_o,
 	float eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight)
 {
 	//float hr = 1.0f + GaussianHeightInvCDF(0.9999f);
@@ -516,7 +524,7 @@ __inline__ __device__ void ggx_multiscattering_dielectric_BSDF_sample_test(const
 	}
 }
 //Sample the diffuse BSDF with a random walk, return the outgoing direction wo
-__device__ __inline__ void ggx_multiscattering_diffuse_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
+__host__ __device__ __inline__ void ggx_multiscattering_diffuse_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
 	const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight, const float3& rho_d)
 {
 	weight = make_float3(1.0f);
@@ -544,7 +552,7 @@ __device__ __inline__ void ggx_multiscattering_diffuse_BSDF_sample(const optix::
 }
 
 //Evaluate diffuse BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float3 ggx_multiscattering_diffuse_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float3 ggx_multiscattering_diffuse_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
 	const float a_x, const float a_y, uint& seed, const float3& rho_d, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -577,7 +585,7 @@ __device__ __inline__ float3 ggx_multiscattering_diffuse_BSDF_eval(const optix::
 }
 
 //Evaluate conductor BSDF with a random walk, return sum(phase*G)
-__device__ __inline__ float3 ggx_multiscattering_conductor_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
+__host__ __device__ __inline__ float3 ggx_multiscattering_conductor_BSDF_eval(const optix::float3& w_i, const optix::float3& w_o,
 	const MyComplex3 eta, const float a_x, const float a_y, uint& seed, uint scatteringOrder)
 {
 	float3 w_r = -w_i;
@@ -611,7 +619,7 @@ __device__ __inline__ float3 ggx_multiscattering_conductor_BSDF_eval(const optix
 }
 
 //Sample the conductor BSDF with a random walk, return the outgoing direction wo
-__device__ __inline__ void ggx_multiscattering_conductor_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
+__host__ __device__ __inline__ void ggx_multiscattering_conductor_BSDF_sample(const optix::float3& w_i, optix::float3& w_o, optix::float3& w_m,
 	const MyComplex3 eta, const float a_x, const float a_y, uint& seed, uint& scatteringOrder, float3& weight)
 {
 	float hr = 1.0f + GaussianHeightInvCDF(0.9999f);
@@ -640,7 +648,7 @@ __device__ __inline__ void ggx_multiscattering_conductor_BSDF_sample(const optix
 }
 
 //Evaluate Beckmann Distribution
-__device__ __inline__ float ggx_distribution_eval(const float3& m, const float3& n, const float alpha)
+__host__ __device__ __inline__ float ggx_distribution_eval(const float3& m, const float3& n, const float alpha)
 {
 	float D = 0.0f;
 	float cos_theta = dot(m, n);
@@ -655,7 +663,7 @@ __device__ __inline__ float ggx_distribution_eval(const float3& m, const float3&
 }
 
 //Evaluate Walter BSDF
-__device__ __inline__ float ggx_microfacet_BSDF_eval(const float3& w_i, const float3& w_o, const float3& n, const float alpha, const float ior1_over_ior2)
+__host__ __device__ __inline__ float ggx_microfacet_BSDF_eval(const float3& w_i, const float3& w_o, const float3& n, const float alpha, const float ior1_over_ior2)
 {
 	uint isReflection = dot(w_o, n) > 0.0f ? 1 : 0;
 	float3 m;
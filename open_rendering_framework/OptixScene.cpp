@@ -3,6 +3,7 @@
 #include <fstream>
 #include <climits>
 #include "sampleConfig.h"
+#include "reservoir.h"
 
 OptixScene::OptixScene(GLuint w, GLuint h)
 {
@@ -30,6 +31,7 @@ void OptixScene::resizeScene(GLuint w, GLuint h)
 	
 	optix::Buffer buffer = getOutputBuffer();
 	buffer->setSize(WIDTH, HEIGHT);
+	optix_context["light_reservoir_buffer"]->getBuffer()->setSize(WIDTH, HEIGHT);
 	//optix::Buffer position_buffer = getPositionBuffer();
 	//position_buffer->setSize(WIDTH, HEIGHT);
 	//optix::Buffer normal_buffer = getNormalBuffer();
@@ -141,20 +143,16 @@ void OptixScene::renderScene()
 	// Launch the ray tracer
 	if (max_frame < 0 || frame < max_frame )
 	{
+		// The reservoirs of the previous frames are stale after a restart
+		if (frame == 0)
+			clearReservoirs(optix_context["light_reservoir_buffer"]->getBuffer());
 		optix_context["frame"]->setUint(frame++);
 
-		// Generate surface position samples
-		if (sceneLoader->getTranslucentObjects().size() == 1)
-			optix_context->launch(sample_camera_pass, sceneLoader->getSamplesFrame());
-		else if (sceneLoader->getTranslucentObjects().size() > 1)
-		{
-			
-			for (unsigned int i = 0; i < sceneLoader->getTranslucentObjects().size(); ++i)
-			{
-				sceneLoader->loadTranslucentGeometry(i);
-				optix_context->launch(sample_camera_pass, sceneLoader->getSamplesFrame());
-			}
-		}
+		// Generate surface position samples, for all the translucent objects at once
+		sceneLoader->updateTranslucentSamples();
+		if (sceneLoader->getTranslucentSamples() > 0)
+			optix_context->launch(sample_camera_pass, sceneLoader->getTranslucentSamples());
+		sceneLoader->updateSSSOctree();
 
 		optix_context->launch(integrator_pass, WIDTH, HEIGHT);
 	}
@@ -249,6 +247,20 @@ void OptixScene::loadScene(uint& width, uint& height)
 
 }
 
+void OptixScene::clearReservoirs(optix::Buffer reservoir_buffer)
+{
+	RTsize width, height;
+	reservoir_buffer->getSize(width, height);
+	PixelReservoir* reservoirs = reinterpret_cast<PixelReservoir*>(reservoir_buffer->map());
+	for (RTsize i = 0; i < width*height; ++i)
+	{
+		reservoir_reset(reservoirs[i].reservoir);
+		reservoirs[i].pos = optix::make_float3(0.0f);
+		reservoirs[i].normal = optix::make_float3(0.0f);
+	}
+	reservoir_buffer->unmap();
+}
+
 void OptixScene::loadBuffer()
 {
 	optix::Buffer buffer;
@@ -262,6 +274,12 @@ void OptixScene::loadBuffer()
 	}
 	optix_context["output_buffer"]->set(buffer);
 
+	// Reservoirs of resampled direct lighting kept across frames, one per pixel
+	optix::Buffer reservoir_buffer = optix_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_USER, WIDTH, HEIGHT);
+	reservoir_buffer->setElementSize(sizeof(PixelReservoir));
+	clearReservoirs(reservoir_buffer);
+	optix_context["light_reservoir_buffer"]->set(reservoir_buffer);
+
 	optix::Buffer positions_buffer;
 	optix::Buffer normals_buffer;
 
@@ -42,6 +42,7 @@ protected:
 	optix::Buffer getOutputBuffer();
 	optix::Buffer getPositionBuffer();
 	optix::Buffer getNormalBuffer();
+	void clearReservoirs(optix::Buffer reservoir_buffer);
 
 private:
 	optix::Context optix_context;
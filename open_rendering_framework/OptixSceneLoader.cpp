@@ -4,22 +4,79 @@
 #include <QJsonDocument>
 #include "OptixScene.h"
 #include "sampleConfig.h"
+#include "alias_table.h"
+#include "triangle_light_table.h"
+#include "area_cdf.h"
+#include "compact_sample.h"
+#include "sss_allocation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// True if the records describe the same mesh, placement and material, so
+	// that the samples of the first are valid for the second. The records are
+	// compared field by field: the padding between their members is undefined.
+	bool sameTranslucentObject(const TranslucentObjectRecord& a, const TranslucentObjectRecord& b)
+	{
+		// the scattering properties are floats only, without padding
+		return a.vertex_buffer_id == b.vertex_buffer_id && a.normal_buffer_id == b.normal_buffer_id
+			&& a.vindex_buffer_id == b.vindex_buffer_id && a.nindex_buffer_id == b.nindex_buffer_id
+			&& memcmp(a.transform_matrix.getData(), b.transform_matrix.getData(), 16 * sizeof(float)) == 0
+			&& memcmp(a.normal_matrix.getData(), b.normal_matrix.getData(), 16 * sizeof(float)) == 0
+			&& memcmp(&a.properties, &b.properties, sizeof(ScatteringMaterialProperties)) == 0
+			&& a.material_type == b.material_type && a.roughness.x == b.roughness.x && a.roughness.y == b.roughness.y
+			&& a.microfacet_model == b.microfacet_model && a.normal_distribution == b.normal_distribution
+			&& a.sss_estimator == b.sss_estimator && a.area_cdf_offset == b.area_cdf_offset && a.area == b.area;
+	}
+}
 
 OptixSceneLoader::OptixSceneLoader(optix::Context c)
 {
 	context = c;
+	light_bvh = 0;
 	SAMPLES_FRAME = 500;
-	ss_samples = context->createBuffer(RT_BUFFER_OUTPUT);
-	ss_samples->setFormat(RT_FORMAT_USER);
-	ss_samples->setElementSize(sizeof(PositionSample));
-	ss_samples->setSize(0);
-	context["samples_output_buffer"]->set(ss_samples);
-	context["samples"]->setUint(SAMPLES_FRAME);
+	// the samples, 32 bytes each, written by the sample pass and read by the
+	// subsurface shaders and the octrees
+	ss_compact_samples = context->createBuffer(RT_BUFFER_OUTPUT);
+	ss_compact_samples->setFormat(RT_FORMAT_USER);
+	ss_compact_samples->setElementSize(sizeof(CompactPositionSample));
+	ss_compact_samples->setSize(0);
+	context["compact_samples_buffer"]->set(ss_compact_samples);
+	translucent_bbox_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, 0);
+	context["translucent_bbox_buffer"]->set(translucent_bbox_buffer);
+	translucent_object_buffer = context->createBuffer(RT_BUFFER_INPUT);
+	translucent_object_buffer->setFormat(RT_FORMAT_USER);
+	translucent_object_buffer->setElementSize(sizeof(TranslucentObjectRecord));
+	translucent_object_buffer->setSize(0);
+	context["translucent_object_buffer"]->set(translucent_object_buffer);
+	translucentSamples = 0;
+	translucentLifetime = 1;
+	translucentRefreshFrame = 0;
+	translucentRecordsDirty = true;
+	context["sss_sample_lifetime"]->setUint(1u);
+	translucent_sample_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT2, 0);
+	context["translucent_sample_buffer"]->set(translucent_sample_buffer);
+	context["sss_sample_budget"]->setUint(0u);
+	translucent_area_cdf = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, 0);
+	context["translucent_area_cdf"]->set(translucent_area_cdf);
+	context["sss_octree_max_solid_angle"]->setFloat(0.0f);
+	sss_octree = new SSSOctree(context);
+	context["sss_poisson_samples"]->setUint(0u);
+	sss_poisson_sets = new SSSPoissonSets(context);
+	energy_compensation = new EnergyCompensation(context);
+	beckmann_vndf_table = new BeckmannVNDFTable(context);
 }
 
 OptixSceneLoader::~OptixSceneLoader()
 {
 	delete integrator, background, camera;
+	delete light_bvh;
+	delete sss_octree;
+	delete sss_poisson_sets;
+	delete energy_compensation;
+	delete beckmann_vndf_table;
 	foreach(const Light* light, lights) {
 		delete light;
 	}
@@ -292,6 +349,16 @@ void OptixSceneLoader::initLightBuffers()
 	triangle_light_buffer->setElementSize(sizeof(TriangleLight));
 	triangle_light_buffer->setSize(0);
 	triangle_light_count = 0;
+	light_alias_buffer = context->createBuffer(RT_BUFFER_INPUT);
+	light_alias_buffer->setFormat(RT_FORMAT_USER);
+	light_alias_buffer->setElementSize(sizeof(AliasEntry));
+	light_alias_buffer->setSize(0);
+	triangle_light_alias_buffer = context->createBuffer(RT_BUFFER_INPUT);
+	triangle_light_alias_buffer->setFormat(RT_FORMAT_USER);
+	triangle_light_alias_buffer->setElementSize(sizeof(AliasEntry));
+	triangle_light_alias_buffer->setSize(0);
+	delete light_bvh;
+	light_bvh = new LightBVH(context);
 }
 
 void OptixSceneLoader::loadTriangleLightBuffer()
@@ -300,6 +367,8 @@ void OptixSceneLoader::loadTriangleLightBuffer()
 	triangle_light_buffer->setElementSize(sizeof(TriangleLight));
 	triangle_light_buffer->setSize(triangle_light_count);
 	TriangleLight* triangle_light_data = static_cast<TriangleLight*>(triangle_light_buffer->map());
+	triangle_light_alias_buffer->setSize(triangle_light_count);
+	AliasEntry* alias_data = static_cast<AliasEntry*>(triangle_light_alias_buffer->map());
 	int idx_offset = 0;
 	for (int idx = 0; idx < lights.size(); idx++)
 	{
@@ -313,11 +382,17 @@ void OptixSceneLoader::loadTriangleLightBuffer()
 			unsigned int number_of_elements = static_cast<unsigned int>(triangle_light_struct->triangle_count) * sizeof(TriangleLight);
 			memcpy(triangle_light_data + idx_offset, tal->getLightBuffer()->map(), number_of_elements );
 			tal->getLightBuffer()->unmap();
+
+			// the table of each light lives in the same range as its triangles
+			unsigned int triangle_count = static_cast<unsigned int>(triangle_light_struct->triangle_count);
+			build_triangle_light_alias_table(triangle_light_data + idx_offset, triangle_count, triangle_light_struct->emitted_radiance, alias_data + idx_offset);
 			idx_offset += triangle_light_struct->triangle_count;
 		}
 	}
 	context["triangle_light_buffer"]->set(triangle_light_buffer);
 	triangle_light_buffer->unmap();
+	context["triangle_light_alias_buffer"]->set(triangle_light_alias_buffer);
+	triangle_light_alias_buffer->unmap();
 }
 
 
@@ -336,6 +411,7 @@ optix::float3 OptixSceneLoader::qVector3DtoFloat3(QVector3D vec) {
 
 void OptixSceneLoader::updateLights(bool triangleAreaLightChanged) {
 
+	invalidateTranslucentSamples();
 
 	if (triangleAreaLightChanged) {
 		loadTriangleLightBuffer();
@@ -344,6 +420,99 @@ void OptixSceneLoader::updateLights(bool triangleAreaLightChanged) {
 	memcpy(light_buffer->map(), lightStructData.data(), lightStructData.size() * sizeof(LightStruct));
 	context["light_buffer"]->set(light_buffer);
 	light_buffer->unmap();
+	loadLightAliasBuffer();
+	loadLightIndices();
+
+	const TriangleLight* triangle_light_data = triangle_light_count > 0 ? static_cast<const TriangleLight*>(triangle_light_buffer->map()) : 0;
+	light_bvh->update(lightStructData, triangle_light_data);
+	if (triangle_light_count > 0)
+		triangle_light_buffer->unmap();
+}
+
+// Rough estimate of the power of a light, used to importance sample
+// lights in the shaders: radiance times area for area lights and
+// intensity for point and directional lights.
+float OptixSceneLoader::estimateLightPower(unsigned int lightIdx)
+{
+	LightStruct* light_struct = &lightStructData[lightIdx];
+	optix::float3 emission;
+	float area = 1.0f;
+	if (light_struct->light_type == POINT_LIGHT)
+	{
+		emission = reinterpret_cast<PointLightStruct*>(light_struct)->emitted_radiance;
+	}
+	else if (light_struct->light_type == DIRECTIONAL_LIGHT)
+	{
+		emission = reinterpret_cast<DirectionalLightStruct*>(light_struct)->emitted_radiance;
+	}
+	else if (light_struct->light_type == TRIANGLES_AREA_LIGHT)
+	{
+		emission = reinterpret_cast<TrianglesAreaLightStruct*>(light_struct)->emitted_radiance;
+		area = reinterpret_cast<TriangleAreaLight*>(lights[lightIdx])->getArea();
+	}
+	else if (light_struct->light_type == DISK_LIGHT)
+	{
+		DiskLightStruct* disk_light = reinterpret_cast<DiskLightStruct*>(light_struct);
+		emission = disk_light->emitted_radiance;
+		area = M_PIf * disk_light->radius * disk_light->radius;
+	}
+	else if (light_struct->light_type == SPHERICAL_LIGHT)
+	{
+		SphericalLightStruct* sphere_light = reinterpret_cast<SphericalLightStruct*>(light_struct);
+		emission = sphere_light->emitted_radiance;
+		area = 4.0f * M_PIf * sphere_light->radius * sphere_light->radius;
+	}
+	else
+	{
+		return 0.0f;
+	}
+	return (emission.x + emission.y + emission.z) / 3.0f * area;
+}
+
+// Tells the geometry of every area light where its emitters are stored, so
+// that rays hitting it can find the pdf of light sampling for MIS.
+void OptixSceneLoader::loadLightIndices()
+{
+	for (int idx = 0; idx < lights.size(); idx++)
+	{
+		LightStruct* light_struct = &lightStructData[idx];
+		if (light_struct->light_type == TRIANGLES_AREA_LIGHT)
+		{
+			TrianglesAreaLightStruct* triangle_light_struct = reinterpret_cast<TrianglesAreaLightStruct*>(light_struct);
+			TriangleAreaLight* tal = reinterpret_cast<TriangleAreaLight*>(lights[idx]);
+			optix::GeometryGroup& geometry_group = tal->getGeometryGroup();
+			int triangle_offset = static_cast<int>(triangle_light_struct->buffer_start_idx);
+			for (unsigned int j = 0; j < geometry_group->getChildCount(); ++j)
+			{
+				optix::GeometryInstance gi = geometry_group->getChild(j);
+				gi["light_index"]->setUint(idx);
+				gi["light_triangle_offset"]->setInt(triangle_offset);
+				triangle_offset += gi->getGeometry()->getPrimitiveCount();
+			}
+		}
+		else if (light_struct->light_type == DISK_LIGHT || light_struct->light_type == SPHERICAL_LIGHT)
+		{
+			optix::GeometryGroup& geometry_group = light_struct->light_type == DISK_LIGHT
+				? reinterpret_cast<DiskAreaLight*>(lights[idx])->getGeometryGroup()
+				: reinterpret_cast<SphericalLight*>(lights[idx])->getGeometryGroup();
+			optix::GeometryInstance gi = geometry_group->getChild(0);
+			gi["light_index"]->setUint(idx);
+			gi["light_triangle_offset"]->setInt(-1);
+		}
+	}
+}
+
+void OptixSceneLoader::loadLightAliasBuffer()
+{
+	QVector<float> power(lights.size());
+	for (int idx = 0; idx < lights.size(); idx++)
+		power[idx] = estimateLightPower(idx);
+
+	light_alias_buffer->setSize(lights.size());
+	AliasEntry* alias_data = static_cast<AliasEntry*>(light_alias_buffer->map());
+	build_alias_table(power.data(), power.size(), alias_data);
+	light_alias_buffer->unmap();
+	context["light_alias_buffer"]->set(light_alias_buffer);
 }
 
 void OptixSceneLoader::addLight(Light* light)
@@ -376,6 +545,7 @@ void OptixSceneLoader::addLight(Light* light)
 		triangleAreaLightStruct->light_type = triangleAreaLight->getType();
 		triangleAreaLightStruct->emitted_radiance = qVector3DtoFloat3(triangleAreaLight->getRadiance());
 		triangleAreaLightStruct->triangle_count = triangleAreaLight->getSize();
+		triangleAreaLightStruct->sampling_mode = triangleAreaLight->getSamplingMode();
 		triangle_light_count += triangleAreaLightStruct->triangle_count;
 	}
 	else if (light->getType() == DISK_LIGHT)
@@ -477,105 +647,267 @@ void OptixSceneLoader::removeGeometry(unsigned int geometryIdx)
 void OptixSceneLoader::updateAcceleration()
 {
 	obj_group->getAcceleration()->markDirty();
+	invalidateTranslucentSamples();
 }
 
 void OptixSceneLoader::computeTranslucentGeometries()
 {	
+	QVector<TranslucentObjectRecord> previous_records = translucentRecords;
 	translucentObjects.clear();
+	translucentRecords.clear();
+	translucentBBoxes.clear();
+	QVector<float> area_cdf;
 	for (int geometryIndex = 0; geometryIndex < geometries.size(); ++geometryIndex) {
 		Geometry *geometry = geometries.at(geometryIndex);
 		if (geometry->getMaterial()->getType() == TRANSLUCENT_SHADER || geometry->getMaterial()->getType() == ROUGH_TRANSLUCENT_SHADER)
 		{			
 			optix::GeometryGroup gg = geometry->getGeometryGroup();
+			optix::Material mtl = geometry->getMaterial()->getOptixMaterial();
 			optix::Matrix4x4 transform_matrix;
 			optix::Matrix4x4 inverse_transform_matrix;
-			ScatteringMaterialProperties properties;
 			for (unsigned int j = 0; j < gg->getChildCount(); ++j)
 			{		
 				optix::GeometryInstance& gi = gg->getChild(j);
+				optix::Geometry& g = gi->getGeometry();
 				geometry->getTransform()->getMatrix(0, transform_matrix.getData(), inverse_transform_matrix.getData());
-				gi["transform_matrix"]->setMatrix4x4fv(0,transform_matrix.getData());
-				gi["inverse_transform_matrix"]->setMatrix4x4fv(0, inverse_transform_matrix.getData());
-				geometry->getMaterial()->getOptixMaterial()["scattering_properties"]->getUserData(sizeof(ScatteringMaterialProperties), &properties);
-				gi["scattering_properties"]->setUserData(sizeof(ScatteringMaterialProperties), &properties);
-				gi["material_type"]->setUint(geometry->getMaterial()->getType());
-				if(geometry->getMaterial()->getType() == ROUGH_TRANSLUCENT_SHADER)
+				TranslucentObjectRecord record;
+				record.vertex_buffer_id = g["vertex_buffer"]->getBuffer()->getId();
+				record.normal_buffer_id = g["normal_buffer"]->getBuffer()->getId();
+				record.vindex_buffer_id = g["vindex_buffer"]->getBuffer()->getId();
+				record.nindex_buffer_id = g["nindex_buffer"]->getBuffer()->getId();
+				record.transform_matrix = transform_matrix;
+				record.normal_matrix = inverse_transform_matrix.transpose();
+				mtl["scattering_properties"]->getUserData(sizeof(ScatteringMaterialProperties), &record.properties);
+				record.material_type = geometry->getMaterial()->getType();
+				record.roughness = optix::make_float2(0.0f);
+				record.microfacet_model = WALTER_MODEL;
+				record.normal_distribution = BECKMANN_DISTRIBUTION;
+				if (record.material_type == ROUGH_TRANSLUCENT_SHADER)
+				{
+					record.roughness = mtl["roughness"]->getFloat2();
+					record.normal_distribution = mtl["normal_distribution"]->getUint();
+					record.microfacet_model = mtl["microfacet_model"]->getUint();
+				}
+				record.sss_estimator = SSS_POINT_CLOUD;
+				if (record.material_type == TRANSLUCENT_SHADER)
 				{
-					gi["roughness"]->setFloat(geometry->getMaterial()->getOptixMaterial()["roughness"]->getFloat2());
-					optix::float2 test = gi["roughness"]->getFloat2();
-					gi["normal_distribution"]->setUint(geometry->getMaterial()->getOptixMaterial()["normal_distribution"]->getUint());
-					gi["microfacet_model"]->setUint(geometry->getMaterial()->getOptixMaterial()["microfacet_model"]->getUint());
+					record.sss_estimator = mtl["sss_estimator"]->getUint();
+					mtl["sss_probe_object"]->set(geometry->getTransform());
 				}
+				optix::Aabb world_bbox;
+				record.area_cdf_offset = area_cdf.size();
+				record.area = computeAreaCdf(gi, transform_matrix, area_cdf, world_bbox);
+				record.sample_offset = 0;
+				record.sample_count = 0;
+				record.launch_offset = 0;
+				record.refresh_offset = 0;
+				record.refresh_count = 0;
+				record.frame_samples = 0;
+				record.poisson_offset = 0;
+				record.poisson_capacity = 0;
+				record.poisson_set = 0;
 				translucentObjects.append(gi);
-				geometry->getMaterial()->getOptixMaterial()["translucent_index"]->setUint(translucentObjects.size()-1);
+				translucentRecords.append(record);
+				translucentBBoxes.append(world_bbox.m_min);
+				translucentBBoxes.append(world_bbox.m_max);
+				mtl["translucent_index"]->setUint(translucentObjects.size()-1);
 			}
 		}
 	}
 
-	context["samples_output_buffer"]->getBuffer()->setSize(SAMPLES_FRAME*getTranslucentObjects().size());
+	translucent_area_cdf->setSize(area_cdf.size());
+	if (area_cdf.size() > 0)
+	{
+		memcpy(translucent_area_cdf->map(), area_cdf.data(), area_cdf.size() * sizeof(float));
+		translucent_area_cdf->unmap();
+	}
+	translucent_bbox_buffer->setSize(translucentBBoxes.size());
+	if (translucentBBoxes.size() > 0)
+	{
+		memcpy(translucent_bbox_buffer->map(), translucentBBoxes.data(), translucentBBoxes.size() * sizeof(optix::float3));
+		translucent_bbox_buffer->unmap();
+	}
 
-	if (getTranslucentObjects().size() > 0)
-	{	
-		loadTranslucentGeometry(0);
+	// The cached samples of an object stay valid if its record did not change
+	unsigned int lifetime = std::max(context["sss_sample_lifetime"]->getUint(), 1u);
+	QVector<unsigned int> counts = nextTranslucentAllocation(lifetime);
+	if (previous_records.size() == translucentRecords.size() && counts == translucentFrameSamples && lifetime == translucentLifetime)
+	{
+		for (int k = 0; k < translucentRecords.size(); ++k)
+		{
+			if (!sameTranslucentObject(previous_records[k], translucentRecords[k]))
+				translucentStale[k] = true;
+			translucentRecords[k].sample_offset = previous_records[k].sample_offset;
+			translucentRecords[k].sample_count = previous_records[k].sample_count;
+		}
+		translucentRecordsDirty = true;
 	}
-	else {
-		initTranslucentContext();
+	else
+	{
+		layoutTranslucentSamples(counts, lifetime);
 	}
 }
 
-void OptixSceneLoader::loadTranslucentGeometry(uint idx)
+// Relights one of the lifetime blocks of samples of every object per frame, in turn,
+// or all of them for the objects invalidated by invalidateTranslucentSamples
+void OptixSceneLoader::updateTranslucentSamples()
 {
-		context["current_translucent_obj"]->setUint(idx);
-		optix::GeometryInstance gi = getTranslucentObjects().at(idx);
-		optix::Geometry& g = gi->getGeometry();
-		context["vertex_buffer"]->setBuffer(g["vertex_buffer"]->getBuffer());
-		context["normal_buffer"]->setBuffer(g["normal_buffer"]->getBuffer());
-		context["vindex_buffer"]->setBuffer(g["vindex_buffer"]->getBuffer());
-		context["nindex_buffer"]->setBuffer(g["nindex_buffer"]->getBuffer());
-		optix::Matrix4x4 transform_matrix;
-		optix::Matrix4x4 inverse_transform_matrix;
-		ScatteringMaterialProperties properties;
-		optix::float2 roughness;
-		uint normal_distribution;
-		uint microfacet_model;
-		uint material_type;
-		gi["transform_matrix"]->getMatrix4x4(0, transform_matrix.getData());
-		gi["inverse_transform_matrix"]->getMatrix4x4(0, inverse_transform_matrix.getData());
-		gi["scattering_properties"]->getUserData(sizeof(ScatteringMaterialProperties), &properties);
-		material_type = gi["material_type"]->getUint();
-		if (material_type == ROUGH_TRANSLUCENT_SHADER) {
-			roughness = gi["roughness"]->getFloat2();
-			normal_distribution = gi["normal_distribution"]->getUint();
-			microfacet_model = gi["microfacet_model"]->getUint();
-			context["current_roughness"]->setFloat(roughness);
-			context["current_microfacet_model"]->setUint(microfacet_model);
-			context["current_normal_distribution"]->setUint(normal_distribution);
+	unsigned int lifetime = std::max(context["sss_sample_lifetime"]->getUint(), 1u);
+	QVector<unsigned int> counts = nextTranslucentAllocation(lifetime);
+	if (counts != translucentFrameSamples || lifetime != translucentLifetime)
+		layoutTranslucentSamples(counts, lifetime);
+	QVector<bool> regenerated = sss_poisson_sets->update(translucentObjects, translucentRecords, counts);
+	bool poisson = false;
+	for (int k = 0; k < translucentRecords.size(); ++k)
+	{
+		if (regenerated[k])
+		{
+			translucentStale[k] = true;
+			translucentRecordsDirty = true;
 		}
+		poisson = poisson || translucentRecords[k].poisson_capacity > 0;
+	}
+	// the Poisson-disk set of every block is picked again every frame
+	if (!translucentRecordsDirty && translucentLifetime == 1 && !poisson)
+		return;
 
-		
-	
-		context["transform_matrix"]->setMatrix4x4fv(0, transform_matrix.getData());
-		context["normal_matrix"]->setMatrix4x4fv(1, inverse_transform_matrix.getData());
-		context["current_scattering_properties"]->setUserData(sizeof(ScatteringMaterialProperties), &properties);
+	translucentSamples = 0;
+	for (int k = 0; k < translucentRecords.size(); ++k)
+	{
+		TranslucentObjectRecord& record = translucentRecords[k];
+		record.launch_offset = translucentSamples;
+		record.frame_samples = translucentFrameSamples[k];
+		if (translucentStale[k] || translucentLifetime == 1)
+		{
+			record.refresh_offset = 0;
+			record.refresh_count = record.sample_count;
+			translucentStale[k] = false;
+		}
+		else
+		{
+			unsigned int block = (translucentRefreshFrame + k) % translucentLifetime;
+			record.refresh_offset = block * translucentFrameSamples[k];
+			record.refresh_count = translucentFrameSamples[k];
+		}
+		translucentSamples += record.refresh_count;
+	}
+	++translucentRefreshFrame;
+	translucent_object_buffer->setSize(translucentRecords.size());
+	if (translucentRecords.size() > 0)
+	{
+		memcpy(translucent_object_buffer->map(), translucentRecords.data(), translucentRecords.size() * sizeof(TranslucentObjectRecord));
+		translucent_object_buffer->unmap();
+	}
+	translucentRecordsDirty = false;
+}
 
-		context["current_material_type"]->setUint(material_type);
+// Called on edits of the lights, geometry, materials, background, max depth or
+// scene epsilon; camera moves and the choice of sampler keep the cache
+void OptixSceneLoader::invalidateTranslucentSamples()
+{
+	translucentStale.fill(true);
+	translucentRecordsDirty = true;
 }
 
-void OptixSceneLoader::initTranslucentContext()
+// Samples per frame of every translucent object; with a lifetime, the allocation only
+// follows the camera once all the samples are stale, or when an estimator changes
+QVector<unsigned int> OptixSceneLoader::nextTranslucentAllocation(unsigned int lifetime)
 {
-	ScatteringMaterialProperties properties;
-	optix::Buffer b = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_INT3, 0);
-	context["current_translucent_obj"]->setUint(0);
-	context["vertex_buffer"]->setBuffer( b);
-	context["normal_buffer"]->setBuffer(b);
-	context["vindex_buffer"]->setBuffer(b);
-	context["nindex_buffer"]->setBuffer(b);
-	context["transform_matrix"]->setMatrix4x4fv(0, optix::Matrix4x4::identity().getData());
-	context["normal_matrix"]->setMatrix4x4fv(1, optix::Matrix4x4::identity().getData());
-	context["current_scattering_properties"]->setUserData(sizeof(ScatteringMaterialProperties), &properties);
-	context["current_material_type"]->setUint(TRANSLUCENT_SHADER);
-	context["current_roughness"]->setFloat(optix::make_float2(0.0f));
-	context["current_microfacet_model"]->setUint(WALTER_MODEL);
-	context["current_normal_distribution"]->setUint(BECKMANN_DISTRIBUTION);
-	
-}
\ No newline at end of file
+	bool keep = lifetime > 1 && lifetime == translucentLifetime && translucentFrameSamples.size() == translucentRecords.size() && translucentStale.contains(false);
+	for (int k = 0; keep && k < translucentRecords.size(); ++k)
+		keep = (translucentFrameSamples[k] > 0) == (translucentRecords[k].sss_estimator == SSS_POINT_CLOUD);
+	return keep ? translucentFrameSamples : allocateTranslucentSamples();
+}
+
+// Number of samples per frame of every translucent object. Without
+// a budget every object gets SAMPLES_FRAME samples. With a budget, the
+// samples are split by screen coverage, area and transport coefficient
+// (sss_split_budget). Objects shaded with probe rays get no samples.
+QVector<unsigned int> OptixSceneLoader::allocateTranslucentSamples()
+{
+	QVector<unsigned int> counts(translucentRecords.size(), 0);
+	for (int k = 0; k < translucentRecords.size(); ++k)
+		if (translucentRecords[k].sss_estimator == SSS_POINT_CLOUD)
+			counts[k] = SAMPLES_FRAME;
+	unsigned int budget = context["sss_sample_budget"]->getUint();
+	if (budget > 0)
+	{
+		optix::float3 eye = context["eye"]->getFloat3();
+		optix::float3 U = context["U"]->getFloat3();
+		optix::float3 V = context["V"]->getFloat3();
+		optix::float3 W = context["W"]->getFloat3();
+		QVector<double> importance(translucentRecords.size(), 0.0);
+		for (int k = 0; k < translucentRecords.size(); ++k)
+		{
+			if (counts[k] == 0)
+				continue;
+			float coverage = sss_screen_coverage(translucentBBoxes[2 * k], translucentBBoxes[2 * k + 1], eye, U, V, W);
+			importance[k] = sss_sample_importance(coverage, translucentRecords[k].area, translucentRecords[k].properties.transport);
+		}
+		sss_split_budget(budget, importance.data(), counts.data(), counts.size());
+	}
+	return counts;
+}
+
+// Assigns lifetime*counts[k] samples of the sample buffers to every object,
+// whose samples all need to be generated again
+void OptixSceneLoader::layoutTranslucentSamples(const QVector<unsigned int>& counts, unsigned int lifetime)
+{
+	translucentFrameSamples = counts;
+	translucentLifetime = lifetime;
+	translucentSampleRanges.resize(counts.size());
+	unsigned int offset = 0;
+	for (int k = 0; k < counts.size(); ++k)
+	{
+		translucentSampleRanges[k] = optix::make_uint2(offset, counts[k] * lifetime);
+		translucentRecords[k].sample_offset = offset;
+		translucentRecords[k].sample_count = counts[k] * lifetime;
+		offset += counts[k] * lifetime;
+	}
+	translucent_sample_buffer->setSize(translucentSampleRanges.size());
+	if (translucentSampleRanges.size() > 0)
+	{
+		memcpy(translucent_sample_buffer->map(), translucentSampleRanges.data(), translucentSampleRanges.size() * sizeof(optix::uint2));
+		translucent_sample_buffer->unmap();
+	}
+	ss_compact_samples->setSize(offset);
+	translucentStale.fill(true, counts.size());
+	translucentRecordsDirty = true;
+}
+
+float OptixSceneLoader::computeAreaCdf(optix::GeometryInstance gi, const optix::Matrix4x4& transform_matrix, QVector<float>& cdf, optix::Aabb& world_bbox)
+{
+	// world space areas, so that non uniform scaling is accounted for
+	optix::Geometry& g = gi->getGeometry();
+	optix::Buffer vertex_buffer = g["vertex_buffer"]->getBuffer();
+	optix::Buffer vindex_buffer = g["vindex_buffer"]->getBuffer();
+	RTsize triangles;
+	vindex_buffer->getSize(triangles);
+	const optix::float3* vertices = static_cast<const optix::float3*>(vertex_buffer->map());
+	const optix::int3* indices = static_cast<const optix::int3*>(vindex_buffer->map());
+	unsigned int offset = cdf.size();
+	cdf.resize(offset + triangles);
+	for (RTsize i = 0; i < triangles; i++)
+	{
+		optix::float3 v0 = make_float3(transform_matrix * optix::make_float4(vertices[indices[i].x], 1.0f));
+		optix::float3 v1 = make_float3(transform_matrix * optix::make_float4(vertices[indices[i].y], 1.0f));
+		optix::float3 v2 = make_float3(transform_matrix * optix::make_float4(vertices[indices[i].z], 1.0f));
+		cdf[offset + i] = 0.5f*optix::length(optix::cross(v1 - v0, v2 - v0));
+		world_bbox.include(v0);
+		world_bbox.include(v1);
+		world_bbox.include(v2);
+	}
+	vindex_buffer->unmap();
+	vertex_buffer->unmap();
+
+	return static_cast<float>(build_area_cdf(cdf.data() + offset, static_cast<unsigned int>(triangles)));
+}
+
+// The samples change at every frame, so the octrees are rebuilt after every
+// sample pass. Nothing is read back when the shaders sum all the samples.
+void OptixSceneLoader::updateSSSOctree()
+{
+	if (getTranslucentObjects().size() == 0 || context["sss_octree_max_solid_angle"]->getFloat() <= 0.0f)
+		return;
+	sss_octree->update(ss_compact_samples, translucentBBoxes, translucentSampleRanges);
+}
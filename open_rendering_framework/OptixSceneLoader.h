@@ -8,6 +8,11 @@
 #include "Camera.h"
 #include "Geometry.h"
 #include "Light.h"
+#include "LightBVH.h"
+#include "SSSOctree.h"
+#include "SSSPoissonSets.h"
+#include "EnergyCompensation.h"
+#include "BeckmannVNDFTable.h"
 #include <QVector>
 
 class OptixSceneLoader 
@@ -20,8 +25,8 @@ public:
 	bool loadJSONScene(const QString scene_path, uint& width, uint& height, QString& buffer_path, unsigned int& frame_count);
 	bool saveJSONScene(QString scene_path, uint frame_count);
 	void setCamera(Camera* c) { camera = c; };
-	void setBackground(Background* b) { background = b; };
-	void setIntegrator(Integrator* i) { integrator = i; };
+	void setBackground(Background* b) { background = b; invalidateTranslucentSamples(); };
+	void setIntegrator(Integrator* i) { integrator = i; invalidateTranslucentSamples(); };
 	Camera* getCamera() { return camera; };
 	Background* getBackground() { return background; };
 	QVector<Light*>* getLights() { return &lights; };
@@ -38,8 +43,12 @@ public:
 	void removeGeometry(unsigned int geometryIdx);
 	void updateAcceleration();
 	GLuint getSamplesFrame() { return SAMPLES_FRAME; };
+	// number of samples generated by the next sample pass
+	GLuint getTranslucentSamples() { return translucentSamples; };
 	void computeTranslucentGeometries();
-	void loadTranslucentGeometry(uint idx);
+	void updateTranslucentSamples();
+	void invalidateTranslucentSamples();
+	void updateSSSOctree();
 	
 protected:
 	void readJSON(const QJsonObject &json, uint& width, uint& height, QString& buffer_path, unsigned int& frame_count);
@@ -51,8 +60,14 @@ protected:
 	void readLight(const QJsonObject &lightObject, LightStruct* light_data);
 	void initLightBuffers();
 	void loadTriangleLightBuffer();
+	void loadLightAliasBuffer();
+	void loadLightIndices();
+	float estimateLightPower(unsigned int lightIdx);
 	optix::float3 qVector3DtoFloat3(QVector3D vec);
-	void initTranslucentContext();
+	QVector<unsigned int> allocateTranslucentSamples();
+	QVector<unsigned int> nextTranslucentAllocation(unsigned int lifetime);
+	void layoutTranslucentSamples(const QVector<unsigned int>& counts, unsigned int lifetime);
+	float computeAreaCdf(optix::GeometryInstance gi, const optix::Matrix4x4& transform_matrix, QVector<float>& cdf, optix::Aabb& world_bbox);
 
 private:
 	//QVector<Integrator*> integrators;
@@ -63,13 +78,37 @@ private:
 	QVector<Light*> lights;
 	QVector<LightStruct> lightStructData;
 	QVector<optix::GeometryInstance> translucentObjects;
+	QVector<TranslucentObjectRecord> translucentRecords;
+	// first sample and number of samples of every translucent object
+	QVector<optix::uint2> translucentSampleRanges;
+	// samples relit per frame of every object, kept for translucentLifetime frames
+	QVector<unsigned int> translucentFrameSamples;
+	unsigned int translucentLifetime;
+	// objects whose samples must all be relit by the next sample pass
+	QVector<bool> translucentStale;
+	unsigned int translucentRefreshFrame;
+	bool translucentRecordsDirty;
+	GLuint translucentSamples;
+	// per translucent object: min and max of its world space bounding box
+	QVector<optix::float3> translucentBBoxes;
 	optix::Group obj_group;
 	optix::Context context;
 	optix::Aabb bbox;
 	optix::Buffer light_buffer;
 	optix::Buffer triangle_light_buffer;
+	optix::Buffer light_alias_buffer;
+	optix::Buffer triangle_light_alias_buffer;
+	LightBVH* light_bvh;
 	unsigned int triangle_light_count;
-	optix::Buffer ss_samples;
+	optix::Buffer ss_compact_samples;
+	optix::Buffer translucent_bbox_buffer;
+	optix::Buffer translucent_object_buffer;
+	optix::Buffer translucent_sample_buffer;
+	optix::Buffer translucent_area_cdf;
+	SSSOctree* sss_octree;
+	SSSPoissonSets* sss_poisson_sets;
+	EnergyCompensation* energy_compensation;
+	BeckmannVNDFTable* beckmann_vndf_table;
 	GLuint SAMPLES_FRAME;
 
 };
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "PBDTable.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <QtConcurrent/QtConcurrent>
+#include "Fresnel.h"
+#include "BSSRDFBatch.h"
+#include "dipoles/dipole_profile.h"
+#include "dipoles/photon_beam_diffusion.h"
+
+using namespace optix;
+
+namespace
+{
+	// points of the beam of the entries, many more than the direct evaluation
+	// (PBD_BEAM_SAMPLES) since the table is built once per material
+	const unsigned int BEAM_SAMPLES = 32;
+
+	// Multiple scattering of pbd_beam for the exit point at x from the
+	// entry point, on a planar surface with normal (0, 0, 1)
+	float3 multiple_scattering(const ScatteringMaterialProperties& properties, const float3& x, const float3& wt, float cos_theta_t, unsigned int samples)
+	{
+		const float3 no = make_float3(0.0f, 0.0f, 1.0f);
+		float3 S;
+		for (int k = 0; k < 3; ++k)
+		{
+			float4 props, C;
+			pbd_channel(properties, k, props, C);
+			setByIndex(S, k, pbd_beam(x, wt, cos_theta_t, no, props, C, samples).x);
+		}
+		return S;
+	}
+
+	float3 refracted_beam(float cos_theta_t)
+	{
+		return make_float3(sqrtf(fmaxf(1.0f - cos_theta_t*cos_theta_t, 0.0f)), 0.0f, -cos_theta_t);
+	}
+
+	// Largest error of the selected points, relative to the peak of the
+	// reference in each channel
+	float max_error(const std::vector<float3>& result, const std::vector<float3>& reference, const std::vector<bool>& selected)
+	{
+		float error = 0.0f;
+		for (int c = 0; c < 3; ++c)
+		{
+			float peak = 0.0f;
+			for (unsigned int i = 0; i < reference.size(); ++i)
+				peak = std::max(peak, getByIndex(reference[i], c));
+			for (unsigned int i = 0; i < reference.size(); ++i)
+				if (selected[i])
+					error = std::max(error, fabsf(getByIndex(result[i], c) - getByIndex(reference[i], c)) / peak);
+		}
+		return error;
+	}
+
+	template<typename Evaluate>
+	double evaluations_per_second(unsigned int count, const Evaluate& evaluate)
+	{
+		const int repetitions = 5;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repetitions; ++r)
+			evaluate();
+		std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+		return repetitions*(double)count / seconds.count();
+	}
+}
+
+const unsigned int PBDTable::AZIMUTHS = 16;
+
+float3 PBDTable::azimuthalMean(const ScatteringMaterialProperties& properties, float dist, float cos_theta_t)
+{
+	// the mean over [0, 2 pi] is the mean over [0, pi] by symmetry
+	float3 wt = refracted_beam(cos_theta_t);
+	float3 S = make_float3(0.0f);
+	for (unsigned int a = 0; a < AZIMUTHS; ++a)
+	{
+		float phi = M_PIf*(a + 0.5f) / AZIMUTHS;
+		S += multiple_scattering(properties, dist*make_float3(cosf(phi), sinf(phi), 0.0f), wt, cos_theta_t, BEAM_SAMPLES);
+	}
+	return fmaxf(S / (float)AZIMUTHS, make_float3(0.0f));
+}
+
+void PBDTable::build(ScatteringMaterialProperties& properties, float3* table)
+{
+	float sigma_t = fmaxf(properties.extinction);
+	properties.pbd_table_r_min = PBD_TABLE_R_MIN / sigma_t;
+	properties.pbd_table_inv_log_range = 1.0f / logf(1.0f + properties.dipole_effective_radius / properties.pbd_table_r_min);
+
+	QVector<unsigned int> radii;
+	for (unsigned int i = 0; i < PBD_TABLE_RADII; ++i)
+		radii.push_back(i);
+	QtConcurrent::blockingMap(radii, [&properties, table](unsigned int i) {
+		// the beam integral of pbd_beam is singular where the exit point is on
+		// the beam, so the first radius repeats the second, a small fraction
+		// of a mean free path (PBD_TABLE_R_MIN) from the entry point
+		float dist = pbd_table_distance(std::max(i, 1u), properties);
+		for (unsigned int j = 0; j < PBD_TABLE_ANGLES; ++j)
+		{
+			float sin_theta_t = pbd_table_sine(j, properties);
+			table[i*PBD_TABLE_ANGLES + j] = azimuthalMean(properties, dist, sqrtf(1.0f - sin_theta_t*sin_theta_t));
+		}
+	});
+}
+
+bool PBDTable::report(std::ostream& out)
+{
+	// bilinear interpolation of a smooth function, relative to its peak,
+	// beyond r_min; closer to the entry point the profile is singular at
+	// normal incidence and its error is only reported
+	const float tolerance = 2.0e-2f;
+	const unsigned int count = 1 << 12;
+	const float scale = 100.0f;
+	struct { const char* name; float3 absorption, scattering, meancosine; } materials[] = {
+		{ "apple", make_float3(0.0030f, 0.0034f, 0.0046f), make_float3(2.29f, 2.39f, 1.97f), make_float3(0.0f) },
+		{ "skin", make_float3(0.032f, 0.17f, 0.48f), make_float3(0.74f, 0.88f, 1.01f), make_float3(0.0f) },
+		{ "ketchup", make_float3(0.061f, 0.97f, 1.45f), make_float3(0.18f, 0.07f, 0.03f), make_float3(0.0f) },
+		{ "soymilk", make_float3(0.0001f, 0.0005f, 0.0034f), make_float3(2.433f, 2.714f, 4.563f), make_float3(0.873f, 0.858f, 0.832f) },
+	};
+
+	bool valid = true;
+	out << "Photon beam diffusion tables (" << PBD_TABLE_RADII << " radii, " << PBD_TABLE_ANGLES << " angles, " << AZIMUTHS << " azimuths), "
+		<< count << " points per material" << std::endl;
+	out << "  material: build time, max error (table beyond r_min, table within r_min, azimuthal mean), evaluations per second (pbd_bssrdf, table)" << std::endl;
+	for (const auto& material : materials)
+	{
+		ScatteringMaterialProperties properties = BSSRDFBatch::materialProperties(scale*material.absorption, scale*material.scattering, material.meancosine, 1.3f);
+		compute_dipole_profile(properties, nullptr);
+		std::vector<float3> table(PBD_TABLE_RADII*PBD_TABLE_ANGLES);
+		auto start = std::chrono::high_resolution_clock::now();
+		build(properties, table.data());
+		std::chrono::duration<double, std::milli> build_time = std::chrono::high_resolution_clock::now() - start;
+
+		// points between the entries, uniform in the coordinates of the table
+		// beyond the first radius, with the incident direction that refracts
+		// to the beam
+		std::mt19937 generator(2013);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		std::vector<float> dists(count), cosines(count), phis(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			float x = (1.0f + uniform(generator)*(PBD_TABLE_RADII - 2)) / (PBD_TABLE_RADII - 1);
+			dists[i] = properties.pbd_table_r_min*(expf(x / properties.pbd_table_inv_log_range) - 1.0f);
+			float sin_theta_t = uniform(generator) / properties.relative_ior;
+			cosines[i] = sqrtf(1.0f - sin_theta_t*sin_theta_t);
+			phis[i] = 2.0f*M_PIf*uniform(generator);
+		}
+		const float3 n = make_float3(0.0f, 0.0f, 1.0f);
+		std::vector<float3> mean(count), tabulated(count), direct(count), pbd(count);
+		std::vector<bool> far(count), near(count), all(count, true);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			far[i] = dists[i] >= properties.pbd_table_r_min;
+			near[i] = !far[i];
+			float3 x = dists[i] * make_float3(cosf(phis[i]), sinf(phis[i]), 0.0f);
+			float3 wt = refracted_beam(cosines[i]);
+			mean[i] = azimuthalMean(properties, dists[i], cosines[i]);
+			direct[i] = fmaxf(multiple_scattering(properties, x, wt, cosines[i], PBD_BEAM_SAMPLES), make_float3(0.0f));
+		}
+		auto pbd_direct = [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				float3 x = dists[i] * make_float3(cosf(phis[i]), sinf(phis[i]), 0.0f);
+				float3 wt = refracted_beam(cosines[i]);
+				// direction of the incident light that refracts to wt
+				float3 wi = make_float3(-wt.x*properties.relative_ior, 0.0f, 0.0f);
+				wi.z = sqrtf(fmaxf(1.0f - wi.x*wi.x, 0.0f));
+				pbd[i] = pbd_bssrdf(x, n, wi, n, properties);
+			}
+		};
+		auto pbd_table = [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+				tabulated[i] = pbd_bssrdf_tabulated(dists[i], refracted_beam(cosines[i]), n, properties, table);
+		};
+		double direct_rate = evaluations_per_second(count, pbd_direct);
+		double table_rate = evaluations_per_second(count, pbd_table);
+		float table_error = max_error(tabulated, mean, far);
+		float near_error = max_error(tabulated, mean, near);
+		float azimuth_error = max_error(mean, direct, all);
+
+		bool material_valid = table_error < tolerance;
+		valid = valid && material_valid;
+		out << "  " << material.name << ": " << build_time.count() << " ms, " << table_error << (material_valid ? "" : " FAILED") << " "
+			<< near_error << " " << azimuth_error << ", "
+			<< direct_rate << " " << table_rate << std::endl;
+	}
+	return valid;
+}
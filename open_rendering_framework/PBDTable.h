@@ -0,0 +1,28 @@
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include <ostream>
+#include "structs.h"
+
+// Host side builder of the tables of the multiple scattering of photon beam
+// diffusion (pbd_bssrdf_tabulated in dipoles/photon_beam_diffusion.h), one
+// per translucent material, with PBD_TABLE_RADII by PBD_TABLE_ANGLES entries
+// per channel. The radii are built in parallel. Every entry is the mean of
+// the multiple scattering of pbd_beam over AZIMUTHS directions of the beam.
+class PBDTable
+{
+public:
+	static const unsigned int AZIMUTHS;
+
+	// Sets the radial parameters of the table in properties and fills its
+	// PBD_TABLE_RADII*PBD_TABLE_ANGLES entries, the effective radius must be
+	// set (compute_dipole_profile)
+	static void build(ScatteringMaterialProperties& properties, optix::float3* table);
+	// Multiple scattering at the given distance from the entry point of a
+	// beam refracted with the given cosine, averaged over the azimuth
+	static optix::float3 azimuthalMean(const ScatteringMaterialProperties& properties, float dist, float cos_theta_t);
+
+	// Compares the tables of the default materials with the direct
+	// evaluation between the entries and measures the evaluations per second
+	// of both. Returns false if the error exceeds the tolerance.
+	static bool report(std::ostream& out);
+};
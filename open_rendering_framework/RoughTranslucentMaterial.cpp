@@ -3,6 +3,7 @@
 #include "OptixScene.h"
 #include "sampleConfig.h"
 #include "Fresnel.h"
+#include "dipoles/dipole_profile.h"
 
 RoughTranslucentMaterial::RoughTranslucentMaterial(optix::Context c)
 {
@@ -135,7 +136,8 @@ void RoughTranslucentMaterial::initPrograms()
 	mtl->setClosestHitProgram(radiance_ray_type, closest_hit);
 	mtl->setAnyHitProgram(shadow_ray_type, any_hit);
 	mtl->setClosestHitProgram(depth_ray_type, depth_closest_hit);
-
+	dipole_profile_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, DIPOLE_PROFILE_SIZE);
+	mtl["dipole_profile_buffer"]->set(dipole_profile_buffer);
 };
 
 void RoughTranslucentMaterial::tableUpdate(int row, int column)
@@ -360,6 +362,8 @@ void RoughTranslucentMaterial::getDefaultMaterial(DefaultScatteringMaterial mate
 void RoughTranslucentMaterial::loadParameters(const char* name)
 {
 	mtl[name]->setUserData(sizeof(ScatteringMaterialProperties), &properties);
+	memcpy(dipole_profile_buffer->map(), dipole_profile.data(), DIPOLE_PROFILE_SIZE * sizeof(optix::float3));
+	dipole_profile_buffer->unmap();
 	mtl["dipole_model"]->setUint(dipole_model);
 }
 
@@ -391,6 +395,8 @@ void RoughTranslucentMaterial::computeCoefficients(optix::float3 ior_outside)
 	properties.global_coeff = optix::make_float3(1.0f) / (4.0f*properties.C_phi_inv) * 1.0f / (4.0f*M_PIf*M_PIf);
 	properties.one_over_three_ext = optix::make_float3(1.0) / (3.0f*properties.extinction);
 	properties.mean_transport = (properties.transport.x + properties.transport.y + properties.transport.z) / 3.0f;
+	dipole_profile.resize(DIPOLE_PROFILE_SIZE);
+	compute_dipole_profile(properties, dipole_profile.data());
 	//properties.min_transport = fminf(fminf(properties.transport.x, properties.transport.y), properties.transport.z);
 }
 
@@ -0,0 +1,306 @@
+#include "SSSOctree.h"
+#include "compact_sample.h"
+#include <algorithm>
+#include <random>
+
+using namespace optix;
+
+namespace
+{
+	// nodes with this many samples or less are leaves
+	const int LEAF_SAMPLES = 8;
+	const int MAX_DEPTH = 16;
+
+	float mean(const float3& v)
+	{
+		return (v.x + v.y + v.z) / 3.0f;
+	}
+
+	float3 sample_power(const PositionSample& sample)
+	{
+		return sample.weight * sample.L;
+	}
+
+	unsigned int octant(const float3& pos, const float3& center)
+	{
+		return (pos.x > center.x ? 1u : 0u) | (pos.y > center.y ? 2u : 0u) | (pos.z > center.z ? 4u : 0u);
+	}
+
+	// Contribution of a sample with the exponential falloff and the
+	// singularity at the exit point of the dipoles, for report
+	struct ReportEval
+	{
+		float3 xo;
+		unsigned int* evaluations;
+		float3 operator()(const float3& pos, const float3& normal, const float3& transmitted, const float3& power) const
+		{
+			++*evaluations;
+			const float sigma_tr = 4.0f;
+			const float z_r = 0.05f;
+			float3 d = pos - xo;
+			float r_sqr = dot(d, d);
+			return power * expf(-sigma_tr * sqrtf(r_sqr)) / (r_sqr + z_r * z_r);
+		}
+	};
+
+	float3 uniform_sphere(float u, float v)
+	{
+		float z = 1.0f - 2.0f * u;
+		float r = sqrtf(fmaxf(1.0f - z * z, 0.0f));
+		float phi = 2.0f * M_PIf * v;
+		return make_float3(r * cosf(phi), r * sinf(phi), z);
+	}
+}
+
+SSSOctree::SSSOctree(optix::Context c)
+{
+	context = c;
+	node_buffer = context->createBuffer(RT_BUFFER_INPUT);
+	node_buffer->setFormat(RT_FORMAT_USER);
+	node_buffer->setElementSize(sizeof(SSSOctreeNode));
+	node_buffer->setSize(0);
+	sample_index_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT, 0);
+	object_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT2, 0);
+	context["sss_octree_buffer"]->set(node_buffer);
+	context["sss_octree_sample_buffer"]->set(sample_index_buffer);
+	context["sss_octree_object_buffer"]->set(object_buffer);
+}
+
+SSSOctree::SSSOctree()
+{
+}
+
+SSSOctree::~SSSOctree()
+{
+	if (!context.get())
+		return;
+	node_buffer->destroy();
+	sample_index_buffer->destroy();
+	object_buffer->destroy();
+}
+
+void SSSOctree::update(optix::Buffer compact_sample_buffer, const QVector<optix::float3>& bboxes, const QVector<optix::uint2>& sample_ranges)
+{
+	RTsize size;
+	compact_sample_buffer->getSize(size);
+	QVector<PositionSample> samples(size);
+	const CompactPositionSample* compact_samples = static_cast<const CompactPositionSample*>(compact_sample_buffer->map(0, RT_BUFFER_MAP_READ));
+	for (int object = 0; object < sample_ranges.size(); ++object)
+		for (unsigned int i = sample_ranges[object].x; i < sample_ranges[object].x + sample_ranges[object].y; ++i)
+			samples[i] = decode_position_sample(compact_samples[i], bboxes[2 * object], bboxes[2 * object + 1]);
+	compact_sample_buffer->unmap();
+	build(samples.data(), sample_ranges);
+	upload();
+}
+
+void SSSOctree::build(const PositionSample* samples, const QVector<optix::uint2>& sample_ranges)
+{
+	nodes.clear();
+	sample_indices.clear();
+	object_nodes.clear();
+	for (int object = 0; object < sample_ranges.size(); ++object)
+	{
+		unsigned int first_node = nodes.size();
+		unsigned int first_sample = sample_indices.size();
+		float3 bbox_min = make_float3(1.0e30f);
+		float3 bbox_max = make_float3(-1.0e30f);
+		for (unsigned int i = sample_ranges[object].x; i < sample_ranges[object].x + sample_ranges[object].y; ++i)
+		{
+			if (mean(sample_power(samples[i])) <= 0.0f)
+				continue;
+			sample_indices.append(i);
+			bbox_min = fminf(bbox_min, samples[i].pos);
+			bbox_max = fmaxf(bbox_max, samples[i].pos);
+		}
+		int end = sample_indices.size();
+		if (end > (int)first_sample)
+		{
+			float3 extent = bbox_max - bbox_min;
+			float cube_size = fmaxf(fmaxf(extent.x, extent.y), extent.z);
+			build(samples, sample_indices.data(), first_sample, end, bbox_min, cube_size, 0);
+			// the traversal works with indices relative to the root of the object
+			for (int i = first_node; i < nodes.size(); ++i)
+				nodes[i].skip -= first_node;
+		}
+		object_nodes.append(make_uint2(first_node, nodes.size() - first_node));
+	}
+}
+
+void SSSOctree::build(const PositionSample* samples, unsigned int* indices, int begin, int end, const float3& cube_min, float cube_size, int depth)
+{
+	// Aggregate the samples of the node
+	SSSOctreeNode node;
+	node.bbox_min = make_float3(1.0e30f);
+	node.bbox_max = make_float3(-1.0e30f);
+	node.pos = make_float3(0.0f);
+	node.normal = make_float3(0.0f);
+	node.transmitted = make_float3(0.0f);
+	node.power = make_float3(0.0f);
+	node.padding = node.padding2 = 0.0f;
+	float weight_sum = 0.0f;
+	for (int i = begin; i < end; ++i)
+	{
+		const PositionSample& sample = samples[indices[i]];
+		float3 power = sample_power(sample);
+		float weight = mean(power);
+		node.bbox_min = fminf(node.bbox_min, sample.pos);
+		node.bbox_max = fmaxf(node.bbox_max, sample.pos);
+		node.pos += weight * sample.pos;
+		node.normal += weight * sample.normal;
+		node.transmitted += weight * sample.transmitted;
+		node.power += power;
+		weight_sum += weight;
+	}
+	node.pos /= weight_sum;
+	node.normal = length(node.normal) > 0.0f ? normalize(node.normal) : node.normal;
+	node.transmitted = length(node.transmitted) > 0.0f ? normalize(node.transmitted) : node.transmitted;
+	float3 diagonal = node.bbox_max - node.bbox_min;
+	node.radius_sqr = 0.25f * dot(diagonal, diagonal);
+
+	unsigned int node_idx = nodes.size();
+	if (end - begin <= LEAF_SAMPLES || depth >= MAX_DEPTH || cube_size <= 0.0f)
+	{
+		node.first = begin;
+		node.count = end - begin;
+		node.skip = node_idx + 1;
+		nodes.append(node);
+		return;
+	}
+	node.first = 0;
+	node.count = 0;
+	nodes.append(node);
+
+	// Sort the samples by octant and recurse into the non empty ones
+	float half_size = 0.5f * cube_size;
+	float3 center = cube_min + make_float3(half_size);
+	std::sort(indices + begin, indices + end, [&](unsigned int a, unsigned int b) {
+		return octant(samples[a].pos, center) < octant(samples[b].pos, center);
+	});
+	int child_begin = begin;
+	while (child_begin < end)
+	{
+		unsigned int child_octant = octant(samples[indices[child_begin]].pos, center);
+		int child_end = child_begin + 1;
+		while (child_end < end && octant(samples[indices[child_end]].pos, center) == child_octant)
+			++child_end;
+		float3 child_min = make_float3(
+			child_octant & 1u ? center.x : cube_min.x,
+			child_octant & 2u ? center.y : cube_min.y,
+			child_octant & 4u ? center.z : cube_min.z);
+		build(samples, indices, child_begin, child_end, child_min, half_size, depth + 1);
+		child_begin = child_end;
+	}
+	nodes[node_idx].skip = nodes.size();
+}
+
+void SSSOctree::upload()
+{
+	node_buffer->setSize(nodes.size());
+	if (nodes.size() > 0)
+	{
+		memcpy(node_buffer->map(), nodes.data(), nodes.size() * sizeof(SSSOctreeNode));
+		node_buffer->unmap();
+	}
+	sample_index_buffer->setSize(sample_indices.size());
+	if (sample_indices.size() > 0)
+	{
+		memcpy(sample_index_buffer->map(), sample_indices.data(), sample_indices.size() * sizeof(unsigned int));
+		sample_index_buffer->unmap();
+	}
+	object_buffer->setSize(object_nodes.size());
+	if (object_nodes.size() > 0)
+	{
+		memcpy(object_buffer->map(), object_nodes.data(), object_nodes.size() * sizeof(uint2));
+		object_buffer->unmap();
+	}
+}
+
+bool SSSOctree::report(std::ostream& out)
+{
+	const unsigned int sphere_samples = 1u << 15, plane_samples = 1u << 13;
+	const unsigned int points = 256;
+	std::mt19937 generator(37);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	// a unit sphere and a plane below it, lit from above, with a tenth of the
+	// samples in shadow
+	QVector<PositionSample> samples;
+	const float3 light = normalize(make_float3(0.3f, 1.0f, 0.2f));
+	for (unsigned int i = 0; i < sphere_samples + plane_samples; ++i)
+	{
+		PositionSample sample;
+		if (i < sphere_samples)
+		{
+			sample.normal = uniform_sphere(uniform(generator), uniform(generator));
+			sample.pos = sample.normal;
+		}
+		else
+		{
+			sample.normal = make_float3(0.0f, 1.0f, 0.0f);
+			sample.pos = make_float3(4.0f * uniform(generator) - 2.0f, -1.5f, 4.0f * uniform(generator) - 2.0f);
+		}
+		sample.dir = light;
+		sample.transmitted = -sample.normal;
+		float cos_light = fmaxf(dot(sample.normal, light), 0.0f);
+		bool shadowed = uniform(generator) < 0.1f;
+		sample.L = shadowed ? make_float3(0.0f) : make_float3(1.0f, 0.8f, 0.6f) * (cos_light + 0.05f);
+		sample.weight = make_float3(0.5f + 0.5f * uniform(generator));
+		sample.padding = make_float2(0.0f);
+		samples.append(sample);
+	}
+	QVector<uint2> sample_ranges;
+	sample_ranges.append(make_uint2(0, sphere_samples));
+	sample_ranges.append(make_uint2(sphere_samples, plane_samples));
+	SSSOctree octree;
+	octree.build(samples.data(), sample_ranges);
+	out << "SSS octree: " << sphere_samples << " samples on a sphere, " << plane_samples << " on a plane, "
+		<< octree.nodes.size() << " nodes, " << points << " points per object" << std::endl;
+
+	// largest relative error tolerated at every solid angle; zero is the
+	// brute force sum in another order
+	const float max_solid_angles[] = { 0.0f, 0.01f, 0.05f, 0.2f };
+	const float tolerances[] = { 1.0e-4f, 1.0e-3f, 5.0e-3f, 0.03f };
+	for (int object = 0; object < 2; ++object)
+	{
+		for (int a = 0; a < 4; ++a)
+		{
+			double error_sum = 0.0;
+			float max_error = 0.0f;
+			unsigned long long evaluations = 0;
+			std::mt19937 point_generator(object);
+			for (unsigned int p = 0; p < points; ++p)
+			{
+				float3 xo = object == 0 ? uniform_sphere(uniform(point_generator), uniform(point_generator))
+					: make_float3(3.0f * uniform(point_generator) - 1.5f, -1.5f, 3.0f * uniform(point_generator) - 1.5f);
+				unsigned int count = 0;
+				ReportEval eval = { xo, &count };
+				float3 reference = make_float3(0.0f);
+				for (unsigned int i = sample_ranges[object].x; i < sample_ranges[object].x + sample_ranges[object].y; ++i)
+					reference += eval(samples[i].pos, samples[i].normal, samples[i].transmitted, sample_power(samples[i]));
+				count = 0;
+				float3 sum = octree.gather(samples.data(), object, xo, max_solid_angles[a], eval);
+				evaluations += count;
+				float error = fabsf(mean(sum) / mean(reference) - 1.0f);
+				error_sum += error;
+				max_error = fmaxf(max_error, error);
+			}
+			bool valid = max_error < tolerances[a];
+			passed = passed && valid;
+			out << "  " << (object == 0 ? "sphere" : "plane") << ", solid angle " << max_solid_angles[a] << ": relative error "
+				<< error_sum / points << " mean, " << max_error << " max (tolerance " << tolerances[a] << "), "
+				<< (double)evaluations / points << " evaluations per point of " << sample_ranges[object].y << " samples"
+				<< (valid ? "" : " FAILED") << std::endl;
+		}
+	}
+
+	// objects without octree contribute nothing
+	unsigned int count = 0;
+	ReportEval eval = { make_float3(0.0f), &count };
+	float3 missing = octree.gather(samples.data(), 2, make_float3(0.0f), 0.0f, eval);
+	bool missing_valid = missing.x == 0.0f && missing.y == 0.0f && missing.z == 0.0f && count == 0;
+	passed = passed && missing_valid;
+	out << "  object without samples: " << count << " evaluations" << (missing_valid ? "" : " FAILED") << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+#include <QVector>
+#include <ostream>
+#include "structs.h"
+#include "sss_octree.h"
+
+// Host side builder of the octrees traversed by sss_octree_gather, one for
+// every translucent object. They are rebuilt after every sample pass, since
+// the irradiance samples change at every frame. Samples that carry no power
+// are left out. The same traversal runs on the host (gather), which serves
+// as CPU reference of the shading and, with a zero solid angle, as brute
+// force sum to validate the error criterion against.
+class SSSOctree
+{
+public:
+	explicit SSSOctree(optix::Context c);
+	~SSSOctree();
+
+	// Builds the octrees from the samples of the translucent objects, where
+	// sample_ranges holds the first sample and the number of samples of
+	// every object
+	void build(const PositionSample* samples, const QVector<optix::uint2>& sample_ranges);
+	// Maps the buffer of compact samples, decodes them with the bounding
+	// boxes of the objects (min and max of every object in bboxes), builds
+	// the octrees and uploads them
+	void update(optix::Buffer compact_sample_buffer, const QVector<optix::float3>& bboxes, const QVector<optix::uint2>& sample_ranges);
+
+	template<typename Eval>
+	optix::float3 gather(const PositionSample* samples, unsigned int object, const optix::float3& xo, float max_solid_angle, const Eval& eval) const
+	{
+		if (object >= (unsigned int)object_nodes.size())
+			return optix::make_float3(0.0f);
+		return sss_octree_gather(nodes, object_nodes[object].x, object_nodes[object].y, sample_indices, samples, xo, max_solid_angle, eval);
+	}
+
+	int getNodeCount() { return nodes.size(); };
+	optix::Buffer& getNodeBuffer() { return node_buffer; };
+	// Compares gather with the brute force sum over the samples of a sphere
+	// and of a plane, at zero solid angle and at the solid angles of the
+	// renders, and reports the evaluations per point. Returns false if an
+	// error exceeds its tolerance.
+	static bool report(std::ostream& out);
+
+protected:
+	// builds without uploading, for report
+	SSSOctree();
+	void build(const PositionSample* samples, unsigned int* indices, int begin, int end, const optix::float3& cube_min, float cube_size, int depth);
+	void upload();
+
+	optix::Context context;
+	optix::Buffer node_buffer;
+	optix::Buffer sample_index_buffer;
+	optix::Buffer object_buffer;
+	QVector<SSSOctreeNode> nodes;
+	// samples of the leaves, as indices in compact_samples_buffer
+	QVector<unsigned int> sample_indices;
+	// first node and number of nodes of the octree of every object
+	QVector<optix::uint2> object_nodes;
+};
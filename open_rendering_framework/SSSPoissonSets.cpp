@@ -0,0 +1,645 @@
+#include "SSSPoissonSets.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include <QtConcurrent/QtConcurrent>
+
+using namespace optix;
+
+namespace
+{
+	// parameters of the weights of sample elimination [Yuksel 2015]
+	const float WEIGHT_EXPONENT = 8.0f;
+	const float WEIGHT_BETA = 0.65f;
+	const float WEIGHT_GAMMA = 1.5f;
+
+	// largest Poisson-disk radius of n points on a surface of the given area
+	float max_radius(float area, unsigned int n)
+	{
+		return sqrtf(area / (2.0f*sqrtf(3.0f)*n));
+	}
+
+	float mesh_area(const SSSPoissonSets::Mesh& mesh, std::vector<double>& cdf)
+	{
+		unsigned int triangles = mesh.vertices.size() / 3;
+		cdf.resize(triangles);
+		double total_area = 0.0;
+		for (unsigned int i = 0; i < triangles; ++i)
+		{
+			const float3* v = &mesh.vertices[3 * i];
+			total_area += 0.5*length(cross(v[1] - v[0], v[2] - v[0]));
+			cdf[i] = total_area;
+		}
+		return static_cast<float>(total_area);
+	}
+
+	// Uniform random points of the mesh, picked as by sample_camera
+	void sample_mesh(const SSSPoissonSets::Mesh& mesh, unsigned int count, unsigned int seed, float3* positions, float3* normals)
+	{
+		std::vector<double> cdf;
+		double area = mesh_area(mesh, cdf);
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			unsigned int triangle = std::upper_bound(cdf.begin(), cdf.end(), uniform(generator)*area) - cdf.begin();
+			triangle = std::min(triangle, (unsigned int)cdf.size() - 1);
+			const float3* v = &mesh.vertices[3 * triangle];
+			const float3* n = &mesh.normals[3 * triangle];
+			float xi1 = sqrtf(uniform(generator));
+			float xi2 = uniform(generator);
+			float u = 1.0f - xi1;
+			float w = xi1*xi2;
+			float t = xi1 - w;
+			positions[i] = u*v[0] + t*v[1] + w*v[2];
+			normals[i] = normalize(u*n[0] + t*n[1] + w*n[2]);
+		}
+	}
+
+	// Points in cells of the given size, hashed into a table with about two
+	// buckets per point. Cells that share a bucket are told apart by the
+	// distance test of the queries.
+	class SpatialHash
+	{
+	public:
+		SpatialHash(const float3* points, const unsigned int* indices, unsigned int n, float cell_size) : points(points), inv_cell_size(1.0f / cell_size)
+		{
+			buckets = 1;
+			while (buckets < 2 * n)
+				buckets <<= 1;
+			start.assign(buckets + 1, 0);
+			entries.resize(n);
+			std::vector<unsigned int> bucket_of(n);
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				bucket_of[i] = bucket(cell(points[indices[i]]));
+				++start[bucket_of[i] + 1];
+			}
+			std::partial_sum(start.begin(), start.end(), start.begin());
+			std::vector<unsigned int> next(start.begin(), start.end() - 1);
+			for (unsigned int i = 0; i < n; ++i)
+				entries[next[bucket_of[i]]++] = i;
+		}
+
+		// Calls visit(i, d) for every point i within radius of p, at distance
+		// d, where radius is at most the cell size
+		template<typename Visit>
+		void query(const float3& p, float radius, const Visit& visit, const unsigned int* indices) const
+		{
+			int3 c = cell(p);
+			unsigned int visited[27];
+			unsigned int visited_count = 0;
+			for (int dz = -1; dz <= 1; ++dz)
+				for (int dy = -1; dy <= 1; ++dy)
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						unsigned int b = bucket(make_int3(c.x + dx, c.y + dy, c.z + dz));
+						if (std::find(visited, visited + visited_count, b) != visited + visited_count)
+							continue;
+						visited[visited_count++] = b;
+						for (unsigned int e = start[b]; e < start[b + 1]; ++e)
+						{
+							float d = length(points[indices[entries[e]]] - p);
+							if (d < radius)
+								visit(entries[e], d);
+						}
+					}
+		}
+
+	private:
+		int3 cell(const float3& p) const
+		{
+			return make_int3((int)floorf(p.x*inv_cell_size), (int)floorf(p.y*inv_cell_size), (int)floorf(p.z*inv_cell_size));
+		}
+
+		unsigned int bucket(const int3& c) const
+		{
+			return ((unsigned int)c.x*73856093u ^ (unsigned int)c.y*19349663u ^ (unsigned int)c.z*83492791u) & (buckets - 1);
+		}
+
+		const float3* points;
+		float inv_cell_size;
+		unsigned int buckets;
+		std::vector<unsigned int> start;
+		std::vector<unsigned int> entries;
+	};
+
+	// Sample elimination of the points order[0, n) down to target points on
+	// a surface of the given area. The points that are kept are moved to
+	// order[0, target) and the eliminated ones to order[target, n), the last
+	// to be eliminated first.
+	void eliminate(const float3* points, unsigned int* order, unsigned int n, unsigned int target, float area)
+	{
+		if (target >= n)
+			return;
+		float r_max = max_radius(area, std::max(target, 1u));
+		float r_min = r_max*(1.0f - powf(target / (float)n, WEIGHT_GAMMA))*WEIGHT_BETA;
+		float radius = 2.0f*r_max;
+		SpatialHash hash(points, order, n, radius);
+
+		// neighbours within 2 r_max and their weights, in local indices
+		std::vector<unsigned int> first(n + 1, 0);
+		std::vector<unsigned int> neighbours;
+		std::vector<float> neighbour_weights;
+		std::vector<float> weights(n, 0.0f);
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			hash.query(points[order[i]], radius, [&](unsigned int j, float d) {
+				if (j == i)
+					return;
+				float w = powf(1.0f - std::max(d, r_min) / radius, WEIGHT_EXPONENT);
+				neighbours.push_back(j);
+				neighbour_weights.push_back(w);
+				weights[i] += w;
+			}, order);
+			first[i + 1] = neighbours.size();
+		}
+
+		// max heap of the weights, with the position of every point in it
+		std::vector<unsigned int> heap(n);
+		std::vector<unsigned int> position(n);
+		std::iota(heap.begin(), heap.end(), 0u);
+		auto sift_down = [&](unsigned int h) {
+			for (;;)
+			{
+				unsigned int largest = h;
+				unsigned int left = 2 * h + 1, right = 2 * h + 2;
+				if (left < heap.size() && weights[heap[left]] > weights[heap[largest]])
+					largest = left;
+				if (right < heap.size() && weights[heap[right]] > weights[heap[largest]])
+					largest = right;
+				if (largest == h)
+					return;
+				std::swap(heap[h], heap[largest]);
+				position[heap[h]] = h;
+				position[heap[largest]] = largest;
+				h = largest;
+			}
+		};
+		for (unsigned int h = n / 2; h-- > 0;)
+			sift_down(h);
+		for (unsigned int h = 0; h < n; ++h)
+			position[heap[h]] = h;
+
+		std::vector<bool> removed(n, false);
+		std::vector<unsigned int> eliminated;
+		eliminated.reserve(n - target);
+		while (heap.size() > target)
+		{
+			unsigned int i = heap[0];
+			heap[0] = heap.back();
+			position[heap[0]] = 0;
+			heap.pop_back();
+			sift_down(0);
+			removed[i] = true;
+			eliminated.push_back(i);
+			// the weights only decrease, so the neighbours only move down
+			for (unsigned int e = first[i]; e < first[i + 1]; ++e)
+			{
+				unsigned int j = neighbours[e];
+				if (removed[j])
+					continue;
+				weights[j] -= neighbour_weights[e];
+				sift_down(position[j]);
+			}
+		}
+
+		std::vector<unsigned int> reordered;
+		reordered.reserve(n);
+		for (unsigned int i = 0; i < n; ++i)
+			if (!removed[i])
+				reordered.push_back(order[i]);
+		for (unsigned int e = eliminated.size(); e-- > 0;)
+			reordered.push_back(order[eliminated[e]]);
+		std::copy(reordered.begin(), reordered.end(), order);
+	}
+
+	unsigned int set_seed(unsigned int generation, unsigned int object, unsigned int set)
+	{
+		unsigned int seed = generation * 0x9E3779B9u ^ object * 0x85EBCA6Bu ^ set * 0xC2B2AE35u;
+		seed ^= seed >> 16;
+		return seed * 0x27D4EB2Du;
+	}
+
+	unsigned int next_power_of_two(unsigned int n)
+	{
+		unsigned int p = 1;
+		while (p < n)
+			p <<= 1;
+		return p;
+	}
+
+	// Triangles of a sphere of radius 1, as subdivided octahedron
+	SSSPoissonSets::Mesh sphere_mesh(unsigned int subdivisions)
+	{
+		SSSPoissonSets::Mesh mesh;
+		const float3 axes[6] = { make_float3(1, 0, 0), make_float3(-1, 0, 0), make_float3(0, 1, 0), make_float3(0, -1, 0), make_float3(0, 0, 1), make_float3(0, 0, -1) };
+		for (int octant = 0; octant < 8; ++octant)
+		{
+			float3 a = axes[octant & 1], b = axes[2 + ((octant >> 1) & 1)], c = axes[4 + ((octant >> 2) & 1)];
+			for (unsigned int i = 0; i < subdivisions; ++i)
+				for (unsigned int j = 0; i + j < subdivisions; ++j)
+				{
+					auto vertex = [&](float s, float t) {
+						return normalize(a + (s / subdivisions)*(b - a) + (t / subdivisions)*(c - a));
+					};
+					float3 tris[2][3] = {
+						{ vertex(i, j), vertex(i + 1, j), vertex(i, j + 1) },
+						{ vertex(i + 1, j), vertex(i + 1, j + 1), vertex(i, j + 1) } };
+					for (int k = 0; k < (i + j + 1 < subdivisions ? 2 : 1); ++k)
+						for (int v = 0; v < 3; ++v)
+						{
+							mesh.vertices.push_back(tris[k][v]);
+							mesh.normals.push_back(tris[k][v]);
+						}
+				}
+		}
+		return mesh;
+	}
+
+	// Square of side 2 in the z = 0 plane
+	SSSPoissonSets::Mesh square_mesh()
+	{
+		SSSPoissonSets::Mesh mesh;
+		const float3 corners[6] = { make_float3(-1, -1, 0), make_float3(1, -1, 0), make_float3(1, 1, 0), make_float3(-1, -1, 0), make_float3(1, 1, 0), make_float3(-1, 1, 0) };
+		for (int v = 0; v < 6; ++v)
+		{
+			mesh.vertices.push_back(corners[v]);
+			mesh.normals.push_back(make_float3(0.0f, 0.0f, 1.0f));
+		}
+		return mesh;
+	}
+
+	// Area integral over the mesh of exp(-|x - c|/scale), the shape of a
+	// diffusion profile, by the midpoint rule on subdivided triangles
+	double profile_integral(const SSSPoissonSets::Mesh& mesh, const float3& c, float scale)
+	{
+		const unsigned int m = 32;
+		double sum = 0.0;
+		for (int t = 0; t < mesh.vertices.size(); t += 3)
+		{
+			const float3* v = &mesh.vertices[t];
+			float3 e1 = (v[1] - v[0]) / (float)m, e2 = (v[2] - v[0]) / (float)m;
+			double cell_area = 0.5*length(cross(e1, e2));
+			for (unsigned int i = 0; i < m; ++i)
+				for (unsigned int j = 0; i + j < m; ++j)
+				{
+					float3 p = v[0] + (i + 1.0f / 3.0f)*e1 + (j + 1.0f / 3.0f)*e2;
+					sum += cell_area*exp(-length(p - c) / scale);
+					if (i + j + 1 < m)
+					{
+						float3 q = v[0] + (i + 2.0f / 3.0f)*e1 + (j + 2.0f / 3.0f)*e2;
+						sum += cell_area*exp(-length(q - c) / scale);
+					}
+				}
+		}
+		return sum;
+	}
+}
+
+const unsigned int SSSPoissonSets::CANDIDATES = 5;
+
+SSSPoissonSets::SSSPoissonSets(optix::Context c)
+{
+	context = c;
+	generation = 0;
+	refreshing = false;
+	refresh_set = 0;
+	position_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, 0);
+	normal_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, 0);
+	context["sss_poisson_positions"]->set(position_buffer);
+	context["sss_poisson_normals"]->set(normal_buffer);
+}
+
+SSSPoissonSets::~SSSPoissonSets()
+{
+	refresh.waitForFinished();
+	position_buffer->destroy();
+	normal_buffer->destroy();
+}
+
+void SSSPoissonSets::generate(const Mesh& mesh, unsigned int count, unsigned int seed, float3* positions, float3* normals)
+{
+	if (count == 0 || mesh.vertices.size() < 3)
+		return;
+	std::vector<double> cdf;
+	float area = mesh_area(mesh, cdf);
+	unsigned int n = CANDIDATES*count;
+	std::vector<float3> candidates(n), candidate_normals(n);
+	sample_mesh(mesh, n, seed, candidates.data(), candidate_normals.data());
+	std::vector<unsigned int> order(n);
+	std::iota(order.begin(), order.end(), 0u);
+	eliminate(candidates.data(), order.data(), n, count, area);
+	// progressive order: the first half of the points is eliminated to a
+	// quarter, and so on
+	for (unsigned int kept = count; kept > 1; kept /= 2)
+		eliminate(candidates.data(), order.data(), kept, kept / 2, area);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		positions[i] = candidates[order[i]];
+		normals[i] = candidate_normals[order[i]];
+	}
+}
+
+void SSSPoissonSets::generateUniform(const Mesh& mesh, unsigned int count, unsigned int seed, float3* positions, float3* normals)
+{
+	if (count == 0 || mesh.vertices.size() < 3)
+		return;
+	sample_mesh(mesh, count, seed, positions, normals);
+}
+
+SSSPoissonSets::Mesh SSSPoissonSets::readMesh(optix::GeometryInstance gi, const TranslucentObjectRecord& record)
+{
+	optix::Geometry g = gi->getGeometry();
+	optix::Buffer vertex_buffer = g["vertex_buffer"]->getBuffer();
+	optix::Buffer normal_buffer = g["normal_buffer"]->getBuffer();
+	optix::Buffer vindex_buffer = g["vindex_buffer"]->getBuffer();
+	optix::Buffer nindex_buffer = g["nindex_buffer"]->getBuffer();
+	RTsize triangles, normal_count;
+	vindex_buffer->getSize(triangles);
+	normal_buffer->getSize(normal_count);
+	const float3* vertices = static_cast<const float3*>(vertex_buffer->map(0, RT_BUFFER_MAP_READ));
+	const int3* vindices = static_cast<const int3*>(vindex_buffer->map(0, RT_BUFFER_MAP_READ));
+	const float3* vertex_normals = normal_count > 0 ? static_cast<const float3*>(normal_buffer->map(0, RT_BUFFER_MAP_READ)) : nullptr;
+	const int3* nindices = normal_count > 0 ? static_cast<const int3*>(nindex_buffer->map(0, RT_BUFFER_MAP_READ)) : nullptr;
+	Mesh mesh;
+	mesh.vertices.reserve(3 * triangles);
+	mesh.normals.reserve(3 * triangles);
+	for (RTsize i = 0; i < triangles; ++i)
+	{
+		float3 v[3];
+		for (int k = 0; k < 3; ++k)
+			v[k] = make_float3(record.transform_matrix * make_float4(vertices[getByIndex(vindices[i], k)], 1.0f));
+		// the face normal where the mesh has none, as in sample_camera
+		float3 face_normal = normalize(cross(v[1] - v[0], v[2] - v[0]));
+		for (int k = 0; k < 3; ++k)
+		{
+			mesh.vertices.push_back(v[k]);
+			if (vertex_normals)
+				mesh.normals.push_back(normalize(make_float3(record.normal_matrix * make_float4(vertex_normals[getByIndex(nindices[i], k)], 0.0f))));
+			else
+				mesh.normals.push_back(face_normal);
+		}
+	}
+	if (vertex_normals)
+	{
+		nindex_buffer->unmap();
+		normal_buffer->unmap();
+	}
+	vindex_buffer->unmap();
+	vertex_buffer->unmap();
+	return mesh;
+}
+
+QVector<bool> SSSPoissonSets::update(const QVector<optix::GeometryInstance>& objects, QVector<TranslucentObjectRecord>& records, const QVector<unsigned int>& counts)
+{
+	bool enabled = context["sss_poisson_samples"]->getUint() != 0;
+	QVector<bool> changed(records.size(), false);
+	QVector<unsigned int> capacities_new(records.size(), 0);
+	QVector<int> regenerate;
+	for (int k = 0; k < records.size(); ++k)
+	{
+		bool kept = k < generated.size() && capacities[k] >= counts[k] && capacities[k] > 0
+			&& memcmp(&generated[k], &records[k], offsetof(TranslucentObjectRecord, properties)) == 0;
+		if (!enabled || counts[k] == 0)
+			changed[k] = k < capacities.size() && capacities[k] > 0;
+		else if (kept)
+			capacities_new[k] = capacities[k];
+		else
+		{
+			// the sets grow in powers of two, so that a budget that moves
+			// with the camera rarely outgrows them
+			capacities_new[k] = next_power_of_two(counts[k]);
+			regenerate.append(k);
+			changed[k] = true;
+		}
+	}
+	if (changed.contains(true) || records.size() != generated.size())
+	{
+		// a set generated in the background for the previous layout is
+		// dropped
+		if (refreshing)
+		{
+			refresh.waitForFinished();
+			refreshing = false;
+		}
+		QVector<unsigned int> offsets_new(records.size(), 0);
+		unsigned int size = 0;
+		for (int k = 0; k < records.size(); ++k)
+		{
+			offsets_new[k] = size;
+			size += SSS_POISSON_SETS*capacities_new[k];
+		}
+		QVector<float3> positions_new(size), normals_new(size);
+		for (int k = 0; k < records.size(); ++k)
+		{
+			if (capacities_new[k] > 0 && !regenerate.contains(k))
+			{
+				std::copy(positions.begin() + offsets[k], positions.begin() + offsets[k] + SSS_POISSON_SETS*capacities[k], positions_new.begin() + offsets_new[k]);
+				std::copy(normals.begin() + offsets[k], normals.begin() + offsets[k] + SSS_POISSON_SETS*capacities[k], normals_new.begin() + offsets_new[k]);
+			}
+		}
+
+		// the meshes are read here and kept for the sets that replace these,
+		// the sets of all the objects are generated in parallel
+		meshes.resize(records.size());
+		for (int k = 0; k < records.size(); ++k)
+			if (capacities_new[k] == 0)
+				meshes[k] = Mesh();
+		QVector<unsigned int> jobs;
+		for (int k : regenerate)
+		{
+			meshes[k] = readMesh(objects[k], records[k]);
+			for (unsigned int s = 0; s < SSS_POISSON_SETS; ++s)
+				jobs.append(k*SSS_POISSON_SETS + s);
+		}
+		++generation;
+		unsigned int current = generation;
+		QtConcurrent::blockingMap(jobs, [&](unsigned int job) {
+			unsigned int k = job / SSS_POISSON_SETS, s = job % SSS_POISSON_SETS;
+			unsigned int first = offsets_new[k] + s*capacities_new[k];
+			generate(meshes[k], capacities_new[k], set_seed(current, k, s), positions_new.data() + first, normals_new.data() + first);
+		});
+
+		positions = positions_new;
+		normals = normals_new;
+		offsets = offsets_new;
+		capacities = capacities_new;
+		generated = records;
+		upload();
+	}
+
+	// one set of every object at a time is replaced by a new one, generated
+	// in the background while the frames are rendered, so that the sets keep
+	// changing and the frames average over ever more of them instead of
+	// SSS_POISSON_SETS sets alone. The samples keep their points, so no
+	// object needs to be relit.
+	if (refreshing && refresh.isFinished())
+	{
+		for (unsigned int k : refresh_objects)
+		{
+			unsigned int first = offsets[k] + refresh_set*capacities[k];
+			std::copy(refresh_positions.begin() + refresh_offsets[k], refresh_positions.begin() + refresh_offsets[k] + capacities[k], positions.begin() + first);
+			std::copy(refresh_normals.begin() + refresh_offsets[k], refresh_normals.begin() + refresh_offsets[k] + capacities[k], normals.begin() + first);
+		}
+		upload();
+		refreshing = false;
+	}
+	if (!refreshing)
+	{
+		refresh_objects.clear();
+		refresh_offsets.fill(0, records.size());
+		unsigned int size = 0;
+		for (int k = 0; k < records.size(); ++k)
+		{
+			if (capacities[k] == 0)
+				continue;
+			refresh_objects.append(k);
+			refresh_offsets[k] = size;
+			size += capacities[k];
+		}
+		if (!refresh_objects.isEmpty())
+		{
+			refresh_set = (refresh_set + 1) % SSS_POISSON_SETS;
+			refresh_positions.resize(size);
+			refresh_normals.resize(size);
+			// the workers only read the members, which do not change until
+			// the sets are finished
+			float3* positions_out = refresh_positions.data();
+			float3* normals_out = refresh_normals.data();
+			++generation;
+			unsigned int current = generation, set = refresh_set;
+			refresh = QtConcurrent::map(refresh_objects, [=](unsigned int k) {
+				generate(meshes.at(k), capacities.at(k), set_seed(current, k, set), positions_out + refresh_offsets.at(k), normals_out + refresh_offsets.at(k));
+			});
+			refreshing = true;
+		}
+	}
+
+	// a different set for every frame, chosen at random so that the points
+	// of consecutive frames are not correlated
+	for (int k = 0; k < records.size(); ++k)
+	{
+		records[k].poisson_offset = offsets[k];
+		records[k].poisson_capacity = capacities[k];
+		records[k].poisson_set = set_generator() % SSS_POISSON_SETS;
+	}
+	return changed;
+}
+
+void SSSPoissonSets::upload()
+{
+	position_buffer->setSize(positions.size());
+	normal_buffer->setSize(normals.size());
+	if (positions.size() > 0)
+	{
+		memcpy(position_buffer->map(), positions.data(), positions.size() * sizeof(float3));
+		position_buffer->unmap();
+		memcpy(normal_buffer->map(), normals.data(), normals.size() * sizeof(float3));
+		normal_buffer->unmap();
+	}
+}
+
+bool SSSPoissonSets::report(std::ostream& out)
+{
+	const unsigned int sets = 64;
+	const unsigned int centers = 16;
+	const float scales[] = { 0.05f, 0.2f, 0.8f };
+	const unsigned int counts[] = { 256, 1024 };
+	// on closed meshes; the points are denser near the border of an open
+	// mesh, where the candidates have fewer neighbours, so its bias is only
+	// reported
+	const double bias_tolerance = 0.02;
+	struct { const char* name; Mesh mesh; bool closed; } meshes[] = { { "sphere", sphere_mesh(32), true }, { "square", square_mesh(), false } };
+
+	bool valid = true;
+	out << "Poisson-disk sets (sample elimination, " << CANDIDATES << " candidates per point) against uniform random points, "
+		<< sets << " sets, " << centers << " profile centers" << std::endl;
+	out << "  mesh points: milliseconds per set, mean nearest neighbour distance / r_max (uniform, poisson), then per profile scale: rms error (uniform, poisson), bias (poisson), rms error of the average of "
+		<< SSS_POISSON_SETS << " and " << sets << " sets (poisson)" << std::endl;
+	for (const auto& m : meshes)
+	{
+		std::vector<double> cdf;
+		float area = mesh_area(m.mesh, cdf);
+		std::vector<float3> center_points(centers), center_normals(centers);
+		sample_mesh(m.mesh, centers, 7, center_points.data(), center_normals.data());
+		for (unsigned int count : counts)
+		{
+			std::vector<float3> uniform(sets*count), poisson(sets*count), normals(sets*count);
+			QVector<unsigned int> indices;
+			for (unsigned int s = 0; s < sets; ++s)
+				indices.append(s);
+			auto start = std::chrono::high_resolution_clock::now();
+			QtConcurrent::blockingMap(indices, [&](unsigned int s) {
+				generate(m.mesh, count, set_seed(2, count, s), poisson.data() + s*count, normals.data() + s*count);
+			});
+			std::chrono::duration<double, std::milli> set_time = std::chrono::high_resolution_clock::now() - start;
+			for (unsigned int s = 0; s < sets; ++s)
+				generateUniform(m.mesh, count, set_seed(1, count, s), uniform.data() + s*count, normals.data() + s*count);
+
+			// spacing, brute force
+			auto mean_spacing = [&](const std::vector<float3>& points) {
+				double sum = 0.0;
+				for (unsigned int s = 0; s < sets; ++s)
+					for (unsigned int i = 0; i < count; ++i)
+					{
+						float nearest = 1e30f;
+						for (unsigned int j = 0; j < count; ++j)
+							if (j != i)
+								nearest = std::min(nearest, length(points[s*count + i] - points[s*count + j]));
+						sum += nearest;
+					}
+				return sum / (sets*count*max_radius(area, count));
+			};
+			out << "  " << m.name << " " << count << ": " << set_time.count() / sets << ", " << mean_spacing(uniform) << " " << mean_spacing(poisson);
+
+			for (float scale : scales)
+			{
+				double error[2] = { 0.0, 0.0 };
+				double bias = 0.0;
+				// error of the average over SSS_POISSON_SETS sets and over all
+				// the sets, as frames average over the sets
+				double average_error[2] = { 0.0, 0.0 };
+				for (unsigned int c = 0; c < centers; ++c)
+				{
+					double reference = profile_integral(m.mesh, center_points[c], scale);
+					double average[2] = { 0.0, 0.0 };
+					for (unsigned int s = 0; s < sets; ++s)
+					{
+						double estimate[2] = { 0.0, 0.0 };
+						for (unsigned int i = 0; i < count; ++i)
+						{
+							estimate[0] += exp(-length(uniform[s*count + i] - center_points[c]) / scale);
+							estimate[1] += exp(-length(poisson[s*count + i] - center_points[c]) / scale);
+						}
+						for (int e = 0; e < 2; ++e)
+						{
+							double relative = estimate[e] * area / count / reference - 1.0;
+							error[e] += relative*relative;
+						}
+						bias += estimate[1] * area / count / reference - 1.0;
+						if (s < SSS_POISSON_SETS)
+							average[0] += estimate[1] * area / count / reference / SSS_POISSON_SETS;
+						average[1] += estimate[1] * area / count / reference / sets;
+					}
+					for (int a = 0; a < 2; ++a)
+						average_error[a] += (average[a] - 1.0)*(average[a] - 1.0);
+				}
+				error[0] = sqrt(error[0] / (centers*sets));
+				error[1] = sqrt(error[1] / (centers*sets));
+				bias /= centers*sets;
+				average_error[0] = sqrt(average_error[0] / centers);
+				average_error[1] = sqrt(average_error[1] / centers);
+				bool scale_valid = error[1] < error[0] && (!m.closed || (fabs(bias) < bias_tolerance && average_error[1] < average_error[0]));
+				valid = valid && scale_valid;
+				out << ", " << scale << ": " << error[0] << " " << error[1] << " " << bias << " " << average_error[0] << " " << average_error[1] << (scale_valid ? "" : " FAILED");
+			}
+			out << std::endl;
+		}
+	}
+	return valid;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <optixu/optixpp_namespace.h>
+#include <optixu/optixu_math_namespace.h>
+#include <QVector>
+#include <QFuture>
+#include <ostream>
+#include <random>
+#include "structs.h"
+
+// Host side generator of Poisson-disk sets of points on the translucent
+// objects, by sample elimination [Yuksel 2015], which sample_camera lights in
+// place of independent uniform points. Every object gets SSS_POISSON_SETS
+// sets in world space. The points of a set are in progressive order, so
+// that its first n points are a Poisson-disk set for any n, and the
+// allocation of the samples under a budget can change without generating
+// the sets again. The sets are generated in parallel, with a spatial hash
+// of the candidates, when the mesh or the transform of an object changes or
+// its samples outgrow the sets. In between, one set of every object at a
+// time is replaced by a new one generated in the background, so that the
+// frames average over ever more sets and the estimate keeps converging.
+class SSSPoissonSets
+{
+public:
+	// world space triangles, three vertices and three normals per triangle
+	struct Mesh
+	{
+		QVector<optix::float3> vertices;
+		QVector<optix::float3> normals;
+	};
+
+	// uniform candidates per point of a set
+	static const unsigned int CANDIDATES;
+
+	explicit SSSPoissonSets(optix::Context c);
+	~SSSPoissonSets();
+
+	// Sets the Poisson-disk sets of the records, for counts[k] samples per
+	// frame of object k, generating the sets that are missing, and picks the
+	// set of every record for the next sample pass. Without
+	// sss_poisson_samples the records get no sets. Returns the objects whose
+	// sets changed, whose samples must all be relit.
+	QVector<bool> update(const QVector<optix::GeometryInstance>& objects, QVector<TranslucentObjectRecord>& records, const QVector<unsigned int>& counts);
+
+	// Fills positions and normals with count points of the mesh, in
+	// progressive order
+	static void generate(const Mesh& mesh, unsigned int count, unsigned int seed, optix::float3* positions, optix::float3* normals);
+	// count uniform random points of the mesh, for comparison
+	static void generateUniform(const Mesh& mesh, unsigned int count, unsigned int seed, optix::float3* positions, optix::float3* normals);
+
+	// Compares the Poisson-disk sets with uniform random points at equal
+	// sample counts on a sphere and a square: distance to the nearest
+	// neighbour and error of the area integral of diffusion-like profiles,
+	// also averaged over SSS_POISSON_SETS sets and over more sets, as the
+	// frames average over the sets that replace each other.
+	// Returns false if the sets are not better, are biased or stop
+	// converging over more sets.
+	static bool report(std::ostream& out);
+
+protected:
+	static Mesh readMesh(optix::GeometryInstance gi, const TranslucentObjectRecord& record);
+	void upload();
+
+	optix::Context context;
+	optix::Buffer position_buffer;
+	optix::Buffer normal_buffer;
+	QVector<optix::float3> positions;
+	QVector<optix::float3> normals;
+	// record of the mesh and transform the sets of every object were
+	// generated for, its mesh, its first point and the points per set
+	QVector<TranslucentObjectRecord> generated;
+	QVector<Mesh> meshes;
+	QVector<unsigned int> offsets;
+	QVector<unsigned int> capacities;
+	unsigned int generation;
+	std::mt19937 set_generator;
+	// the next set refresh_set of the objects refresh_objects, generated in
+	// the background, of capacities[k] points from refresh_offsets[k]
+	QFuture<void> refresh;
+	bool refreshing;
+	unsigned int refresh_set;
+	QVector<unsigned int> refresh_objects;
+	QVector<unsigned int> refresh_offsets;
+	QVector<optix::float3> refresh_positions;
+	QVector<optix::float3> refresh_normals;
+};
@@ -3,6 +3,7 @@
 //#include "../optprops/apple_juice.h"
 #include "fresnel.h"
 #include "ScatteringMaterial.h"
+#include "dipoles/dipole_profile.h"
 
 using namespace std;
 using namespace optix;
@@ -158,6 +159,8 @@ void ScatteringMaterial::computeCoefficients(float3 ior_outside)
   properties.global_coeff = make_float3(1.0f)/(4.0f*properties.C_phi_inv) * 1.0f/(4.0f*M_PIf*M_PIf);
   properties.one_over_three_ext = make_float3(1.0)/(3.0f*properties.extinction);
   properties.mean_transport = (properties.transport.x + properties.transport.y + properties.transport.z)/3.0f;
+  // the materials uploading the tabulated profile fill it, see TranslucentMaterial
+  compute_dipole_profile(properties, 0);
   //properties.min_transport = fminf(fminf(properties.transport.x, properties.transport.y), properties.transport.z);
 }
 
@@ -3,6 +3,9 @@
 #include "OptixScene.h"
 #include "sampleConfig.h"
 #include "Fresnel.h"
+#include "dipoles/dipole_profile.h"
+#include "dipoles/bssrdf_sampling.h"
+#include "PBDTable.h"
 
 TranslucentMaterial::TranslucentMaterial(optix::Context c)
 {
@@ -11,8 +14,9 @@ TranslucentMaterial::TranslucentMaterial(optix::Context c)
 	shader_name = QString::fromStdString("subsurface_scattering_shader.cu");
 	//concentration = 1.0f;
 	scale = 100.0f;
-	getDefaultMaterial(Apple);
 	dipole_model = STANDARD_DIPOLE;
+	getDefaultMaterial(Apple);
+	sss_estimator = SSS_POINT_CLOUD;
 	initTable();
 	initPrograms();
 	loadParameters("scattering_properties");
@@ -23,6 +27,7 @@ TranslucentMaterial::TranslucentMaterial(optix::Context c, const QJsonObject &js
 	context = c;
 	type = TRANSLUCENT_SHADER;
 	dipole_model = STANDARD_DIPOLE;
+	sss_estimator = SSS_POINT_CLOUD;
 	current = Custom;
 	shader_name = QString::fromStdString("subsurface_scattering_shader.cu");
 	loadFromJSON(json);
@@ -80,9 +85,19 @@ void TranslucentMaterial::initTable()
 	QComboBox *modelComboBox = new QComboBox();
 	modelComboBox->addItem("standard dipole");
 	modelComboBox->addItem("directional dipole");
+	modelComboBox->addItem("photon beam diffusion");
 	modelComboBox->setCurrentIndex(dipole_model);
 	QObject::connect(modelComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateDipoleModel(int)));
 	table->setCellWidget(dipole_row, 1, modelComboBox);
+
+	table->setItem(estimator_row, 0, new QTableWidgetItem(tr("estimator")));
+	table->item(estimator_row, 0)->setFlags(table->item(estimator_row, 0)->flags() &  ~Qt::ItemIsEditable);
+	QComboBox *estimatorComboBox = new QComboBox();
+	estimatorComboBox->addItem("point cloud");
+	estimatorComboBox->addItem("probe rays");
+	estimatorComboBox->setCurrentIndex(sss_estimator);
+	QObject::connect(estimatorComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateSSSEstimator(int)));
+	table->setCellWidget(estimator_row, 1, estimatorComboBox);
 	
 
 	QObject::connect(table, &QTableWidget::cellChanged, this, &TranslucentMaterial::tableUpdate);
@@ -97,7 +112,13 @@ void TranslucentMaterial::initPrograms()
 	mtl->setClosestHitProgram(radiance_ray_type, closest_hit);
 	mtl->setAnyHitProgram(shadow_ray_type, any_hit);
 	mtl->setClosestHitProgram(depth_ray_type, depth_closest_hit);
-
+	mtl->setClosestHitProgram(probe_ray_type, context->createProgramFromPTXFile(OptixScene::ptxPath(SAMPLE_NAME, shader_name.toStdString()), "probe_closest_hit"));
+	dipole_profile_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, DIPOLE_PROFILE_SIZE);
+	mtl["dipole_profile_buffer"]->set(dipole_profile_buffer);
+	dipole_cdf_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, DIPOLE_PROFILE_SIZE);
+	mtl["dipole_cdf_buffer"]->set(dipole_cdf_buffer);
+	pbd_table_buffer = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, PBD_TABLE_RADII*PBD_TABLE_ANGLES);
+	mtl["pbd_table_buffer"]->set(pbd_table_buffer);
 };
 
 void TranslucentMaterial::tableUpdate(int row, int column)
@@ -146,6 +167,9 @@ void TranslucentMaterial::loadFromJSON(const QJsonObject &json)
 	if (parameters.contains("dipole_model") && parameters["dipole_model"].isDouble()) {
 		dipole_model = static_cast<DipoleModel>(parameters["dipole_model"].toInt());
 	}
+	if (parameters.contains("sss_estimator") && parameters["sss_estimator"].isDouble()) {
+		sss_estimator = static_cast<SSSEstimator>(parameters["sss_estimator"].toInt());
+	}
 	if (parameters.contains("material_type") && parameters["material_type"].isDouble()) {
 		current = static_cast<DefaultScatteringMaterial>(parameters["material_type"].toInt());
 	}
@@ -165,6 +189,7 @@ void TranslucentMaterial::writeJSON(QJsonObject &json) const
 	parameters["scattering"] = QJsonArray{ scattering.x, scattering.y, scattering.z };
 	parameters["meancosine"] = QJsonArray{ meancosine.x, meancosine.y, meancosine.z };
 	parameters["dipole_model"] = dipole_model;
+	parameters["sss_estimator"] = sss_estimator;
 	parameters["material_type"] = current;
 	json["mtl_parameters"] = parameters;
 }
@@ -297,7 +322,17 @@ void TranslucentMaterial::getDefaultMaterial(DefaultScatteringMaterial material)
 void TranslucentMaterial::loadParameters(const char* name)
 {
 	mtl[name]->setUserData(sizeof(ScatteringMaterialProperties), &properties);
+	memcpy(dipole_profile_buffer->map(), dipole_profile.data(), DIPOLE_PROFILE_SIZE * sizeof(optix::float3));
+	dipole_profile_buffer->unmap();
+	memcpy(dipole_cdf_buffer->map(), dipole_cdf.data(), DIPOLE_PROFILE_SIZE * sizeof(optix::float3));
+	dipole_cdf_buffer->unmap();
+	if (dipole_model == PHOTON_BEAM_DIFFUSION)
+	{
+		memcpy(pbd_table_buffer->map(), pbd_table.data(), PBD_TABLE_RADII*PBD_TABLE_ANGLES * sizeof(optix::float3));
+		pbd_table_buffer->unmap();
+	}
 	mtl["dipole_model"]->setUint(dipole_model);
+	mtl["sss_estimator"]->setUint(sss_estimator);
 }
 
 void TranslucentMaterial::computeCoefficients(optix::float3 ior_outside)
@@ -328,6 +363,15 @@ void TranslucentMaterial::computeCoefficients(optix::float3 ior_outside)
 	properties.global_coeff = optix::make_float3(1.0f) / (4.0f*properties.C_phi_inv) * 1.0f / (4.0f*M_PIf*M_PIf);
 	properties.one_over_three_ext = optix::make_float3(1.0) / (3.0f*properties.extinction);
 	properties.mean_transport = (properties.transport.x + properties.transport.y + properties.transport.z) / 3.0f;
+	dipole_profile.resize(DIPOLE_PROFILE_SIZE);
+	compute_dipole_profile(properties, dipole_profile.data());
+	dipole_cdf.resize(DIPOLE_PROFILE_SIZE);
+	compute_dipole_cdf(properties, dipole_profile.data(), dipole_cdf.data());
+	if (dipole_model == PHOTON_BEAM_DIFFUSION)
+	{
+		pbd_table.resize(PBD_TABLE_RADII*PBD_TABLE_ANGLES);
+		PBDTable::build(properties, pbd_table.data());
+	}
 	//properties.min_transport = fminf(fminf(properties.transport.x, properties.transport.y), properties.transport.z);
 }
 
@@ -431,6 +475,14 @@ void TranslucentMaterial::updateDefaultMaterial(int material)
 void TranslucentMaterial::updateDipoleModel(int model)
 {
 	dipole_model = static_cast<DipoleModel>(model);
+	computeCoefficients();
 	loadParameters("scattering_properties");
 	table->cellChanged(6, 1);
+}
+
+void TranslucentMaterial::updateSSSEstimator(int estimator)
+{
+	sss_estimator = static_cast<SSSEstimator>(estimator);
+	loadParameters("scattering_properties");
+	table->cellChanged(7, 1);
 }
\ No newline at end of file
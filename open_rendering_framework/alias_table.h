@@ -0,0 +1,102 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Alias table for O(1) sampling of a discrete distribution
+// [Walker 1977, with the construction of Vose 1991].
+// Every entry stores the pmf of itself and of its alias, so that
+// a sample and its probability are found with a single fetch.
+struct AliasEntry
+{
+	float prob;
+	unsigned int alias;
+	float pmf;
+	float alias_pmf;
+};
+
+// Samples an index in [0, size) from the table entries starting at offset.
+// The returned index is relative to offset. On return u holds a fresh
+// uniform number recovered from the unused part of the sample, so that it
+// can be reused for a nested choice.
+template<typename Table>
+static __host__ __device__ __inline__ unsigned int sample_alias(Table& table, unsigned int offset, unsigned int size, float& u, float& pmf)
+{
+	float scaled = u*size;
+	unsigned int idx = optix::min((unsigned int)scaled, size - 1);
+	float v = fminf(scaled - idx, 0.99999994f);
+	AliasEntry entry = table[offset + idx];
+	if (v < entry.prob)
+	{
+		pmf = entry.pmf;
+		u = v / entry.prob;
+		return idx;
+	}
+	pmf = entry.alias_pmf;
+	u = (v - entry.prob) / (1.0f - entry.prob);
+	return entry.alias;
+}
+
+#ifndef __CUDACC__
+#include <vector>
+
+// Builds the table for the given (unnormalized) weights into table[0..n).
+// If all weights are zero the distribution falls back to uniform.
+// Returns the sum of the weights.
+static inline float build_alias_table(const float* weights, unsigned int n, AliasEntry* table)
+{
+	if (n == 0)
+		return 0.0f;
+
+	double sum = 0.0;
+	for (unsigned int i = 0; i < n; i++)
+		sum += weights[i] > 0.0f ? weights[i] : 0.0f;
+
+	std::vector<double> scaled(n);
+	std::vector<unsigned int> small, large;
+	small.reserve(n);
+	large.reserve(n);
+	for (unsigned int i = 0; i < n; i++)
+	{
+		double w = sum > 0.0 ? (weights[i] > 0.0f ? weights[i] : 0.0f) / sum : 1.0 / n;
+		table[i].pmf = static_cast<float>(w);
+		scaled[i] = w*n;
+		if (scaled[i] < 1.0)
+			small.push_back(i);
+		else
+			large.push_back(i);
+	}
+
+	while (!small.empty() && !large.empty())
+	{
+		unsigned int s = small.back();
+		small.pop_back();
+		unsigned int l = large.back();
+		table[s].prob = static_cast<float>(scaled[s]);
+		table[s].alias = l;
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if (scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// what remains is one up to round-off
+	for (unsigned int i : large)
+	{
+		table[i].prob = 1.0f;
+		table[i].alias = i;
+	}
+	for (unsigned int i : small)
+	{
+		table[i].prob = 1.0f;
+		table[i].alias = i;
+	}
+	for (unsigned int i = 0; i < n; i++)
+		table[i].alias_pmf = table[table[i].alias].pmf;
+
+	return static_cast<float>(sum);
+}
+#endif
+
+#endif // ALIAS_TABLE_H
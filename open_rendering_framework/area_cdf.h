@@ -0,0 +1,49 @@
+#ifndef AREA_CDF_H
+#define AREA_CDF_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Triangle area CDFs of the translucent objects, from which sample_camera
+// picks triangles proportionally to their world space area, so that the
+// points are uniform on the surface with pdf 1/area.
+
+// Index of the first triangle whose CDF value exceeds xi, among the
+// triangles whose CDF starts at offset
+template<typename CDF>
+static __host__ __device__ __inline__ unsigned int sample_area_cdf(CDF& cdf, unsigned int offset, unsigned int triangles, float xi)
+{
+	unsigned int low = 0;
+	unsigned int high = triangles - 1;
+	while (low < high)
+	{
+		unsigned int middle = (low + high) >> 1;
+		if (cdf[offset + middle] <= xi)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+#ifndef __CUDACC__
+// Turns the triangle areas in cdf[0..triangles) into their normalized CDF.
+// Degenerate meshes fall back to picking triangles uniformly.
+// Returns the total area.
+static inline double build_area_cdf(float* cdf, unsigned int triangles)
+{
+	double total_area = 0.0;
+	for (unsigned int i = 0; i < triangles; i++)
+	{
+		total_area += cdf[i];
+		cdf[i] = static_cast<float>(total_area);
+	}
+	for (unsigned int i = 0; i < triangles; i++)
+		cdf[i] = total_area > 0.0 ? static_cast<float>(cdf[i] / total_area) : static_cast<float>(i + 1) / triangles;
+	// guard against round-off so that every u < 1 finds a triangle
+	if (triangles > 0)
+		cdf[triangles - 1] = 1.0f;
+	return total_area;
+}
+#endif
+
+#endif // AREA_CDF_H
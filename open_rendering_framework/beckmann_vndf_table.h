@@ -0,0 +1,43 @@
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+
+// Inverse CDF of the visible slope.x of the unit roughness Beckmann distribution,
+// stored as erf(slope.x) per incident angle, built by BeckmannVNDFTable
+#define BECKMANN_VNDF_TABLE_SAMPLES 256
+#define BECKMANN_VNDF_TABLE_ANGLES 64
+// |slope| < 3.8; 0.99999 dropped the steepest 2e-4 of the visible normals
+#define BECKMANN_VNDF_TABLE_ERF_MAX 0.9999999f
+
+// random number of column i, denser where the slopes end (z close to 1)
+static __host__ __device__ __inline__ float beckmann_vndf_table_sample(unsigned int i)
+{
+	float x = 1.0f - i / (float)(BECKMANN_VNDF_TABLE_SAMPLES - 1);
+	return 1.0f - x*x;
+}
+
+static __host__ __device__ __inline__ float beckmann_vndf_table_angle(unsigned int j)
+{
+	return M_PIf * j / (float)(BECKMANN_VNDF_TABLE_ANGLES - 1);
+}
+
+// Normalized texture coordinate of x in [0, 1] for n entries, the first and
+// last entries are at 0 and 1
+static __host__ __device__ __inline__ float beckmann_vndf_table_texel(float x, unsigned int n)
+{
+	return (optix::clamp(x, 0.0f, 1.0f)*(n - 1) + 0.5f) / n;
+}
+
+#ifdef __CUDACC__
+#include <optix.h>
+rtTextureSampler<float, 2> beckmann_vndf_texture;
+
+// Visible slope of the Beckmann distribution with unit roughness, as
+// beckmann_sample_P22_11
+static __device__ __inline__ optix::float2 beckmann_sample_P22_11_table(const float theta_i, const float z1, const float z2)
+{
+	float erf_x = tex2D(beckmann_vndf_texture, beckmann_vndf_table_texel(1.0f - sqrtf(fmaxf(0.0f, 1.0f - z1)), BECKMANN_VNDF_TABLE_SAMPLES),
+		beckmann_vndf_table_texel(theta_i * M_1_PIf, BECKMANN_VNDF_TABLE_ANGLES));
+	float erf_y = optix::clamp(2.0f * z2 - 1.0f, -BECKMANN_VNDF_TABLE_ERF_MAX, BECKMANN_VNDF_TABLE_ERF_MAX);
+	return optix::make_float2(erfinvf(erf_x), erfinvf(erf_y));
+}
+#endif
@@ -0,0 +1,63 @@
+#ifndef CHI_SQUARE_H
+#define CHI_SQUARE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Chi-square goodness of fit tests of the host reports of the samplers.
+
+// Upper tail probability of the chi-square distribution with dof degrees
+// of freedom, with the approximation of Wilson and Hilferty
+static inline double chi_square_p_value(double statistic, unsigned int dof)
+{
+	double k = dof;
+	double z = (pow(statistic / k, 1.0 / 3.0) - (1.0 - 2.0 / (9.0*k))) / sqrt(2.0 / (9.0*k));
+	return 0.5*erfc(z / sqrt(2.0));
+}
+
+// Chi-square statistic of a histogram against its expected counts. Bins
+// expecting fewer than min_expected counts are pooled into one, as the test
+// needs. Returns the statistic and its degrees of freedom.
+static inline double chi_square(const std::vector<unsigned int>& observed, const std::vector<double>& expected, double min_expected, unsigned int& dof)
+{
+	double statistic = 0.0;
+	double pooled_observed = 0.0, pooled_expected = 0.0;
+	unsigned int bins = 0;
+	for (size_t i = 0; i < observed.size(); ++i)
+	{
+		if (expected[i] < min_expected)
+		{
+			pooled_observed += observed[i];
+			pooled_expected += expected[i];
+			continue;
+		}
+		double d = observed[i] - expected[i];
+		statistic += d*d / expected[i];
+		++bins;
+	}
+	if (pooled_expected > 0.0)
+	{
+		double d = pooled_observed - pooled_expected;
+		statistic += d*d / pooled_expected;
+		++bins;
+	}
+	else if (pooled_observed > 0.0)
+	{
+		// counts where none are expected
+		statistic = HUGE_VAL;
+	}
+	dof = std::max(bins, 2u) - 1;
+	return statistic;
+}
+
+// p-value of a histogram against its expected counts, pooling the bins
+// expecting fewer than five counts
+static inline double chi_square_test(const std::vector<unsigned int>& observed, const std::vector<double>& expected)
+{
+	unsigned int dof;
+	double statistic = chi_square(observed, expected, 5.0, dof);
+	return chi_square_p_value(statistic, dof);
+}
+
+#endif // CHI_SQUARE_H
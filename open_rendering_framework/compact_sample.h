@@ -0,0 +1,189 @@
+#ifndef COMPACT_SAMPLE_H
+#define COMPACT_SAMPLE_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "structs.h"
+
+// 32 byte encoding of a PositionSample (80 bytes) read by the subsurface
+// shaders when they sum all the samples of an object.
+//  pos:          21/21/22 bit fixed point position in the bounding box of
+//                the object
+//  normal, dir:  octahedral unit vectors, 16 bits per coordinate
+//  transmitted:  octahedral unit vector, paired with weight, the shared
+//                exponent transmittance (9 bit mantissas, 5 bit exponent)
+//  L:            shared exponent radiance, 18 bit mantissas and 8 bit
+//                exponent, so that it has the range of a float
+struct CompactPositionSample
+{
+	optix::uint2 pos;
+	unsigned int normal;
+	unsigned int dir;
+	unsigned int transmitted;
+	unsigned int weight;
+	optix::uint2 L;
+};
+
+#define COMPACT_SAMPLE_POS_BITS_X 21
+#define COMPACT_SAMPLE_POS_BITS_Y 21
+#define COMPACT_SAMPLE_POS_BITS_Z 22
+
+static __host__ __device__ __inline__ unsigned int compact_sample_quantize(float t, int bits)
+{
+	float max_value = (float)((1u << bits) - 1u);
+	return (unsigned int)(optix::clamp(t, 0.0f, 1.0f) * max_value + 0.5f);
+}
+
+static __host__ __device__ __inline__ float compact_sample_dequantize(unsigned int q, int bits)
+{
+	return (float)q / (float)((1u << bits) - 1u);
+}
+
+static __host__ __device__ __inline__ optix::uint2 encode_sample_position(const optix::float3& pos, const optix::float3& bbox_min, const optix::float3& bbox_max)
+{
+	optix::float3 extent = bbox_max - bbox_min;
+	optix::float3 t = optix::make_float3(
+		extent.x > 0.0f ? (pos.x - bbox_min.x) / extent.x : 0.0f,
+		extent.y > 0.0f ? (pos.y - bbox_min.y) / extent.y : 0.0f,
+		extent.z > 0.0f ? (pos.z - bbox_min.z) / extent.z : 0.0f);
+	unsigned int x = compact_sample_quantize(t.x, COMPACT_SAMPLE_POS_BITS_X);
+	unsigned int y = compact_sample_quantize(t.y, COMPACT_SAMPLE_POS_BITS_Y);
+	unsigned int z = compact_sample_quantize(t.z, COMPACT_SAMPLE_POS_BITS_Z);
+	// y straddles the two words
+	return optix::make_uint2(x | (y << COMPACT_SAMPLE_POS_BITS_X), (y >> (32 - COMPACT_SAMPLE_POS_BITS_X)) | (z << (COMPACT_SAMPLE_POS_BITS_X + COMPACT_SAMPLE_POS_BITS_Y - 32)));
+}
+
+static __host__ __device__ __inline__ optix::float3 decode_sample_position(const optix::uint2& p, const optix::float3& bbox_min, const optix::float3& bbox_max)
+{
+	unsigned int x = p.x & ((1u << COMPACT_SAMPLE_POS_BITS_X) - 1u);
+	unsigned int y = ((p.x >> COMPACT_SAMPLE_POS_BITS_X) | (p.y << (32 - COMPACT_SAMPLE_POS_BITS_X))) & ((1u << COMPACT_SAMPLE_POS_BITS_Y) - 1u);
+	unsigned int z = p.y >> (COMPACT_SAMPLE_POS_BITS_X + COMPACT_SAMPLE_POS_BITS_Y - 32);
+	optix::float3 t = optix::make_float3(
+		compact_sample_dequantize(x, COMPACT_SAMPLE_POS_BITS_X),
+		compact_sample_dequantize(y, COMPACT_SAMPLE_POS_BITS_Y),
+		compact_sample_dequantize(z, COMPACT_SAMPLE_POS_BITS_Z));
+	return bbox_min + t * (bbox_max - bbox_min);
+}
+
+// Octahedral mapping of unit vectors [Cigolle et al. 2014]
+static __host__ __device__ __inline__ unsigned int encode_octahedral(const optix::float3& v)
+{
+	float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (l1 <= 0.0f)
+		return 0x80008000u;
+	float x = v.x / l1;
+	float y = v.y / l1;
+	if (v.z < 0.0f)
+	{
+		float folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = folded_x;
+		y = folded_y;
+	}
+	return compact_sample_quantize(0.5f * x + 0.5f, 16) | (compact_sample_quantize(0.5f * y + 0.5f, 16) << 16);
+}
+
+static __host__ __device__ __inline__ optix::float3 decode_octahedral(unsigned int e)
+{
+	float x = 2.0f * compact_sample_dequantize(e & 0xffffu, 16) - 1.0f;
+	float y = 2.0f * compact_sample_dequantize(e >> 16, 16) - 1.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float unfolded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfolded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfolded_x;
+		y = unfolded_y;
+	}
+	optix::float3 v = optix::make_float3(x, y, z);
+	float len = optix::length(v);
+	return len > 0.0f ? v / len : optix::make_float3(0.0f);
+}
+
+// Shared exponent RGB: the mantissas are scaled so that the largest one
+// fits in mantissa_bits, and negative values are clamped to zero. Returns
+// the three mantissas and the biased exponent.
+static __host__ __device__ __inline__ optix::uint4 encode_shared_exponent(const optix::float3& c, int mantissa_bits, int exponent_bits, int bias)
+{
+	float r = fmaxf(c.x, 0.0f);
+	float g = fmaxf(c.y, 0.0f);
+	float b = fmaxf(c.z, 0.0f);
+	float max_c = fmaxf(r, fmaxf(g, b));
+	if (!(max_c > 0.0f))
+		return optix::make_uint4(0u);
+	int max_exponent = (1 << exponent_bits) - 1 - bias;
+	int max_mantissa = (1 << mantissa_bits) - 1;
+	int e;
+	frexpf(max_c, &e);
+	e = e < -bias ? -bias : (e > max_exponent ? max_exponent : e);
+	if ((int)(ldexpf(max_c, mantissa_bits - e) + 0.5f) > max_mantissa && e < max_exponent)
+	{
+		// rounding carried into the next power of two
+		++e;
+	}
+	// ldexpf per channel, as 2^(mantissa_bits - e) may not be representable
+	int mr = (int)(ldexpf(r, mantissa_bits - e) + 0.5f);
+	int mg = (int)(ldexpf(g, mantissa_bits - e) + 0.5f);
+	int mb = (int)(ldexpf(b, mantissa_bits - e) + 0.5f);
+	mr = mr > max_mantissa ? max_mantissa : mr;
+	mg = mg > max_mantissa ? max_mantissa : mg;
+	mb = mb > max_mantissa ? max_mantissa : mb;
+	return optix::make_uint4((unsigned int)mr, (unsigned int)mg, (unsigned int)mb, (unsigned int)(e + bias));
+}
+
+static __host__ __device__ __inline__ optix::float3 decode_shared_exponent(const optix::uint4& m, int mantissa_bits, int bias)
+{
+	int e = (int)m.w - bias - mantissa_bits;
+	return optix::make_float3(ldexpf((float)m.x, e), ldexpf((float)m.y, e), ldexpf((float)m.z, e));
+}
+
+// 9 bit mantissas and 5 bit exponent in 32 bits
+static __host__ __device__ __inline__ unsigned int encode_rgb9e5(const optix::float3& c)
+{
+	optix::uint4 m = encode_shared_exponent(c, 9, 5, 15);
+	return m.x | (m.y << 9) | (m.z << 18) | (m.w << 27);
+}
+
+static __host__ __device__ __inline__ optix::float3 decode_rgb9e5(unsigned int e)
+{
+	return decode_shared_exponent(optix::make_uint4(e & 0x1ffu, (e >> 9) & 0x1ffu, (e >> 18) & 0x1ffu, e >> 27), 9, 15);
+}
+
+// 18 bit mantissas and 8 bit exponent in 64 bits
+static __host__ __device__ __inline__ optix::uint2 encode_rgb18e8(const optix::float3& c)
+{
+	optix::uint4 m = encode_shared_exponent(c, 18, 8, 127);
+	return optix::make_uint2(m.x | (m.y << 18), (m.y >> 14) | (m.z << 4) | (m.w << 24));
+}
+
+static __host__ __device__ __inline__ optix::float3 decode_rgb18e8(const optix::uint2& e)
+{
+	unsigned int mask = (1u << 18) - 1u;
+	return decode_shared_exponent(optix::make_uint4(e.x & mask, ((e.x >> 18) | (e.y << 14)) & mask, (e.y >> 4) & mask, e.y >> 24), 18, 127);
+}
+
+static __host__ __device__ __inline__ CompactPositionSample encode_position_sample(const PositionSample& sample, const optix::float3& bbox_min, const optix::float3& bbox_max)
+{
+	CompactPositionSample c;
+	c.pos = encode_sample_position(sample.pos, bbox_min, bbox_max);
+	c.normal = encode_octahedral(sample.normal);
+	c.dir = encode_octahedral(sample.dir);
+	c.transmitted = encode_octahedral(sample.transmitted);
+	c.weight = encode_rgb9e5(sample.weight);
+	c.L = encode_rgb18e8(sample.L);
+	return c;
+}
+
+static __host__ __device__ __inline__ PositionSample decode_position_sample(const CompactPositionSample& c, const optix::float3& bbox_min, const optix::float3& bbox_max)
+{
+	PositionSample sample;
+	sample.pos = decode_sample_position(c.pos, bbox_min, bbox_max);
+	sample.normal = decode_octahedral(c.normal);
+	sample.dir = decode_octahedral(c.dir);
+	sample.transmitted = decode_octahedral(c.transmitted);
+	sample.weight = decode_rgb9e5(c.weight);
+	sample.L = decode_rgb18e8(c.L);
+	sample.padding = optix::make_float2(0.0f);
+	return sample;
+}
+
+#endif // COMPACT_SAMPLE_H
@@ -0,0 +1,171 @@
+#ifndef BSSRDF_SAMPLING_H
+#define BSSRDF_SAMPLING_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "../structs.h"
+#include "../solid_angle_sampling.h"
+#include "dipole_profile.h"
+
+// Importance sampling of the entry points of a BSSRDF by probe rays
+// [King et al., "BSSRDF importance sampling", SIGGRAPH talks 2013; pbrt-v3, 15.4].
+// A radius is drawn from the radial profile of the standard dipole in one
+// color channel, and a probe segment through the sphere of the effective
+// radius around the exit point, parallel to the normal or to one of the
+// tangents, is traced against the object. The pdf of a point found by the
+// probe combines all the three axes and the three channels, so the surfaces
+// almost parallel to the sampled axis are still sampled well.
+//
+// The radii are drawn from the tabulated profile (dipole_profile.h): a
+// segment of the table with probability proportional to its power, then a
+// point uniform in the area of its annulus. The pdf is piecewise constant
+// in area, so it is exact for the inversion below.
+
+#define BSSRDF_PROBE_MAX_HITS 8
+
+// Probability of probing along the normal and along either tangent
+#define BSSRDF_NORMAL_AXIS_PROB 0.5f
+#define BSSRDF_TANGENT_AXIS_PROB 0.25f
+
+// Probe segment from origin to origin + length*direction
+struct BSSRDFProbe
+{
+	optix::float3 origin;
+	optix::float3 direction;
+	float length;
+};
+
+static __host__ __device__ __inline__ float bssrdf_table_radius(unsigned int i, const ScatteringMaterialProperties& properties)
+{
+	return dipole_profile_distance(i / (float)(DIPOLE_PROFILE_SIZE - 1), properties);
+}
+
+// Radius in the given channel for xi in [0, 1), cdf is the table of
+// compute_dipole_cdf
+template<typename Cdf>
+static __host__ __device__ __inline__ float bssrdf_sample_radius(float xi, int channel, const ScatteringMaterialProperties& properties, Cdf& cdf)
+{
+	// last entry not above xi
+	unsigned int low = 0;
+	unsigned int high = DIPOLE_PROFILE_SIZE - 2;
+	while (low < high)
+	{
+		unsigned int middle = (low + high + 1) >> 1;
+		if (optix::getByIndex(cdf[middle], channel) <= xi)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	float c0 = optix::getByIndex(cdf[low], channel);
+	float c1 = optix::getByIndex(cdf[low + 1], channel);
+	float t = c1 > c0 ? optix::clamp((xi - c0) / (c1 - c0), 0.0f, 1.0f) : 0.0f;
+	float r0 = bssrdf_table_radius(low, properties);
+	float r1 = bssrdf_table_radius(low + 1, properties);
+	return sqrtf(r0*r0 + t*(r1*r1 - r0*r0));
+}
+
+// Area pdf of bssrdf_sample_radius at the distance r from the exit point,
+// in the plane of the probe disk
+template<typename Cdf>
+static __host__ __device__ __inline__ float bssrdf_radius_pdf(float r, int channel, const ScatteringMaterialProperties& properties, Cdf& cdf)
+{
+	if (r >= properties.dipole_effective_radius)
+		return 0.0f;
+	float x = dipole_profile_coordinate(r, properties) * (DIPOLE_PROFILE_SIZE - 1);
+	unsigned int i = optix::min((unsigned int)x, (unsigned int)DIPOLE_PROFILE_SIZE - 2);
+	float r0 = bssrdf_table_radius(i, properties);
+	float r1 = bssrdf_table_radius(i + 1, properties);
+	float power = optix::getByIndex(cdf[i + 1], channel) - optix::getByIndex(cdf[i], channel);
+	return power / (M_PIf*(r1*r1 - r0*r0));
+}
+
+// Picks the axis with xi_axis, the channel with xi_channel and the point on
+// the probe disk with xi_radius and xi_phi. Returns false if the radius
+// leaves no segment inside the effective radius.
+template<typename Cdf>
+static __host__ __device__ __inline__ bool bssrdf_sample_probe(const optix::float3& xo, const optix::float3& no, float xi_axis, float xi_channel, float xi_radius, float xi_phi,
+	const ScatteringMaterialProperties& properties, Cdf& cdf, BSSRDFProbe& probe)
+{
+	optix::float3 s, t;
+	solid_angle_onb(no, s, t);
+	optix::float3 vx, vy, vz;
+	if (xi_axis < BSSRDF_NORMAL_AXIS_PROB)
+	{
+		vx = s; vy = t; vz = no;
+	}
+	else if (xi_axis < BSSRDF_NORMAL_AXIS_PROB + BSSRDF_TANGENT_AXIS_PROB)
+	{
+		vx = t; vy = no; vz = s;
+	}
+	else
+	{
+		vx = no; vy = s; vz = t;
+	}
+	int channel = optix::min((int)(xi_channel*3.0f), 2);
+	float r = bssrdf_sample_radius(xi_radius, channel, properties, cdf);
+	float r_max = properties.dipole_effective_radius;
+	float half_length = sqrtf(fmaxf(r_max*r_max - r*r, 0.0f));
+	float phi = 2.0f*M_PIf*xi_phi;
+	probe.origin = xo + r*(cosf(phi)*vx + sinf(phi)*vy) - half_length*vz;
+	probe.direction = vz;
+	probe.length = 2.0f*half_length;
+	return half_length > 0.0f;
+}
+
+// Area pdf of the point xi with normal ni on the surface, summed over the
+// axes and the channels that could have found it. As in pbrt, the caller
+// divides by the number of points on the traced probe, which stands for the
+// count on the probes along the other axes; the two agree on convex objects.
+template<typename Cdf>
+static __host__ __device__ __inline__ float bssrdf_probe_pdf(const optix::float3& xo, const optix::float3& no, const optix::float3& xi, const optix::float3& ni,
+	const ScatteringMaterialProperties& properties, Cdf& cdf)
+{
+	optix::float3 s, t;
+	solid_angle_onb(no, s, t);
+	optix::float3 d = xi - xo;
+	optix::float3 d_local = optix::make_float3(optix::dot(s, d), optix::dot(t, d), optix::dot(no, d));
+	optix::float3 n_local = optix::make_float3(optix::dot(s, ni), optix::dot(t, ni), optix::dot(no, ni));
+	// distance from xo in the planes orthogonal to s, t and no
+	float r_proj[3] = {
+		sqrtf(d_local.y*d_local.y + d_local.z*d_local.z),
+		sqrtf(d_local.z*d_local.z + d_local.x*d_local.x),
+		sqrtf(d_local.x*d_local.x + d_local.y*d_local.y) };
+	const float axis_prob[3] = { BSSRDF_TANGENT_AXIS_PROB, BSSRDF_TANGENT_AXIS_PROB, BSSRDF_NORMAL_AXIS_PROB };
+	float pdf = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float cos_axis = fabsf(optix::getByIndex(n_local, axis));
+		for (int channel = 0; channel < 3; ++channel)
+			pdf += bssrdf_radius_pdf(r_proj[axis], channel, properties, cdf) * cos_axis * axis_prob[axis] / 3.0f;
+	}
+	return pdf;
+}
+
+#ifndef __CUDACC__
+// Fills the DIPOLE_PROFILE_SIZE entries of cdf with the normalized power of
+// the profile, R(r)*2*pi*r, integrated up to the radii of the table
+static inline void compute_dipole_cdf(const ScatteringMaterialProperties& properties, const optix::float3* profile, optix::float3* cdf)
+{
+	cdf[0] = optix::make_float3(0.0f);
+	for (unsigned int i = 0; i + 1 < DIPOLE_PROFILE_SIZE; ++i)
+	{
+		float r0 = bssrdf_table_radius(i, properties);
+		float r1 = bssrdf_table_radius(i + 1, properties);
+		cdf[i + 1] = cdf[i] + 0.5f*(profile[i] + profile[i + 1])*M_PIf*(r1*r1 - r0*r0);
+	}
+	optix::float3 total = cdf[DIPOLE_PROFILE_SIZE - 1];
+	for (unsigned int i = 0; i < DIPOLE_PROFILE_SIZE; ++i)
+	{
+		// uniform in area if a channel has no power
+		float r = bssrdf_table_radius(i, properties);
+		for (int c = 0; c < 3; ++c)
+		{
+			float value = optix::getByIndex(total, c) > 0.0f ? optix::getByIndex(cdf[i], c) / optix::getByIndex(total, c)
+				: r*r / (properties.dipole_effective_radius*properties.dipole_effective_radius);
+			optix::setByIndex(cdf[i], c, value);
+		}
+	}
+	cdf[DIPOLE_PROFILE_SIZE - 1] = optix::make_float3(1.0f);
+}
+#endif
+
+#endif // BSSRDF_SAMPLING_H
@@ -0,0 +1,84 @@
+#ifndef DIPOLE_PROFILE_H
+#define DIPOLE_PROFILE_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "../structs.h"
+#include "standard_dipole.h"
+
+// Radial profile of the standard dipole tabulated per material, so that
+// shading a sample costs a lookup instead of two square roots and two
+// exponentials per channel. The table spans [0, effective radius] with
+// entries uniform in log(1 + r/r_min), which packs them where the profile
+// is steep. The effective radius leaves out DIPOLE_PROFILE_EPSILON of the
+// power scattered over the plane, the integral of the profile times 2*pi*r,
+// in every channel; samples further away are skipped.
+#define DIPOLE_PROFILE_SIZE 256
+#define DIPOLE_PROFILE_EPSILON 1.0e-3f
+
+static __host__ __device__ __inline__ float dipole_profile_coordinate(float dist, const ScatteringMaterialProperties& properties)
+{
+	return logf(1.0f + dist / properties.dipole_profile_r_min) * properties.dipole_profile_inv_log_range;
+}
+
+static __host__ __device__ __inline__ float dipole_profile_distance(float u, const ScatteringMaterialProperties& properties)
+{
+	return properties.dipole_profile_r_min * (expf(u / properties.dipole_profile_inv_log_range) - 1.0f);
+}
+
+// Linear interpolation of the profile, zero beyond the effective radius
+template<typename Profile>
+static __host__ __device__ __inline__ optix::float3 dipole_bssrdf_tabulated(float dist, const ScatteringMaterialProperties& properties, Profile& profile)
+{
+	if (dist >= properties.dipole_effective_radius)
+		return optix::make_float3(0.0f);
+	float x = dipole_profile_coordinate(dist, properties) * (DIPOLE_PROFILE_SIZE - 1);
+	unsigned int i = optix::min((unsigned int)x, (unsigned int)DIPOLE_PROFILE_SIZE - 2);
+	float t = x - i;
+	return (1.0f - t)*profile[i] + t*profile[i + 1];
+}
+
+#ifndef __CUDACC__
+// Sets the effective radius and the parameters of the table and, if
+// profile is not null, fills its DIPOLE_PROFILE_SIZE entries
+static inline void compute_dipole_profile(ScatteringMaterialProperties& properties, optix::float3* profile)
+{
+	// Search the effective radius on a geometric grid up to many mean free
+	// paths, which bounds it when a channel does not absorb
+	const int search_steps = 4096;
+	float min_depth = fminf(fminf(properties.three_D.x, properties.three_D.y), properties.three_D.z);
+	float max_depth = fmaxf(fmaxf(properties.three_D.x, properties.three_D.y), properties.three_D.z);
+	float r_min = 0.01f * min_depth;
+	float r_max = 1000.0f * max_depth;
+	float growth = powf(r_max / r_min, 1.0f / search_steps);
+	double total[3] = { 0.0, 0.0, 0.0 };
+	optix::float3 radius = optix::make_float3(r_min);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		double power[3] = { 0.0, 0.0, 0.0 };
+		float r = r_min;
+		for (int i = 0; i <= search_steps; ++i, r *= growth)
+		{
+			optix::float3 ring = dipole_bssrdf(r, properties) * (r*r*(growth - 1.0f));
+			for (int c = 0; c < 3; ++c)
+			{
+				if (pass == 1 && power[c] < (1.0 - DIPOLE_PROFILE_EPSILON)*total[c])
+					optix::setByIndex(radius, c, r*growth);
+				power[c] += optix::getByIndex(ring, c);
+			}
+		}
+		for (int c = 0; c < 3; ++c)
+			total[c] = power[c];
+	}
+	properties.dipole_effective_radius = fmaxf(fmaxf(radius.x, radius.y), radius.z);
+	// the entries are close to uniform up to the depth of the real source,
+	// where the profile is flat, and geometric beyond it
+	properties.dipole_profile_r_min = min_depth;
+	properties.dipole_profile_inv_log_range = 1.0f / logf(1.0f + properties.dipole_effective_radius / properties.dipole_profile_r_min);
+	if (!profile)
+		return;
+	for (unsigned int i = 0; i < DIPOLE_PROFILE_SIZE; ++i)
+		profile[i] = dipole_bssrdf(dipole_profile_distance(i / (float)(DIPOLE_PROFILE_SIZE - 1), properties), properties);
+}
+#endif
+
+#endif // DIPOLE_PROFILE_H
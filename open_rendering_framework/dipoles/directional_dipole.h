@@ -2,10 +2,11 @@
 
 #include <optix_world.h>
 #include "../structs.h"
+#include "../helpers.h"
 
 using namespace optix;
   
-__device__ float3 S_infinite(const float3& _r_sqr, const float x_dot_w12, const float no_dot_w12, const float x_dot_no,
+static __host__ __device__ __inline__ float3 S_infinite(const float3& _r_sqr, const float x_dot_w12, const float no_dot_w12, const float x_dot_no,
                              const ScatteringMaterialProperties& properties)
 {
   float3 _r = sqrt(_r_sqr);
@@ -19,7 +20,7 @@ __device__ float3 S_infinite(const float3& _r_sqr, const float x_dot_w12, const
   return _S;
 }
 
-__device__ float3 S_infinite_vec(const float3& _r_sqr, const float3& x_dot_w12, const float no_dot_w12, const float3& x_dot_no,
+static __host__ __device__ __inline__ float3 S_infinite_vec(const float3& _r_sqr, const float3& x_dot_w12, const float no_dot_w12, const float3& x_dot_no,
                                  const ScatteringMaterialProperties& properties)
 {
   float3 _r = sqrt(_r_sqr);
@@ -34,7 +35,7 @@ __device__ float3 S_infinite_vec(const float3& _r_sqr, const float3& x_dot_w12,
 }
 
 
-__device__ float3 dirpole_bssrdf(const float3& _xi, const float3& _ni, const float3& _w12,
+static __host__ __device__ __inline__ float3 dirpole_bssrdf(const float3& _xi, const float3& _ni, const float3& _w12,
                                  const float3& _xo, const float3& _no,
                                  const ScatteringMaterialProperties& properties)
 {
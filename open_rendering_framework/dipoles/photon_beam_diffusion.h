@@ -2,7 +2,7 @@
 
 #include <optix_world.h>
 #include "../structs.h"
-#include "../sampler.h"
+#include "dipole_profile.h"
 
 using namespace optix;
 
@@ -10,7 +10,7 @@ const float M_4PIf = 4.0f*M_PIf;
 const float M_1_4PIPIf = M_1_PIf/M_4PIf;
 
 // Better dipole if z_r = 1/sigma_t_p and d_r = sqrt(z_r^2 + r^2)
-__device__ float bdp_bssrdf(float d_r, float z_r, const float4& props, const float4& C)
+static __host__ __device__ __inline__ float bdp_bssrdf(float d_r, float z_r, const float4& props, const float4& C)
 {
   float sigma_s = props.x, sigma_a = props.y, g = props.z, A = C.w;
   float sigma_t = sigma_s + sigma_a;
@@ -20,17 +20,17 @@ __device__ float bdp_bssrdf(float d_r, float z_r, const float4& props, const flo
   float D = 1.0f/(3.0f*sigma_t_p);
   D *= (sigma_a*2.0f + sigma_s_p)/sigma_t_p; // Grosjean's approximation
   float d_e = 4.0f*A*D;
-  float sigma_tr = sqrt(sigma_a/D);
+  float sigma_tr = sqrtf(sigma_a/D);
   float d_v_sqr = d_r*d_r + 2.0f*z_r*d_e + d_e*d_e; // d_r^2 - z_r^2 + z_v^2
-  float d_v = sqrt(d_v_sqr);
+  float d_v = sqrtf(d_v_sqr);
   float tr_r = sigma_tr*d_r;
-  float d_r_c = max(d_r, 0.25f/sigma_t);
+  float d_r_c = fmaxf(d_r, 0.25f/sigma_t);
   float S_r = z_r*(1.0f + tr_r)/(d_r_c*d_r_c*d_r_c);
-  float T_r = exp(-tr_r);
+  float T_r = expf(-tr_r);
   S_r *= T_r;
   float tr_v = sigma_tr*d_v;
   float S_v = (z_r + d_e)*(1.0f + tr_v)/(d_v_sqr*d_v);
-  float T_v = exp(-tr_v);
+  float T_v = expf(-tr_v);
   S_v *= T_v;
   float phi = (T_r/d_r - T_v/d_v)/D;
   float S_d = phi*C.y + (S_r + S_v)*C.z;
@@ -38,7 +38,7 @@ __device__ float bdp_bssrdf(float d_r, float z_r, const float4& props, const flo
 }
 
 // Henyey-Greenstein phase function
-__device__ float phase_HG(float cos_theta, float g)
+static __host__ __device__ __inline__ float phase_HG(float cos_theta, float g)
 {
   float g_sqr = g*g;
   float demon = 1.0f + g_sqr - g*(2.0f*cos_theta);
@@ -46,17 +46,27 @@ __device__ float phase_HG(float cos_theta, float g)
 }
 
 // Photon Beam Diffusion [Habel et al. 2013]
-__device__ float single_diffuse(float t, float d_r, const float3& w_i, const float3& w_o, const float3& n_o, const float4& props) {
+static __host__ __device__ __inline__ float single_diffuse(float t, float d_r, const float3& w_i, const float3& w_o, const float3& n_o, const float4& props) {
   float sigma_s = props.x, sigma_a = props.y, g = props.z;
   float sigma_t = sigma_s + sigma_a;
-  float cos_theta_o = abs(dot(w_o, n_o));
-  float d_r_c = max(d_r, 0.25f/sigma_t);
-  return sigma_s*phase_HG(dot(w_i, w_o), g)*exp(-sigma_t*(t + d_r))*cos_theta_o/(d_r_c*d_r_c);
+  float cos_theta_o = fabsf(dot(w_o, n_o));
+  float d_r_c = fmaxf(d_r, 0.25f/sigma_t);
+  return sigma_s*phase_HG(dot(w_i, w_o), g)*expf(-sigma_t*(t + d_r))*cos_theta_o/(d_r_c*d_r_c);
 }
-__device__ float3 pbd_bssrdf(const float3& x, const float3& ni, const float3& wi, const float3& no, const float4& props, const float4& C)
+
+// Points of the beam of the direct evaluation, for each of the two
+// sampling strategies
+#define PBD_BEAM_SAMPLES 5
+
+// Multiple (x) and single (y) scattering of one channel along the beam
+// refracted in the direction wt, for the exit point at x from the entry
+// point. props is (sigma_s, sigma_a, g, eta) and C is (1/(4 C_phi(1/eta)),
+// C_phi(eta), C_E(eta), A) of the channel.
+static __host__ __device__ __inline__ float2 pbd_beam(const float3& x, const float3& wt, float cos_theta_t, const float3& no, const float4& props, const float4& C,
+  unsigned int samples = PBD_BEAM_SAMPLES)
 {
-  const float N = 5.0f;
-  float sigma_s = props.x, sigma_a = props.y, g = props.z, eta = props.w;
+  const float N = (float)samples;
+  float sigma_s = props.x, sigma_a = props.y, g = props.z;
   float sigma_t = sigma_s + sigma_a;
   float sigma_s_p = sigma_s*(1.0f - g);
   float sigma_t_p = sigma_s_p + sigma_a;
@@ -65,82 +75,117 @@ __device__ float3 pbd_bssrdf(const float3& x, const float3& ni, const float3& wi
   float b = 1.1f/sigma_t_p;
   float w_exp = clamp((length(x) - a)/(b - a), 0.0f, 1.0f);
   float w_equ = 1.0f - w_exp;
-  float3 wt = refract(-wi, ni, 1.0f/eta);
-  float cos_theta_t = dot(wt, -ni);
   float Delta = dot(x, wt);                           // signed distance to perpendicular
   float h = length(Delta*wt - x);                     // perpendicular distance to beam
-  float theta_a = atan2(-Delta, h);
+  float theta_a = atan2f(-Delta, h);
   float theta_b = 0.5f*M_PIf;
-  float3 S_d = make_float3(0.0f);
-  for(unsigned int k = 0; k < 3; ++k)
+  float2 S = make_float2(0.0f);
+  for(float i = 1.0f; i <= N; ++i)
   {
-    for(float i = 1.0f; i <= N; ++i)
-    {
-      float xi_i = (i - 0.5)/N;                         // deterministic regular sequence
-      float t_i = -log(1.0f - xi_i)/sigma_t_p;          // exponential sampling
-      float3 xr_xo = x - t_i*wt;
-      float d_r = length(xr_xo);
-      float z_r = t_i*cos_theta_t;
-      float kappa = 1.0f - exp(-2.0f*sigma_t*(d_r + t_i));
-      float pdf_exp = sigma_t_p*exp(-sigma_t_p*t_i);
-      float Q = alpha_p*pdf_exp;
-      float f = bdp_bssrdf(d_r, z_r, props, C)*Q*kappa;
-      float s = single_diffuse(t_i, d_r, wt, normalize(xr_xo), no, props)*M_1_PIf*C.x*kappa;
-      float theta_j = lerp(theta_a, theta_b, xi_i);
-      float t_j = h*tan(theta_j) + Delta;               // equiangular sampling
-      float t_equ = t_i - Delta;                        // multiple importance sampling
-      float pdf_equ = h/((theta_b - theta_a)*(h*h + t_equ*t_equ));
-      *(&S_d.x + k) += (f + s)*w_exp/(w_exp*pdf_exp + w_equ*pdf_equ);  // exponential sampling part (t_i)
-      t_equ = t_j - Delta;
-      pdf_equ = h/((theta_b - theta_a)*(h*h + t_equ*t_equ));
-      pdf_exp = sigma_t_p*exp(-sigma_t_p*t_j);
-      xr_xo = x - t_j*wt;
-      d_r = length(xr_xo);
-      z_r = t_j*cos_theta_t;
-      kappa = 1.0f - exp(-2.0f*sigma_t*(d_r + t_j));
-      Q = alpha_p*pdf_exp;
-      f = bdp_bssrdf(d_r, z_r, props, C)*Q*kappa;
-      s = single_diffuse(t_j, d_r, wt, normalize(xr_xo), no, props)*M_1_PIf*C.x*kappa;
-      *(&S_d.x + k) += (f + s)*w_equ/(w_exp*pdf_exp + w_equ*pdf_equ);  // equiangular sampling part (t_j)
-    }
+    float xi_i = (i - 0.5f)/N;                        // deterministic regular sequence
+    float t_i = -logf(1.0f - xi_i)/sigma_t_p;         // exponential sampling
+    float3 xr_xo = x - t_i*wt;
+    float d_r = length(xr_xo);
+    float z_r = t_i*cos_theta_t;
+    float kappa = 1.0f - expf(-2.0f*sigma_t*(d_r + t_i));
+    float pdf_exp = sigma_t_p*expf(-sigma_t_p*t_i);
+    float Q = alpha_p*pdf_exp;
+    float f = bdp_bssrdf(d_r, z_r, props, C)*Q*kappa;
+    float s = single_diffuse(t_i, d_r, wt, normalize(xr_xo), no, props)*M_1_PIf*C.x*kappa;
+    float theta_j = lerp(theta_a, theta_b, xi_i);
+    float t_j = h*tanf(theta_j) + Delta;              // equiangular sampling
+    float t_equ = t_i - Delta;                        // multiple importance sampling
+    float pdf_equ = h/((theta_b - theta_a)*(h*h + t_equ*t_equ));
+    float pdf_mis = w_exp*pdf_exp + w_equ*pdf_equ;  // zero where the pdfs underflow
+    if(pdf_mis > 0.0f)
+      S += make_float2(f, s)*w_exp/pdf_mis;         // exponential sampling part (t_i)
+    t_equ = t_j - Delta;
+    pdf_equ = h/((theta_b - theta_a)*(h*h + t_equ*t_equ));
+    pdf_exp = sigma_t_p*expf(-sigma_t_p*t_j);
+    xr_xo = x - t_j*wt;
+    d_r = length(xr_xo);
+    z_r = t_j*cos_theta_t;
+    kappa = 1.0f - expf(-2.0f*sigma_t*(d_r + t_j));
+    Q = alpha_p*pdf_exp;
+    f = bdp_bssrdf(d_r, z_r, props, C)*Q*kappa;
+    s = single_diffuse(t_j, d_r, wt, normalize(xr_xo), no, props)*M_1_PIf*C.x*kappa;
+    pdf_mis = w_exp*pdf_exp + w_equ*pdf_equ;
+    if(pdf_mis > 0.0f)
+      S += make_float2(f, s)*w_equ/pdf_mis;         // equiangular sampling part (t_j)
   }
-  return fmaxf(S_d, make_float3(0.0f))/N;
+  return S/N;
 }
 
-__device__ float3 bssrdf(const float3& _xi, const float3& _ni, const float3& _w12,
-  const float3& _xo, const float3& _no,
-  const ScatteringMaterialProperties& properties, uint& t)
+// Parameters of pbd_beam for one channel of a material
+static __host__ __device__ __inline__ void pbd_channel(const ScatteringMaterialProperties& properties, int k, float4& props, float4& C)
 {
-  float3 _x = _xo - _xi;
-  float3 _r_sqr = make_float3(dot(_x, _x));
+  props = make_float4(getByIndex(properties.scattering, k), getByIndex(properties.absorption, k), getByIndex(properties.meancosine, k), properties.relative_ior);
+  C = make_float4(0.25f/getByIndex(properties.C_phi_inv, k), getByIndex(properties.C_phi, k), getByIndex(properties.C_E, k), getByIndex(properties.A, k));
+}
 
-  // distance to the real source
-  float3 _dr_sqr = _r_sqr;
-  float dot_x_w12 = dot(_x, w12);
-  float3 cos_beta = -sqrt(make_float3(_r_sqr.x - dot_x_w12 * dot_x_w12)/(_r_sqr + properties.de_sqr));
-  float mu0 = -dot(_no, w12);
-  float edge = mu0 > 0.0f ? 1.0f : 0.0f;
-  float3 _D_prime = mu0 * properties.D * edge + properties.one_over_three_ext * (1.0f - edge);
-  _dr_sqr += _D_prime * (_D_prime - properties.two_de * cos_beta * edge);
+// wi points away from the surface, towards the light
+static __host__ __device__ __inline__ float3 pbd_bssrdf(const float3& x, const float3& ni, const float3& wi, const float3& no, const ScatteringMaterialProperties& properties)
+{
+  float recip_ior = 1.0f/properties.relative_ior;
+  float cos_theta_i = dot(wi, ni);
+  float cos_theta_t = sqrtf(fmaxf(1.0f - recip_ior*recip_ior*(1.0f - cos_theta_i*cos_theta_i), 0.0f));
+  float3 wt = recip_ior*(cos_theta_i*ni - wi) - ni*cos_theta_t;
+  float3 S_d;
+  for(int k = 0; k < 3; ++k)
+  {
+    float4 props, C;
+    pbd_channel(properties, k, props, C);
+    float2 S = pbd_beam(x, wt, cos_theta_t, no, props, C);
+    setByIndex(S_d, k, S.x + S.y);
+  }
+  return fmaxf(S_d, make_float3(0.0f));
+}
 
-  // direction of the virtual source
-  float3 _t = normalize(cross(_ni, _x));
-  float3 _nistar = _r_sqr.x < 1.0e-12f ? _ni : cross(normalize(_x), _t);
-  float3 _wv = w12 - (2.0f * dot(w12, _nistar)) * _nistar;
+// Multiple scattering of pbd_bssrdf tabulated per material (PBDTable) in
+// the distance from the entry point, uniformly in log(1 + r/r_min) up to
+// the effective radius of the dipole profile (dipole_profile.h), and in the
+// sine of the angle of the refracted beam with the inward normal, uniformly
+// up to 1/eta. r_min is PBD_TABLE_R_MIN mean free paths of the densest
+// channel, as the profile peaks within a fraction of a mean free path, and
+// the sine resolves the beams close to the normal, where the profile is
+// sharper than in the cosine. Every entry is the mean over the azimuth of
+// the beam around the normal, for a planar surface.
+#define PBD_TABLE_RADII 128
+#define PBD_TABLE_ANGLES 32
+#define PBD_TABLE_R_MIN 0.05f
 
-  // distance to the virtual source
-  float3 _xoxv_r = _x - properties.two_a_de.x * _nistar;
-  float3 _xoxv_g = _x - properties.two_a_de.y * _nistar;
-  float3 _xoxv_b = _x - properties.two_a_de.z * _nistar;
-  float3 _dv_sqr = make_float3(dot(_xoxv_r, _xoxv_r), dot(_xoxv_g, _xoxv_g), dot(_xoxv_b, _xoxv_b));
+static __host__ __device__ __inline__ float pbd_table_coordinate(float dist, const ScatteringMaterialProperties& properties)
+{
+  return logf(1.0f + dist/properties.pbd_table_r_min)*properties.pbd_table_inv_log_range;
+}
+
+static __host__ __device__ __inline__ float pbd_table_distance(unsigned int i, const ScatteringMaterialProperties& properties)
+{
+  return properties.pbd_table_r_min*(expf(i/(float)(PBD_TABLE_RADII - 1)/properties.pbd_table_inv_log_range) - 1.0f);
+}
 
-  // cosines of the virtual source
-  float3 _x_dot_wv = make_float3(dot(_xoxv_r, _wv), dot(_xoxv_g, _wv), dot(_xoxv_b, _wv));
-  float3 _x_dot_no = make_float3(dot(_xoxv_r, _no), dot(_xoxv_g, _no), dot(_xoxv_b, _no));
+static __host__ __device__ __inline__ float pbd_table_sine(unsigned int j, const ScatteringMaterialProperties& properties)
+{
+  return j/((PBD_TABLE_ANGLES - 1)*properties.relative_ior);
+}
 
-  // compute source contributions and return BSSRDF result
-  float3 _Sr = S_infinite(_dr_sqr, dot_x_w12, -mu0, dot(_x, _no), properties);
-  float3 _Sv = S_infinite_vec(_dv_sqr, _x_dot_wv, dot(_no, _wv), _x_dot_no, properties);
-  float3 _Sd = _Sr - _Sv;
-  return max(_Sd, make_float3(0.0f));
-}
\ No newline at end of file
+// Bilinear interpolation of the table, zero beyond the effective radius.
+// w12 is the refracted direction of the light and ni the normal at the
+// entry point.
+template<typename Table>
+static __host__ __device__ __inline__ float3 pbd_bssrdf_tabulated(float dist, const float3& w12, const float3& ni, const ScatteringMaterialProperties& properties, Table& table)
+{
+  if(dist >= properties.dipole_effective_radius)
+    return make_float3(0.0f);
+  float x = pbd_table_coordinate(dist, properties)*(PBD_TABLE_RADII - 1);
+  float cos_theta_t = clamp(-dot(w12, ni), 0.0f, 1.0f);
+  float y = fminf(sqrtf(1.0f - cos_theta_t*cos_theta_t)*properties.relative_ior, 1.0f)*(PBD_TABLE_ANGLES - 1);
+  unsigned int i = min((unsigned int)x, (unsigned int)PBD_TABLE_RADII - 2);
+  unsigned int j = min((unsigned int)y, (unsigned int)PBD_TABLE_ANGLES - 2);
+  float s = x - i;
+  float t = y - j;
+  unsigned int idx = i*PBD_TABLE_ANGLES + j;
+  float3 inner = lerp(table[idx], table[idx + 1], t);
+  float3 outer = lerp(table[idx + PBD_TABLE_ANGLES], table[idx + PBD_TABLE_ANGLES + 1], t);
+  return lerp(inner, outer, s);
+}
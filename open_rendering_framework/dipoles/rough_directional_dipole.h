@@ -8,7 +8,7 @@
 
 using namespace optix;
   
-__device__ float3 rough_dirpole_bssrdf(const float3& _xi, const float3& _ni, const float3& _w12,
+static __host__ __device__ __inline__ float3 rough_dirpole_bssrdf(const float3& _xi, const float3& _ni, const float3& _w12,
                                        const float3& _xo, const float3& _no,
                                        const ScatteringMaterialProperties& properties)
 {
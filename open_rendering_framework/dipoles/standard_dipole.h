@@ -5,7 +5,7 @@
 
 using namespace optix;
 
-__device__ float3 dipole_bssrdf(float dist, const ScatteringMaterialProperties& properties)
+static __host__ __device__ __inline__ float3 dipole_bssrdf(float dist, const ScatteringMaterialProperties& properties)
 {
   float3 real_source = properties.three_D*properties.three_D;
   float3 extrapolation = 4.0f*properties.A*properties.D;
@@ -0,0 +1,95 @@
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "structs.h"
+
+// Albedo tables of the single scattering microfacet BSDFs for the energy
+// compensation of ENERGY_COMPENSATION_MODEL [Kulla and Conty 2017], built by EnergyCompensation
+#define ENERGY_TABLE_COSINES 32
+#define ENERGY_TABLE_ROUGHNESSES 32
+#define ENERGY_TABLE_ETAS 16
+#define ENERGY_TABLE_ETA_MAX 3.0f
+
+static __host__ __device__ __inline__ float energy_table_cosine(unsigned int i)
+{
+	return i / (float)(ENERGY_TABLE_COSINES - 1);
+}
+
+static __host__ __device__ __inline__ float energy_table_roughness(unsigned int j)
+{
+	return j / (float)(ENERGY_TABLE_ROUGHNESSES - 1);
+}
+
+// uniform in sqrt((eta - 1)/(eta + 1)), as the albedo changes quickly close to eta = 1
+static __host__ __device__ __inline__ float energy_table_eta(unsigned int k)
+{
+	float x = k / (float)(ENERGY_TABLE_ETAS - 1);
+	x *= x*(ENERGY_TABLE_ETA_MAX - 1.0f) / (ENERGY_TABLE_ETA_MAX + 1.0f);
+	return (1.0f + x) / (1.0f - x);
+}
+
+// Normalized texture coordinate of x in [0, 1] for n entries, the first and
+// last entries are at 0 and 1
+static __host__ __device__ __inline__ float energy_table_texel(float x, unsigned int n)
+{
+	return (optix::clamp(x, 0.0f, 1.0f)*(n - 1) + 0.5f) / n;
+}
+
+// Third texture coordinate of the dielectric table, eta is n_t/n_i;
+// light leaving the denser medium is in the second half
+static __host__ __device__ __inline__ float energy_table_eta_texel(float eta)
+{
+	bool leaving = eta < 1.0f;
+	if (leaving)
+		eta = 1.0f / eta;
+	float x = sqrtf(optix::clamp((eta - 1.0f)*(ENERGY_TABLE_ETA_MAX + 1.0f) / ((eta + 1.0f)*(ENERGY_TABLE_ETA_MAX - 1.0f)), 0.0f, 1.0f));
+	return (x*(ENERGY_TABLE_ETAS - 1) + 0.5f + (leaving ? ENERGY_TABLE_ETAS : 0)) / (2*ENERGY_TABLE_ETAS);
+}
+
+// Multiple scattering lobe of a conductor without the cosine, from the white
+// albedos E_i, E_o, their average E_avg and the average Fresnel reflectance F_avg
+static __host__ __device__ __inline__ optix::float3 conductor_multiple_scattering(float E_i, float E_o, float E_avg, const optix::float3& F_avg)
+{
+	if (E_avg >= 1.0f)
+		return optix::make_float3(0.0f);
+	optix::float3 F_ms = F_avg*F_avg*E_avg / (1.0f - F_avg*(1.0f - E_avg));
+	return F_ms*(1.0f - E_i)*(1.0f - E_o)*M_1_PIf / (1.0f - E_avg);
+}
+
+#ifdef __CUDACC__
+#include <optix.h>
+rtTextureSampler<optix::float2, 2> conductor_albedo_texture;
+rtTextureSampler<optix::float2, 1> conductor_average_albedo_texture;
+rtTextureSampler<optix::float2, 3> dielectric_albedo_texture;
+
+// every entry is (Beckmann, GGX)
+static __device__ __inline__ float energy_table_entry(const optix::float2& entry, unsigned int normal_distribution)
+{
+	return normal_distribution == GGX_DISTRIBUTION ? entry.y : entry.x;
+}
+
+// alpha of the tables for anisotropic roughness
+static __device__ __inline__ float energy_table_alpha(float a_x, float a_y)
+{
+	return sqrtf(a_x*a_y);
+}
+
+static __device__ __inline__ float conductor_albedo(float mu, float alpha, unsigned int normal_distribution)
+{
+	optix::float2 E = tex2D(conductor_albedo_texture, energy_table_texel(mu, ENERGY_TABLE_COSINES), energy_table_texel(alpha, ENERGY_TABLE_ROUGHNESSES));
+	return energy_table_entry(E, normal_distribution);
+}
+
+static __device__ __inline__ float conductor_average_albedo(float alpha, unsigned int normal_distribution)
+{
+	optix::float2 E = tex1D(conductor_average_albedo_texture, energy_table_texel(alpha, ENERGY_TABLE_ROUGHNESSES));
+	return energy_table_entry(E, normal_distribution);
+}
+
+// eta is n_t/n_i
+static __device__ __inline__ float dielectric_albedo(float mu, float alpha, float eta, unsigned int normal_distribution)
+{
+	optix::float2 E = tex3D(dielectric_albedo_texture, energy_table_texel(mu, ENERGY_TABLE_COSINES), energy_table_texel(alpha, ENERGY_TABLE_ROUGHNESSES),
+		energy_table_eta_texel(eta));
+	return energy_table_entry(E, normal_distribution);
+}
+#endif
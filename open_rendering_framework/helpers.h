@@ -105,7 +105,7 @@ __host__ __device__ __inline__ void create_onb( const optix::float3& n, optix::f
 
 // Create ONB from normalized vector
 static
-__device__ __inline__ void create_onb( const optix::float3& n, optix::float3& U, optix::float3& V)
+__host__ __device__ __inline__ void create_onb( const optix::float3& n, optix::float3& U, optix::float3& V)
 {
   using namespace optix;
 
@@ -234,38 +234,38 @@ static __host__ __device__ __inline__ optix::float3 tonemap( const optix::float3
 }
 
 
-static __device__ __inline__ optix::float3 max(const optix::float3 &value1, const optix::float3 &value2)
+static __host__ __device__ __inline__ optix::float3 max(const optix::float3 &value1, const optix::float3 &value2)
 {
 	return optix::make_float3(fmaxf(value1.x, value2.x), fmaxf(value1.y, value2.y), fmaxf(value1.z, value2.z));
 }
 
-static __device__ __inline__ optix::float3 min(const optix::float3 &value1, const optix::float3 &value2)
+static __host__ __device__ __inline__ optix::float3 min(const optix::float3 &value1, const optix::float3 &value2)
 {
 	return optix::make_float3(fminf(value1.x, value2.x), fminf(value1.y, value2.y), fminf(value1.z, value2.z));
 }
 
 
-static __device__ __inline__ optix::float3 exp(const optix::float3 &value1)
+static __host__ __device__ __inline__ optix::float3 exp(const optix::float3 &value1)
 {
 	return optix::make_float3(exp(value1.x), exp(value1.y), exp(value1.z));
 }
 
-static __device__ __inline__ optix::float3 sqrt(const optix::float3 &value1)
+static __host__ __device__ __inline__ optix::float3 sqrt(const optix::float3 &value1)
 {
 	return optix::make_float3(sqrt(value1.x), sqrt(value1.y), sqrt(value1.z));
 }
 
-static  __device__ __inline__ optix::float3 abs(const optix::float3 &value1)
+static __host__ __device__ __inline__ optix::float3 abs(const optix::float3 &value1)
 {
-	return optix::make_float3(abs(value1.x), abs(value1.y), abs(value1.z));
+	return optix::make_float3(fabsf(value1.x), fabsf(value1.y), fabsf(value1.z));
 }
 
-static __device__ __inline__ float step(const float &edge, const float &x)
+static __host__ __device__ __inline__ float step(const float &edge, const float &x)
 {
 	  return (x < edge)? 0.0f : 1.0f;
 }
 
-static  __device__ __inline__ optix::float3 fpowf(const optix::float3 & p, const float ex)
+static  __host__ __device__ __inline__ optix::float3 fpowf(const optix::float3 & p, const float ex)
 {
 	return optix::make_float3(powf(p.x, ex), powf(p.y, ex), powf(p.z, ex));
 }
@@ -281,7 +281,7 @@ static __host__ __device__ __inline__ optix::float3 sample_point_triangle(float
 }
 
 //Transform direction wi to local coordinates around the normal
-static __device__ __inline__ optix::float3 transformToLocal(const optix::float3 wi, const optix::float3 normal){
+static __host__ __device__ __inline__ optix::float3 transformToLocal(const optix::float3 wi, const optix::float3 normal){
 	optix::float3 u, v;
 	create_onb(normal, u, v);
 	float x = optix::dot(wi, u);
@@ -291,7 +291,7 @@ static __device__ __inline__ optix::float3 transformToLocal(const optix::float3
 }
 
 //Transform a local direction wi to world coordinates around the normal
-static __device__ __inline__ optix::float3 transformToWorld(const optix::float3 wi, const optix::float3 normal){
+static __host__ __device__ __inline__ optix::float3 transformToWorld(const optix::float3 wi, const optix::float3 normal){
 	optix::float3 u, v;
 	create_onb(normal, u, v);
 	optix::float3 new_w = optix::normalize(u * wi.x + v * wi.y + normal * wi.z);
@@ -377,19 +377,19 @@ static __host__ __inline__ __device__ double erfinv(double x)
 }
 
 //Gaussian height inverse CDF
-static __device__ __inline__ float GaussianHeightInvCDF(const float z){
+static __host__ __device__ __inline__ float GaussianHeightInvCDF(const float z){
 	float h = M_SQRT2f * (float)erfinv(2.0f * z - 1.0f);
 	return h;
 }
 
 //Gaussian height CDF
-static __device__ __inline__ float GaussianHeightCDF(const float h){
+static __host__ __device__ __inline__ float GaussianHeightCDF(const float h){
 	float cdf = 0.5f + 0.5f * (float)erf(M_SQRT1_2f * h);
 	return cdf;
 }
 
 //Gaussian Height PDF
-static __device__ __inline__ float  GaussianHeightPDF(const float h){
+static __host__ __device__ __inline__ float  GaussianHeightPDF(const float h){
 
 	float sqrt2pi_inv = 1.f / sqrtf(2 * M_PIf);
 	float pdf = sqrt2pi_inv *expf(-0.5f * h * h);
@@ -0,0 +1,172 @@
+#ifndef LIGHT_BVH_H
+#define LIGHT_BVH_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Nodes of the light hierarchy, stored depth first: the first child of an
+// interior node follows it directly, the second one is at child_or_light.
+// Every node bounds its emitters in space and in emitted direction with an
+// oriented cone (axis, theta_o for the normals, theta_e for the emission
+// around each normal) [Conty Estevez and Kulla 2018; pbrt-v4 BVHLightSampler].
+struct LightBVHNode
+{
+	optix::float3 bbox_min;
+	float phi;
+	optix::float3 bbox_max;
+	float cos_theta_o;
+	optix::float3 axis;
+	float cos_theta_e;
+	// interior: index of the second child, leaf: index in light_buffer
+	unsigned int child_or_light;
+	// leaf: index in triangle_light_buffer or -1 for non triangle lights
+	int triangle_idx;
+	unsigned int leaf;
+	unsigned int two_sided;
+};
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b
+static __host__ __device__ __inline__ float cos_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b)
+{
+	if (cos_a > cos_b)
+		return 1.0f;
+	return cos_a * cos_b + sin_a * sin_b;
+}
+
+static __host__ __device__ __inline__ float sin_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b)
+{
+	if (cos_a > cos_b)
+		return 0.0f;
+	return sin_a * cos_b - cos_a * sin_b;
+}
+
+static __host__ __device__ __inline__ float light_bvh_safe_sqrt(float x)
+{
+	return sqrtf(optix::fmaxf(x, 0.0f));
+}
+
+// Conservative estimate of the contribution of the emitters in a node
+// to the point pos with normal n (a zero normal skips the cosine term).
+static __host__ __device__ __inline__ float light_bvh_importance(const LightBVHNode& node, const optix::float3& pos, const optix::float3& n)
+{
+	if (node.phi <= 0.0f)
+		return 0.0f;
+	optix::float3 center = 0.5f * (node.bbox_min + node.bbox_max);
+	optix::float3 diagonal = node.bbox_max - node.bbox_min;
+	optix::float3 to_pos = pos - center;
+	float d2 = optix::dot(to_pos, to_pos);
+	float radius_sqr = 0.25f * optix::dot(diagonal, diagonal);
+	d2 = optix::fmaxf(d2, 0.5f * sqrtf(optix::dot(diagonal, diagonal)));
+	if (d2 <= 0.0f)
+		return node.phi;
+
+	optix::float3 w = to_pos / sqrtf(optix::dot(to_pos, to_pos) + 1.0e-20f);
+	float cos_theta_w = optix::dot(node.axis, w);
+	if (node.two_sided)
+		cos_theta_w = fabsf(cos_theta_w);
+	float sin_theta_w = light_bvh_safe_sqrt(1.0f - cos_theta_w * cos_theta_w);
+
+	// angle subtended by the bounding sphere of the node
+	float dist_sqr = optix::dot(to_pos, to_pos);
+	float cos_theta_b = -1.0f;
+	if (dist_sqr > radius_sqr)
+		cos_theta_b = light_bvh_safe_sqrt(1.0f - radius_sqr / dist_sqr);
+	float sin_theta_b = light_bvh_safe_sqrt(1.0f - cos_theta_b * cos_theta_b);
+
+	float sin_theta_o = light_bvh_safe_sqrt(1.0f - node.cos_theta_o * node.cos_theta_o);
+	float cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, node.cos_theta_o);
+	float sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, node.cos_theta_o);
+	float cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+	if (cos_theta_p <= node.cos_theta_e)
+		return 0.0f;
+
+	float importance = node.phi * cos_theta_p / d2;
+	if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+	{
+		float cos_theta_i = fabsf(optix::dot(w, n));
+		float sin_theta_i = light_bvh_safe_sqrt(1.0f - cos_theta_i * cos_theta_i);
+		importance *= cos_sub_clamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+	}
+	return optix::fmaxf(importance, 0.0f);
+}
+
+// Probability of walking down to a child of the given importance. A child
+// that cannot contribute is never chosen, and neither is a node whose
+// children both cannot contribute, so that light_bvh_sample and
+// light_bvh_pmf apply the same test.
+static __host__ __device__ __inline__ float light_bvh_child_probability(float importance, float sibling_importance)
+{
+	if (importance <= 0.0f)
+		return 0.0f;
+	return importance / (importance + optix::fmaxf(sibling_importance, 0.0f));
+}
+
+// Walks down the hierarchy choosing children proportionally to their importance.
+// Returns false if no emitter can contribute. On success the leaf is returned
+// and pmf holds the probability of having picked it. u is rescaled at every
+// level and can be reused afterwards.
+template<typename Nodes>
+static __host__ __device__ __inline__ bool light_bvh_sample(Nodes& nodes, unsigned int node_count, const optix::float3& pos, const optix::float3& n, float& u, LightBVHNode& leaf, float& pmf)
+{
+	pmf = 0.0f;
+	if (node_count == 0)
+		return false;
+	LightBVHNode node = nodes[0];
+	if (light_bvh_importance(node, pos, n) <= 0.0f)
+		return false;
+	float node_pmf = 1.0f;
+	unsigned int node_idx = 0;
+	while (!node.leaf)
+	{
+		LightBVHNode first = nodes[node_idx + 1];
+		LightBVHNode second = nodes[node.child_or_light];
+		float importance_first = light_bvh_importance(first, pos, n);
+		float importance_second = light_bvh_importance(second, pos, n);
+		float p_first = light_bvh_child_probability(importance_first, importance_second);
+		float p_second = light_bvh_child_probability(importance_second, importance_first);
+		if (p_first + p_second <= 0.0f)
+			return false;
+		if (u < p_first)
+		{
+			u = optix::fminf(u / p_first, 0.99999994f);
+			node_pmf *= p_first;
+			node_idx = node_idx + 1;
+			node = first;
+		}
+		else
+		{
+			u = optix::fminf((u - p_first) / p_second, 0.99999994f);
+			node_pmf *= p_second;
+			node_idx = node.child_or_light;
+			node = second;
+		}
+	}
+	leaf = node;
+	pmf = node_pmf;
+	return true;
+}
+
+// Probability that light_bvh_sample picks the leaf at leaf_idx, found by
+// walking up to the root through the parent indices.
+template<typename Nodes, typename Parents>
+static __host__ __device__ __inline__ float light_bvh_pmf(Nodes& nodes, Parents& parents, unsigned int node_count, unsigned int leaf_idx, const optix::float3& pos, const optix::float3& n)
+{
+	if (leaf_idx >= node_count)
+		return 0.0f;
+	float importance = light_bvh_importance(nodes[leaf_idx], pos, n);
+	float pmf = 1.0f;
+	unsigned int node_idx = leaf_idx;
+	while (node_idx != 0 && pmf > 0.0f)
+	{
+		unsigned int parent_idx = parents[node_idx];
+		LightBVHNode parent = nodes[parent_idx];
+		unsigned int sibling_idx = node_idx == parent_idx + 1 ? parent.child_or_light : parent_idx + 1;
+		float sibling_importance = light_bvh_importance(nodes[sibling_idx], pos, n);
+		pmf *= light_bvh_child_probability(importance, sibling_importance);
+		importance = light_bvh_importance(parent, pos, n);
+		node_idx = parent_idx;
+	}
+	// the root is tested like in light_bvh_sample
+	return importance > 0.0f ? pmf : 0.0f;
+}
+
+#endif // LIGHT_BVH_H
@@ -2,6 +2,16 @@
 #include "GuiWindow.h"
 #include <QtWidgets>
 #include "sampleConfig.h"
+#include "LightBVH.h"
+#include "BSSRDFBatch.h"
+#include "PBDTable.h"
+#include "SSSPoissonSets.h"
+#include "SSSOctree.h"
+#include "EnergyCompensation.h"
+#include "BeckmannVNDFTable.h"
+#include "ConductorFresnel.h"
+#include "MicrofacetBenchmark.h"
+#include <iostream>
 GLuint WIDTH = 512;
 GLuint HEIGHT = 512;
 
@@ -11,9 +21,7 @@ GLuint GUI_HEIGHT = 600;
 int main(int argc, char **argv)
 {
 
-	
-	QApplication app(argc, argv);
-
+	// the reports run without a display, before the Qt platform plugin loads
 	bool quit_and_save = false;
 	for (int i = 1; i < argc; ++i)
 	{
@@ -22,8 +30,54 @@ int main(int argc, char **argv)
 		{
 			quit_and_save = true;
 		}
+		// Checks the pmf of the light hierarchy, compares its noise with the selection by power and exits
+		if (arg == "--light-bvh")
+		{
+			return LightBVH::report(std::cout) ? 0 : 1;
+		}
+		// Checks the host BSSRDF batches against the dipoles, reports their evaluations per second and exits
+		if (arg == "--bssrdf-batch")
+		{
+			return BSSRDFBatch::report(std::cout) ? 0 : 1;
+		}
+		// Checks the photon beam diffusion tables against the direct evaluation, reports their evaluations per second and exits
+		if (arg == "--pbd-table")
+		{
+			return PBDTable::report(std::cout) ? 0 : 1;
+		}
+		// Compares the subsurface octrees with the brute force sum of their samples and exits
+		if (arg == "--sss-octree")
+		{
+			return SSSOctree::report(std::cout) ? 0 : 1;
+		}
+		// Compares the Poisson-disk sets of the subsurface samples with uniform random points and exits
+		if (arg == "--poisson-samples")
+		{
+			return SSSPoissonSets::report(std::cout) ? 0 : 1;
+		}
+		// Checks the energy compensation tables with a white furnace test, reports their build time and exits
+		if (arg == "--energy-compensation")
+		{
+			return EnergyCompensation::report(std::cout) ? 0 : 1;
+		}
+		// Checks the Beckmann visible normals table against the exact sampler with chi-square tests, reports its throughput and exits
+		if (arg == "--beckmann-vndf")
+		{
+			return BeckmannVNDFTable::report(std::cout) ? 0 : 1;
+		}
+		// Checks the conductor Fresnel tables against the complex formula, reports the Fresnel cost per metallic hit and exits
+		if (arg == "--conductor-fresnel")
+		{
+			return ConductorFresnel::report(std::cout) ? 0 : 1;
+		}
+		// Measures the throughput of the microfacet models on the host, checks their sampling with chi-square tests and their random walks with white furnace tests, and exits
+		if (arg == "--microfacet-benchmark")
+		{
+			return MicrofacetBenchmark::report(std::cout) ? 0 : 1;
+		}
 	}
 
+	QApplication app(argc, argv);
 
     QSurfaceFormat format;
     format.setSamples(16);
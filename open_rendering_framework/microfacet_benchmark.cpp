@@ -0,0 +1,10 @@
+#include "MicrofacetBenchmark.h"
+#include <iostream>
+
+// Host only build of --microfacet-benchmark, for machines without a GPU:
+// runs the benchmark and the tests of the microfacet models and exits with
+// a nonzero status if a test fails
+int main()
+{
+	return MicrofacetBenchmark::report(std::cout) ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#ifndef MIS_H
+#define MIS_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Weights for combining light sampling and BSDF sampling with multiple
+// importance sampling [Veach and Guibas 1995]. pdf is the density of the
+// strategy that produced the sample, other_pdf the density the other
+// strategy would have had for it, both with respect to solid angle.
+// The weights of the two strategies sum to one whenever either pdf is positive.
+
+static __host__ __device__ __inline__ float mis_balance_heuristic(float pdf, float other_pdf)
+{
+	float sum = pdf + other_pdf;
+	return sum > 0.0f ? pdf / sum : 0.0f;
+}
+
+static __host__ __device__ __inline__ float mis_power_heuristic(float pdf, float other_pdf)
+{
+	// divided by the larger pdf, so that the squares neither overflow nor underflow
+	float scale = fmaxf(pdf, other_pdf);
+	if (!(scale > 0.0f))
+		return 0.0f;
+	float a = pdf / scale;
+	float b = other_pdf / scale;
+	return a*a / (a*a + b*b);
+}
+
+#endif // MIS_H
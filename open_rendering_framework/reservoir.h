@@ -0,0 +1,81 @@
+#ifndef RESERVOIR_H
+#define RESERVOIR_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Weighted reservoir of light samples for RIS [Talbot et al. 2005] with reuse
+// [Bitterli et al. 2020], keeping the sampled point to evaluate it elsewhere
+struct LightReservoir
+{
+	unsigned int light_idx;
+	int triangle_idx;
+	optix::float3 light_pos;
+	float target;   // target function of the kept sample
+	float w_sum;    // sum of the resampling weights seen so far
+	float M;        // number of candidates seen so far
+	float W;        // contribution weight of the kept sample, set by reservoir_finalize
+};
+
+static __host__ __device__ __inline__ void reservoir_reset(LightReservoir& r)
+{
+	r.light_idx = 0;
+	r.triangle_idx = -1;
+	r.light_pos = optix::make_float3(0.0f);
+	r.target = 0.0f;
+	r.w_sum = 0.0f;
+	r.M = 0.0f;
+	r.W = 0.0f;
+}
+
+// Streams a candidate with resampling weight w = target/source pdf.
+// u is a uniform number; returns true if the candidate is kept.
+static __host__ __device__ __inline__ bool reservoir_update(LightReservoir& r, unsigned int light_idx, int triangle_idx, const optix::float3& light_pos, float target, float w, float u)
+{
+	r.M += 1.0f;
+	if (!(w > 0.0f))
+		return false;
+	r.w_sum += w;
+	if (u*r.w_sum >= w)
+		return false;
+	r.light_idx = light_idx;
+	r.triangle_idx = triangle_idx;
+	r.light_pos = light_pos;
+	r.target = target;
+	return true;
+}
+
+// Merges a finalized reservoir into r. target is the target function of
+// the sample kept by other, evaluated at the shading point of r.
+static __host__ __device__ __inline__ bool reservoir_merge(LightReservoir& r, const LightReservoir& other, float target, float u)
+{
+	float M = r.M;
+	bool kept = reservoir_update(r, other.light_idx, other.triangle_idx, other.light_pos, target, target*other.W*other.M, u);
+	r.M = M + other.M;
+	return kept;
+}
+
+// Sets the contribution weight W, so that f(y)*W estimates the integral of f
+static __host__ __device__ __inline__ void reservoir_finalize(LightReservoir& r)
+{
+	r.W = r.target > 0.0f && r.M > 0.0f ? r.w_sum / (r.M*r.target) : 0.0f;
+}
+
+// As above for a reservoir merged from other shading points, where Z counts
+// only the candidates of those whose target function is nonzero at the kept
+// sample. Dividing by M instead darkens the estimate wherever the supports
+// of the targets differ [Bitterli et al. 2020, Algorithm 6].
+static __host__ __device__ __inline__ void reservoir_finalize(LightReservoir& r, float Z)
+{
+	r.W = r.target > 0.0f && Z > 0.0f ? r.w_sum / (Z*r.target) : 0.0f;
+}
+
+// Reservoir that a pixel keeps across frames, with the shading point and
+// normal it was made for, which tell where its target function is nonzero
+struct PixelReservoir
+{
+	LightReservoir reservoir;
+	optix::float3 pos;
+	optix::float3 normal;
+};
+
+#endif // RESERVOIR_H
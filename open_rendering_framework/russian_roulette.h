@@ -0,0 +1,52 @@
+#ifndef RUSSIAN_ROULETTE_H
+#define RUSSIAN_ROULETTE_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Russian roulette path termination. Past start_depth a path survives
+// with probability equal to the largest channel of its throughput, but at
+// least min_prob, and survivors are scaled by the inverse probability.
+static __host__ __device__ __inline__ float russian_roulette_probability(const optix::float3& throughput, int depth, int start_depth, float min_prob)
+{
+	if (depth < start_depth)
+		return 1.0f;
+	float q = optix::fmaxf(throughput.x, optix::fmaxf(throughput.y, throughput.z));
+	return optix::clamp(q, min_prob, 1.0f);
+}
+
+#ifdef __CUDACC__
+#include <optix.h>
+#include "structs.h"
+#include "random.h"
+
+rtDeclareVariable(int, rr_start_depth, , );
+rtDeclareVariable(float, rr_min_prob, , );
+
+__device__ __inline__ float russian_roulette_survival(const optix::float3& throughput, int depth)
+{
+	return russian_roulette_probability(throughput, depth, rr_start_depth, rr_min_prob);
+}
+
+// Traces a radiance ray continuing the path of prd. Its throughput should
+// include the weight the caller applies to prd.result; an estimate is
+// enough where the weight is only known after tracing, as it only sets the
+// survival probability.
+__device__ __inline__ void trace_radiance(rtObject top_node, const optix::Ray& ray, PerRayData_radiance& prd)
+{
+	float q = russian_roulette_survival(prd.throughput, prd.depth);
+	if (q < 1.0f)
+	{
+		if (rnd_tea(prd.seed) >= q)
+		{
+			prd.result = optix::make_float3(0.0f);
+			return;
+		}
+		prd.throughput /= q;
+	}
+	rtTrace(top_node, ray, prd);
+	if (q < 1.0f)
+		prd.result /= q;
+}
+#endif
+
+#endif // RUSSIAN_ROULETTE_H
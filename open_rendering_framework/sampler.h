@@ -48,6 +48,20 @@ __inline__ __device__ optix::float3 sample_hemisphere(const optix::float3& norma
   return v;
 }
 
+__inline__ __device__ optix::float3 sample_cosine_weighted(const optix::float3& normal, const optix::float2& xi)
+{
+  float cos_theta = sqrtf(xi.x);
+  float phi = 2.0f*M_PIf*xi.y;
+
+  // Calculate new direction as if the z-axis were the normal
+  float sin_theta = sqrtf(1.0f - cos_theta*cos_theta);
+  float3 v = spherical_direction(sin_theta, cos_theta, phi);
+
+  // Rotate from z-axis to actual normal and return
+  rotate_to_normal(normal, v);
+  return v;
+}
+
 __inline__ __device__ optix::float3 sample_cosine_weighted(const optix::float3& normal, optix::uint& t)
 {
   // Get random numbers
@@ -100,6 +114,20 @@ __inline__ __device__ float3 sample_HG(optix::float3& forward, float g, optix::u
   return v;
 }
 
+__inline__ __device__ float3 sample_barycentric(const optix::float2& xi)
+{
+  float sqrt_xi1 = sqrtf(xi.x);
+  float xi2 = xi.y;
+
+  // Calculate Barycentric coordinates
+  float u = 1.0f - sqrt_xi1;
+  float v = (1.0f - xi2)*sqrt_xi1;
+  float w = xi2*sqrt_xi1;
+
+  // Return barycentric coordinates
+  return make_float3(u, v, w);
+}
+
 __inline__ __device__ float3 sample_barycentric(optix::uint& t)
 {
   // Get random numbers
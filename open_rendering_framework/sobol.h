@@ -0,0 +1,131 @@
+#ifndef SOBOL_H
+#define SOBOL_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "random.h"
+
+// Owen-scrambled Sobol sampler using the hash-based nested uniform
+// scrambling of Burley [Practical Hash-based Owen Scrambling, JCGT 9(4), 2020].
+// Every pixel owns a scrambling seed and the sample index is the frame number,
+// so that consecutive frames walk along the same (0,2)-sequence. Dimensions
+// above the first two are padded: each slot takes its own shuffled and
+// scrambled copy of the 2D sequence, decorrelated by a hash of the slot id.
+
+struct SobolSampler
+{
+	unsigned int seed;
+	unsigned int index;
+};
+
+// Dimensions consumed at every bounce of a path. Slot 0 is reserved for the
+// camera jitter, each bounce then takes SOBOL_DIMENSIONS_PER_BOUNCE slots.
+enum SobolDimension
+{
+	SOBOL_LIGHT_SELECTION,
+	SOBOL_LIGHT_POSITION,
+	SOBOL_BSDF_LOBE,
+	SOBOL_MICROFACET_NORMAL,
+	SOBOL_BSDF_DIRECTION,
+	SOBOL_DIMENSIONS_PER_BOUNCE
+};
+
+#ifdef __CUDACC__
+#include <optix.h>
+// the shaders draw their samples from the sampler instead of rnd_tea when set
+rtDeclareVariable(int, sobol_sampler, , );
+#endif
+
+static __host__ __device__ __inline__ unsigned int sobol_reverse_bits(unsigned int x)
+{
+#ifdef __CUDA_ARCH__
+	return __brev(x);
+#else
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+#endif
+}
+
+// Laine-Karras style permutation, operating on bit-reversed integers
+static __host__ __device__ __inline__ unsigned int laine_karras_permutation(unsigned int x, unsigned int seed)
+{
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+static __host__ __device__ __inline__ unsigned int nested_uniform_scramble(unsigned int x, unsigned int seed)
+{
+	x = sobol_reverse_bits(x);
+	x = laine_karras_permutation(x, seed);
+	return sobol_reverse_bits(x);
+}
+
+static __host__ __device__ __inline__ unsigned int sobol_hash_combine(unsigned int seed, unsigned int v)
+{
+	return seed ^ (tea<4>(v, seed) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// First dimension of the Sobol sequence (van der Corput)
+static __host__ __device__ __inline__ unsigned int sobol_dimension_0(unsigned int index)
+{
+	return sobol_reverse_bits(index);
+}
+
+// Second dimension of the Sobol sequence (primitive polynomial x + 1)
+static __host__ __device__ __inline__ unsigned int sobol_dimension_1(unsigned int index)
+{
+	unsigned int result = 0;
+	for (unsigned int v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		if (index & 1u)
+			result ^= v;
+	return result;
+}
+
+static __host__ __device__ __inline__ float sobol_to_float(unsigned int x)
+{
+	// keep 24 bits so that the result is strictly smaller than one
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static __host__ __device__ __inline__ SobolSampler sobol_init(unsigned int pixel, unsigned int frame)
+{
+	SobolSampler sampler;
+	sampler.seed = tea<16>(pixel, 0x5f3759dfu);
+	sampler.index = frame;
+	return sampler;
+}
+
+static __host__ __device__ __inline__ unsigned int sobol_slot(int depth, SobolDimension dimension)
+{
+	return 1u + (unsigned int)depth * SOBOL_DIMENSIONS_PER_BOUNCE + (unsigned int)dimension;
+}
+
+static __host__ __device__ __inline__ unsigned int sobol_camera_slot()
+{
+	return 0u;
+}
+
+static __host__ __device__ __inline__ optix::float2 sobol_2d(const SobolSampler& sampler, unsigned int slot)
+{
+	unsigned int seed = sobol_hash_combine(sampler.seed, slot);
+	unsigned int index = nested_uniform_scramble(sampler.index, seed);
+	unsigned int x = nested_uniform_scramble(sobol_dimension_0(index), sobol_hash_combine(seed, 0u));
+	unsigned int y = nested_uniform_scramble(sobol_dimension_1(index), sobol_hash_combine(seed, 1u));
+	return optix::make_float2(sobol_to_float(x), sobol_to_float(y));
+}
+
+static __host__ __device__ __inline__ float sobol_1d(const SobolSampler& sampler, unsigned int slot)
+{
+	unsigned int seed = sobol_hash_combine(sampler.seed, slot);
+	unsigned int index = nested_uniform_scramble(sampler.index, seed);
+	return sobol_to_float(nested_uniform_scramble(sobol_dimension_0(index), sobol_hash_combine(seed, 0u)));
+}
+
+#endif // SOBOL_H
@@ -0,0 +1,168 @@
+#ifndef SOLID_ANGLE_SAMPLING_H
+#define SOLID_ANGLE_SAMPLING_H
+
+#include <optixu/optixu_math_namespace.h>
+
+// Sampling of light sources by the solid angle they subtend from a point.
+// All pdfs returned here are with respect to solid angle.
+
+// Orthonormal basis around a unit vector n [Frisvad, Journal of Graphics Tools 16, 2012]
+static __host__ __device__ __inline__ void solid_angle_onb(const optix::float3& n, optix::float3& b1, optix::float3& b2)
+{
+	if (n.z < -0.9999999f)
+	{
+		b1 = optix::make_float3(0.0f, -1.0f, 0.0f);
+		b2 = optix::make_float3(-1.0f, 0.0f, 0.0f);
+		return;
+	}
+	const float a = 1.0f / (1.0f + n.z);
+	const float b = -n.x*n.y*a;
+	b1 = optix::make_float3(1.0f - n.x*n.x*a, b, -n.x);
+	b2 = optix::make_float3(b, 1.0f - n.y*n.y*a, -n.y);
+}
+
+// Solid angle pdf of sample_sphere_solid_angle for points outside the sphere
+static __host__ __device__ __inline__ float sphere_solid_angle_pdf(const optix::float3& pos, const optix::float3& center, float radius)
+{
+	optix::float3 d = center - pos;
+	float dist_sqr = optix::dot(d, d);
+	float sin_theta_max_sqr = radius*radius / dist_sqr;
+	// Taylor expansion of 1 - cos(theta_max) for small cones, where the direct form cancels
+	float one_minus_cos_theta_max = sin_theta_max_sqr < 0.00068523f
+		? 0.5f*sin_theta_max_sqr
+		: 1.0f - sqrtf(optix::fmaxf(1.0f - sin_theta_max_sqr, 0.0f));
+	return 1.0f / (2.0f*M_PIf*one_minus_cos_theta_max);
+}
+
+// Uniformly samples the cone of directions subtended by a sphere [pbrt-v4, Sphere::Sample].
+// Returns the point on the sphere, its outward normal and the solid angle pdf.
+// If pos is inside the sphere, the whole sphere is sampled uniformly by area
+// and the pdf converted to solid angle.
+static __host__ __device__ __inline__ void sample_sphere_solid_angle(const optix::float3& pos, const optix::float3& center, float radius, const optix::float2& xi, optix::float3& light_pos, optix::float3& light_normal, float& pdf)
+{
+	optix::float3 d = center - pos;
+	float dist_sqr = optix::dot(d, d);
+	float radius_sqr = radius*radius;
+	if (dist_sqr <= radius_sqr)
+	{
+		float z = 1.0f - 2.0f*xi.x;
+		float r = sqrtf(optix::fmaxf(1.0f - z*z, 0.0f));
+		float phi = 2.0f*M_PIf*xi.y;
+		light_normal = optix::make_float3(r*cosf(phi), r*sinf(phi), z);
+		light_pos = center + radius*light_normal;
+		optix::float3 w = light_pos - pos;
+		float w_sqr = optix::dot(w, w);
+		float cos_theta = w_sqr > 0.0f ? fabsf(optix::dot(light_normal, w)) / sqrtf(w_sqr) : 0.0f;
+		pdf = cos_theta > 0.0f ? w_sqr / (cos_theta*4.0f*M_PIf*radius_sqr) : 0.0f;
+		return;
+	}
+
+	float dist = sqrtf(dist_sqr);
+	optix::float3 w_c = d / dist;
+	optix::float3 w_c_x, w_c_y;
+	solid_angle_onb(w_c, w_c_x, w_c_y);
+
+	// sample a direction in the cone
+	float sin_theta_max_sqr = radius_sqr / dist_sqr;
+	float sin_theta_max = sqrtf(sin_theta_max_sqr);
+	float cos_theta_max = sqrtf(optix::fmaxf(1.0f - sin_theta_max_sqr, 0.0f));
+	float one_minus_cos_theta_max = 1.0f - cos_theta_max;
+	float cos_theta = (cos_theta_max - 1.0f)*xi.x + 1.0f;
+	float sin_theta_sqr = 1.0f - cos_theta*cos_theta;
+	if (sin_theta_max_sqr < 0.00068523f)
+	{
+		sin_theta_sqr = sin_theta_max_sqr*xi.x;
+		cos_theta = sqrtf(1.0f - sin_theta_sqr);
+		one_minus_cos_theta_max = 0.5f*sin_theta_max_sqr;
+	}
+
+	// find the point on the sphere seen in that direction
+	float cos_alpha = sin_theta_sqr / sin_theta_max + cos_theta*sqrtf(optix::fmaxf(1.0f - sin_theta_sqr / sin_theta_max_sqr, 0.0f));
+	float sin_alpha = sqrtf(optix::fmaxf(1.0f - cos_alpha*cos_alpha, 0.0f));
+	float phi = 2.0f*M_PIf*xi.y;
+	light_normal = -(sin_alpha*cosf(phi)*w_c_x + sin_alpha*sinf(phi)*w_c_y + cos_alpha*w_c);
+	light_pos = center + radius*light_normal;
+	pdf = 1.0f / (2.0f*M_PIf*one_minus_cos_theta_max);
+}
+
+// Solid angle subtended by a triangle [Van Oosterom and Strackee 1983]
+static __host__ __device__ __inline__ float spherical_triangle_solid_angle(const optix::float3& pos, const optix::float3& v0, const optix::float3& v1, const optix::float3& v2)
+{
+	optix::float3 a = optix::normalize(v0 - pos);
+	optix::float3 b = optix::normalize(v1 - pos);
+	optix::float3 c = optix::normalize(v2 - pos);
+	float numerator = fabsf(optix::dot(a, optix::cross(b, c)));
+	float denominator = 1.0f + optix::dot(a, b) + optix::dot(b, c) + optix::dot(c, a);
+	return fabsf(2.0f*atan2f(numerator, denominator));
+}
+
+// Angle between unit vectors, accurate also for nearly (anti)parallel vectors
+static __host__ __device__ __inline__ float spherical_angle_between(const optix::float3& a, const optix::float3& b)
+{
+	if (optix::dot(a, b) < 0.0f)
+		return M_PIf - 2.0f*asinf(optix::fminf(0.5f*optix::length(a + b), 1.0f));
+	return 2.0f*asinf(optix::fminf(0.5f*optix::length(b - a), 1.0f));
+}
+
+// Uniformly samples the solid angle subtended by the triangle v0, v1, v2 as seen
+// from pos [Arvo 1995, Stratified sampling of spherical triangles].
+// Returns false for degenerate spherical triangles. On success dir is the
+// sampled unit direction and pdf the (constant) solid angle pdf.
+static __host__ __device__ __inline__ bool sample_spherical_triangle(const optix::float3& pos, const optix::float3& v0, const optix::float3& v1, const optix::float3& v2, const optix::float2& xi, optix::float3& dir, float& pdf)
+{
+	optix::float3 a = v0 - pos;
+	optix::float3 b = v1 - pos;
+	optix::float3 c = v2 - pos;
+	if (optix::dot(a, a) == 0.0f || optix::dot(b, b) == 0.0f || optix::dot(c, c) == 0.0f)
+		return false;
+	a = optix::normalize(a);
+	b = optix::normalize(b);
+	c = optix::normalize(c);
+
+	// normals of the great circle arcs and angles at the vertices
+	optix::float3 n_ab = optix::cross(a, b);
+	optix::float3 n_bc = optix::cross(b, c);
+	optix::float3 n_ca = optix::cross(c, a);
+	if (optix::dot(n_ab, n_ab) == 0.0f || optix::dot(n_bc, n_bc) == 0.0f || optix::dot(n_ca, n_ca) == 0.0f)
+		return false;
+	n_ab = optix::normalize(n_ab);
+	n_bc = optix::normalize(n_bc);
+	n_ca = optix::normalize(n_ca);
+	float alpha = spherical_angle_between(n_ab, -n_ca);
+	float beta = spherical_angle_between(n_bc, -n_ab);
+	float gamma = spherical_angle_between(n_ca, -n_bc);
+
+	// pick the sub-triangle area and find the matching vertex c' on the arc ac
+	float area = alpha + beta + gamma - M_PIf;
+	if (area <= 0.0f)
+		return false;
+	pdf = 1.0f / area;
+	float sub_area = xi.x*area;
+	// Arvo's cos(b') rewritten with 1 - cos(x) = 2 sin^2(x/2), since his form
+	// cancels in float for thin spherical triangles, seen edge-on
+	float sin_half_sub_area = sinf(0.5f*sub_area);
+	float one_minus_cos_sub_area = 2.0f*sin_half_sub_area*sin_half_sub_area;
+	optix::float3 a_minus_b = a - b;
+	float k = sinf(sub_area - alpha)*sinf(alpha)*0.5f*optix::dot(a_minus_b, a_minus_b);
+	float cos_b_prime = -(optix::dot(a, b)*one_minus_cos_sub_area + k) / (one_minus_cos_sub_area - k);
+	cos_b_prime = optix::fmaxf(optix::fminf(cos_b_prime, 1.0f), -1.0f);
+	float sin_b_prime = sqrtf(optix::fmaxf(1.0f - cos_b_prime*cos_b_prime, 0.0f));
+	optix::float3 c_ortho = c - optix::dot(c, a)*a;
+	if (optix::dot(c_ortho, c_ortho) == 0.0f)
+		return false;
+	optix::float3 c_prime = cos_b_prime*a + sin_b_prime*optix::normalize(c_ortho);
+
+	// sample the arc between b and c'
+	float cos_theta = 1.0f - xi.y*(1.0f - optix::dot(c_prime, b));
+	float sin_theta = sqrtf(optix::fmaxf(1.0f - cos_theta*cos_theta, 0.0f));
+	optix::float3 c_prime_ortho = c_prime - optix::dot(c_prime, b)*b;
+	if (optix::dot(c_prime_ortho, c_prime_ortho) == 0.0f)
+	{
+		dir = b;
+		return true;
+	}
+	dir = optix::normalize(cos_theta*b + sin_theta*optix::normalize(c_prime_ortho));
+	return true;
+}
+
+#endif // SOLID_ANGLE_SAMPLING_H
@@ -0,0 +1,98 @@
+#ifndef SSS_ALLOCATION_H
+#define SSS_ALLOCATION_H
+
+#include <optixu/optixu_math_namespace.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Split of a budget of subsurface samples per frame among the translucent
+// objects (OptixSceneLoader::allocateTranslucentSamples).
+
+// fewest samples per frame of a translucent object under a sample budget
+const unsigned int SSS_MIN_SAMPLES = 32;
+
+// Fraction of the image covered by the projection of a bounding box,
+// for the pinhole camera with ray directions W + x*U + y*V, x and y in
+// [-1, 1]. Boxes reaching behind the camera count as covering all of it.
+static inline float sss_screen_coverage(const optix::float3& bbox_min, const optix::float3& bbox_max,
+	const optix::float3& eye, const optix::float3& U, const optix::float3& V, const optix::float3& W)
+{
+	float uu = optix::dot(U, U);
+	float vv = optix::dot(V, V);
+	float ww = optix::dot(W, W);
+	if (uu <= 0.0f || vv <= 0.0f || ww <= 0.0f)
+		return 1.0f;
+	float x_min = 1.0f, x_max = -1.0f, y_min = 1.0f, y_max = -1.0f;
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		optix::float3 corner = optix::make_float3(i & 1 ? bbox_max.x : bbox_min.x, i & 2 ? bbox_max.y : bbox_min.y, i & 4 ? bbox_max.z : bbox_min.z);
+		optix::float3 d = corner - eye;
+		float t = optix::dot(d, W) / ww;
+		if (t <= 0.0f)
+			return 1.0f;
+		float x = optix::dot(d, U) / (uu * t);
+		float y = optix::dot(d, V) / (vv * t);
+		x_min = std::min(x_min, x);
+		x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y);
+		y_max = std::max(y_max, y);
+	}
+	float width = std::max(std::min(x_max, 1.0f) - std::max(x_min, -1.0f), 0.0f);
+	float height = std::max(std::min(y_max, 1.0f) - std::max(y_min, -1.0f), 0.0f);
+	return 0.25f * width * height;
+}
+
+// The variance of the gather is proportional to the number of diffusion
+// footprints on the surface, area*transport^2, over the number of samples.
+// The sum over the objects of coverage times that variance is smallest for
+// shares proportional to sqrt(coverage*area)*transport. The longest
+// footprint (smallest transport coefficient) is used, as for the Russian
+// roulette of the shaders.
+static inline double sss_sample_importance(float coverage, float area, const optix::float3& transport)
+{
+	return std::sqrt((double)coverage * area) * std::min(transport.x, std::min(transport.y, transport.z));
+}
+
+// Splits budget samples among the objects with counts[k] > 0: every object
+// gets a minimum, and the rest in proportion to importance[k], or evenly
+// if all of the importances are zero. The samples lost to rounding go to
+// the largest remainders.
+static inline void sss_split_budget(unsigned int budget, const double* importance, unsigned int* counts, unsigned int size)
+{
+	unsigned int objects = 0;
+	double total = 0.0;
+	for (unsigned int k = 0; k < size; ++k)
+	{
+		if (counts[k] == 0)
+			continue;
+		++objects;
+		total += importance[k];
+	}
+	if (budget == 0 || objects == 0)
+		return;
+	unsigned int min_samples = std::max(1u, std::min(SSS_MIN_SAMPLES, budget / objects));
+	unsigned int free_samples = budget > min_samples * objects ? budget - min_samples * objects : 0;
+	bool even = !(total > 0.0);
+	if (even)
+		total = objects;
+	std::vector<double> remainders(size, -1.0);
+	unsigned int assigned = 0;
+	for (unsigned int k = 0; k < size; ++k)
+	{
+		if (counts[k] == 0)
+			continue;
+		double share = free_samples * (even ? 1.0 : importance[k]) / total;
+		counts[k] = min_samples + (unsigned int)share;
+		remainders[k] = share - std::floor(share);
+		assigned += (unsigned int)share;
+	}
+	for (; assigned < free_samples; ++assigned)
+	{
+		unsigned int k = (unsigned int)(std::max_element(remainders.begin(), remainders.end()) - remainders.begin());
+		++counts[k];
+		remainders[k] = -1.0;
+	}
+}
+
+#endif // SSS_ALLOCATION_H
@@ -0,0 +1,72 @@
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "structs.h"
+
+// Octree over the irradiance samples of a translucent object, used to
+// integrate the BSSRDF hierarchically [Jensen and Buhler 2002]. Nodes are
+// stored depth first: the children of an interior node follow it, and skip
+// is the index of the first node after its subtree, so the octree can be
+// traversed without a stack. Every node aggregates its samples: power is
+// the sum of their transmitted power (weight*L), while position, normal
+// and refracted direction are averages weighted by the power.
+struct SSSOctreeNode
+{
+	optix::float3 bbox_min;
+	unsigned int skip;
+	optix::float3 bbox_max;
+	// leaf: first entry of its samples in the sample index buffer
+	unsigned int first;
+	optix::float3 pos;
+	// leaf: number of samples, interior: zero
+	unsigned int count;
+	optix::float3 normal;
+	// squared radius of the bounding sphere of the samples
+	float radius_sqr;
+	optix::float3 transmitted;
+	float padding;
+	optix::float3 power;
+	float padding2;
+};
+
+static __host__ __device__ __inline__ bool sss_octree_inside(const SSSOctreeNode& node, const optix::float3& pos)
+{
+	return pos.x >= node.bbox_min.x && pos.y >= node.bbox_min.y && pos.z >= node.bbox_min.z &&
+		pos.x <= node.bbox_max.x && pos.y <= node.bbox_max.y && pos.z <= node.bbox_max.z;
+}
+
+// Sums eval over the octree of an object as seen from xo. An interior node
+// is evaluated as a single sample if xo is outside of it and its solid angle
+// (estimated from the bounding sphere of its samples) is below
+// max_solid_angle, otherwise it is opened. Leaves are evaluated sample by
+// sample. eval(pos, normal, transmitted, power) returns the contribution of
+// a (possibly aggregated) sample. With max_solid_angle equal to zero this is
+// the brute force sum over all the samples.
+template<typename Nodes, typename Indices, typename Samples, typename Eval>
+static __host__ __device__ __inline__ optix::float3 sss_octree_gather(Nodes& nodes, unsigned int node_offset, unsigned int node_count, Indices& indices, Samples& samples, const optix::float3& xo, float max_solid_angle, const Eval& eval)
+{
+	optix::float3 sum = optix::make_float3(0.0f);
+	unsigned int i = 0;
+	while (i < node_count)
+	{
+		const SSSOctreeNode node = nodes[node_offset + i];
+		if (node.count == 0)
+		{
+			optix::float3 d = xo - node.pos;
+			if (!sss_octree_inside(node, xo) && M_PIf * node.radius_sqr < max_solid_angle * optix::dot(d, d))
+			{
+				sum += eval(node.pos, node.normal, node.transmitted, node.power);
+				i = node.skip;
+			}
+			else
+				++i;
+			continue;
+		}
+		for (unsigned int k = 0; k < node.count; ++k)
+		{
+			const PositionSample sample = samples[indices[node.first + k]];
+			sum += eval(sample.pos, sample.normal, sample.transmitted, sample.weight * sample.L);
+		}
+		i = node.skip;
+	}
+	return sum;
+}
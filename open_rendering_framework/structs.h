@@ -1,12 +1,14 @@
 #pragma once
 #include <optix_world.h>
 #include "random.h"
+#include "sobol.h"
 
 enum RayTypes
 {
 	radiance_ray_type,
 	shadow_ray_type,
 	depth_ray_type,
+	probe_ray_type,
 	NUMBER_OF_RAYS
 };
 
@@ -24,6 +26,13 @@ struct PerRayData_radiance
 	int depth;
 	unsigned int seed;
 	Seed64 seed64;
+	SobolSampler sobol;
+	// Solid angle pdf of the BSDF sample that spawned the ray and the normal at its
+	// origin; when positive, emitters hit by the ray weight their emission with MIS
+	float bsdf_pdf;
+	optix::float3 mis_normal;
+	// Product of the weights along the path, used for Russian roulette
+	optix::float3 throughput;
 };
 
 // Payload for shadow ray type
@@ -32,6 +41,14 @@ struct PerRayData_shadow
 	float attenuation;
 };
 
+// Payload for the probe rays of the BSSRDF sampling, dist is negative if
+// the ray missed
+struct PerRayData_probe
+{
+	optix::float3 normal;
+	float dist;
+};
+
 struct PerRayData_depth
 {
 	optix::float3 normal;
@@ -70,7 +87,8 @@ struct TrianglesAreaLightStruct
 	float triangle_count;
 	float buffer_start_idx;
 	float buffer_end_idx;
-	optix::float3 padding;
+	unsigned int sampling_mode;
+	optix::float2 padding;
 };
 
 struct DiskLightStruct
@@ -141,8 +159,58 @@ struct ScatteringMaterialProperties
 	optix::float3 global_coeff;
 	optix::float3 one_over_three_ext;
 	float mean_transport;
+
+	// tabulated standard dipole (dipoles/dipole_profile.h)
+	float dipole_effective_radius;
+	float dipole_profile_r_min;
+	float dipole_profile_inv_log_range;
+	// tabulated photon beam diffusion (dipoles/photon_beam_diffusion.h)
+	float pbd_table_r_min;
+	float pbd_table_inv_log_range;
 };
 
+// Everything the sample pass needs to know about a translucent object, so
+// that all objects are sampled by a single launch
+struct TranslucentObjectRecord
+{
+	// bindless ids of the mesh buffers
+	int vertex_buffer_id;
+	int normal_buffer_id;
+	int vindex_buffer_id;
+	int nindex_buffer_id;
+	optix::Matrix4x4 transform_matrix;
+	// inverse transpose of transform_matrix
+	optix::Matrix4x4 normal_matrix;
+	ScatteringMaterialProperties properties;
+	unsigned int material_type;
+	optix::float2 roughness;
+	unsigned int microfacet_model;
+	unsigned int normal_distribution;
+	// SSSEstimator, objects sampled by probe rays get no samples
+	unsigned int sss_estimator;
+	// start of the triangle area CDF and world space area
+	unsigned int area_cdf_offset;
+	float area;
+	// range of the samples of the object in the sample buffers
+	unsigned int sample_offset;
+	unsigned int sample_count;
+	// the sample pass relights refresh_count samples of the object from
+	// sample_offset + refresh_offset, for the launch indices from launch_offset
+	unsigned int launch_offset;
+	unsigned int refresh_offset;
+	unsigned int refresh_count;
+	// samples of a block, relit per frame
+	unsigned int frame_samples;
+	// Poisson-disk sets of poisson_capacity points from poisson_offset (SSSPoissonSets),
+	// block b of the samples takes set poisson_set + b
+	unsigned int poisson_offset;
+	unsigned int poisson_capacity;
+	unsigned int poisson_set;
+};
+
+// Poisson-disk sets per object at a time, each replaced in turn
+#define SSS_POISSON_SETS 16
+
 enum LightType
 {
 	POINT_LIGHT,
@@ -161,6 +229,18 @@ static char *lightNames[] = {
 	"SphericalLight"
 };
 
+enum TriangleLightSampling
+{
+	AREA_SAMPLING,
+	SPHERICAL_TRIANGLE_SAMPLING,
+	NUMBER_OF_TRIANGLE_LIGHT_SAMPLINGS
+};
+
+static char *triangleLightSamplingNames[] = {
+	"AreaSampling",
+	"SphericalTriangleSampling"
+};
+
 enum CameraType
 {
 	PINHOLE_CAMERA,
@@ -244,13 +324,16 @@ enum MicrofacetModel
 	WALTER_MODEL,
 	VISIBLE_NORMALS_MODEL,
 	MULTISCATTERING_MODEL,
+	// visible normals with tabulated energy compensation (energy_compensation.h)
+	ENERGY_COMPENSATION_MODEL,
 	NUMBER_OF_MICROFACET_MODELS
 };
 
 static char *microfacetModelNames[] = {
 	"walter_model",
 	"visible_normals_model",
-	"multiscattering_model"
+	"multiscattering_model",
+	"energy_compensation_model"
 };
 
 enum NormalsDistribution
@@ -265,7 +348,7 @@ static char *normalDistributionNames[] = {
 	"ggx_distribution"
 };
 
-static enum DefaultScatteringMaterial {
+enum DefaultScatteringMaterial {
 	Apple,
 	Marble,
 	Potato,
@@ -312,9 +395,20 @@ enum DipoleModel
 {
 	STANDARD_DIPOLE,
 	DIRECTIONAL_DIPOLE,
+	PHOTON_BEAM_DIFFUSION,
 	NUMBER_OF_DIPOLE_MODELS
 };
 
+// How the shaders of translucent objects find the entry points of the light
+enum SSSEstimator
+{
+	// sum over the samples of the sample pass (point cloud)
+	SSS_POINT_CLOUD,
+	// probe rays importance sampled by the BSSRDF (dipoles/bssrdf_sampling.h)
+	SSS_PROBE_RAYS,
+	NUMBER_OF_SSS_ESTIMATORS
+};
+
 enum AnisotropicStructure
 {
 	RIDGED_STRUCTURE,
@@ -0,0 +1,112 @@
+#include "host_tests.h"
+#include "../alias_table.h"
+#include "../chi_square.h"
+#include <random>
+#include <vector>
+
+bool alias_table_report(std::ostream& out)
+{
+	const unsigned int samples = 1u << 20;
+	const double significance = 0.01;
+	std::mt19937 generator(27);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	std::vector<std::vector<float>> distributions;
+	distributions.push_back(std::vector<float>(1, 3.0f));
+	distributions.push_back(std::vector<float>(5, 0.0f));
+	distributions.push_back({ 1.0f, 0.0f, 0.0f, 2.0f, 0.0f, 1.0f });
+	distributions.push_back({ 1.0e6f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f });
+	for (unsigned int n : { 17u, 1000u })
+	{
+		std::vector<float> weights(n);
+		for (unsigned int i = 0; i < n; ++i)
+			weights[i] = powf(10.0f, 6.0f*uniform(generator) - 3.0f) * (i % 7 == 3 ? 0.0f : 1.0f);
+		distributions.push_back(weights);
+	}
+
+	out << "Alias tables: " << samples << " samples each" << std::endl;
+	for (const std::vector<float>& weights : distributions)
+	{
+		unsigned int n = (unsigned int)weights.size();
+		std::vector<AliasEntry> table(n);
+		double sum = build_alias_table(weights.data(), n, table.data());
+		float pmf_error = 0.0f;
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			float expected = sum > 0.0 ? (float)(weights[i] / sum) : 1.0f / n;
+			// relative error, and never a pmf for a zero weight
+			pmf_error = fmaxf(pmf_error, expected > 0.0f ? fabsf(table[i].pmf - expected) / expected : table[i].pmf);
+		}
+
+		std::vector<unsigned int> observed(n, 0u), reused(16, 0u);
+		unsigned int wrong_pmf = 0;
+		for (unsigned int s = 0; s < samples; ++s)
+		{
+			float u = uniform(generator);
+			float pmf;
+			unsigned int idx = sample_alias(table, 0u, n, u, pmf);
+			++observed[idx];
+			wrong_pmf += pmf == table[idx].pmf ? 0u : 1u;
+			++reused[std::min((unsigned int)(u * 16.0f), 15u)];
+		}
+		std::vector<double> expected(n), expected_reused(16, samples / 16.0);
+		for (unsigned int i = 0; i < n; ++i)
+			expected[i] = table[i].pmf * (double)samples;
+		double p_value = chi_square_test(observed, expected);
+		double p_reused = chi_square_test(reused, expected_reused);
+		// one test of the sampled indices and one of the reused sample per table
+		double threshold = significance / (2.0 * distributions.size());
+		bool valid = pmf_error < 1.0e-5f && wrong_pmf == 0 && p_value > threshold && p_reused > threshold;
+		passed = passed && valid;
+		out << "  " << n << " weights: pmf error " << pmf_error << ", p-value " << p_value << ", reused sample p-value " << p_reused
+			<< (valid ? "" : " FAILED") << std::endl;
+	}
+
+	// E = I cos / r^2 of one light at shading points on the plane y = 0
+	const unsigned int lights = 64, points = 256, light_samples = 16;
+	std::vector<optix::float3> positions(lights);
+	std::vector<float> intensity(lights);
+	for (unsigned int i = 0; i < lights; ++i)
+	{
+		positions[i] = optix::make_float3(20.0f*uniform(generator) - 10.0f, 1.0f + 4.0f*uniform(generator), 20.0f*uniform(generator) - 10.0f);
+		intensity[i] = powf(10.0f, 4.0f*uniform(generator));
+	}
+	std::vector<AliasEntry> uniform_table(lights), power_table(lights);
+	std::vector<float> ones(lights, 1.0f);
+	build_alias_table(ones.data(), lights, uniform_table.data());
+	build_alias_table(intensity.data(), lights, power_table.data());
+	double squared_error[2] = { 0.0, 0.0 };
+	for (unsigned int p = 0; p < points; ++p)
+	{
+		optix::float3 x = optix::make_float3(20.0f*uniform(generator) - 10.0f, 0.0f, 20.0f*uniform(generator) - 10.0f);
+		auto irradiance = [&](unsigned int i) {
+			optix::float3 d = positions[i] - x;
+			float r_sqr = optix::dot(d, d);
+			return intensity[i] * d.y / (r_sqr * sqrtf(r_sqr));
+		};
+		double reference = 0.0;
+		for (unsigned int i = 0; i < lights; ++i)
+			reference += irradiance(i);
+		for (int t = 0; t < 2; ++t)
+		{
+			double estimate = 0.0;
+			for (unsigned int s = 0; s < light_samples; ++s)
+			{
+				float u = uniform(generator);
+				float pmf;
+				unsigned int i = sample_alias(t == 0 ? uniform_table : power_table, 0u, lights, u, pmf);
+				estimate += irradiance(i) / pmf;
+			}
+			double relative_error = (estimate / light_samples - reference) / reference;
+			squared_error[t] += relative_error * relative_error;
+		}
+	}
+	float uniform_rmse = (float)sqrt(squared_error[0] / points);
+	float power_rmse = (float)sqrt(squared_error[1] / points);
+	passed = passed && power_rmse < uniform_rmse;
+	out << "  " << lights << " point lights, " << light_samples << " samples per point: relative RMSE " << power_rmse
+		<< " by power, " << uniform_rmse << " uniform" << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,78 @@
+#include "host_tests.h"
+#include "../area_cdf.h"
+#include "../chi_square.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+bool area_cdf_report(std::ostream& out)
+{
+	const unsigned int grid = 32, bins = 16, samples = 1u << 20;
+	const double significance = 0.01;
+	std::mt19937 generator(32);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	// grid lines at (i/grid)^3 in object space, and the world space map
+	// (x, y) -> (3x + y, 0.5y, x - y) of area |(-0.5, 4, 1.5)| = 4.30
+	auto line = [&](unsigned int i) { float t = (float)i / grid; return t*t*t; };
+	auto world = [](const optix::float2& p) { return optix::make_float3(3.0f*p.x + p.y, 0.5f*p.y, p.x - p.y); };
+	std::vector<optix::float2> vertices;
+	for (unsigned int i = 0; i < grid; ++i)
+		for (unsigned int j = 0; j < grid; ++j)
+		{
+			optix::float2 p00 = optix::make_float2(line(i), line(j)), p10 = optix::make_float2(line(i + 1), line(j));
+			optix::float2 p01 = optix::make_float2(line(i), line(j + 1)), p11 = optix::make_float2(line(i + 1), line(j + 1));
+			vertices.insert(vertices.end(), { p00, p10, p11, p00, p11, p01 });
+		}
+	unsigned int triangles = (unsigned int)vertices.size() / 3;
+	std::vector<float> cdf(triangles);
+	for (unsigned int i = 0; i < triangles; ++i)
+	{
+		optix::float3 v0 = world(vertices[3 * i]), v1 = world(vertices[3 * i + 1]), v2 = world(vertices[3 * i + 2]);
+		cdf[i] = 0.5f*optix::length(optix::cross(v1 - v0, v2 - v0));
+	}
+	double area = build_area_cdf(cdf.data(), triangles);
+	double exact_area = sqrt(0.25 + 16.0 + 2.25);
+	bool area_valid = fabs(area / exact_area - 1.0) < 1.0e-5;
+	passed = passed && area_valid;
+	out << "Subsurface sample coverage: " << triangles << " triangles, areas from " << cdf[0] / area << " to "
+		<< (cdf[triangles - 1] - cdf[triangles - 2]) << " of the surface, total area " << area << " of " << exact_area
+		<< (area_valid ? "" : " FAILED") << std::endl;
+
+	// sample_camera first, then the uniform choice of a triangle it replaced
+	const char* names[2] = { "by area", "uniform triangles" };
+	for (int t = 0; t < 2; ++t)
+	{
+		std::vector<unsigned int> observed(bins*bins, 0u);
+		for (unsigned int s = 0; s < samples; ++s)
+		{
+			float xi = uniform(generator);
+			unsigned int triangle = t == 0 ? sample_area_cdf(cdf, 0u, triangles, xi) : std::min((unsigned int)(xi*triangles), triangles - 1);
+			float xi1 = sqrtf(uniform(generator));
+			float xi2 = uniform(generator);
+			// the map is affine, so the barycentric coordinates are the
+			// same in object and world space
+			optix::float2 p = (1.0f - xi1)*vertices[3 * triangle] + (1.0f - xi2)*xi1*vertices[3 * triangle + 1] + xi1*xi2*vertices[3 * triangle + 2];
+			unsigned int x = std::min((unsigned int)(p.x*bins), bins - 1);
+			unsigned int y = std::min((unsigned int)(p.y*bins), bins - 1);
+			++observed[x*bins + y];
+		}
+		std::vector<double> expected(bins*bins, (double)samples / (bins*bins));
+		double p_value = chi_square_test(observed, expected);
+		unsigned int most = *std::max_element(observed.begin(), observed.end());
+		bool valid = t == 0 ? p_value > significance / 2.0 : p_value < significance / 2.0;
+		passed = passed && valid;
+		out << "  " << names[t] << ": p-value " << p_value << ", densest cell " << most / expected[0] << " times the mean"
+			<< (valid ? "" : " FAILED") << std::endl;
+	}
+
+	// degenerate meshes, and the ends of [0, 1)
+	std::vector<float> degenerate(4, 0.0f);
+	bool degenerate_valid = build_area_cdf(degenerate.data(), 4) == 0.0 && sample_area_cdf(degenerate, 0u, 4u, 0.3f) == 1u;
+	bool ends_valid = sample_area_cdf(cdf, 0u, triangles, 0.0f) == 0u && sample_area_cdf(cdf, 0u, triangles, 0.99999994f) == triangles - 1;
+	passed = passed && degenerate_valid && ends_valid;
+	out << "  degenerate mesh " << (degenerate_valid ? "uniform" : "FAILED") << ", ends of [0, 1) " << (ends_valid ? "found" : "FAILED") << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
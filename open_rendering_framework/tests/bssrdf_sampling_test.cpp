@@ -0,0 +1,150 @@
+#include "host_tests.h"
+#include "../dipoles/bssrdf_sampling.h"
+#include <random>
+#include <vector>
+
+bool bssrdf_sampling_report(std::ostream& out)
+{
+	const float cdf_tolerance = 1.0e-4f;
+	const float integral_tolerance = 1.0e-2f;
+	const unsigned int count = 1 << 20;
+	const float mfp[3] = { 0.25f, 0.5f, 1.0f };
+
+	ScatteringMaterialProperties properties;
+	properties.dipole_effective_radius = 12.0f;
+	properties.dipole_profile_r_min = 0.1f;
+	properties.dipole_profile_inv_log_range = 1.0f / logf(1.0f + properties.dipole_effective_radius / properties.dipole_profile_r_min);
+	auto exact_profile = [&](float r) {
+		return optix::make_float3(expf(-r / mfp[0]), expf(-r / mfp[1]), expf(-r / mfp[2]));
+	};
+	std::vector<optix::float3> profile(DIPOLE_PROFILE_SIZE), cdf(DIPOLE_PROFILE_SIZE);
+	for (unsigned int i = 0; i < DIPOLE_PROFILE_SIZE; ++i)
+		profile[i] = exact_profile(bssrdf_table_radius(i, properties));
+	compute_dipole_cdf(properties, profile.data(), cdf.data());
+
+	bool valid = true;
+	out << "BSSRDF sampling, " << count << " probes per surface" << std::endl;
+
+	// the pdf integrates to one over the disk of the effective radius, and
+	// the CDF of the sampled radius is xi
+	const unsigned int steps = 1 << 18;
+	for (int c = 0; c < 3; ++c)
+	{
+		double integral = 0.0;
+		double dr = properties.dipole_effective_radius / steps;
+		for (unsigned int i = 0; i < steps; ++i)
+		{
+			double r = (i + 0.5)*dr;
+			integral += bssrdf_radius_pdf((float)r, c, properties, cdf) * 2.0*M_PIf*r*dr;
+		}
+		float inversion_error = 0.0f;
+		for (unsigned int i = 0; i < steps; ++i)
+		{
+			float xi = (i + 0.5f) / steps;
+			float r = bssrdf_sample_radius(xi, c, properties, cdf);
+			unsigned int k = 0;
+			while (k + 2 < DIPOLE_PROFILE_SIZE && bssrdf_table_radius(k + 1, properties) <= r)
+				++k;
+			float r0 = bssrdf_table_radius(k, properties);
+			float r1 = bssrdf_table_radius(k + 1, properties);
+			float c0 = optix::getByIndex(cdf[k], c);
+			float c1 = optix::getByIndex(cdf[k + 1], c);
+			float value = c0 + (r*r - r0*r0) / (r1*r1 - r0*r0)*(c1 - c0);
+			inversion_error = fmaxf(inversion_error, fabsf(value - xi));
+		}
+		bool channel_valid = fabs(integral - 1.0) < cdf_tolerance && inversion_error < cdf_tolerance;
+		out << "  channel " << c << ": pdf integral " << integral << ", CDF inversion error " << inversion_error << (channel_valid ? "" : " FAILED") << std::endl;
+		valid = valid && channel_valid;
+	}
+
+	// Surfaces given by the points where a line crosses them, at most two
+	struct Surface
+	{
+		const char* name;
+		float radius;
+		optix::float3 xo, no;
+	};
+	const Surface surfaces[] = {
+		{ "plane", 0.0f, optix::make_float3(0.0f), optix::make_float3(0.0f, 0.0f, 1.0f) },
+		{ "sphere of radius 1", 1.0f, optix::make_float3(0.0f, 0.0f, 1.0f), optix::make_float3(0.0f, 0.0f, 1.0f) },
+		{ "sphere of radius 3", 3.0f, optix::make_float3(0.0f, 0.0f, 3.0f), optix::make_float3(0.0f, 0.0f, 1.0f) },
+	};
+	std::mt19937 generator(2014);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	for (const Surface& surface : surfaces)
+	{
+		// quadrature of the tabulated profile over the distance from xo
+		optix::float3 reference = optix::make_float3(0.0f);
+		if (surface.radius == 0.0f)
+		{
+			double dr = properties.dipole_effective_radius / steps;
+			for (unsigned int i = 0; i < steps; ++i)
+			{
+				float r = (i + 0.5f)*(float)dr;
+				reference += dipole_bssrdf_tabulated(r, properties, profile) * (2.0f*M_PIf*r*(float)dr);
+			}
+		}
+		else
+		{
+			double dtheta = M_PIf / steps;
+			for (unsigned int i = 0; i < steps; ++i)
+			{
+				float theta = (i + 0.5f)*(float)dtheta;
+				float r = 2.0f*surface.radius*sinf(0.5f*theta);
+				reference += dipole_bssrdf_tabulated(r, properties, profile) * (2.0f*M_PIf*surface.radius*surface.radius*sinf(theta)*(float)dtheta);
+			}
+		}
+
+		optix::float3 estimate = optix::make_float3(0.0f);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			BSSRDFProbe probe;
+			if (!bssrdf_sample_probe(surface.xo, surface.no, uniform(generator), uniform(generator), uniform(generator), uniform(generator), properties, cdf, probe))
+				continue;
+			float hits_t[2];
+			unsigned int hits = 0;
+			if (surface.radius == 0.0f)
+			{
+				if (probe.direction.z != 0.0f)
+				{
+					float t = -probe.origin.z / probe.direction.z;
+					if (t >= 0.0f && t <= probe.length)
+						hits_t[hits++] = t;
+				}
+			}
+			else
+			{
+				// the sphere is centered in the origin
+				float b = optix::dot(probe.origin, probe.direction);
+				float discriminant = b*b - (optix::dot(probe.origin, probe.origin) - surface.radius*surface.radius);
+				if (discriminant > 0.0f)
+				{
+					float root = sqrtf(discriminant);
+					for (float t : { -b - root, -b + root })
+						if (t >= 0.0f && t <= probe.length)
+							hits_t[hits++] = t;
+				}
+			}
+			if (hits == 0)
+				continue;
+			float t = hits_t[std::min((unsigned int)(uniform(generator)*hits), hits - 1)];
+			optix::float3 xi = probe.origin + t*probe.direction;
+			optix::float3 ni = surface.radius == 0.0f ? surface.no : xi / surface.radius;
+			float pdf = bssrdf_probe_pdf(surface.xo, surface.no, xi, ni, properties, cdf) / hits;
+			if (pdf > 0.0f)
+				estimate += dipole_bssrdf_tabulated(optix::length(xi - surface.xo), properties, profile) / pdf;
+		}
+		estimate /= (float)count;
+
+		float error = 0.0f;
+		for (int c = 0; c < 3; ++c)
+			error = fmaxf(error, fabsf(optix::getByIndex(estimate, c) / optix::getByIndex(reference, c) - 1.0f));
+		bool surface_valid = error < integral_tolerance;
+		out << "  " << surface.name << ": integral " << reference.x << " " << reference.y << " " << reference.z
+			<< ", estimate " << estimate.x << " " << estimate.y << " " << estimate.z
+			<< ", relative error " << error << (surface_valid ? "" : " FAILED") << std::endl;
+		valid = valid && surface_valid;
+	}
+	out << (valid ? "passed" : "FAILED") << std::endl;
+	return valid;
+}
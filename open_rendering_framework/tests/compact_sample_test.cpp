@@ -0,0 +1,76 @@
+#include "host_tests.h"
+#include "../compact_sample.h"
+#include <cfloat>
+#include <random>
+
+bool compact_sample_report(std::ostream& out)
+{
+	std::mt19937 rng(2020);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	auto random_direction = [&]() {
+		float z = 2.0f * uniform(rng) - 1.0f;
+		float phi = 2.0f * M_PIf * uniform(rng);
+		float r = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+		return optix::make_float3(r * cosf(phi), r * sinf(phi), z);
+	};
+	auto angle = [](const optix::float3& a, const optix::float3& b) {
+		// atan2 of the cross and dot products is accurate for small angles
+		return atan2f(optix::length(optix::cross(a, b)), optix::dot(a, b));
+	};
+	auto relative_error = [](const optix::float3& a, const optix::float3& b, float min_normal) {
+		float max_c = fmaxf(min_normal, fmaxf(a.x, fmaxf(a.y, a.z)));
+		optix::float3 d = a - b;
+		return fmaxf(fabsf(d.x), fmaxf(fabsf(d.y), fabsf(d.z))) / max_c;
+	};
+
+	const optix::float3 bbox_min = optix::make_float3(-1.3f, 0.2f, -5.0f);
+	const optix::float3 bbox_max = optix::make_float3(2.1f, 3.3f, 1.0f);
+	const optix::float3 extent = bbox_max - bbox_min;
+	const int count = 1000000;
+	float pos_error = 0.0f, normal_error = 0.0f, dir_error = 0.0f, transmitted_error = 0.0f;
+	float weight_error = 0.0f, L_error = 0.0f;
+	for (int i = 0; i < count; ++i)
+	{
+		PositionSample sample;
+		sample.pos = bbox_min + optix::make_float3(uniform(rng), uniform(rng), uniform(rng)) * extent;
+		// the corners and faces of the box are the extremes of the quantization
+		if (i < 8)
+			sample.pos = optix::make_float3(i & 1 ? bbox_max.x : bbox_min.x, i & 2 ? bbox_max.y : bbox_min.y, i & 4 ? bbox_max.z : bbox_min.z);
+		sample.normal = random_direction();
+		sample.dir = random_direction();
+		sample.transmitted = random_direction();
+		float T12 = 1.5f * uniform(rng);
+		sample.weight = optix::make_float3(T12);
+		// radiance spanning twelve orders of magnitude, with unequal channels
+		float magnitude = powf(10.0f, 12.0f * uniform(rng) - 6.0f);
+		sample.L = magnitude * optix::make_float3(uniform(rng), uniform(rng), uniform(rng));
+		if (i % 16 == 0)
+			sample.L.y = 0.0f;
+
+		PositionSample decoded = decode_position_sample(encode_position_sample(sample, bbox_min, bbox_max), bbox_min, bbox_max);
+		optix::float3 d = (decoded.pos - sample.pos) / extent;
+		pos_error = fmaxf(pos_error, fmaxf(fabsf(d.x), fmaxf(fabsf(d.y), fabsf(d.z))));
+		normal_error = fmaxf(normal_error, angle(sample.normal, decoded.normal));
+		dir_error = fmaxf(dir_error, angle(sample.dir, decoded.dir));
+		transmitted_error = fmaxf(transmitted_error, angle(sample.transmitted, decoded.transmitted));
+		weight_error = fmaxf(weight_error, relative_error(sample.weight, decoded.weight, ldexpf(1.0f, -15)));
+		L_error = fmaxf(L_error, relative_error(sample.L, decoded.L, ldexpf(1.0f, -127)));
+	}
+	// quantization step plus the round-off of the decoding
+	const float pos_tolerance = 0.5f / ((1u << COMPACT_SAMPLE_POS_BITS_X) - 1u) + 4.0f * FLT_EPSILON;
+	const float direction_tolerance = 2.0e-4f;
+	const float weight_tolerance = 1.0f / (1 << 9) + FLT_EPSILON;
+	const float L_tolerance = 1.0f / (1 << 18) + FLT_EPSILON;
+	bool passed = pos_error <= pos_tolerance && normal_error <= direction_tolerance && dir_error <= direction_tolerance &&
+		transmitted_error <= direction_tolerance && weight_error <= weight_tolerance && L_error <= L_tolerance;
+
+	out << "Compact position samples: " << sizeof(CompactPositionSample) << " bytes, " << sizeof(PositionSample) << " bytes uncompressed" << std::endl;
+	out << "  position    " << pos_error << " of the extent (tolerance " << pos_tolerance << ")" << std::endl;
+	out << "  normal      " << normal_error << " rad (tolerance " << direction_tolerance << ")" << std::endl;
+	out << "  dir         " << dir_error << " rad" << std::endl;
+	out << "  transmitted " << transmitted_error << " rad" << std::endl;
+	out << "  weight      " << weight_error << " relative (tolerance " << weight_tolerance << ")" << std::endl;
+	out << "  L           " << L_error << " relative (tolerance " << L_tolerance << ")" << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
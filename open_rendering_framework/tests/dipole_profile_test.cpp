@@ -0,0 +1,157 @@
+#include "host_tests.h"
+#include "../Fresnel.h"
+#include "../dipoles/dipole_profile.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// The derived parameters of ScatteringMaterial::computeCoefficients in air
+	ScatteringMaterialProperties material_properties(const optix::float3& absorption, const optix::float3& scattering, const optix::float3& meancosine, float ior)
+	{
+		ScatteringMaterialProperties properties;
+		properties.absorption = absorption;
+		properties.scattering = scattering;
+		properties.meancosine = meancosine;
+		properties.relative_ior = ior;
+		properties.ior_real = optix::make_float3(ior);
+		properties.ior_imag = optix::make_float3(0.0f);
+		optix::float3 reducedScattering = properties.scattering*(1.0f - properties.meancosine);
+		properties.extinction = properties.scattering + properties.absorption;
+		properties.reducedExtinction = reducedScattering + properties.absorption;
+		properties.deltaEddExtinction = properties.scattering*(1.0f - properties.meancosine*properties.meancosine) + properties.absorption;
+		properties.D = optix::make_float3(1.0f) / (3.0f*properties.reducedExtinction);
+		properties.transport = sqrtf(properties.absorption / properties.D);
+		properties.C_phi = optix::make_float3(C_phi(ior));
+		properties.C_phi_inv = optix::make_float3(C_phi(1.0f / ior));
+		properties.C_E = optix::make_float3(C_E(ior));
+		properties.albedo = properties.scattering / properties.extinction;
+		properties.reducedAlbedo = reducedScattering / properties.reducedExtinction;
+		properties.de = 2.131f*properties.D / sqrtf(properties.reducedAlbedo);
+		properties.A = (1.0f - properties.C_E) / (2.0f*properties.C_phi);
+		properties.three_D = 3.0f*properties.D;
+		properties.two_A_de = 2.0f*properties.A*properties.de;
+		properties.global_coeff = optix::make_float3(1.0f) / (4.0f*properties.C_phi_inv) * 1.0f / (4.0f*M_PIf*M_PIf);
+		properties.one_over_three_ext = optix::make_float3(1.0f) / (3.0f*properties.extinction);
+		properties.mean_transport = (properties.transport.x + properties.transport.y + properties.transport.z) / 3.0f;
+		return properties;
+	}
+
+	template<typename Evaluate>
+	double nanoseconds_per_evaluation(unsigned int count, const Evaluate& evaluate)
+	{
+		const int repetitions = 5;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repetitions; ++r)
+			evaluate();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count() / (repetitions*(double)count);
+	}
+}
+
+bool dipole_profile_report(std::ostream& out)
+{
+	const float profile_tolerance = 1.0e-3f;
+	const float dropped_tolerance = 2.0f*DIPOLE_PROFILE_EPSILON;
+	const unsigned int count = 1 << 20;
+	const float scale = 100.0f;
+	// the default materials of ScatteringMaterial::getDefaultMaterial
+	const struct
+	{
+		const char* name;
+		optix::float3 absorption, scattering, meancosine;
+		float ior;
+	} materials[] = {
+		{ "apple", optix::make_float3(0.0030f, 0.0034f, 0.0046f), optix::make_float3(2.29f, 2.39f, 1.97f), optix::make_float3(0.0f), 1.3f },
+		{ "marble", optix::make_float3(0.0021f, 0.0041f, 0.0071f), optix::make_float3(2.19f, 2.62f, 3.00f), optix::make_float3(0.0f), 1.5f },
+		{ "potato", optix::make_float3(0.0024f, 0.0090f, 0.12f), optix::make_float3(0.68f, 0.70f, 0.55f), optix::make_float3(0.0f), 1.3f },
+		{ "skin", optix::make_float3(0.032f, 0.17f, 0.48f), optix::make_float3(0.74f, 0.88f, 1.01f), optix::make_float3(0.0f), 1.3f },
+		{ "chocolate milk", optix::make_float3(0.0007f, 0.003f, 0.01f), optix::make_float3(0.7352f, 0.9142f, 1.0588f), optix::make_float3(0.862f, 0.838f, 0.806f), 1.3f },
+		{ "soymilk", optix::make_float3(0.0001f, 0.0005f, 0.0034f), optix::make_float3(2.433f, 2.714f, 4.563f), optix::make_float3(0.873f, 0.858f, 0.832f), 1.3f },
+		{ "white grapefruit", optix::make_float3(0.096f, 0.131f, 0.395f), optix::make_float3(3.513f, 3.669f, 5.237f), optix::make_float3(0.548f, 0.545f, 0.565f), 1.3f },
+		{ "reduced milk", optix::make_float3(0.0001f, 0.0002f, 0.0005f), optix::make_float3(10.748f, 12.209f, 13.931f), optix::make_float3(0.819f, 0.797f, 0.746f), 1.3f },
+		{ "ketchup", optix::make_float3(0.061f, 0.97f, 1.45f), optix::make_float3(0.18f, 0.07f, 0.03f), optix::make_float3(0.0f), 1.3f },
+		{ "whole milk", optix::make_float3(0.0011f, 0.0024f, 0.014f), optix::make_float3(2.55f, 3.21f, 3.77f), optix::make_float3(0.0f), 1.3f },
+		{ "chicken", optix::make_float3(0.015f, 0.077f, 0.19f), optix::make_float3(0.15f, 0.21f, 0.38f), optix::make_float3(0.0f), 1.3f },
+		{ "beer", optix::make_float3(0.1449f, 0.3141f, 0.7286f), optix::make_float3(0.0037f, 0.0069f, 0.0074f), optix::make_float3(0.917f, 0.956f, 0.982f), 1.3f },
+		{ "coffee", optix::make_float3(0.1669f, 0.2287f, 0.3078f), optix::make_float3(0.2707f, 0.2828f, 0.297f), optix::make_float3(0.907f, 0.896f, 0.88f), 1.3f },
+		{ "shampoo", optix::make_float3(0.178f, 0.328f, 0.439f), optix::make_float3(8.111f, 9.919f, 10.575f), optix::make_float3(0.907f, 0.882f, 0.874f), 1.3f },
+		{ "mustard", optix::make_float3(0.057f, 0.061f, 0.451f), optix::make_float3(16.447f, 18.536f, 6.457f), optix::make_float3(0.155f, 0.173f, 0.351f), 1.3f },
+		{ "mixed soap", optix::make_float3(0.003f, 0.005f, 0.013f), optix::make_float3(3.923f, 4.018f, 4.351f), optix::make_float3(0.330f, 0.322f, 0.316f), 1.3f },
+		{ "glycerine soap", optix::make_float3(0.001f, 0.001f, 0.002f), optix::make_float3(0.201f, 0.202f, 0.221f), optix::make_float3(0.955f, 0.949f, 0.943f), 1.3f },
+	};
+
+	bool valid = true;
+	out << "Tabulated dipole against dipole_bssrdf, per material: effective radius, largest error of r R(r) "
+		<< "relative to its peak (tolerance " << profile_tolerance << "), relative error of the power inside the radius, "
+		<< "power dropped beyond the radius (tolerance " << dropped_tolerance << "), ns per evaluation of dipole_bssrdf and of the table" << std::endl;
+	std::mt19937 generator(2014);
+	for (const auto& material : materials)
+	{
+		ScatteringMaterialProperties properties = material_properties(scale*material.absorption, scale*material.scattering, material.meancosine, material.ior);
+		std::vector<optix::float3> profile(DIPOLE_PROFILE_SIZE);
+		compute_dipole_profile(properties, profile.data());
+		const float radius = properties.dipole_effective_radius;
+
+		// power r R(r) on a grid uniform in the table coordinate, with
+		// several points between entries, and its integral in 2 pi r dr
+		// up to far beyond the radius, where the profile has vanished
+		const unsigned int steps = 1 << 16;
+		const float far_range = 100.0f;
+		float peak[3] = { 0.0f, 0.0f, 0.0f }, max_error[3] = { 0.0f, 0.0f, 0.0f };
+		double inside[3] = { 0.0, 0.0, 0.0 }, tabulated[3] = { 0.0, 0.0, 0.0 }, beyond[3] = { 0.0, 0.0, 0.0 };
+		float far_inv_log_range = 1.0f / logf(1.0f + far_range*radius / properties.dipole_profile_r_min);
+		float previous = 0.0f;
+		for (unsigned int i = 1; i <= steps; ++i)
+		{
+			float r = properties.dipole_profile_r_min*(expf(i / (float)steps / far_inv_log_range) - 1.0f);
+			float r_mid = 0.5f*(r + previous);
+			float dr = r - previous;
+			previous = r;
+			optix::float3 exact = dipole_bssrdf(r_mid, properties);
+			optix::float3 table = dipole_bssrdf_tabulated(r_mid, properties, profile);
+			for (int c = 0; c < 3; ++c)
+			{
+				double power = 2.0*M_PIf*r_mid*dr*optix::getByIndex(exact, c);
+				if (r_mid < radius)
+				{
+					inside[c] += power;
+					tabulated[c] += 2.0*M_PIf*r_mid*dr*optix::getByIndex(table, c);
+					peak[c] = fmaxf(peak[c], r_mid*optix::getByIndex(exact, c));
+					max_error[c] = fmaxf(max_error[c], r_mid*fabsf(optix::getByIndex(table, c) - optix::getByIndex(exact, c)));
+				}
+				else
+					beyond[c] += power;
+			}
+		}
+		float profile_error = 0.0f, integral_error = 0.0f, dropped = 0.0f;
+		for (int c = 0; c < 3; ++c)
+		{
+			profile_error = fmaxf(profile_error, max_error[c] / peak[c]);
+			integral_error = fmaxf(integral_error, (float)fabs(tabulated[c] / inside[c] - 1.0));
+			dropped = fmaxf(dropped, (float)(beyond[c] / (inside[c] + beyond[c])));
+		}
+
+		std::vector<float> dists(count);
+		std::uniform_real_distribution<float> uniform(0.0f, radius);
+		for (float& d : dists)
+			d = uniform(generator);
+		std::vector<optix::float3> results(count);
+		double exact_ns = nanoseconds_per_evaluation(count, [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+				results[i] = dipole_bssrdf(dists[i], properties);
+		});
+		double table_ns = nanoseconds_per_evaluation(count, [&]() {
+			for (unsigned int i = 0; i < count; ++i)
+				results[i] = dipole_bssrdf_tabulated(dists[i], properties, profile);
+		});
+
+		bool material_valid = profile_error < profile_tolerance && dropped < dropped_tolerance;
+		valid = valid && material_valid;
+		out << "  " << material.name << ": " << radius << ", " << profile_error << " " << integral_error << " " << dropped
+			<< (material_valid ? "" : " FAILED") << ", " << exact_ns << " " << table_ns << std::endl;
+	}
+	out << (valid ? "passed" : "FAILED") << std::endl;
+	return valid;
+}
@@ -0,0 +1,49 @@
+#include "host_tests.h"
+#include <cstring>
+#include <iostream>
+
+// Runs the tests named on the command line, or all of them without
+// arguments, and exits with a nonzero status if a test fails
+int main(int argc, char *argv[])
+{
+	const struct
+	{
+		const char* flag;
+		bool(*report)(std::ostream&);
+	} tests[] = {
+		{ "--sobol", sobol_report },
+		{ "--alias-table", alias_table_report },
+		{ "--triangle-light-table", triangle_light_table_report },
+		{ "--sphere-sampling", sphere_sampling_report },
+		{ "--spherical-triangle", spherical_triangle_report },
+		{ "--sss-coverage", area_cdf_report },
+		{ "--mis", mis_report },
+		{ "--russian-roulette", russian_roulette_report },
+		{ "--reservoir", reservoir_report },
+		{ "--compact-sample", compact_sample_report },
+		{ "--bssrdf-sampling", bssrdf_sampling_report },
+		{ "--dipole-profile", dipole_profile_report },
+		{ "--sss-allocation", sss_allocation_report },
+	};
+
+	bool passed = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		bool found = false;
+		for (const auto& test : tests)
+			if (strcmp(argv[i], test.flag) == 0)
+			{
+				passed = test.report(std::cout) && passed;
+				found = true;
+			}
+		if (!found)
+		{
+			std::cerr << "Unknown test " << argv[i] << std::endl;
+			return 2;
+		}
+	}
+	if (argc == 1)
+		for (const auto& test : tests)
+			passed = test.report(std::cout) && passed;
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+#ifndef HOST_TESTS_H
+#define HOST_TESTS_H
+
+#include <cmath>
+#include <ostream>
+
+// Tests of the sampling headers, built for the host by the host_tests
+// target. Each test prints its results and returns false if a check fails.
+
+// Mean and variance of an estimator from its independent samples
+struct SampleMean
+{
+	double sum = 0.0;
+	double sum_sqr = 0.0;
+	unsigned long long count = 0;
+
+	void add(double x)
+	{
+		sum += x;
+		sum_sqr += x*x;
+		++count;
+	}
+	double mean() const { return sum / count; }
+	double variance() const { return fmax(sum_sqr / count - mean()*mean(), 0.0); }
+	double relative_bias(double reference) const { return mean() / reference - 1.0; }
+	double relative_variance(double reference) const { return variance() / (reference*reference); }
+	// within four standard errors of the reference, plus tolerance times the
+	// reference for the float round-off of the estimates
+	bool unbiased(double reference, double tolerance) const
+	{
+		return fabs(mean() - reference) < 4.0*sqrt(variance() / count) + tolerance*reference;
+	}
+};
+
+// Checks that the first 2^k samples of every pixel, slot and digital shift
+// place exactly one point in every elementary interval of area 2^-k (in one
+// dimension, in every interval of length 2^-k), which is the stratification
+// of a (0,2)-sequence, and compares the RMSE over many pixels of a smooth and
+// a discontinuous integrand with independent rnd_tea samples. Returns false
+// if a set is not stratified, the sampler does not beat rnd_tea at every
+// sample count, or its error on the smooth integrand does not converge faster
+// than N^-1.
+bool sobol_report(std::ostream& out);
+
+// Samples alias tables of weights with zeros, outliers and dynamic ranges
+// up to 10^6, and checks the stored pmfs against the weights, the sampled
+// frequencies with chi-square tests and that the reused part of the sample
+// is uniform. Then compares the noise of one light sample per shading point
+// between uniform and power-proportional selection, with an equal number of
+// samples, among point lights of unequal intensity above a plane.
+// Returns false if a test fails or the alias table is noisier.
+bool alias_table_report(std::ostream& out);
+
+// Builds the table of a unit square emitter split into strips whose widths
+// fall by powers of two, so that slivers far outnumber the large triangles,
+// with per-triangle emission that the shaders ignore. Checks that the pmfs
+// are proportional to area, also for a black light, and compares the
+// irradiance noise below the emitter at an equal number of samples between
+// the table and the uniform choice of a triangle it replaces.
+// Returns false if the pmfs are wrong, the estimates disagree or the table
+// is noisier.
+bool triangle_light_table_report(std::ostream& out);
+
+// Irradiance from a unit radiance sphere at distance / radius ratios from
+// just outside the surface to 1000, on receivers facing the center and
+// tilted so that the sphere stays above their horizon, where it is exactly
+// pi sin^2(theta_max) cos(tilt). Checks that the samples lie in the cone on
+// the visible side of the sphere, that the solid angle and the area sampling
+// of the facing hemisphere it replaced are unbiased, and compares their
+// variance at an equal number of samples. The irradiance of the inside of
+// the sphere, 4 pi for a receiver without cosine, checks the fallback.
+// Returns false if an estimate is biased, a sample lies outside the cone or
+// the solid angle sampling is noisier.
+bool sphere_sampling_report(std::ostream& out);
+
+// Samples spherical triangles from a large one close to the point, through
+// unit and obtuse ones, to one of a few 1e-4 sr, all above the horizon of a
+// tilted receiver. Checks that the pdf matches the solid angle of the
+// triangle, that the directions are uniform in it with a chi-square test
+// over the solid angles of 64 sub-triangles, and that the irradiance of
+// unit radiance is unbiased against the exact formula of Lambert, then
+// compares the variance with the area sampling it replaces.
+// Returns false if a test fails or the solid angle sampling is noisier.
+bool spherical_triangle_report(std::ostream& out);
+
+// Tessellates the unit square with a grid whose spacing falls from 0.09 to
+// 3e-5 towards one corner, maps it to world space with a non uniform scale
+// and a shear, and samples points as sample_camera does. Checks with
+// chi-square tests over a 16x16 grid of equal world space areas that the
+// points cover the surface uniformly, and that picking triangles uniformly,
+// as before, does not. Also checks the total area, the fallback of
+// degenerate meshes and the search at the ends of [0, 1).
+// Returns false if a test fails.
+bool area_cdf_report(std::ostream& out);
+
+// Checks that the weights of both heuristics sum to one for pdfs from zero
+// to where their squares would overflow. Then estimates the light reflected
+// by a diffuse receiver lit by a sphere at several distances and tilts, as
+// diffuse_shader does: one light sample of the subtended cone, and one
+// cosine weighted direction, continued with probability equal to the albedo.
+// The MIS estimate must be unbiased against the exact value. Weights that
+// leave that probability out of the BSDF pdf still sum to one, so their
+// estimate is unbiased as well, but noisier.
+// Returns false if a sum differs from one, the estimate is biased or it is
+// noisier than without the probability.
+bool mis_report(std::ostream& out);
+
+// Follows paths through closed scenes where every bounce scales the
+// throughput by a colored albedo times a random factor of mean one and
+// finds an emitter with probability 0.1, as the shaders continue paths with
+// trace_radiance, with the roulette of the default parameters and with the
+// fixed depth max_depth alone. Reports the relative variance and the
+// bounces and time per path, and the efficiency of the roulette relative
+// to fixed depth, the ratio of variance times cost.
+// Returns false if an estimate is biased or the roulette is less efficient
+// per bounce.
+bool russian_roulette_report(std::ostream& out);
+
+// Streams candidate lights, drawn from a source pmf unlike the target, into
+// reservoirs. Checks with chi-square tests that the kept light is chosen in
+// proportion to its resampling weight, that zero weights are never kept but
+// counted in M, and that f W estimates the sum of f without bias, where f is
+// the target times a visibility as in the shaders, for 1 to 16 candidates.
+// Merging 4 reservoirs of M candidates must be as unbiased, and as noisy,
+// as streaming 4M candidates into one. Merging the reservoir of a shading
+// point whose target is zero on other lights must be unbiased when only
+// the candidates that could have kept the sample are counted.
+// Returns false if a test fails.
+bool reservoir_report(std::ostream& out);
+
+// Encodes random samples in a bounding box and reports the largest decoding
+// errors: position error relative to the box extent, angle between unit
+// vectors in radians, and weight and radiance error relative to their
+// largest channel (or to the smallest normal value of the format, below
+// which the precision drops). Returns false if any exceeds the precision of its format.
+bool compact_sample_report(std::ostream& out);
+
+// Checks the sampling on a profile of exponentials in every channel, with
+// mean free paths a factor of two apart: the normalization of the radial
+// pdf, the inversion of its CDF and, for a plane and for a sphere, the
+// integral of the profile over the surface estimated with probe samples
+// against quadrature. Returns false if an error exceeds its tolerance.
+bool bssrdf_sampling_report(std::ostream& out);
+
+// Compares the tabulated standard dipole with dipole_bssrdf for the default
+// materials: the largest error of the power r R(r) within the effective
+// radius relative to its peak, and the power beyond the radius, which the
+// gather shaders skip. Reports the time per evaluation of both.
+// Returns false if the error or the skipped power exceeds its tolerance.
+bool dipole_profile_report(std::ostream& out);
+
+// Splits the subsurface samples of the fixed split, SAMPLES_FRAME per
+// object, among a hero object filling 40% of the image, a small object and
+// an off-screen one, and compares the sum over the objects of screen
+// coverage times the variance of the gather with its optimum. Also checks
+// the coverage of the boxes, and the even splits when nothing is on screen
+// or the budget is below the minimum.
+// Returns false if a check fails, the variance is 2% above the optimum or
+// the gain over the fixed split is below 1.5.
+bool sss_allocation_report(std::ostream& out);
+
+#endif // HOST_TESTS_H
@@ -0,0 +1,79 @@
+#include "host_tests.h"
+#include "../mis.h"
+#include "../solid_angle_sampling.h"
+#include <random>
+
+bool mis_report(std::ostream& out)
+{
+	const unsigned int pairs = 1u << 20, samples = 1u << 20;
+	std::mt19937 generator(33);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	float sum_error = 0.0f;
+	const float special[] = { 0.0f, 1.0e-30f, 1.0e-10f, 1.0f, 1.0e10f, 1.0e18f, 2.0e18f, 1.0e30f };
+	for (float a : special)
+		for (float b : special)
+		{
+			if (a == 0.0f && b == 0.0f)
+				continue;
+			sum_error = fmaxf(sum_error, fabsf(mis_balance_heuristic(a, b) + mis_balance_heuristic(b, a) - 1.0f));
+			sum_error = fmaxf(sum_error, fabsf(mis_power_heuristic(a, b) + mis_power_heuristic(b, a) - 1.0f));
+		}
+	for (unsigned int i = 0; i < pairs; ++i)
+	{
+		float a = powf(10.0f, 40.0f*uniform(generator) - 20.0f);
+		float b = powf(10.0f, 40.0f*uniform(generator) - 20.0f);
+		sum_error = fmaxf(sum_error, fabsf(mis_balance_heuristic(a, b) + mis_balance_heuristic(b, a) - 1.0f));
+		sum_error = fmaxf(sum_error, fabsf(mis_power_heuristic(a, b) + mis_power_heuristic(b, a) - 1.0f));
+	}
+	bool zero_valid = mis_balance_heuristic(0.0f, 0.0f) == 0.0f && mis_power_heuristic(0.0f, 0.0f) == 0.0f;
+	passed = passed && sum_error < 1.0e-6f && zero_valid;
+	out << "MIS weights: largest error of the sums " << sum_error << " over " << pairs << " pairs of pdfs from 1e-20 to 1e20"
+		<< (zero_valid ? "" : ", weights of zero pdfs FAILED") << std::endl;
+
+	// unit radiance sphere above a receiver with normal z, albedo albedo
+	const float albedo = 0.4f, radius = 1.0f;
+	for (float distance : { 1.2f, 3.0f, 20.0f })
+		for (float tilt : { 0.0f, 0.5f })
+		{
+			optix::float3 center = distance*optix::make_float3(sinf(tilt), 0.0f, cosf(tilt));
+			float sin_theta_max = radius / distance;
+			if (tilt + asinf(sin_theta_max) > 0.5f*M_PIf)
+				continue;
+			double reference = albedo*sin_theta_max*sin_theta_max*cos(tilt);
+			// with and without the probability of the diffuse lobe in its pdf
+			SampleMean estimates[2];
+			for (unsigned int s = 0; s < samples; ++s)
+			{
+				optix::float3 light_pos, light_normal;
+				float light_pdf;
+				sample_sphere_solid_angle(optix::make_float3(0.0f), center, radius, optix::make_float2(uniform(generator), uniform(generator)), light_pos, light_normal, light_pdf);
+				float cos_light = optix::normalize(light_pos).z;
+				float u = uniform(generator);
+				float r = sqrtf(uniform(generator));
+				float phi = 2.0f*M_PIf*uniform(generator);
+				optix::float3 dir = optix::make_float3(r*cosf(phi), r*sinf(phi), sqrtf(fmaxf(1.0f - r*r, 0.0f)));
+				// the direction hits the sphere if it passes within the radius of the center
+				float t = optix::dot(dir, center);
+				bool hit = u < albedo && t > 0.0f && optix::dot(center, center) - t*t < radius*radius;
+				for (int k = 0; k < 2; ++k)
+				{
+					float lobe = k == 0 ? albedo : 1.0f;
+					double estimate = light_pdf > 0.0f && cos_light > 0.0f ?
+						albedo*M_1_PIf*cos_light / light_pdf*mis_power_heuristic(light_pdf, lobe*cos_light*M_1_PIf) : 0.0;
+					if (hit)
+						estimate += mis_power_heuristic(lobe*dir.z*M_1_PIf, sphere_solid_angle_pdf(optix::make_float3(0.0f), center, radius));
+					estimates[k].add(estimate);
+				}
+			}
+			bool valid = estimates[0].unbiased(reference, 1.0e-4) && estimates[1].unbiased(reference, 1.0e-4) && estimates[0].variance() <= estimates[1].variance();
+			passed = passed && valid;
+			out << "  sphere at " << distance << " radii, tilt " << tilt << ": relative bias " << estimates[0].relative_bias(reference) << " with the lobe probability, "
+				<< estimates[1].relative_bias(reference) << " without, relative variance " << estimates[0].relative_variance(reference) << " with, "
+				<< estimates[1].relative_variance(reference) << " without"
+				<< (valid ? "" : " FAILED") << std::endl;
+		}
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
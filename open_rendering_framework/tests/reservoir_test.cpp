@@ -0,0 +1,174 @@
+#include "host_tests.h"
+#include "../reservoir.h"
+#include "../chi_square.h"
+#include <random>
+#include <vector>
+
+bool reservoir_report(std::ostream& out)
+{
+	const unsigned int lights = 16, trials = 1u << 20;
+	const double significance = 0.01;
+	std::mt19937 generator(35);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	// source pmf, target and visibility of every light, two of them with a
+	// zero target and one occluded
+	std::vector<float> source(lights), target(lights), visibility(lights, 1.0f), cdf(lights);
+	float source_sum = 0.0f;
+	for (unsigned int i = 0; i < lights; ++i)
+	{
+		source[i] = 1.0f + (float)(i % 4);
+		target[i] = i % 7 == 2 ? 0.0f : 0.2f + uniform(generator);
+		source_sum += source[i];
+	}
+	visibility[5] = 0.0f;
+	double reference = 0.0;
+	for (unsigned int i = 0; i < lights; ++i)
+	{
+		source[i] /= source_sum;
+		cdf[i] = (i > 0 ? cdf[i - 1] : 0.0f) + source[i];
+		reference += target[i] * visibility[i];
+	}
+	cdf[lights - 1] = 1.0f;
+	auto draw = [&]() {
+		float u = uniform(generator);
+		unsigned int i = 0;
+		while (i + 1 < lights && cdf[i] <= u)
+			++i;
+		return i;
+	};
+	// reservoir of candidates drawn from the source pmf
+	auto stream_target = [&](LightReservoir& r, unsigned int candidates, const std::vector<float>& f) {
+		reservoir_reset(r);
+		for (unsigned int c = 0; c < candidates; ++c)
+		{
+			unsigned int i = draw();
+			reservoir_update(r, i, -1, optix::make_float3(0.0f), f[i], f[i] / source[i], uniform(generator));
+		}
+		reservoir_finalize(r);
+	};
+	auto stream = [&](LightReservoir& r, unsigned int candidates) {
+		stream_target(r, candidates, target);
+	};
+
+	// choice among fixed weights, with zeros
+	{
+		std::vector<float> weights = { 0.0f, 3.0f, 1.0f, 0.0f, 0.5f, 2.5f, 0.0f, 1.0f };
+		unsigned int n = (unsigned int)weights.size();
+		float weight_sum = 0.0f;
+		for (float w : weights)
+			weight_sum += w;
+		std::vector<unsigned int> observed(n, 0u);
+		bool counted = true;
+		for (unsigned int t = 0; t < trials; ++t)
+		{
+			LightReservoir r;
+			reservoir_reset(r);
+			for (unsigned int i = 0; i < n; ++i)
+				reservoir_update(r, i, -1, optix::make_float3(0.0f), weights[i], weights[i], uniform(generator));
+			++observed[r.light_idx];
+			counted = counted && r.M == (float)n && r.w_sum == weight_sum;
+		}
+		std::vector<double> expected(n);
+		for (unsigned int i = 0; i < n; ++i)
+			expected[i] = weights[i] / weight_sum * trials;
+		double p_value = chi_square_test(observed, expected);
+		LightReservoir empty;
+		reservoir_reset(empty);
+		for (unsigned int i = 0; i < 4; ++i)
+			reservoir_update(empty, i, -1, optix::make_float3(0.0f), 0.0f, 0.0f, uniform(generator));
+		reservoir_finalize(empty);
+		bool empty_valid = empty.M == 4.0f && empty.W == 0.0f && empty.w_sum == 0.0f;
+		bool valid = p_value > significance / 4.0 && counted && empty_valid;
+		passed = passed && valid;
+		out << "Reservoirs: choice among " << n << " weights: p-value " << p_value << (counted ? "" : ", wrong M or weight sum")
+			<< (empty_valid ? "" : ", wrong reservoir of zero weights") << (valid ? "" : " FAILED") << std::endl;
+	}
+
+	// unbiased estimates f(y) W, and the choice of the kept light in
+	// proportion to target/source after merging
+	const unsigned int configurations[][2] = { { 1, 1 }, { 4, 1 }, { 16, 1 }, { 1, 4 }, { 4, 4 } };
+	double relative_variance[5];
+	for (int c = 0; c < 5; ++c)
+	{
+		unsigned int candidates = configurations[c][0], merged = configurations[c][1];
+		SampleMean estimates;
+		std::vector<unsigned int> observed(lights, 0u);
+		bool counted = true;
+		for (unsigned int t = 0; t < trials; ++t)
+		{
+			LightReservoir r;
+			stream(r, candidates);
+			for (unsigned int k = 1; k < merged; ++k)
+			{
+				LightReservoir other;
+				stream(other, candidates);
+				reservoir_merge(r, other, other.target, uniform(generator));
+			}
+			reservoir_finalize(r);
+			counted = counted && r.M == (float)(candidates*merged);
+			estimates.add(target[r.light_idx] * visibility[r.light_idx] * r.W);
+			if (r.W > 0.0f)
+				++observed[r.light_idx];
+		}
+		bool valid = estimates.unbiased(reference, 1.0e-4) && counted;
+		// with a single candidate the kept light follows the source pmf,
+		// with many it tends to the target
+		if (candidates == 1 && merged == 1)
+		{
+			std::vector<double> expected(lights);
+			for (unsigned int i = 0; i < lights; ++i)
+				expected[i] = target[i] > 0.0f ? source[i] * trials : 0.0;
+			double p_value = chi_square_test(observed, expected);
+			valid = valid && p_value > significance / 4.0;
+			out << "  1 candidate: kept lights p-value " << p_value << std::endl;
+		}
+		relative_variance[c] = estimates.relative_variance(reference);
+		passed = passed && valid;
+		out << "  " << candidates << " candidates, " << merged << (merged > 1 ? " reservoirs merged" : " reservoir") << ": relative bias "
+			<< estimates.relative_bias(reference) << ", relative variance " << relative_variance[c] << (counted ? "" : ", wrong M")
+			<< (valid ? "" : " FAILED") << std::endl;
+	}
+	// merged reservoirs against the single ones of as many candidates
+	double merge_error = fmax(fabs(relative_variance[3] / relative_variance[1] - 1.0), fabs(relative_variance[4] / relative_variance[2] - 1.0));
+	passed = passed && merge_error < 0.03;
+	out << "  merged and streamed variances differ by " << merge_error << (merge_error < 0.03 ? "" : " FAILED") << std::endl;
+
+	// reuse of the reservoir of another shading point, as the temporal reuse
+	// of sample_light_ris, where each point sees lights that the other does not
+	{
+		std::vector<float> previous_target(target);
+		for (unsigned int i = 0; i < lights; ++i)
+		{
+			if (i % 5 == 1)
+				previous_target[i] = 0.0f;
+			if (i % 5 == 3)
+				previous_target[i] = 0.5f + uniform(generator);
+		}
+		const unsigned int candidates = 4, history = 8;
+		SampleMean estimates, estimates_by_M;
+		for (unsigned int t = 0; t < trials; ++t)
+		{
+			LightReservoir previous, r;
+			stream_target(previous, history, previous_target);
+			stream(r, candidates);
+			float Z = r.M;
+			reservoir_merge(r, previous, target[previous.light_idx], uniform(generator));
+			if (previous_target[r.light_idx] > 0.0f)
+				Z += previous.M;
+			LightReservoir by_M = r;
+			reservoir_finalize(r, Z);
+			reservoir_finalize(by_M);
+			estimates.add(target[r.light_idx] * visibility[r.light_idx] * r.W);
+			estimates_by_M.add(target[by_M.light_idx] * visibility[by_M.light_idx] * by_M.W);
+		}
+		// dividing by M must be visibly biased for the check to mean anything
+		bool valid = estimates.unbiased(reference, 1.0e-4) && !estimates_by_M.unbiased(reference, 1.0e-2);
+		passed = passed && valid;
+		out << "  reuse across shading points: relative bias " << estimates.relative_bias(reference)
+			<< ", " << estimates_by_M.relative_bias(reference) << " when dividing by M" << (valid ? "" : " FAILED") << std::endl;
+	}
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,80 @@
+#include "host_tests.h"
+#include "../russian_roulette.h"
+#include <chrono>
+#include <random>
+
+bool russian_roulette_report(std::ostream& out)
+{
+	const unsigned int paths = 1u << 20;
+	const int start_depth = 3;
+	const float min_prob = 0.05f, emitter_prob = 0.1f;
+	std::mt19937 generator(34);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	struct Scene { const char* name; optix::float3 albedo; int max_depth; };
+	const Scene scenes[] = {
+		{ "diffuse", optix::make_float3(0.7f, 0.6f, 0.5f), 50 },
+		{ "dark", optix::make_float3(0.2f, 0.2f, 0.2f), 50 },
+		{ "translucent", optix::make_float3(0.95f, 0.95f, 0.9f), 100 },
+	};
+	out << "Russian roulette: " << paths << " paths, start depth " << start_depth << ", minimum survival " << min_prob << std::endl;
+	for (const Scene& scene : scenes)
+	{
+		// expected radiance of the mean of the channels, bounces 0 to max_depth
+		double reference = 0.0;
+		optix::float3 power = optix::make_float3(1.0f);
+		for (int depth = 0; depth <= scene.max_depth; ++depth)
+		{
+			reference += emitter_prob*(power.x + power.y + power.z) / 3.0;
+			power *= scene.albedo;
+		}
+
+		// fixed depth, then roulette
+		SampleMean estimates[2];
+		double bounces[2], seconds[2];
+		for (int r = 0; r < 2; ++r)
+		{
+			unsigned long long traced = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int p = 0; p < paths; ++p)
+			{
+				// factor is the product of the weights and inverse survival
+				// probabilities applied to the results on the way back
+				optix::float3 result = optix::make_float3(0.0f), factor = optix::make_float3(1.0f), throughput = optix::make_float3(1.0f);
+				for (int depth = 0; ; ++depth)
+				{
+					++traced;
+					if (uniform(generator) < emitter_prob)
+						result += factor;
+					if (depth == scene.max_depth)
+						break;
+					optix::float3 weight = scene.albedo*(0.5f + uniform(generator));
+					throughput *= weight;
+					float q = r == 1 ? russian_roulette_probability(throughput, depth + 1, start_depth, min_prob) : 1.0f;
+					if (q < 1.0f)
+					{
+						if (uniform(generator) >= q)
+							break;
+						throughput /= q;
+					}
+					factor *= weight / q;
+				}
+				estimates[r].add((result.x + result.y + result.z) / 3.0);
+			}
+			seconds[r] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / paths;
+			bounces[r] = (double)traced / paths;
+		}
+		double bounce_efficiency = estimates[0].variance() * bounces[0] / (estimates[1].variance() * bounces[1]);
+		double time_efficiency = estimates[0].variance() * seconds[0] / (estimates[1].variance() * seconds[1]);
+		bool valid = estimates[0].unbiased(reference, 1.0e-4) && estimates[1].unbiased(reference, 1.0e-4) && bounce_efficiency > 1.0;
+		passed = passed && valid;
+		out << "  " << scene.name << ", max depth " << scene.max_depth << ": relative bias " << estimates[0].relative_bias(reference) << " fixed, "
+			<< estimates[1].relative_bias(reference) << " roulette; relative variance " << estimates[0].relative_variance(reference) << " fixed, "
+			<< estimates[1].relative_variance(reference)
+			<< " roulette; bounces per path " << bounces[0] << " fixed, " << bounces[1] << " roulette; efficiency of the roulette "
+			<< bounce_efficiency << " per bounce, " << time_efficiency << " per second" << (valid ? "" : " FAILED") << std::endl;
+	}
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,102 @@
+#include "host_tests.h"
+#include "../sobol.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+bool sobol_report(std::ostream& out)
+{
+	const unsigned int pixels = 256;
+	const unsigned int slots = 1u + 4u * SOBOL_DIMENSIONS_PER_BOUNCE;
+	bool passed = true;
+
+	// stratification
+	unsigned int sets = 0, unstratified = 0;
+	for (unsigned int k = 1; k <= 10; ++k)
+	{
+		unsigned int n = 1u << k;
+		std::vector<unsigned int> cells(n);
+		for (unsigned int pixel = 0; pixel < 64; ++pixel)
+			for (unsigned int slot = 0; slot < slots; ++slot)
+			{
+				SobolSampler sampler = sobol_init(pixel, 0u);
+				bool stratified = true;
+				for (unsigned int a = 0; a <= k; ++a)
+				{
+					std::fill(cells.begin(), cells.end(), 0u);
+					for (sampler.index = 0; sampler.index < n; ++sampler.index)
+					{
+						optix::float2 p = sobol_2d(sampler, slot);
+						unsigned int cx = (unsigned int)(p.x * (1u << a));
+						unsigned int cy = (unsigned int)(p.y * (1u << (k - a)));
+						++cells[(cy << a) | cx];
+					}
+					for (unsigned int c = 0; c < n; ++c)
+						stratified = stratified && cells[c] == 1u;
+				}
+				std::fill(cells.begin(), cells.end(), 0u);
+				for (sampler.index = 0; sampler.index < n; ++sampler.index)
+					++cells[(unsigned int)(sobol_1d(sampler, slot) * n)];
+				for (unsigned int c = 0; c < n; ++c)
+					stratified = stratified && cells[c] == 1u;
+				++sets;
+				unstratified += stratified ? 0u : 1u;
+			}
+	}
+	passed = passed && unstratified == 0;
+	out << "Sobol sampler: " << sets - unstratified << " of " << sets << " sample sets of 2 to 1024 points stratified" << std::endl;
+
+	// RMSE over the pixels of the integral over the unit square of a gaussian
+	// and of the indicator of the quarter disk
+	const float smooth_reference = 0.25f * M_PIf * erff(1.0f) * erff(1.0f);
+	const float disk_reference = 0.25f * M_PIf;
+	const unsigned int slot = sobol_slot(1, SOBOL_BSDF_DIRECTION);
+	const unsigned int min_log_n = 4, max_log_n = 10;
+	float smooth_rmse[2][max_log_n + 1], disk_rmse[2][max_log_n + 1];
+	for (unsigned int k = min_log_n; k <= max_log_n; k += 2)
+	{
+		unsigned int n = 1u << k;
+		double smooth_sse[2] = { 0.0, 0.0 }, disk_sse[2] = { 0.0, 0.0 };
+		for (unsigned int pixel = 0; pixel < pixels; ++pixel)
+		{
+			SobolSampler sampler = sobol_init(pixel, 0u);
+			unsigned int t = tea<16>(pixel, k);
+			double smooth[2] = { 0.0, 0.0 }, disk[2] = { 0.0, 0.0 };
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				sampler.index = i;
+				optix::float2 p[2];
+				p[0] = sobol_2d(sampler, slot);
+				p[1].x = rnd_tea(t);
+				p[1].y = rnd_tea(t);
+				for (int j = 0; j < 2; ++j)
+				{
+					smooth[j] += expf(-(p[j].x * p[j].x + p[j].y * p[j].y));
+					disk[j] += p[j].x * p[j].x + p[j].y * p[j].y < 1.0f ? 1.0 : 0.0;
+				}
+			}
+			for (int j = 0; j < 2; ++j)
+			{
+				smooth_sse[j] += (smooth[j] / n - smooth_reference) * (smooth[j] / n - smooth_reference);
+				disk_sse[j] += (disk[j] / n - disk_reference) * (disk[j] / n - disk_reference);
+			}
+		}
+		for (int j = 0; j < 2; ++j)
+		{
+			smooth_rmse[j][k] = (float)sqrt(smooth_sse[j] / pixels);
+			disk_rmse[j][k] = (float)sqrt(disk_sse[j] / pixels);
+		}
+		passed = passed && smooth_rmse[0][k] < smooth_rmse[1][k] && disk_rmse[0][k] < disk_rmse[1][k];
+		out << "  " << n << " samples: gaussian RMSE " << smooth_rmse[0][k] << " (rnd_tea " << smooth_rmse[1][k]
+			<< "), quarter disk RMSE " << disk_rmse[0][k] << " (rnd_tea " << disk_rmse[1][k] << ")" << std::endl;
+	}
+	// convergence rate between the smallest and largest sample count
+	float log_ratio = logf((float)(1u << (max_log_n - min_log_n)));
+	float smooth_rate = logf(smooth_rmse[0][max_log_n] / smooth_rmse[0][min_log_n]) / log_ratio;
+	float disk_rate = logf(disk_rmse[0][max_log_n] / disk_rmse[0][min_log_n]) / log_ratio;
+	float random_rate = logf(smooth_rmse[1][max_log_n] / smooth_rmse[1][min_log_n]) / log_ratio;
+	passed = passed && smooth_rate < -1.0f;
+	out << "  convergence rate: gaussian N^" << smooth_rate << ", quarter disk N^" << disk_rate << " (rnd_tea N^" << random_rate << ")" << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
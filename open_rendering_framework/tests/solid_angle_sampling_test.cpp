@@ -0,0 +1,196 @@
+#include "host_tests.h"
+#include "../solid_angle_sampling.h"
+#include "../chi_square.h"
+#include <random>
+#include <vector>
+
+bool sphere_sampling_report(std::ostream& out)
+{
+	const unsigned int samples = 1u << 18;
+	std::mt19937 generator(30);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	const float radius = 0.5f;
+	const optix::float3 center = optix::make_float3(0.3f, -0.2f, 0.1f);
+	out << "Sphere light sampling: " << samples << " samples per receiver" << std::endl;
+	for (float ratio : { 1.01f, 1.5f, 3.0f, 10.0f, 100.0f, 1000.0f })
+	{
+		float sin_theta_max = 1.0f / ratio;
+		float theta_max = asinf(sin_theta_max);
+		optix::float3 w_c = optix::normalize(optix::make_float3(0.2f, 0.9f, -0.4f));
+		optix::float3 pos = center - ratio*radius*w_c;
+		for (float tilt : { 0.0f, 0.5f*(0.5f*M_PIf - theta_max) })
+		{
+			optix::float3 t_x, t_y;
+			solid_angle_onb(w_c, t_x, t_y);
+			optix::float3 normal = cosf(tilt)*w_c + sinf(tilt)*t_x;
+			double reference = M_PI*sin_theta_max*sin_theta_max*cos(tilt);
+
+			// solid angle then area
+			SampleMean estimates[2];
+			unsigned int outside_cone = 0;
+			for (unsigned int s = 0; s < samples; ++s)
+			{
+				optix::float2 xi = optix::make_float2(uniform(generator), uniform(generator));
+				optix::float3 light_pos, light_normal;
+				float pdf;
+				sample_sphere_solid_angle(pos, center, radius, xi, light_pos, light_normal, pdf);
+				optix::float3 dir = optix::normalize(light_pos - pos);
+				float cos_light = optix::dot(light_normal, -dir);
+				outside_cone += (cos_light < -1.0e-3f || optix::dot(dir, w_c) < cosf(theta_max) - 1.0e-5f) ? 1u : 0u;
+				double estimate = pdf > 0.0f ? optix::fmaxf(optix::dot(normal, dir), 0.0f) / pdf : 0.0;
+				estimates[0].add(estimate);
+
+				// the facing hemisphere by area, as evaluate_spherical_area_light did
+				optix::float3 u, v;
+				solid_angle_onb(-w_c, u, v);
+				float z = xi.x;
+				float r = sqrtf(optix::fmaxf(1.0f - z*z, 0.0f));
+				float phi = 2.0f*M_PIf*xi.y;
+				light_normal = r*cosf(phi)*u + r*sinf(phi)*v - z*w_c;
+				optix::float3 d = center + radius*light_normal - pos;
+				float dist_sqr = optix::dot(d, d);
+				dir = d / sqrtf(dist_sqr);
+				cos_light = optix::dot(light_normal, -dir);
+				estimate = cos_light > 0.0f ? optix::fmaxf(optix::dot(normal, dir), 0.0f)*cos_light / dist_sqr*2.0f*M_PIf*radius*radius : 0.0;
+				estimates[1].add(estimate);
+			}
+			bool unbiased = estimates[0].unbiased(reference, 1.0e-4) && estimates[1].unbiased(reference, 1.0e-4);
+			// the variance of the solid angle sampling vanishes facing the center
+			bool valid = unbiased && outside_cone == 0 && estimates[0].variance() < estimates[1].variance();
+			passed = passed && valid;
+			out << "  distance " << ratio << " radii, tilt " << tilt << ": relative bias " << estimates[0].relative_bias(reference) << " by solid angle, "
+				<< estimates[1].relative_bias(reference) << " by area, relative variance " << estimates[0].relative_variance(reference) << " by solid angle, "
+				<< estimates[1].relative_variance(reference) << " by area" << (outside_cone ? ", samples outside the cone" : "") << (valid ? "" : " FAILED") << std::endl;
+		}
+	}
+
+	// inside the sphere the estimate of the full solid angle is 4 pi
+	SampleMean inside_estimate;
+	optix::float3 inside = center + optix::make_float3(0.1f, 0.2f, -0.15f);
+	for (unsigned int s = 0; s < samples; ++s)
+	{
+		optix::float3 light_pos, light_normal;
+		float pdf;
+		sample_sphere_solid_angle(inside, center, radius, optix::make_float2(uniform(generator), uniform(generator)), light_pos, light_normal, pdf);
+		inside_estimate.add(pdf > 0.0f ? 1.0 / pdf : 0.0);
+	}
+	bool inside_valid = inside_estimate.unbiased(4.0*M_PI, 1.0e-4);
+	passed = passed && inside_valid;
+	out << "  inside the sphere: solid angle " << inside_estimate.mean() << " of " << 4.0*M_PI << (inside_valid ? "" : " FAILED") << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
+
+bool spherical_triangle_report(std::ostream& out)
+{
+	const unsigned int samples = 1u << 20, subdivisions = 8;
+	const double significance = 0.01;
+	std::mt19937 generator(31);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	bool passed = true;
+
+	const optix::float3 pos = optix::make_float3(0.0f);
+	const optix::float3 normal = optix::normalize(optix::make_float3(0.2f, 1.0f, -0.1f));
+	const optix::float3 triangles[][3] = {
+		{ optix::make_float3(-2.0f, 0.4f, -1.5f), optix::make_float3(2.0f, 0.4f, -1.5f), optix::make_float3(0.0f, 0.4f, 2.0f) },
+		{ optix::make_float3(-0.5f, 1.0f, -0.5f), optix::make_float3(0.5f, 1.0f, -0.3f), optix::make_float3(0.0f, 1.0f, 0.6f) },
+		{ optix::make_float3(-2.0f, 1.0f, 0.0f), optix::make_float3(2.0f, 1.2f, 0.1f), optix::make_float3(0.1f, 1.0f, 0.05f) },
+		{ optix::make_float3(1.0f, 0.5f, 0.0f), optix::make_float3(0.0f, 2.0f, 1.0f), optix::make_float3(-1.0f, 1.0f, -1.0f) },
+		{ optix::make_float3(-0.5f, 40.0f, -0.5f), optix::make_float3(0.5f, 40.0f, -0.3f), optix::make_float3(0.0f, 40.0f, 0.6f) },
+	};
+	const unsigned int count = sizeof(triangles) / sizeof(triangles[0]);
+
+	out << "Spherical triangle sampling: " << samples << " samples per triangle" << std::endl;
+	for (unsigned int k = 0; k < count; ++k)
+	{
+		const optix::float3& v0 = triangles[k][0];
+		const optix::float3& v1 = triangles[k][1];
+		const optix::float3& v2 = triangles[k][2];
+		optix::float3 e1 = v1 - v0, e2 = v2 - v0;
+		optix::float3 light_normal = optix::normalize(optix::cross(e1, e2));
+		if (optix::dot(light_normal, v0 - pos) > 0.0f)
+			light_normal = -light_normal;
+		float area = 0.5f*optix::length(optix::cross(e1, e2));
+		double solid_angle = spherical_triangle_solid_angle(pos, v0, v1, v2);
+
+		// irradiance of unit radiance [Lambert 1760]
+		const optix::float3 vertices[3] = { v0, v1, v2 };
+		double reference = 0.0;
+		for (int i = 0; i < 3; ++i)
+		{
+			optix::float3 a = optix::normalize(vertices[i] - pos);
+			optix::float3 b = optix::normalize(vertices[(i + 1) % 3] - pos);
+			reference += 0.5*spherical_angle_between(a, b)*optix::dot(normal, optix::normalize(optix::cross(a, b)));
+		}
+		reference = fabs(reference);
+
+		// expected counts of the sub-triangles of a uniform subdivision
+		// of the barycentric coordinates, lower ones then upper ones
+		std::vector<double> expected(subdivisions*subdivisions);
+		auto point = [&](float v, float w) { return v0 + e1*(v / subdivisions) + e2*(w / subdivisions); };
+		unsigned int bin = 0;
+		for (unsigned int i = 0; i < subdivisions; ++i)
+			for (unsigned int j = 0; i + j < subdivisions; ++j)
+			{
+				expected[bin++] = spherical_triangle_solid_angle(pos, point(i, j), point(i + 1, j), point(i, j + 1)) / solid_angle * samples;
+				if (i + j + 1 < subdivisions)
+					expected[bin++] = spherical_triangle_solid_angle(pos, point(i + 1, j), point(i + 1, j + 1), point(i, j + 1)) / solid_angle * samples;
+			}
+
+		std::vector<unsigned int> observed(expected.size(), 0u);
+		SampleMean estimates[2];
+		float pdf_error = 0.0f;
+		unsigned int failures = 0;
+		for (unsigned int s = 0; s < samples; ++s)
+		{
+			optix::float2 xi = optix::make_float2(uniform(generator), uniform(generator));
+			optix::float3 dir;
+			float pdf;
+			double estimate = 0.0;
+			if (sample_spherical_triangle(pos, v0, v1, v2, xi, dir, pdf))
+			{
+				pdf_error = fmaxf(pdf_error, fabsf((float)(pdf*solid_angle) - 1.0f));
+				estimate = optix::fmaxf(optix::dot(normal, dir), 0.0f) / pdf;
+
+				// barycentric coordinates of the point seen along dir [Moller and Trumbore 1997]
+				optix::float3 p = optix::cross(dir, e2);
+				float inv_det = 1.0f / optix::dot(e1, p);
+				optix::float3 t = pos - v0;
+				float v = optix::dot(t, p)*inv_det*subdivisions;
+				float w = optix::dot(dir, optix::cross(t, e1))*inv_det*subdivisions;
+				int i = std::min(std::max((int)floorf(v), 0), (int)subdivisions - 1);
+				int j = std::min(std::max((int)floorf(w), 0), (int)subdivisions - 1 - i);
+				bool upper = v - i + w - j > 1.0f && i + j + 1 < (int)subdivisions;
+				// bins of the rows before i, then the two of every cell before j
+				unsigned int index = i*(2 * subdivisions - i) + 2 * j + (upper ? 1 : 0);
+				++observed[std::min(index, (unsigned int)observed.size() - 1)];
+			}
+			else
+			{
+				++failures;
+			}
+			estimates[0].add(estimate);
+
+			// uniform point on the triangle by area
+			float sqrt_xi1 = sqrtf(xi.x);
+			optix::float3 d = v0*(1.0f - sqrt_xi1) + v1*((1.0f - xi.y)*sqrt_xi1) + v2*(xi.y*sqrt_xi1) - pos;
+			float dist_sqr = optix::dot(d, d);
+			dir = d / sqrtf(dist_sqr);
+			estimate = optix::fmaxf(optix::dot(normal, dir), 0.0f)*optix::fmaxf(optix::dot(light_normal, -dir), 0.0f) / dist_sqr*area;
+			estimates[1].add(estimate);
+		}
+		double p_value = chi_square_test(observed, expected);
+		// the float round-off of the spherical excess reaches 3e-4 at
+		// MIN_SPHERICAL_TRIANGLE_SOLID_ANGLE
+		bool unbiased = estimates[0].unbiased(reference, 1.0e-3) && estimates[1].unbiased(reference, 1.0e-3);
+		bool valid = failures == 0 && pdf_error < 1.0e-3f && p_value > significance / count && unbiased && estimates[0].variance() < estimates[1].variance();
+		passed = passed && valid;
+		out << "  " << solid_angle << " sr: pdf error " << pdf_error << ", p-value " << p_value << ", relative bias " << estimates[0].relative_bias(reference)
+			<< " by solid angle, " << estimates[1].relative_bias(reference) << " by area, relative variance " << estimates[0].relative_variance(reference) << " by solid angle, "
+			<< estimates[1].relative_variance(reference) << " by area" << (failures ? ", failed samples" : "") << (valid ? "" : " FAILED") << std::endl;
+	}
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,115 @@
+#include "host_tests.h"
+#include "../sss_allocation.h"
+#include <vector>
+
+namespace
+{
+	struct TranslucentBox
+	{
+		optix::float3 bbox_min, bbox_max;
+		optix::float3 transport;
+	};
+
+	float box_area(const TranslucentBox& box)
+	{
+		optix::float3 d = box.bbox_max - box.bbox_min;
+		return 2.0f*(d.x*d.y + d.y*d.z + d.z*d.x);
+	}
+
+	// Sum over the objects of screen coverage times the variance of the
+	// gather, area*transport^2 over the number of samples
+	double weighted_variance(const std::vector<float>& coverage, const std::vector<float>& area,
+		const std::vector<optix::float3>& transport, const unsigned int* counts)
+	{
+		double variance = 0.0;
+		for (size_t k = 0; k < coverage.size(); ++k)
+		{
+			double t = fmin(transport[k].x, fmin(transport[k].y, transport[k].z));
+			if (coverage[k] > 0.0f)
+				variance += coverage[k] * area[k] * t*t / counts[k];
+		}
+		return variance;
+	}
+}
+
+bool sss_allocation_report(std::ostream& out)
+{
+	// SAMPLES_FRAME of OptixSceneLoader, the samples of every object without a budget
+	const unsigned int samples_frame = 500;
+	const double min_gain = 1.5;
+	const double optimum_tolerance = 0.02;
+	// pinhole camera at the origin looking down -z with a 90 degree field of view
+	const optix::float3 eye = optix::make_float3(0.0f);
+	const optix::float3 U = optix::make_float3(1.0f, 0.0f, 0.0f);
+	const optix::float3 V = optix::make_float3(0.0f, 1.0f, 0.0f);
+	const optix::float3 W = optix::make_float3(0.0f, 0.0f, -1.0f);
+	// a hero, a small and an off-screen object
+	const TranslucentBox boxes[] = {
+		{ optix::make_float3(-0.63f, -0.63f, -1.2f), optix::make_float3(0.63f, 0.63f, -1.0f), optix::make_float3(1.5f, 2.0f, 3.0f) },
+		{ optix::make_float3(0.5f, 0.5f, -2.1f), optix::make_float3(1.1f, 1.1f, -2.0f), optix::make_float3(4.0f, 5.0f, 6.0f) },
+		{ optix::make_float3(5.0f, -0.5f, -3.0f), optix::make_float3(6.0f, 0.5f, -2.0f), optix::make_float3(1.5f, 2.0f, 3.0f) },
+	};
+	const unsigned int objects = sizeof(boxes) / sizeof(boxes[0]);
+	bool passed = true;
+
+	// the coverage of the front face of the hero is exact, the box reaching
+	// behind the camera covers everything
+	std::vector<float> coverage(objects), area(objects);
+	std::vector<optix::float3> transport(objects);
+	std::vector<double> importance(objects);
+	for (unsigned int k = 0; k < objects; ++k)
+	{
+		coverage[k] = sss_screen_coverage(boxes[k].bbox_min, boxes[k].bbox_max, eye, U, V, W);
+		area[k] = box_area(boxes[k]);
+		transport[k] = boxes[k].transport;
+		importance[k] = sss_sample_importance(coverage[k], area[k], transport[k]);
+	}
+	float behind = sss_screen_coverage(optix::make_float3(-1.0f), optix::make_float3(1.0f), eye, U, V, W);
+	bool coverage_valid = fabs(coverage[0] - 0.25f*1.26f*1.26f) < 1.0e-4f && coverage[1] > 0.0f && coverage[1] < coverage[0]
+		&& coverage[2] == 0.0f && behind == 1.0f;
+	passed = passed && coverage_valid;
+	out << "Subsurface sample allocation, screen coverage: hero " << coverage[0] << ", small " << coverage[1]
+		<< ", off-screen " << coverage[2] << ", around the camera " << behind << (coverage_valid ? "" : " FAILED") << std::endl;
+
+	// the budget of the fixed split, shared by coverage, area and transport
+	const unsigned int budget = objects * samples_frame;
+	std::vector<unsigned int> fixed(objects, samples_frame), counts(objects, samples_frame);
+	sss_split_budget(budget, importance.data(), counts.data(), objects);
+	unsigned int total = 0;
+	for (unsigned int k = 0; k < objects; ++k)
+		total += counts[k];
+	double fixed_variance = weighted_variance(coverage, area, transport, fixed.data());
+	double variance = weighted_variance(coverage, area, transport, counts.data());
+	double gain = fixed_variance / variance;
+	// the smallest weighted variance for the samples left by the minimum of
+	// the off-screen object, with shares proportional to the importance
+	double visible_importance = importance[0] + importance[1];
+	double optimum = visible_importance*visible_importance / (budget - SSS_MIN_SAMPLES);
+	bool split_valid = total == budget && counts[2] == SSS_MIN_SAMPLES && counts[0] > counts[1] && counts[1] > SSS_MIN_SAMPLES
+		&& gain >= min_gain && variance < (1.0 + optimum_tolerance)*optimum;
+	passed = passed && split_valid;
+	out << "  " << budget << " samples: hero " << counts[0] << ", small " << counts[1] << ", off-screen " << counts[2]
+		<< ", weighted variance " << variance << " (optimum " << optimum << ") against " << fixed_variance << " for "
+		<< samples_frame << " each, gain " << gain << " (at least " << min_gain << ")" << (split_valid ? "" : " FAILED") << std::endl;
+
+	// all off-screen: even split; budgets below the minimum: even split of the budget
+	std::vector<double> zero(objects, 0.0);
+	std::vector<unsigned int> even(objects, samples_frame), small(objects, samples_frame);
+	sss_split_budget(budget, zero.data(), even.data(), objects);
+	sss_split_budget(2 * objects, importance.data(), small.data(), objects);
+	bool fallback_valid = true;
+	for (unsigned int k = 0; k < objects; ++k)
+		fallback_valid = fallback_valid && even[k] == samples_frame && small[k] == 2u;
+	// objects shaded with probe rays keep no samples
+	std::vector<unsigned int> probes(objects, samples_frame);
+	probes[1] = 0;
+	sss_split_budget(budget, importance.data(), probes.data(), objects);
+	fallback_valid = fallback_valid && probes[1] == 0 && probes[0] + probes[2] == budget;
+	passed = passed && fallback_valid;
+	out << "  nothing on screen: " << even[0] << " " << even[1] << " " << even[2] << ", budget of " << 2 * objects
+		<< ": " << small[0] << " " << small[1] << " " << small[2] << ", probe rays on the small object: "
+		<< probes[0] << " " << probes[1] << " " << probes[2] << (fallback_valid ? "" : " FAILED") << std::endl;
+
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,102 @@
+#include "host_tests.h"
+#include "../triangle_light_table.h"
+#include <random>
+#include <vector>
+
+bool triangle_light_table_report(std::ostream& out)
+{
+	const unsigned int strips = 64, points = 256, light_samples = 16;
+	std::mt19937 generator(28);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+	// the first strips halve the remaining width, the others split the last
+	// 1/256 of the square evenly
+	std::vector<TriangleLight> triangles;
+	const unsigned int halving_strips = 8;
+	float x0 = 0.0f;
+	double total_area = 0.0;
+	for (unsigned int k = 0; k < strips; ++k)
+	{
+		float x1 = k < halving_strips ? 1.0f - ldexpf(1.0f, -(int)(k + 1)) :
+			1.0f - ldexpf(1.0f, -(int)halving_strips) * (strips - k - 1) / (strips - halving_strips);
+		optix::float3 corners[4] = { optix::make_float3(x0, 1.0f, 0.0f), optix::make_float3(x1, 1.0f, 0.0f),
+			optix::make_float3(x1, 1.0f, 1.0f), optix::make_float3(x0, 1.0f, 1.0f) };
+		for (int t = 0; t < 2; ++t)
+		{
+			TriangleLight triangle;
+			triangle.v0 = corners[0];
+			triangle.v1 = corners[1 + t];
+			triangle.v2 = corners[2 + t];
+			triangle.n0 = triangle.n1 = triangle.n2 = optix::make_float3(0.0f, -1.0f, 0.0f);
+			triangle.has_normals = 0;
+			triangle.emission = optix::make_float3(10.0f * uniform(generator));
+			triangle.area = 0.5f * (x1 - x0);
+			total_area += triangle.area;
+			triangles.push_back(triangle);
+		}
+		x0 = x1;
+	}
+	unsigned int count = (unsigned int)triangles.size();
+
+	bool passed = true;
+	const optix::float3 radiance = optix::make_float3(2.0f, 1.0f, 0.5f);
+	std::vector<AliasEntry> table(count), black_table(count), uniform_table(count);
+	build_triangle_light_alias_table(triangles.data(), count, radiance, table.data());
+	build_triangle_light_alias_table(triangles.data(), count, optix::make_float3(0.0f), black_table.data());
+	std::vector<float> ones(count, 1.0f);
+	build_alias_table(ones.data(), count, uniform_table.data());
+	float pmf_error = 0.0f;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		float expected = (float)(triangles[i].area / total_area);
+		pmf_error = fmaxf(pmf_error, fabsf(table[i].pmf - expected) / expected);
+		pmf_error = fmaxf(pmf_error, fabsf(black_table[i].pmf - expected) / expected);
+	}
+	passed = passed && pmf_error < 1.0e-4f;
+	out << "Triangle light tables: " << count << " triangles, areas " << triangles.back().area << " to " << triangles.front().area << std::endl;
+	out << "  pmf error " << pmf_error << " relative to the area" << std::endl;
+
+	// one sample estimate of the irradiance at x from the emitter, the radiance is one
+	auto estimate = [&](const std::vector<AliasEntry>& t, const optix::float3& x) {
+		float u = uniform(generator);
+		float pmf;
+		unsigned int i = sample_alias(t, 0u, count, u, pmf);
+		float sqrt_xi1 = sqrtf(uniform(generator));
+		float xi2 = uniform(generator);
+		const TriangleLight& triangle = triangles[i];
+		optix::float3 p = triangle.v0 * (1.0f - sqrt_xi1) + triangle.v1 * ((1.0f - xi2) * sqrt_xi1) + triangle.v2 * (xi2 * sqrt_xi1);
+		optix::float3 d = p - x;
+		float r_sqr = optix::dot(d, d);
+		float cos_theta = d.y / sqrtf(r_sqr);
+		return (double)(triangle.area * cos_theta * cos_theta / r_sqr / pmf);
+	};
+	double squared_error[2] = { 0.0, 0.0 }, mean[2] = { 0.0, 0.0 }, reference_mean = 0.0;
+	for (unsigned int p = 0; p < points; ++p)
+	{
+		optix::float3 x = optix::make_float3(2.0f * uniform(generator) - 0.5f, 0.0f, 2.0f * uniform(generator) - 0.5f);
+		double reference = 0.0;
+		const unsigned int reference_samples = 1u << 16;
+		for (unsigned int s = 0; s < reference_samples; ++s)
+			reference += estimate(table, x);
+		reference /= reference_samples;
+		reference_mean += reference;
+		for (int t = 0; t < 2; ++t)
+		{
+			double sum = 0.0;
+			for (unsigned int s = 0; s < light_samples; ++s)
+				sum += estimate(t == 0 ? table : uniform_table, x);
+			mean[t] += sum / light_samples;
+			double relative_error = (sum / light_samples - reference) / reference;
+			squared_error[t] += relative_error * relative_error;
+		}
+	}
+	float table_rmse = (float)sqrt(squared_error[0] / points);
+	float uniform_rmse = (float)sqrt(squared_error[1] / points);
+	// the mean over all points of the uniform estimate is itself noisy
+	float bias = (float)fabs(mean[1] / reference_mean - 1.0);
+	passed = passed && table_rmse < uniform_rmse && bias < 3.0f * uniform_rmse / sqrtf((float)points);
+	out << "  " << light_samples << " samples per point: relative RMSE " << table_rmse << " by area, " << uniform_rmse
+		<< " uniform, relative difference of the uniform mean " << bias << std::endl;
+	out << (passed ? "passed" : "FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,24 @@
+#ifndef TRIANGLE_LIGHT_TABLE_H
+#define TRIANGLE_LIGHT_TABLE_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "structs.h"
+#include "alias_table.h"
+
+// Alias table of the triangles of a TrianglesAreaLight, read by
+// evaluate_triangle_area_light. The shaders light every triangle of a mesh
+// with the emitted_radiance of its light, so triangles are weighted by area
+// times that radiance. A mesh without radiance falls back to area alone as
+// a whole, so that its table is still a valid distribution.
+static inline void build_triangle_light_alias_table(const TriangleLight* triangles, unsigned int count, const optix::float3& emitted_radiance, AliasEntry* table)
+{
+	float radiance = (emitted_radiance.x + emitted_radiance.y + emitted_radiance.z) / 3.0f;
+	if (!(radiance > 0.0f))
+		radiance = 1.0f;
+	std::vector<float> weights(count);
+	for (unsigned int i = 0; i < count; i++)
+		weights[i] = triangles[i].area * radiance;
+	build_alias_table(weights.data(), count, table);
+}
+
+#endif // TRIANGLE_LIGHT_TABLE_H